@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock bench_clock;
+
+// Microseconds since start
+inline double elapsed_us(bench_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(bench_clock::now() - start).count();
+}
+
+// Value below which the given fraction of the samples lie, the samples are sorted
+inline double percentile(std::vector<double> &samples, double fraction)
+{
+    if (samples.empty()) return 0;
+    std::sort(samples.begin(), samples.end());
+    size_t idx = static_cast<size_t>(fraction * (samples.size() - 1) + 0.5);
+    return samples[std::min(idx, samples.size() - 1)];
+}
+
+// Prints throughput and latency percentiles of a run, latencies in microseconds
+inline void print_result(const std::string &name, size_t ops, double seconds, std::vector<double> &latencies)
+{
+    printf("%-32s %10.0f ops/s   p50 %9.1f us   p99 %9.1f us   p99.9 %9.1f us\n", name.c_str(), ops / seconds,
+           percentile(latencies, 0.5), percentile(latencies, 0.99), percentile(latencies, 0.999));
+}
+
+// Peak resident set size of the process in kilobytes
+inline size_t peak_rss_kb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+// Numeric command line argument or its default
+inline size_t arg_or(int argc, char *argv[], int idx, size_t fallback)
+{
+    return argc > idx ? std::strtoull(argv[idx], nullptr, 10) : fallback;
+}
+
+// Connects to a server on this host, returns the socket or -1
+inline int connect_local(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Reads a line without its CRLF from a blocking socket, bytes read past the line stay in buffer
+inline bool read_line(int fd, std::string &buffer, std::string &line)
+{
+    size_t end;
+    while ((end = buffer.find("\r\n")) == std::string::npos)
+    {
+        char chunk[4096];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+    }
+    line = buffer.substr(0, end);
+    buffer.erase(0, end + 2);
+    return true;
+}
+
+// Sends all bytes to a blocking socket
+inline bool send_all(int fd, const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Raises the limit of open files to the hard limit, returns the new limit
+inline size_t raise_file_limit()
+{
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    return limit.rlim_cur;
+}
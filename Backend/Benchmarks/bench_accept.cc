@@ -0,0 +1,96 @@
+// Accept latency benchmark against a running server: opens connections in bursts separated by idle gaps and
+// measures the time from connect until the welcome line of the server arrives
+// Run it against servers built before and after the epoll accept loop to compare them
+// Usage: bench_accept [port] [bursts] [connections per burst] [gap between bursts in ms]
+
+#include <cerrno>
+#include <fcntl.h>
+#include <thread>
+#include <sys/epoll.h>
+#include "BenchUtil.h"
+
+// Opens a burst of connections at once, adds the connect-to-welcome latency of each one to latencies
+static void run_burst(int port, size_t connections, std::vector<double> &latencies)
+{
+    int epoll_fd = epoll_create1(0);
+    std::vector<int> fds;
+    std::vector<bench_clock::time_point> started;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    // Non-blocking connects, so all connections of the burst reach the server together
+    for (size_t i = 0; i < connections; ++i)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        started.push_back(bench_clock::now());
+        if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 && errno != EINPROGRESS)
+        {
+            close(fd);
+            started.pop_back();
+            continue;
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = fds.size();
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+        fds.push_back(fd);
+    }
+
+    // The welcome line is the first thing the server sends
+    size_t pending{fds.size()};
+    std::vector<epoll_event> events(256);
+    while (pending > 0)
+    {
+        int ready = epoll_wait(epoll_fd, events.data(), events.size(), 10000);
+        if (ready <= 0)
+        {
+            fprintf(stderr, "No welcome within 10 s on %zu connections\n", pending);
+            break;
+        }
+        for (int e = 0; e < ready; ++e)
+        {
+            const size_t i = events[e].data.u64;
+            latencies.push_back(elapsed_us(started[i]));
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fds[i], nullptr);
+            --pending;
+        }
+    }
+
+    for (int fd : fds) close(fd);
+    close(epoll_fd);
+}
+
+int main(int argc, char *argv[])
+{
+    const int port = arg_or(argc, argv, 1, 8080);
+    const size_t bursts{arg_or(argc, argv, 2, 50)};
+    const size_t connections{arg_or(argc, argv, 3, 50)};
+    const size_t gap_ms{arg_or(argc, argv, 4, 250)};
+    printf("port %d, %zu bursts of %zu connections, %zu ms apart, file limit %zu\n", port, bursts, connections, gap_ms,
+           raise_file_limit());
+
+    std::vector<double> latencies, first_latencies;
+    auto start = bench_clock::now();
+    double idle_us{0};
+    for (size_t burst = 0; burst < bursts; ++burst)
+    {
+        // The server is idle between bursts
+        std::this_thread::sleep_for(std::chrono::milliseconds(gap_ms));
+        idle_us += gap_ms * 1000.0;
+
+        std::vector<double> burst_latencies;
+        run_burst(port, connections, burst_latencies);
+        if (!burst_latencies.empty())
+            first_latencies.push_back(*std::min_element(burst_latencies.begin(), burst_latencies.end()));
+        latencies.insert(latencies.end(), burst_latencies.begin(), burst_latencies.end());
+    }
+    const double seconds = (elapsed_us(start) - idle_us) / 1e6;
+
+    print_result("connect to welcome", latencies.size(), seconds, latencies);
+    printf("%-32s p50 %9.1f us   p99 %9.1f us\n", "first connection of a burst", percentile(first_latencies, 0.5),
+           percentile(first_latencies, 0.99));
+    return 0;
+}
@@ -0,0 +1,146 @@
+// Checkpoint load benchmark: single-file mapped checkpoint against the former index and binary file pair
+// Each load runs in its own process, so the peak RSS of one format does not hide the other
+// Usage: bench_checkpoint [rows] [columns per row] [value bytes]
+
+#include <filesystem>
+#include <fstream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "BenchUtil.h"
+#include "Tablet.h"
+
+namespace fs = std::filesystem;
+
+// Resident set size of the process in kilobytes
+static size_t current_rss_kb()
+{
+    size_t pages{0}, resident{0};
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm)
+    {
+        if (fscanf(statm, "%zu %zu", &pages, &resident) != 2) resident = 0;
+        fclose(statm);
+    }
+    return resident * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+// Former checkpoint format, a text index of row,column,size lines and the values concatenated in a binary file
+static void write_pair(const Tablet &tablet, const std::string &filename)
+{
+    std::ofstream ofs_bin{filename + ".bin.tblt", std::ios::binary};
+    std::ofstream ofs_idx{filename + ".idx.tblt"};
+    std::set<std::string> row_keys;
+    tablet.list_rows(row_keys);
+    for (const std::string &row_key : row_keys)
+    {
+        std::set<std::string> column_keys;
+        tablet.list_columns(row_key, column_keys);
+        for (const std::string &column_key : column_keys)
+        {
+            tablet_value value;
+            tablet.read(row_key, column_key, value);
+            ofs_idx << row_key << "," << column_key << "," << value.size() << "\n";
+            ofs_bin.write(reinterpret_cast<const char *>(value.data()), value.size());
+        }
+    }
+}
+
+// Builds the tablet and writes it in both formats
+static void generate(const fs::path &dir, size_t rows, size_t columns, size_t value_bytes)
+{
+    Tablet tablet;
+    for (size_t r = 0; r < rows; ++r)
+    {
+        const std::string row_key{"user" + std::to_string(r)};
+        tablet.create_row(row_key);
+        for (size_t c = 0; c < columns; ++c)
+        {
+            tablet_value value(value_bytes, std::byte(r + c));
+            tablet.write(row_key, "column" + std::to_string(c), value);
+        }
+    }
+    tablet.save_to_file((dir / "chk").string());
+    write_pair(tablet, (dir / "pair").string());
+}
+
+// Reads every value of the tablet once, returns the number of bytes read
+static size_t read_all(const Tablet &tablet)
+{
+    size_t bytes{0};
+    std::set<std::string> row_keys;
+    tablet.list_rows(row_keys);
+    for (const std::string &row_key : row_keys)
+    {
+        std::set<std::string> column_keys;
+        tablet.list_columns(row_key, column_keys);
+        for (const std::string &column_key : column_keys)
+        {
+            tablet_value value;
+            tablet.read(row_key, column_key, value);
+            bytes += value.size();
+        }
+    }
+    return bytes;
+}
+
+// Loads one checkpoint and reports load time, peak RSS and the RSS growth over the process before loading
+// With read_values every value is read once after loading, which pages in values left in the checkpoint
+static void load(const std::string &name, const fs::path &filename, bool paged, bool read_values)
+{
+    const size_t rss_before{current_rss_kb()};
+    Tablet tablet;
+    auto start = bench_clock::now();
+    tablet.read_from_file(filename.string(), paged);
+    if (read_values) read_all(tablet);
+    const double ms = elapsed_us(start) / 1e3;
+    const size_t peak{peak_rss_kb()};
+    printf("%-36s %8.1f ms   %8.1f MB peak RSS   %8.1f MB above start   %zu rows\n", name.c_str(), ms,
+           peak / 1024.0, (peak - rss_before) / 1024.0, tablet.row_count());
+}
+
+// Runs a function in a child process and waits for it
+template <typename Run>
+static void in_child(Run run)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        run();
+        fflush(stdout);
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t rows{arg_or(argc, argv, 1, 15000)};
+    const size_t columns{arg_or(argc, argv, 2, 10)};
+    const size_t value_bytes{arg_or(argc, argv, 3, 1000)};
+
+    const fs::path dir{fs::temp_directory_path() / ("bench_checkpoint_" + std::to_string(getpid()))};
+    fs::create_directories(dir);
+    printf("%zu rows x %zu columns of %zu bytes (%.1f MB of values) in %s\n", rows, columns, value_bytes,
+           rows * columns * value_bytes / 1e6, dir.c_str());
+
+    in_child([&] { generate(dir, rows, columns, value_bytes); });
+
+    for (bool read_values : {false, true})
+    {
+        const std::string suffix{read_values ? ", load + read all" : ", load"};
+        const std::pair<std::string, bool> formats[]{{"pair", false}, {"chk", false}, {"chk", true}};
+        for (const auto &[file, paged] : formats)
+        {
+            // Drop the checkpoints from the page cache where permitted, so every load starts out cold
+            sync();
+            std::ofstream{"/proc/sys/vm/drop_caches"} << "1\n";
+            const std::string name{file == "pair" ? "index + binary pair" : paged ? "single file paged" : "single file"};
+            in_child([&] { load(name + suffix, dir / file, paged, read_values); });
+        }
+    }
+
+    fs::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Connection scaling benchmark against a running server: holds idle connections open while active connections
+// send requests in a closed loop, and reports request latency and the threads and memory of the server
+// Run it against servers built before and after the reactor to compare them
+// Usage: bench_connections [port] [idle connections] [active connections] [requests per active connection] [server pid]
+
+#include <cstring>
+#include <sys/epoll.h>
+#include "BenchUtil.h"
+
+// Request answered with a single line, reads a row that does not exist
+static const std::string REQUEST{"GET bench-connections-row column\r\n"};
+
+// Prints the threads and resident memory of the server
+static void print_server(const std::string &when, size_t pid)
+{
+    if (!pid) return;
+    FILE *status = fopen(("/proc/" + std::to_string(pid) + "/status").c_str(), "r");
+    if (!status) return;
+    size_t threads{0}, rss_kb{0};
+    char line[256];
+    while (fgets(line, sizeof(line), status))
+    {
+        sscanf(line, "Threads: %zu", &threads);
+        sscanf(line, "VmRSS: %zu", &rss_kb);
+    }
+    fclose(status);
+    printf("%-32s %10zu threads %10.1f MB RSS\n", ("server " + when).c_str(), threads, rss_kb / 1024.0);
+}
+
+// Connections opened before their welcome lines are read, stays below the listen backlog of the server
+static constexpr size_t CONNECT_BATCH{100};
+
+// Opens connections and waits for the welcome line on each, returns the sockets
+static std::vector<int> open_connections(int port, size_t count)
+{
+    std::vector<int> fds;
+    std::string buffer, line;
+    while (fds.size() < count)
+    {
+        const size_t batch_start{fds.size()};
+        while (fds.size() < std::min(count, batch_start + CONNECT_BATCH))
+        {
+            int fd = connect_local(port);
+            if (fd < 0)
+            {
+                fprintf(stderr, "Connection %zu failed: %s\n", fds.size(), strerror(errno));
+                return fds;
+            }
+            fds.push_back(fd);
+        }
+        for (size_t i = batch_start; i < fds.size(); ++i)
+        {
+            buffer.clear();
+            if (!read_line(fds[i], buffer, line))
+            {
+                fprintf(stderr, "No welcome on connection %zu\n", i);
+                for (size_t j = i; j < fds.size(); ++j) close(fds[j]);
+                fds.resize(i);
+                return fds;
+            }
+        }
+    }
+    return fds;
+}
+
+int main(int argc, char *argv[])
+{
+    const int port = arg_or(argc, argv, 1, 8080);
+    const size_t idle{arg_or(argc, argv, 2, 10000)};
+    const size_t active{arg_or(argc, argv, 3, 1000)};
+    const size_t requests{arg_or(argc, argv, 4, 100)};
+    const size_t pid{arg_or(argc, argv, 5, 0)};
+
+    printf("port %d, %zu idle and %zu active connections, %zu requests each, file limit %zu\n", port, idle, active,
+           requests, raise_file_limit());
+    print_server("before", pid);
+
+    auto start = bench_clock::now();
+    std::vector<int> idle_fds{open_connections(port, idle)};
+    printf("%-32s %10zu in %.1f ms\n", "idle connections", idle_fds.size(), elapsed_us(start) / 1e3);
+    print_server("with idle connections", pid);
+
+    std::vector<int> active_fds{open_connections(port, active)};
+    if (active_fds.empty()) return 1;
+
+    // One request in flight per active connection, the next one is sent when the reply arrived
+    int epoll_fd = epoll_create1(0);
+    std::vector<std::string> buffers(active_fds.size());
+    std::vector<bench_clock::time_point> sent(active_fds.size());
+    std::vector<size_t> remaining(active_fds.size(), requests);
+    std::vector<double> latencies;
+    latencies.reserve(active_fds.size() * requests);
+    for (size_t i = 0; i < active_fds.size(); ++i)
+    {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = i;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, active_fds[i], &event);
+    }
+
+    start = bench_clock::now();
+    for (size_t i = 0; i < active_fds.size(); ++i)
+    {
+        sent[i] = bench_clock::now();
+        send_all(active_fds[i], REQUEST.data(), REQUEST.size());
+    }
+
+    size_t pending{active_fds.size()};
+    std::vector<epoll_event> events(1024);
+    while (pending > 0)
+    {
+        int ready = epoll_wait(epoll_fd, events.data(), events.size(), 10000);
+        if (ready <= 0)
+        {
+            fprintf(stderr, "No reply within 10 s, %zu connections pending\n", pending);
+            break;
+        }
+        for (int e = 0; e < ready; ++e)
+        {
+            const size_t i = events[e].data.u64;
+            char chunk[4096];
+            ssize_t n = recv(active_fds[i], chunk, sizeof(chunk), 0);
+            if (n <= 0)
+            {
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, active_fds[i], nullptr);
+                --pending;
+                continue;
+            }
+            buffers[i].append(chunk, n);
+
+            size_t end;
+            while ((end = buffers[i].find("\r\n")) != std::string::npos)
+            {
+                buffers[i].erase(0, end + 2);
+                latencies.push_back(elapsed_us(sent[i]));
+                if (--remaining[i] == 0)
+                {
+                    --pending;
+                    break;
+                }
+                sent[i] = bench_clock::now();
+                send_all(active_fds[i], REQUEST.data(), REQUEST.size());
+            }
+        }
+    }
+    const double seconds = elapsed_us(start) / 1e6;
+    print_server("with active connections", pid);
+    print_result("requests on active connections", latencies.size(), seconds, latencies);
+
+    close(epoll_fd);
+    for (int fd : active_fds) close(fd);
+    for (int fd : idle_fds) close(fd);
+    return 0;
+}
@@ -0,0 +1,164 @@
+// Write consistency benchmark: latency of shipping the records of a write to the replicas with ReplicationLog at
+// the ALL, QUORUM and ONE consistency levels while one replica is slow
+// The replicas and the coordinator listing them are fake servers in this process, the replicas acknowledge every
+// message after a delay. Only the replication of a write is timed, not applying it to the tablets of the primary
+// Usage: bench_consistency [replicas] [writes] [value bytes] [replica delay in us] [slow replica delay in us] [port]
+
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "BenchUtil.h"
+#include "CoordinatorService.h"
+#include "Globals.h"
+#include "KVServerCommand.h"
+#include "ReplicationLog.h"
+#include "TabletLogRecord.h"
+
+// Listens on a port of this host, returns the socket or -1
+static int listen_local(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int optval = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(fd, 64) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Accepts connections on a listening socket and serves each one on its own thread
+template <typename Serve>
+static void accept_loop(int listen_fd, Serve serve)
+{
+    std::thread([listen_fd, serve]
+    {
+        int fd;
+        while ((fd = accept(listen_fd, nullptr, nullptr)) >= 0)
+            std::thread(serve, fd).detach();
+    }).detach();
+}
+
+// Fake coordinator: answers KVLIST with the replication group and QUIT, as the coordinator does
+static void serve_coordinator(int fd, const std::string &group)
+{
+    std::string buffer, line;
+    bool ok = send_all(fd, "+OK Server ready\r\n", 18);
+    while (ok && read_line(fd, buffer, line))
+    {
+        const std::string response{line == "KVLIST" ? group + "\r\n" : "+OK Service closing transmission channel\r\n"};
+        ok = send_all(fd, response.data(), response.size()) && line != "QUIT";
+    }
+    close(fd);
+}
+
+// Fake replica on its internal port: acknowledges every LOG message with its last record after the delay
+static void serve_replica(int fd, size_t delay_us)
+{
+    std::string buffer, line;
+    char chunk[4096];
+    while (read_line(fd, buffer, line))
+    {
+        // "#LOG <stream> <bytes>" is followed by the records and CRLF
+        std::istringstream parts{line};
+        std::string command;
+        uint64_t stream{0};
+        size_t bytes{0};
+        parts >> command >> stream >> bytes;
+        while (buffer.size() < bytes + 2)
+        {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) break;
+            buffer.append(chunk, n);
+        }
+        if (buffer.size() < bytes + 2) break;
+
+        std::string_view records{buffer.data(), bytes};
+        TabletLogEntry entry;
+        uint64_t last{0};
+        size_t record_size;
+        while (!records.empty() && (record_size = parse_log_record(records, entry)) != 0)
+        {
+            last = entry.version;
+            records.remove_prefix(record_size);
+        }
+        buffer.erase(0, bytes + 2);
+
+        std::this_thread::sleep_for(std::chrono::microseconds(delay_us));
+        const std::string ack{"+OK " + std::to_string(last) + "\r\n"};
+        if (!send_all(fd, ack.data(), ack.size())) break;
+    }
+    close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t replicas{std::max<size_t>(1, arg_or(argc, argv, 1, 2))};
+    const size_t writes{arg_or(argc, argv, 2, 300)};
+    const size_t value_bytes{arg_or(argc, argv, 3, 1000)};
+    const size_t delay_us{arg_or(argc, argv, 4, 200)};
+    const size_t slow_delay_us{arg_or(argc, argv, 5, 20000)};
+    const int port = arg_or(argc, argv, 6, 9300);
+    printf("primary and %zu replicas, %zu writes, %zu byte values, replicas reply after %zu us, the last one after "
+           "%zu us\n", replicas, writes, value_bytes, delay_us, slow_delay_us);
+
+    // This process is the primary of replication group 0, the replicas take the ports after it, two apart as the
+    // internal port of a server is its port plus one. The last replica is the slow one
+    HOST = "127.0.0.1";
+    PORT_NO = port;
+    RG_ID = 0;
+    std::string group{"0:(127.0.0.1:" + std::to_string(port) + ",true,true)"};
+    for (size_t i = 1; i <= replicas; ++i)
+    {
+        const int replica_port = port + 2 * i;
+        const size_t delay = i == replicas ? slow_delay_us : delay_us;
+        int listen_fd = listen_local(replica_port + 1);
+        if (listen_fd < 0)
+        {
+            fprintf(stderr, "Cannot listen on port %d\n", replica_port + 1);
+            return 1;
+        }
+        accept_loop(listen_fd, [delay](int fd) { serve_replica(fd, delay); });
+        group += "(127.0.0.1:" + std::to_string(replica_port) + ",false,true)";
+    }
+
+    const int coordinator_port = port + 2 * (replicas + 1);
+    int coordinator_fd = listen_local(coordinator_port);
+    if (coordinator_fd < 0)
+    {
+        fprintf(stderr, "Cannot listen on port %d\n", coordinator_port);
+        return 1;
+    }
+    accept_loop(coordinator_fd, [group](int fd) { serve_coordinator(fd, group); });
+    COORDINATOR_SERVICE = new CoordinatorService("127.0.0.1", coordinator_port, false);
+    std::thread([] { COORDINATOR_SERVICE->start(RUN_COORDINATOR_SERVICE); }).detach();
+    COORDINATOR_SERVICE->wait_until_ready();
+
+    // ALL goes first, QUORUM and ONE leave a backlog on the slow replica that ALL writes would wait for
+    const std::string value(value_bytes, 'v');
+    for (auto [name, consistency] : {std::pair{"ALL", WriteConsistency::ALL},
+                                     std::pair{"QUORUM", WriteConsistency::QUORUM},
+                                     std::pair{"ONE", WriteConsistency::ONE}})
+    {
+        std::vector<double> latencies;
+        size_t failed{0};
+        auto start = bench_clock::now();
+        for (size_t w = 0; w < writes; ++w)
+        {
+            auto op_start = bench_clock::now();
+            std::vector<TabletLogRecord> records;
+            records.emplace_back(TabletLoggerCmdType::PUT, "00000000000000000009", "column" + std::to_string(w), value);
+            failed += !replication_log.ship("bench" + std::to_string(w), records, consistency).success;
+            latencies.push_back(elapsed_us(op_start));
+        }
+        print_result(name, writes, elapsed_us(start) / 1e6, latencies);
+        if (failed) fprintf(stderr, "%zu writes failed\n", failed);
+    }
+    return 0;
+}
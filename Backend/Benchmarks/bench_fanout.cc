@@ -0,0 +1,135 @@
+// Replica fan-out benchmark: write latency of IStorageService::broadcast_put, which sends to all replicas at once,
+// against sending the same request to one replica after the other as broadcasts did before
+// The replicas are fake servers in this process that acknowledge each write after a delay, one of them is slow
+// Usage: bench_fanout [replicas] [writes] [value bytes] [replica delay in us] [slow replica delay in us]
+
+#include <sstream>
+#include <thread>
+#include "BenchUtil.h"
+#include "IStorageService.h"
+#include "RequestAssembler.h"
+
+static const std::string ROW_KEY{"00000000000000000009"};
+
+// Reads the rest of a value and its CRLF that follow a request line
+static bool read_value(int fd, std::string &buffer, size_t bytes)
+{
+    char chunk[4096];
+    while (buffer.size() < bytes)
+    {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+    }
+    buffer.erase(0, bytes);
+    return true;
+}
+
+// Serves one connection of a fake replica: welcome line, then "+OK" for every request after the delay
+static void serve_replica(int fd, size_t delay_us)
+{
+    std::string buffer, line;
+    bool ok = send_all(fd, "+OK KVStore ready [penncloud]\r\n", 31);
+    while (ok && read_line(fd, buffer, line))
+    {
+        // "#PUT <row> <column> <bytes>" is followed by the value
+        std::istringstream parts{line};
+        std::string command, row, column;
+        size_t bytes{0};
+        parts >> command >> row >> column >> bytes;
+        ok = command != "#PUT" || read_value(fd, buffer, bytes + 2);
+        std::this_thread::sleep_for(std::chrono::microseconds(delay_us));
+        ok = ok && send_all(fd, "+OK\r\n", 5);
+    }
+    close(fd);
+}
+
+// Starts a fake replica on a free port, returns the port
+static int start_replica(size_t delay_us)
+{
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), addr_len) < 0 || listen(listen_fd, 64) < 0 ||
+        getsockname(listen_fd, reinterpret_cast<sockaddr *>(&addr), &addr_len) < 0)
+        return -1;
+    std::thread([listen_fd, delay_us]
+    {
+        int fd;
+        while ((fd = accept(listen_fd, nullptr, nullptr)) >= 0)
+            std::thread(serve_replica, fd, delay_us).detach();
+    }).detach();
+    return ntohs(addr.sin_port);
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t replicas{std::max<size_t>(1, arg_or(argc, argv, 1, 3))};
+    const size_t writes{arg_or(argc, argv, 2, 200)};
+    const size_t value_bytes{arg_or(argc, argv, 3, 1000)};
+    const size_t delay_us{arg_or(argc, argv, 4, 5000)};
+    const size_t slow_delay_us{arg_or(argc, argv, 5, 20000)};
+    printf("%zu replicas, %zu writes, %zu byte values, replicas reply after %zu us, the last one after %zu us\n",
+           replicas, writes, value_bytes, delay_us, slow_delay_us);
+
+    // The last replica is the slow one
+    std::vector<KVServer> servers;
+    for (size_t i = 0; i < replicas; ++i)
+    {
+        int port = start_replica(i + 1 == replicas ? slow_delay_us : delay_us);
+        if (port < 0)
+        {
+            fprintf(stderr, "Cannot start replica %zu\n", i);
+            return 1;
+        }
+        servers.push_back({"127.0.0.1", port, 0, i == 0, true});
+    }
+    const tablet_value value(value_bytes, std::byte{'v'});
+
+    // One replica after the other over a connection to each, the latency is the sum of the replicas
+    {
+        std::vector<int> fds;
+        std::vector<std::string> buffers(replicas);
+        std::string line;
+        for (size_t i = 0; i < replicas; ++i)
+        {
+            fds.push_back(connect_local(servers[i].port));
+            read_line(fds[i], buffers[i], line);
+        }
+        std::vector<double> latencies;
+        size_t failed{0};
+        auto start = bench_clock::now();
+        for (size_t w = 0; w < writes; ++w)
+        {
+            auto op_start = bench_clock::now();
+            const std::string request{"#" + RequestAssembler::assemble_put(ROW_KEY, "column" + std::to_string(w), value)};
+            for (size_t i = 0; i < replicas; ++i)
+                failed += !send_all(fds[i], request.data(), request.size()) || !read_line(fds[i], buffers[i], line);
+            latencies.push_back(elapsed_us(op_start));
+        }
+        print_result("one replica after the other", writes, elapsed_us(start) / 1e6, latencies);
+        if (failed) fprintf(stderr, "%zu requests failed\n", failed);
+        for (int fd : fds) close(fd);
+    }
+
+    // All replicas at once, the latency is the slowest replica
+    {
+        IStorageService service({{0, servers}});
+        std::vector<double> latencies;
+        size_t failed{0};
+        auto start = bench_clock::now();
+        for (size_t w = 0; w < writes; ++w)
+        {
+            auto op_start = bench_clock::now();
+            BroadcastResult result = service.broadcast_put(0, "bench" + std::to_string(w), ROW_KEY,
+                                                           "column" + std::to_string(w), value);
+            latencies.push_back(elapsed_us(op_start));
+            for (const auto &[server, status] : result.status_codes) failed += status != 0;
+        }
+        print_result("broadcast_put", writes, elapsed_us(start) / 1e6, latencies);
+        if (failed) fprintf(stderr, "%zu requests failed\n", failed);
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+// Write-ahead log benchmark: group-commit log segment of TabletLogger against the former per-operation scheme,
+// which opened the log, appended one record, closed it and renamed the file to the next version for every write
+// Usage: bench_log [threads] [records per thread] [value bytes]
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "BenchUtil.h"
+#include "TabletLogger.h"
+
+namespace fs = std::filesystem;
+
+// Former logging of a write, optionally followed by an fsync so the record is as durable as with group commit
+static void log_write_rename(const fs::path &path, size_t &version, const std::string &row_key,
+                             const std::string &column_key, const tablet_value &value, bool sync)
+{
+    const fs::path old_file{path / ("0_0_" + std::to_string(version) + ".log.tblt")};
+    const fs::path new_file{path / ("0_0_" + std::to_string(version + 1) + ".log.tblt")};
+    std::ofstream ofs_log{old_file, std::ios::app | std::ios::binary};
+
+    ++version;
+    ofs_log << "put," << version << "," << row_key << "," << column_key << "," << value.size() << "\n";
+    ofs_log.write(reinterpret_cast<const char *>(value.data()), value.size());
+    ofs_log << "\n";
+    ofs_log.close();
+
+    if (sync)
+    {
+        int fd = open(old_file.c_str(), O_RDONLY);
+        if (fd >= 0)
+        {
+            fdatasync(fd);
+            close(fd);
+        }
+    }
+
+    fs::rename(old_file, new_file);
+}
+
+// Runs one writer per thread, each logging records and timing every write until it is logged
+template <typename Write>
+static void run(const std::string &name, size_t threads, size_t records, Write write)
+{
+    std::vector<std::vector<double>> thread_latencies(threads);
+    std::vector<std::thread> writers;
+    auto start = bench_clock::now();
+    for (size_t t = 0; t < threads; ++t)
+    {
+        writers.emplace_back([&, t]
+        {
+            thread_latencies[t].reserve(records);
+            for (size_t i = 0; i < records; ++i)
+            {
+                auto op_start = bench_clock::now();
+                write(t, i);
+                thread_latencies[t].push_back(elapsed_us(op_start));
+            }
+        });
+    }
+    for (std::thread &writer : writers) writer.join();
+    double seconds = elapsed_us(start) / 1e6;
+
+    std::vector<double> latencies;
+    for (const auto &samples : thread_latencies) latencies.insert(latencies.end(), samples.begin(), samples.end());
+    print_result(name, threads * records, seconds, latencies);
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t threads{arg_or(argc, argv, 1, 8)};
+    const size_t records{arg_or(argc, argv, 2, 2000)};
+    const size_t value_bytes{arg_or(argc, argv, 3, 128)};
+    const tablet_value value(value_bytes, std::byte{'x'});
+
+    const fs::path path{fs::temp_directory_path() / ("bench_log_" + std::to_string(getpid()))};
+    printf("%zu threads, %zu records each, %zu byte values, log in %s\n", threads, records, value_bytes, path.c_str());
+
+    for (bool sync : {false, true})
+    {
+        fs::remove_all(path);
+        fs::create_directories(path);
+        // The former scheme serialized writers of a tablet on the tablet lock
+        std::mutex tablet_mutex;
+        size_t version{0};
+        run(sync ? "per-op rename + fdatasync" : "per-op rename (no fsync)", threads, records, [&](size_t t, size_t i)
+        {
+            std::lock_guard lock{tablet_mutex};
+            log_write_rename(path, version, "row" + std::to_string(t), "col" + std::to_string(i), value, sync);
+        });
+    }
+
+    {
+        fs::remove_all(path);
+        fs::create_directories(path);
+        TabletLogger logger{0};
+        run("group commit", threads, records, [&](size_t t, size_t i)
+        {
+            std::shared_future<void> committed = logger.log_write(path, "row" + std::to_string(t), "col" + std::to_string(i), value);
+            logger.applied();
+            TabletLogger::wait_durable(committed);
+        });
+    }
+
+    fs::remove_all(path);
+    return 0;
+}
@@ -0,0 +1,106 @@
+// Connection pool benchmark against a running replication group: small GETs and PUTs through IStorageService,
+// whose connections are pooled, against a new connection per request as IStorageService opened before
+// Each request creates its own IStorageService, as the frontend handlers do
+// Usage: bench_pool [threads] [requests per thread] [value bytes] [primary port] [replica port] [replica port]
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include "BenchUtil.h"
+#include "IStorageService.h"
+#include "RequestAssembler.h"
+
+static const std::string ROW_KEY{"00000000000000000009"};
+
+// Sends a request on a new connection and reads the reply line and the value that may follow it, then closes it
+static bool request_unpooled(const KVServer &server, const std::string &request, bool read_value)
+{
+    int fd = connect_local(server.port);
+    if (fd < 0) return false;
+    std::string buffer, line;
+    bool ok = read_line(fd, buffer, line) && send_all(fd, request.data(), request.size()) &&
+              read_line(fd, buffer, line) && line.compare(0, 3, "+OK") == 0;
+    if (ok && read_value)
+    {
+        // "+OK <bytes>" is followed by the value and its CRLF
+        const size_t bytes{std::strtoull(line.c_str() + 4, nullptr, 10) + 2};
+        char chunk[4096];
+        while (ok && buffer.size() < bytes)
+        {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            ok = n > 0;
+            if (ok) buffer.append(chunk, n);
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+// Runs requests on several threads and prints their throughput and latency
+template <typename Request>
+static void run(const std::string &name, size_t threads, size_t requests, Request request)
+{
+    std::vector<std::vector<double>> thread_latencies(threads);
+    std::atomic<size_t> failed{0};
+    std::vector<std::thread> clients;
+    auto start = bench_clock::now();
+    for (size_t t = 0; t < threads; ++t)
+    {
+        clients.emplace_back([&, t]
+        {
+            std::mt19937_64 random{t};
+            thread_latencies[t].reserve(requests);
+            for (size_t i = 0; i < requests; ++i)
+            {
+                auto op_start = bench_clock::now();
+                failed += !request(t, i, random);
+                thread_latencies[t].push_back(elapsed_us(op_start));
+            }
+        });
+    }
+    for (std::thread &client : clients) client.join();
+    const double seconds = elapsed_us(start) / 1e6;
+
+    std::vector<double> latencies;
+    for (const auto &samples : thread_latencies) latencies.insert(latencies.end(), samples.begin(), samples.end());
+    print_result(name, threads * requests, seconds, latencies);
+    if (failed) fprintf(stderr, "%zu requests failed\n", failed.load());
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t threads{arg_or(argc, argv, 1, 4)};
+    const size_t requests{arg_or(argc, argv, 2, 2000)};
+    const size_t value_bytes{arg_or(argc, argv, 3, 100)};
+    const std::vector<KVServer> servers{{"127.0.0.1", static_cast<int>(arg_or(argc, argv, 4, 8080)), 0, true, true},
+                                        {"127.0.0.1", static_cast<int>(arg_or(argc, argv, 5, 8082)), 0, false, true},
+                                        {"127.0.0.1", static_cast<int>(arg_or(argc, argv, 6, 8084)), 0, false, true}};
+    const std::map<int, std::vector<KVServer>> group{{0, servers}};
+    printf("%zu threads, %zu requests each, %zu byte values, primary on port %d\n", threads, requests, value_bytes,
+           servers[0].port);
+
+    const tablet_value value(value_bytes, std::byte{'v'});
+    IStorageService(group).create_row(ROW_KEY);
+    auto column = [](size_t t, size_t i) { return "column" + std::to_string(t) + "-" + std::to_string(i % 64); };
+
+    // Writes go to the primary, which replicates them, reads to any server of the group
+    run("PUT, connection per request", threads, requests, [&](size_t t, size_t i, std::mt19937_64 &)
+    {
+        return request_unpooled(servers[0], RequestAssembler::assemble_put(ROW_KEY, column(t, i), value), false);
+    });
+    run("PUT, pooled", threads, requests, [&](size_t t, size_t i, std::mt19937_64 &)
+    {
+        return IStorageService(group).put(ROW_KEY, column(t, i), value) == 0;
+    });
+    run("GET, connection per request", threads, requests, [&](size_t t, size_t i, std::mt19937_64 &random)
+    {
+        return request_unpooled(servers[random() % servers.size()], RequestAssembler::assemble_get(ROW_KEY, column(t, i)),
+                                true);
+    });
+    run("GET, pooled", threads, requests, [&](size_t t, size_t i, std::mt19937_64 &)
+    {
+        tablet_value read;
+        return IStorageService(group).get(ROW_KEY, column(t, i), read) == 0 && read.size() == value_bytes;
+    });
+    return 0;
+}
@@ -0,0 +1,66 @@
+// PUT throughput benchmark against a running storage server: writes 1 KB, 1 MB and 25 MB values over one connection
+// Run it against servers built before and after the framed reader to compare them
+// Usage: bench_put [port] [MB written per value size] [maximum PUTs per value size]
+
+#include "BenchUtil.h"
+
+// PUTs cycle through rows with one column each, so the largest values stay below the maximum row size
+static constexpr size_t ROWS{8};
+static const std::string ROW_KEY{"bench-put-row"};
+
+// Sends a command and reads its one line reply
+static bool command(int fd, std::string &buffer, const std::string &request, std::string &reply)
+{
+    return send_all(fd, request.data(), request.size()) && read_line(fd, buffer, reply);
+}
+
+int main(int argc, char *argv[])
+{
+    const int port = arg_or(argc, argv, 1, 8080);
+    const size_t megabytes{arg_or(argc, argv, 2, 200)};
+    const size_t max_puts{arg_or(argc, argv, 3, 2000)};
+    printf("port %d, %zu MB or at most %zu PUTs per value size\n", port, megabytes, max_puts);
+
+    int fd = connect_local(port);
+    std::string buffer, reply;
+    if (fd < 0 || !read_line(fd, buffer, reply))
+    {
+        fprintf(stderr, "Cannot connect to port %d\n", port);
+        return 1;
+    }
+    for (size_t row = 0; row < ROWS; ++row)
+        command(fd, buffer, "CROW " + ROW_KEY + std::to_string(row) + "\r\n", reply);
+
+    for (size_t value_bytes : {size_t{1000}, size_t{1000 * 1000}, size_t{25 * 1000 * 1000}})
+    {
+        const size_t puts{std::max<size_t>(1, std::min(max_puts, megabytes * 1000 * 1000 / value_bytes))};
+        const std::string value(value_bytes, 'v');
+        std::vector<double> latencies;
+        size_t failed{0};
+
+        auto start = bench_clock::now();
+        for (size_t i = 0; i < puts; ++i)
+        {
+            // Header line, then the value and its CRLF, sent at once as a client would
+            auto op_start = bench_clock::now();
+            const std::string request{"PUT " + ROW_KEY + std::to_string(i % ROWS) + " column " +
+                                      std::to_string(value_bytes) + "\r\n" + value + "\r\n"};
+            if (!command(fd, buffer, request, reply))
+            {
+                fprintf(stderr, "Connection closed\n");
+                return 1;
+            }
+            latencies.push_back(elapsed_us(op_start));
+            failed += reply.compare(0, 3, "+OK") != 0;
+        }
+        const double seconds = elapsed_us(start) / 1e6;
+
+        const std::string name{"PUT " + std::to_string(value_bytes / 1000) + " KB"};
+        print_result(name, puts, seconds, latencies);
+        printf("%-32s %10.1f MB/s%s\n", "", puts * value_bytes / 1e6 / seconds,
+               failed ? (", " + std::to_string(failed) + " failed, last: " + reply).c_str() : "");
+    }
+
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,126 @@
+// Frame queue microbenchmark: bounded lock-free ring of ThreadSafeQueue against the former mutex and condition
+// variable queue, push/pop cost on one thread and push-to-pop latency between a producer and a consumer thread
+// Usage: bench_queue [frames]
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include "BenchUtil.h"
+#include "ThreadSafeQueue.h"
+
+// Former queue, unbounded behind a mutex, pop blocks on a condition variable until a frame is pushed
+class MutexQueue
+{
+public:
+    bool push(Frame &&frame)
+    {
+        std::lock_guard lock{mtx_};
+        queue_.push(std::move(frame));
+        cond_.notify_one();
+        return true;
+    }
+
+    bool try_pop(Frame &frame)
+    {
+        std::lock_guard lock{mtx_};
+        if (queue_.empty()) return false;
+        frame = std::move(queue_.front());
+        queue_.pop();
+        return true;
+    }
+
+    void pop(Frame &frame)
+    {
+        std::unique_lock lock{mtx_};
+        cond_.wait(lock, [this] { return !queue_.empty(); });
+        frame = std::move(queue_.front());
+        queue_.pop();
+    }
+
+private:
+    std::queue<Frame> queue_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
+};
+
+// The ring has no blocking pop, its consumer is woken by the reactor, here it yields until a frame arrives
+static void pop(ThreadSafeQueue &queue, Frame &frame)
+{
+    while (!queue.try_pop(frame)) std::this_thread::yield();
+}
+
+static void pop(MutexQueue &queue, Frame &frame)
+{
+    queue.pop(frame);
+}
+
+// Pushes and pops batches of frames on one thread and prints the cost of a push and pop pair
+template <typename Queue>
+static void run_single(const std::string &name, Queue &queue, size_t frames)
+{
+    constexpr size_t BATCH{64};
+    std::vector<double> latencies;
+    latencies.reserve(frames / BATCH);
+    Frame frame;
+    auto start = bench_clock::now();
+    for (size_t i = 0; i < frames; i += BATCH)
+    {
+        auto batch_start = bench_clock::now();
+        for (size_t j = 0; j < BATCH; ++j) queue.push(Frame{"GET row column"});
+        for (size_t j = 0; j < BATCH; ++j) queue.try_pop(frame);
+        latencies.push_back(elapsed_us(batch_start) * 1000 / BATCH);
+    }
+    const double seconds = elapsed_us(start) / 1e6;
+    printf("%-32s %10.0f ops/s   p50 %9.1f ns   p99 %9.1f ns per push and pop\n", name.c_str(),
+           frames / seconds, percentile(latencies, 0.5), percentile(latencies, 0.99));
+}
+
+// A producer pushes frames to a consumer that pops them, latency is from push to pop
+// Paced, the producer waits for each frame to be popped before the next push, so only the hand-off is timed,
+// otherwise it pushes as fast as the queue takes them and the time frames spend queued is included
+template <typename Queue>
+static void run_threads(const std::string &name, Queue &queue, size_t frames, bool paced)
+{
+    std::vector<bench_clock::time_point> pushed(frames);
+    std::vector<double> latencies(frames);
+    std::atomic<size_t> popped{0};
+    auto start = bench_clock::now();
+    std::thread consumer([&]
+    {
+        Frame frame;
+        for (size_t i = 0; i < frames; ++i)
+        {
+            pop(queue, frame);
+            latencies[i] = elapsed_us(pushed[i]);
+            popped.store(i + 1, std::memory_order_release);
+        }
+    });
+    for (size_t i = 0; i < frames; ++i)
+    {
+        // A full ring pushes back, the producer retries once the consumer made room
+        pushed[i] = bench_clock::now();
+        while (!queue.push(Frame{"GET row column"})) std::this_thread::yield();
+        while (paced && popped.load(std::memory_order_acquire) <= i) std::this_thread::yield();
+    }
+    consumer.join();
+    print_result(name, frames, elapsed_us(start) / 1e6, latencies);
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t frames{arg_or(argc, argv, 1, 1000000)};
+    printf("%zu frames, ring of %zu frames, %zu bytes per ring\n", frames, ThreadSafeQueue::CAPACITY,
+           sizeof(ThreadSafeQueue));
+
+    MutexQueue mutex_queue;
+    auto ring = std::make_unique<ThreadSafeQueue>();
+    run_single("mutex queue, one thread", mutex_queue, frames);
+    run_single("ring, one thread", *ring, frames);
+    run_threads("mutex queue, hand-off", mutex_queue, frames / 10, true);
+    run_threads("ring, hand-off", *ring, frames / 10, true);
+    run_threads("mutex queue, streaming", mutex_queue, frames, false);
+    run_threads("ring, streaming", *ring, frames, false);
+    return 0;
+}
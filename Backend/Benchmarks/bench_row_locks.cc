@@ -0,0 +1,101 @@
+// Row lock contention benchmark: striped row lock table against the former map of one shared_mutex per row
+// Writers share one tablet and hit either distinct cold rows or a few hot rows
+// Usage: bench_row_locks [threads] [rows] [writes per thread]
+
+#include <array>
+#include <malloc.h>
+#include <map>
+#include <random>
+#include <thread>
+#include "BenchUtil.h"
+#include "TabletArray.h"
+
+// Former row locks, one mutex per row looked up in a map (filled up front, so lookups never insert concurrently)
+struct RowLockMap
+{
+    std::map<std::string, std::shared_mutex> row_mutexes;
+
+    inline std::shared_mutex &row_mutex(const std::string &row_key)
+    {
+        return row_mutexes.find(row_key)->second;
+    }
+};
+
+// Row locks as used by the tablet array, rows map to a fixed number of stripes by the hash of their key
+struct RowLockTable
+{
+    std::array<RowLockStripe, ROW_LOCK_STRIPES> row_locks;
+
+    inline std::shared_mutex &row_mutex(const std::string &row_key)
+    {
+        return row_locks[std::hash<std::string>{}(row_key) & (ROW_LOCK_STRIPES - 1)].mutex;
+    }
+};
+
+// Writers lock the tablet shared and their row exclusively and write a small value, as TabletArray::write does
+template <typename Locks>
+static void run(const std::string &name, Locks &locks, Tablet &tablet, const std::vector<std::string> &row_keys,
+                size_t threads, size_t writes, size_t hot_rows)
+{
+    std::vector<std::vector<double>> thread_latencies(threads);
+    std::vector<std::thread> writers;
+    auto start = bench_clock::now();
+    for (size_t t = 0; t < threads; ++t)
+    {
+        writers.emplace_back([&, t]
+        {
+            std::mt19937_64 random{t};
+            thread_latencies[t].reserve(writes);
+            for (size_t i = 0; i < writes; ++i)
+            {
+                // Cold writers own distinct rows, hot writers share a few rows
+                const size_t row = hot_rows ? random() % hot_rows : (random() % (row_keys.size() / threads)) * threads + t;
+                const std::string &row_key{row_keys[row]};
+                tablet_value value(16, std::byte(i));
+
+                auto op_start = bench_clock::now();
+                std::shared_lock tablet_lock{tablet.tablet_mutex};
+                std::lock_guard row_lock{locks.row_mutex(row_key)};
+                tablet.write(row_key, "column" + std::to_string(i % 4), value);
+                thread_latencies[t].push_back(elapsed_us(op_start));
+            }
+        });
+    }
+    for (std::thread &writer : writers) writer.join();
+    const double seconds = elapsed_us(start) / 1e6;
+
+    std::vector<double> latencies;
+    for (const auto &samples : thread_latencies) latencies.insert(latencies.end(), samples.begin(), samples.end());
+    print_result(name, threads * writes, seconds, latencies);
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t threads{arg_or(argc, argv, 1, std::max(2u, std::thread::hardware_concurrency()))};
+    const size_t rows{arg_or(argc, argv, 2, 1000000)};
+    const size_t writes{arg_or(argc, argv, 3, 200000)};
+    printf("%zu writers, %zu rows, %zu writes each\n", threads, rows, writes);
+
+    std::vector<std::string> row_keys(rows);
+    for (size_t r = 0; r < rows; ++r) row_keys[r] = "user" + std::to_string(r) + "-mailbox";
+
+    Tablet tablet;
+    for (const std::string &row_key : row_keys) tablet.create_row(row_key);
+
+    size_t heap_before{mallinfo2().uordblks};
+    RowLockMap lock_map;
+    for (const std::string &row_key : row_keys) lock_map.row_mutexes[row_key];
+    printf("%-32s %10.1f MB\n", "lock memory, map of mutexes", (mallinfo2().uordblks - heap_before) / 1e6);
+
+    heap_before = mallinfo2().uordblks;
+    auto lock_table = std::make_unique<RowLockTable>();
+    printf("%-32s %10.1f MB\n", "lock memory, stripe table", (mallinfo2().uordblks - heap_before) / 1e6);
+
+    for (size_t hot_rows : {size_t{0}, size_t{16}})
+    {
+        const std::string suffix{hot_rows ? ", 16 hot rows" : ", cold rows"};
+        run("map of mutexes" + suffix, lock_map, tablet, row_keys, threads, writes, hot_rows);
+        run("stripe table" + suffix, *lock_table, tablet, row_keys, threads, writes, hot_rows);
+    }
+    return 0;
+}
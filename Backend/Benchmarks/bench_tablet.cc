@@ -0,0 +1,91 @@
+// Tablet engine microbenchmark: put, get and list_columns throughput and heap bytes per entry
+// The engine is chosen at build time, build with TABLET_ENGINE=btree for the flat B+-tree and compare with the default
+// Usage: bench_tablet [rows] [columns per row] [value bytes]
+
+#include <malloc.h>
+#include <random>
+#include "BenchUtil.h"
+#include "Tablet.h"
+
+// Bytes allocated on the heap
+static size_t heap_bytes()
+{
+    return mallinfo2().uordblks;
+}
+
+// Runs count operations and prints their throughput
+template <typename Op>
+static void run(const std::string &name, size_t count, Op op)
+{
+    auto start = bench_clock::now();
+    for (size_t i = 0; i < count; ++i) op(i);
+    const double seconds = elapsed_us(start) / 1e6;
+    printf("%-24s %12.0f ops/s\n", name.c_str(), count / seconds);
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t rows{arg_or(argc, argv, 1, 100000)};
+    const size_t columns{arg_or(argc, argv, 2, 10)};
+    const size_t value_bytes{arg_or(argc, argv, 3, 16)};
+    const size_t entries{rows * columns};
+
+#ifdef TABLET_ENGINE_BTREE
+    printf("engine btree, ");
+#else
+    printf("engine std::map, ");
+#endif
+    printf("%zu rows x %zu columns of %zu bytes\n", rows, columns, value_bytes);
+
+    // Keys look like mailbox rows and message columns
+    std::vector<std::string> row_keys(rows), column_keys(columns);
+    for (size_t r = 0; r < rows; ++r) row_keys[r] = "user" + std::to_string(r * 7919 % rows) + "-mailbox";
+    for (size_t c = 0; c < columns; ++c) column_keys[c] = "message-" + std::to_string(c);
+
+    // Random order of all entries, so lookups do not follow insertion order
+    std::vector<size_t> order(entries);
+    for (size_t i = 0; i < entries; ++i) order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937_64{42});
+
+    const size_t heap_before{heap_bytes()};
+    Tablet tablet;
+    {
+        Tablet &t = tablet;
+        run("create_row", rows, [&](size_t i) { t.create_row(row_keys[i]); });
+        run("put (new column)", entries, [&](size_t i)
+        {
+            const size_t e = order[i];
+            tablet_value value(value_bytes, std::byte(e));
+            t.write(row_keys[e / columns], column_keys[e % columns], value);
+        });
+    }
+    const size_t heap_after{heap_bytes()};
+    printf("%-24s %12.1f bytes (%zu of them value)\n", "heap per entry",
+           static_cast<double>(heap_after - heap_before) / entries, value_bytes);
+
+    run("put (overwrite)", entries, [&](size_t i)
+    {
+        const size_t e = order[i];
+        tablet_value value(value_bytes, std::byte(i));
+        tablet.write(row_keys[e / columns], column_keys[e % columns], value);
+    });
+
+    size_t found{0};
+    tablet_value value;
+    run("get", entries, [&](size_t i)
+    {
+        const size_t e = order[i];
+        found += tablet.read(row_keys[e / columns], column_keys[e % columns], value) == TabletStatus::OK;
+    });
+
+    size_t listed{0};
+    run("list_columns", rows, [&](size_t i)
+    {
+        std::set<std::string> keys;
+        tablet.list_columns(row_keys[order[i] % rows], keys);
+        listed += keys.size();
+    });
+
+    if (found != entries || listed != entries) fprintf(stderr, "Lookups missed entries: %zu %zu\n", found, listed);
+    return 0;
+}
@@ -1,11 +1,7 @@
 #include <unistd.h>
 #include <mutex>
-#include <pthread.h>
-#include <signal.h> // Used for signal message types
-#include "Server.h" // Used for DEBUG flag and signal handlers declared in Server.h
+#include "Server.h" // Used for DEBUG flag
 #include "ClientHandler.h"
-#include "SocketReader.h"
-#include "SocketWriter.h"
 #include "ICommandDispatcher.h"
 #include "POP3/Pop3CommandDispatcher.h"
 #include "KVStorage/KVStorageCommandDispatcher.h"
@@ -13,52 +9,24 @@
 #include "Coordinator/CoordinatorCommandDispatcher.h"
 // TODO: Include other command dispatchers for servers
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 using namespace std;
 
-ClientHandler::ClientHandler(NewClientArgs *nca)
+ClientHandler::ClientHandler(int socket_fd, ServerType server_type)
+    : socket_fd(socket_fd), server_type_(server_type), dispatcher_(getDispatcher_(server_type)),
+      reader_(socket_fd, message_queue, *dispatcher_), writer_(socket_fd)
 {
-    this->socket_fd = nca->socket_fd;
-    this->server_type_ = nca->server_type;
-    delete nca;
-}
-
-void *ClientHandler::handleClientThreadWrapper(void *arg)
-{
-    NewClientArgs *nca = static_cast<NewClientArgs *>(arg);
-
-    // Create an instance of ClientHandler and call handleClient
-    ClientHandler handler(nca);
-
     if (DEBUG)
     {
-        fprintf(stderr, "New client thread (%ld)\n", pthread_self());
+        fprintf(stderr, "[%d] New connection\n", this->socket_fd);
     }
-
-    handler.handleClient();
-
-    return nullptr;
 }
 
-void *ClientHandler::readerThreadFunction_(void *arg)
+ClientHandler::~ClientHandler()
 {
-    // Block all signals from being received to reader threads.
-    // ClientHandler will be the only one to receive SIGUSR1.
-    sigset_t sigset;
-    sigfillset(&sigset);                       // Add all signals to the set
-    pthread_sigmask(SIG_BLOCK, &sigset, NULL); // Block all signals for this thread
-
-    // Call reader
-    ClientHandler *handler = static_cast<ClientHandler *>(arg);
-
-    if (DEBUG)
-    {
-        fprintf(stderr, "New reader thread (%ld)\n", pthread_self());
-    }
-
-    SocketReader reader(handler->socket_fd, handler->message_queue);
-    reader.read_data();
-    return nullptr;
+    delete this->dispatcher_;
 }
 
 // Helper function to split string by a delimiter
@@ -82,19 +50,8 @@ vector<string> ClientHandler::splitByDelimiter_(const string &str, const string
     return result;
 }
 
-void ClientHandler::handleClient()
+void ClientHandler::welcome()
 {
-    unique_lock lock(mtx);
-    THREAD2SOCKET[pthread_self()] = this->socket_fd;
-    lock.unlock();
-
-    if (DEBUG)
-    {
-        fprintf(stderr, "[%d] New connection\n", this->socket_fd);
-    }
-
-    SocketWriter writer = SocketWriter(this->socket_fd);
-
     // TODO: Refactor this to use CommandDispatcher
     string welcome_message;
     switch (this->server_type_)
@@ -112,39 +69,167 @@ void ClientHandler::handleClient()
         welcome_message = "+OK Coordinator ready [penncloud]";
         break;
     }
-    writer.write_message(welcome_message);
+    this->writer_.write_message(welcome_message);
+}
 
-    // Start the reader thread to read data using pthread_create. Note how we pass an
-    // instance of the current class as an argumen (this) so it can access member variables.
-    pthread_create(&this->reader_thread_, nullptr, this->readerThreadFunction_, this);
+bool ClientHandler::read_messages()
+{
+    // A connection closed by the server is not read anymore, its socket number may already belong to a new client
+    lock_guard lock(this->socket_mutex_);
+    if (this->closed_)
+        return true;
 
-    ICommandDispatcher *dispatcher = getDispatcher_(this->server_type_);
+    return this->reader_.read_available();
+}
 
-    // Process the messages in the main clientHandler thread
-    while (true)
+bool ClientHandler::process_messages(vector<TaggedRequest> &requests)
+{
+    Frame frame;
+    while (!this->throttled() && this->message_queue.try_pop(frame))
     {
-        // Read from ThreadSafeQueeu or block until a message is available
-        string message = this->message_queue.pop();
+        // Collect a tagged request with its payloads, it is dispatched on its own once it is complete
+        if (this->pending_payloads_ > 0 && frame.is_payload)
+        {
+            this->pending_request_.payloads.push_back(std::move(frame.payload));
+            if (--this->pending_payloads_ == 0)
+                this->submit_request_(requests);
+            continue;
+        }
+        if (!frame.tag.empty())
+        {
+            // Responses to tagged requests are written by several workers and would otherwise wait for the ACK
+            // of the previous one, responses to untagged requests are still coalesced by Nagle
+            if (!this->sends_tagged_)
+            {
+                int nodelay = 1;
+                setsockopt(this->socket_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+                this->sends_tagged_ = true;
+            }
 
-        if (DEBUG) truncated_print("C:", message, this->socket_fd);
+            if (DEBUG) truncated_print("C: @" + frame.tag, frame.message, this->socket_fd);
+            vector<size_t> sizes;
+            this->dispatcher_->payload_sizes(frame.message, sizes);
+            this->pending_request_ = {std::move(frame.tag), std::move(frame.message), {}};
+            this->pending_payloads_ = sizes.size();
+            if (this->pending_payloads_ == 0)
+                this->submit_request_(requests);
+            continue;
+        }
 
         // Dispatch to corresponding dispatcher and get response message
-        DispatcherResponse response = dispatcher->dispatch(message);
-
-        if (response.second != "")
+        DispatcherResponse response;
+        if (frame.is_payload)
         {
-            writer.write_message(response.second);
-            if (DEBUG) truncated_print("S:", response.second, this->socket_fd);
+            if (DEBUG) fprintf(stderr, "[%d] C: <%zu bytes>\n", this->socket_fd, frame.payload.size());
+            response = this->dispatcher_->dispatch_payload(std::move(frame.payload));
         }
-
-        if (response.first == DispatcherStatusCode::QUIT)
-        {         
-            delete dispatcher;
-            this->closeClient_();
-            return;
+        else
+        {
+            if (DEBUG) truncated_print("C:", frame.message, this->socket_fd);
+            response = this->dispatcher_->dispatch(frame.message);
         }
+
+        if (response.body || response.message != "")
+            this->write_response_(response);
+
+        if (response.status == DispatcherStatusCode::QUIT)
+            return false;
     }
-    return;
+    return true;
+}
+
+void ClientHandler::submit_request_(vector<TaggedRequest> &requests)
+{
+    requests.push_back(std::move(this->pending_request_));
+    this->pending_request_ = {};
+    lock_guard lock(this->requests_mutex_);
+    ++this->requests_in_flight_;
+}
+
+bool ClientHandler::execute_request(TaggedRequest &request)
+{
+    // A dispatcher of its own keeps the state of a command waiting for its payloads apart from other requests
+    unique_ptr<ICommandDispatcher> dispatcher(getDispatcher_(this->server_type_));
+    DispatcherResponse response = dispatcher->dispatch(request.message);
+    for (vector<std::byte> &payload : request.payloads)
+        response = dispatcher->dispatch_payload(std::move(payload));
+
+    // Every tag is answered, so the client does not wait for it forever
+    if (!response.body && response.message == "")
+        response.message = "-ERR No response";
+    this->write_response_(response, request.tag);
+
+    // A tagged QUIT ends the connection as well, the event thread reads EOF and the connection is closed
+    if (response.status == DispatcherStatusCode::QUIT)
+        this->shutdown_socket();
+
+    lock_guard lock(this->requests_mutex_);
+    --this->requests_in_flight_;
+    return !(this->stopped_ && this->requests_in_flight_ == 0);
+}
+
+bool ClientHandler::stop_processing()
+{
+    lock_guard lock(this->requests_mutex_);
+    this->stopped_ = true;
+    return this->requests_in_flight_ == 0;
+}
+
+bool ClientHandler::throttled() const
+{
+    return this->requests_in_flight_.load() >= MAX_REQUESTS_IN_FLIGHT;
+}
+
+void ClientHandler::write_response_(const DispatcherResponse &response, const string &tag)
+{
+    string tagged_message;
+    if (!tag.empty())
+        tagged_message = "@" + tag + " " + response.message;
+    const string &message = tag.empty() ? response.message : tagged_message;
+
+    lock_guard lock(this->write_mutex_);
+    if (response.body)
+        this->writer_.write_message(message, response.body->parts());
+    else
+        this->writer_.write_message(message);
+    if (DEBUG) truncated_print("S:", message, this->socket_fd);
+}
+
+bool ClientHandler::pause_reading()
+{
+    lock_guard lock(this->socket_mutex_);
+    if (this->closed_)
+        return false;
+
+    // The worker may have made room since the last read
+    this->reader_.push_buffered();
+    this->reading_paused_ = this->message_queue.full();
+    return this->reading_paused_;
+}
+
+bool ClientHandler::resume_reading()
+{
+    lock_guard lock(this->socket_mutex_);
+    if (this->closed_ || !this->reading_paused_)
+        return false;
+
+    this->reader_.push_buffered();
+    this->reading_paused_ = this->message_queue.full();
+    return !this->reading_paused_;
+}
+
+void ClientHandler::shutdown_socket(const string &message)
+{
+    lock_guard lock(this->socket_mutex_);
+    if (this->closed_)
+        return;
+
+    if (message != "")
+    {
+        lock_guard write_lock(this->write_mutex_);
+        this->writer_.write_message(message);
+    }
+    shutdown(this->socket_fd, SHUT_RDWR); // Unblocks the client and the event thread reads EOF
 }
 
 ICommandDispatcher *ClientHandler::getDispatcher_(ServerType server_type)
@@ -162,25 +247,20 @@ ICommandDispatcher *ClientHandler::getDispatcher_(ServerType server_type)
     }
 }
 
-void ClientHandler::closeClient_()
+void ClientHandler::closeClient()
 {
     // Gracefully shut down reading and writing
-    if (this->socket_fd != -1)
+    lock_guard lock(this->socket_mutex_);
+    if (this->socket_fd != -1 && !this->closed_)
     {
         shutdown(this->socket_fd, SHUT_RDWR);
         close(this->socket_fd);
         if (DEBUG) fprintf(stderr, "[%d] Socket closed\n", this->socket_fd);
     }
-
-    // Wait for reader thread to exit
-    pthread_join(this->reader_thread_, NULL);
+    this->closed_ = true;
 
     if (DEBUG)
     {
         fprintf(stderr, "[%d] Connection Closed\n", this->socket_fd);
     }
-
-    // Clean up the THREAD2SOCKET dictionary
-    unique_lock lock(mtx);
-    THREAD2SOCKET.erase(pthread_self());
 }
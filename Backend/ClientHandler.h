@@ -1,41 +1,107 @@
 #ifndef CLIENTHANDLER_H
 #define CLIENTHANDLER_H
 
-#include "NewClientArgs.h"
+#include <atomic>
+#include <mutex>
+#include "ServerConfig.h"
 #include "ThreadSafeQueue.h"
 #include "ICommandDispatcher.h"
+#include "SocketReader.h"
+#include "SocketWriter.h"
+
+// Number of tagged requests of a connection executed at the same time, further frames wait in its queue
+constexpr size_t MAX_REQUESTS_IN_FLIGHT{32};
+
+// A tagged request and its payloads, executed concurrently with the other requests of its connection
+struct TaggedRequest
+{
+    string tag;
+    string message;
+    vector<vector<std::byte>> payloads;
+};
 
 /*
  * Class for handling each individual client
+ * The Reactor reads from the socket on its event thread and dispatches the messages on a worker thread
  */
 class ClientHandler
 {
 public:
-    ClientHandler(NewClientArgs *nca);
-    ~ClientHandler() = default;
-    void handleClient();
+    ClientHandler(int socket_fd, ServerType server_type);
+    ~ClientHandler();
+
+    // Sends the welcome message of the server to the client
+    void welcome();
+
+    // Reads the data available on the socket without blocking and queues complete messages
+    // Returns false once the client has closed the connection, TQUIT is queued as the last message
+    bool read_messages();
+
+    // Dispatches the queued messages in order and writes the responses, complete tagged requests are moved to
+    // requests instead to be executed concurrently
+    // Returns false once the connection should be closed
+    bool process_messages(vector<TaggedRequest> &requests);
 
-    // Static wrapper instanciates new ClientHandler class inside each thread
-    static void *handleClientThreadWrapper(void *arg);
+    // Executes a tagged request and writes its tagged response
+    // Returns false if the connection should be closed now, because it was the last request in flight of a
+    // connection that stopped processing
+    bool execute_request(TaggedRequest &request);
 
-    // Creates a new thread that will read data from the client and push to thread safe queue
-    static void *readerThreadFunction_(void *arg);
+    // Stops processing messages, returns true if the connection can be closed now and false if the last
+    // tagged request in flight closes it
+    bool stop_processing();
+
+    // Returns true while the maximum number of tagged requests is in flight
+    bool throttled() const;
+
+    // Called by the event thread after reading, returns true if the queue is full and the socket must not be
+    // watched until resume_reading succeeds
+    bool pause_reading();
+    // Called by the worker after dispatching, queues the frames held back and returns true if the socket
+    // can be watched again
+    bool resume_reading();
+
+    // Sends message (if not empty) and shuts down the socket, so the event thread reads EOF
+    void shutdown_socket(const string &message = "");
+
+    // Close client connection on the server side
+    void closeClient();
 
-    // NOTE: The below member variables are public because
-    // we need to use them in the readerThreadFunction_
     int socket_fd;
     ThreadSafeQueue message_queue;
+    // Set while the connection waits for or is processed by a worker thread
+    std::atomic<bool> scheduled{false};
 
 private:
-    pthread_t reader_thread_;
     ServerType server_type_;
+    ICommandDispatcher *dispatcher_;
+    SocketReader reader_;
+    SocketWriter writer_;
+
+    // Keeps the socket open while the event thread reads from it
+    std::mutex socket_mutex_;
+    bool closed_{false};
+    // Set while the queue is full and the socket is not watched
+    bool reading_paused_{false};
+
+    // Keeps the responses of concurrent tagged requests apart
+    std::mutex write_mutex_;
+
+    // Set once the client sent a tagged request
+    bool sends_tagged_{false};
+    // Tagged request waiting for the payloads announced by its message
+    TaggedRequest pending_request_;
+    size_t pending_payloads_{0};
 
-    // Other types of arguments expected for each type of server
-    // might vary depending on the server type
-    // string mailbox_path_;
+    // Tagged requests moved out for execution and not answered yet
+    std::mutex requests_mutex_;
+    std::atomic<size_t> requests_in_flight_{0};
+    bool stopped_{false};
 
-    // Close client connection on the server side and removes the socket from the global THREAD2SOCKET map
-    void closeClient_();
+    // Moves the complete pending request to requests and counts it as in flight
+    void submit_request_(vector<TaggedRequest> &requests);
+    // Writes a response, the tag of a tagged request is prefixed to its message
+    void write_response_(const DispatcherResponse &response, const string &tag = "");
 
     // Uses server_type_ to retreive corresponding dispatcher
     ICommandDispatcher *getDispatcher_(ServerType server_type);
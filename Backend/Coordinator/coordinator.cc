@@ -43,10 +43,6 @@ int main(int argc, char *argv[])
     sa.sa_flags = 0; // Ensures SA_RESTART is not set, system calls should return EINTR
     sigaction(SIGINT, &sa, NULL);
 
-    // Setup SIGUSR1 handler for worker threads
-    sa.sa_handler = Server::sigusr1_handler;
-    sigaction(SIGUSR1, &sa, NULL);
-
     // Initialize CoordinatorHBService in a background thread
     pthread_t thread_id;
     CoordinatorHBService hb_service(config.kv_servers_map_);
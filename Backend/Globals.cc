@@ -3,8 +3,6 @@
 
 int PORT_NO = -1;
 std::string HOST = "";
-std::shared_mutex mtx;
-std::unordered_map<pthread_t, int> THREAD2SOCKET;
 std::atomic<int> SS_FD(-1);
 bool DEBUG = false;
 std::mutex coord_service_created_mtx;
@@ -13,6 +11,8 @@ CoordinatorService *COORDINATOR_SERVICE = nullptr;
 std::shared_mutex coord_kv_servers_map_mtx;
 std::map<int, std::vector<KVServer>> COORD_KV_SERVERS_MAP;
 std::atomic<bool> IS_ALIVE(true);
+int SERVER_EVENT_FD = -1;
+Reactor *REACTOR = nullptr;
 UpdateForwarder *UPDATE_FORWARDER = nullptr;
 std::shared_mutex pipe_map_mutex;
 std::map<string, int> PIPE_MAP;
@@ -6,10 +6,10 @@
 #include <unordered_map>
 #include <atomic>
 
+class Reactor;
+
 extern int PORT_NO;      // Port number of the server
 extern std::string HOST; // Hostname of the server
-extern std::shared_mutex mtx;
-extern std::unordered_map<pthread_t, int> THREAD2SOCKET; // Maps thread IDs to client socket FDs;
 extern std::atomic<int> SS_FD;                           // Listener socket descriptor (to access inside SIGINT handler)
 extern bool DEBUG;
 extern std::mutex coord_service_created_mtx;             // Mutex to protect the Coordinator created condition variable
@@ -18,6 +18,8 @@ extern CoordinatorService *COORDINATOR_SERVICE;          // Pointer to Coordinat
 extern std::shared_mutex coord_kv_servers_map_mtx;
 extern std::map<int, std::vector<KVServer>> COORD_KV_SERVERS_MAP; // Used by the Coordinator to keep track of the KVStorage servers (through Heartbeat)
 extern std::atomic<bool> IS_ALIVE;                                // Used by KVStorage servers to check if the server is alive
+extern int SERVER_EVENT_FD;                                       // Wakes the main thread of the server after IS_ALIVE changed (eventfd)
+extern Reactor *REACTOR;                                          // Serves all client connections of the server
 extern UpdateForwarder *UPDATE_FORWARDER;                         // Used by KVStorage servers to forward updates to the primary node
 extern std::shared_mutex pipe_map_mutex;                          // Mutex to protect the global pipe map
 extern std::map<string, int> PIPE_MAP;                            // Used by KVStorage servers to write response back to update request initiator
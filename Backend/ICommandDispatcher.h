@@ -1,7 +1,11 @@
 #ifndef ICOMMANDDISPACHER_H
 #define ICOMMANDDISPACHER_H
 
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <vector>
+#include "ResponseBody.h"
 
 using namespace std;
 
@@ -13,7 +17,14 @@ enum class DispatcherStatusCode
     READING_DATA
 };
 
-typedef pair<DispatcherStatusCode, string> DispatcherResponse;
+struct DispatcherResponse
+{
+    DispatcherStatusCode status;
+    // Line sent back, the writer adds its CRLF
+    string message;
+    // Written right after message, lets large data skip being copied into message
+    unique_ptr<ResponseBody> body{};
+};
 
 template <typename T>
 struct Command
@@ -30,6 +41,22 @@ public:
     // Gets a message from client, performs necessary server specific parsing (i.e., SMTP, POP3, etc)
     // and returns a string response to be sent to client through the ClientHandler class.
     virtual DispatcherResponse dispatch(const string &message) = 0; // Pure virtual function
+
+    // Appends the sizes of the binary payloads that follow message, the reader receives each of them as one
+    // payload frame without scanning it for line ends. Called on the reader thread before message is
+    // dispatched, so it may only parse message.
+    virtual void payload_sizes(const string &message, vector<size_t> &sizes) const {}
+
+    // Returns true if requests may carry a client-assigned tag ("@<tag> <message>"). A tagged request is dispatched
+    // on a dispatcher of its own, concurrently with the other requests of the connection, and its response is
+    // prefixed with the tag.
+    virtual bool accepts_tags() const { return false; }
+
+    // Gets the next payload announced by payload_sizes
+    virtual DispatcherResponse dispatch_payload(vector<std::byte> &&payload)
+    {
+        return {DispatcherStatusCode::DISPATCHER_OK, ""};
+    }
 };
 
 #endif
\ No newline at end of file
@@ -10,6 +10,7 @@
 // #include <poll.h>
 #include <fcntl.h>
 #include "SharedStructures.h"
+#include "ReplicationLog.h"
 
 KVPrimaryThread::KVPrimaryThread(const ServerConfig &config)
     : config_(config), command_dispatcher_()
@@ -104,6 +105,7 @@ void KVPrimaryThread::start()
                             FD_CLR(private_fd, &master_fd_set);
                             close(private_fd); 
                             port_to_private_fd_map_.erase(s);  
+                            connection_dispatchers_.erase(private_fd);
                         }
 
                         // Connect to the internal port of the server
@@ -146,16 +148,28 @@ void KVPrimaryThread::start()
             // When and if you happen to become the primary again, you can reconnect to them.
             read_fd_set = master_fd_set;
 
+            // Replicas acknowledge the writes shipped to them on the same sockets
+            int select_max_fd = max_fd;
+            for (int ack_fd : replication_log.ack_sockets())
+            {
+                FD_SET(ack_fd, &read_fd_set);
+                select_max_fd = std::max(select_max_fd, ack_fd);
+            }
+
             // Timeout: 1 second
             timeout.tv_sec = 1;
             timeout.tv_usec = 0;
 
-            int activity = select(max_fd + 1, &read_fd_set, nullptr, nullptr, &timeout);
+            int activity = select(select_max_fd + 1, &read_fd_set, nullptr, nullptr, &timeout);
             if (activity < 0)
             {
                 throw std::runtime_error("KVPrimaryThread: Select Error " + std::string(strerror(errno)) + "\n");
             }
-            else if (activity == 0)
+
+            // Writes that were acknowledged or timed out send their results
+            replication_log.process_acks();
+
+            if (activity == 0)
             {
                 // Timeout occurred, no incoming connection, loop again
                 if (DEBUG) fprintf(stderr, "KVPrimaryThread: No activity on sockets, continuing...\n");
@@ -188,6 +202,12 @@ void KVPrimaryThread::start()
                 if (client_fd > max_fd)
                     max_fd = client_fd;
 
+                // Writes forwarded on this connection are answered once their replicas acknowledged them
+                connection_dispatchers_[client_fd].set_result_sender([this](DispatcherResponse response)
+                {
+                    respond_(response, -1);
+                });
+
                 if (DEBUG)
                     fprintf(stderr, "KVPrimaryThread: New connection accepted: %d\n", client_fd);
 
@@ -206,55 +226,19 @@ void KVPrimaryThread::start()
                     try
                     {
                         DispatcherResponse response = {DispatcherStatusCode::READING_DATA, ""};
-                        while (response.first == DispatcherStatusCode::READING_DATA)
+                        while (response.status == DispatcherStatusCode::READING_DATA)
                         {
                             fprintf(stderr, "KVPrimaryThread: Reading data from client %d\n", client_fd);
                             std::string complete_message = read_data_(client_fd);
 
                             if (DEBUG) truncated_print("KVPrimaryThread: Received message from client", complete_message, client_fd);
 
-                            response = command_dispatcher_.dispatch(complete_message);
+                            response = connection_dispatchers_[client_fd].dispatch(complete_message);
                         }
 
-                        int respond_to_fd = client_fd;
+                        respond_(response, client_fd);
 
-                        if (response.first == DispatcherStatusCode::TO_PT)
-                        {
-                            // We need to find the corresponding private fd based on the public port of the replica node
-                            // Get the host and port from the message. Note that any DispatcherStatusCode::TO_PT response, it must have the first argument to be the host and port of the request initiator
-                            string message = response.second;
-                            size_t space_pos = message.find(' ');
-                            size_t second_space_pos = message.find(' ', space_pos + 1);
-                            std::string host_port = message.substr(space_pos + 1, second_space_pos - space_pos - 1);
-
-                            // If its me, then I need to dispatch the message directly instead of resending it to myself
-                            if (host_port == my_host_port)
-                            {
-                                command_dispatcher_.dispatch(message);
-                                ++it;
-                                continue;
-                            }
-
-                            // TODO: CHECK IF HOST_PORT IS IN THE MAP
-                            if (port_to_private_fd_map_.find(host_port) == port_to_private_fd_map_.end())
-                            {
-                                fprintf(stderr, "KVPrimaryThread: Failed to find private fd for host and port %s\n", host_port.c_str());
-                                ++it;
-                                continue;
-                            }
-
-                            // Use the host and port to find the corresponding private fd
-                            respond_to_fd = port_to_private_fd_map_[host_port];
-                        }
-
-                        if (response.second != "")
-                        {
-                            SocketWriter writer(respond_to_fd);
-                            writer.write_message(response.second);
-                            if (DEBUG) truncated_print("KVPrimaryThread S:", response.second, client_fd);
-                        }
-
-                        if (response.first == DispatcherStatusCode::QUIT)
+                        if (response.status == DispatcherStatusCode::QUIT)
                         {
                             remove_client = true;
                         }
@@ -277,6 +261,7 @@ void KVPrimaryThread::start()
                     close(client_fd);
                     FD_CLR(client_fd, &master_fd_set);
                     it = client_fds.erase(it); // Erase and advance
+                    connection_dispatchers_.erase(client_fd);
 
                     for (auto &map_entry : port_to_private_fd_map_)
                     {
@@ -358,6 +343,15 @@ std::string KVPrimaryThread::read_data_(const int sockfd)
 
         std::string chunk(buffer, peek_bytes_received);
 
+        // The termination may be split between two chunks, its CR was read with the previous one
+        if (!response.empty() && response.back() == '\r' && chunk[0] == '\n')
+        {
+            if (recv(sockfd, buffer, 1, 0) != 1)
+                throw std::runtime_error("KVPrimaryThread: Failed reading bytes from socket " + std::to_string(sockfd) + "\n");
+            response.push_back('\n');
+            break;
+        }
+
         // Check if termination exists in current chunk
         term_pos = chunk.find(termination);
         if (term_pos != std::string::npos)
@@ -397,6 +391,50 @@ std::string KVPrimaryThread::read_data_(const int sockfd)
     return response.substr(0, response.size() - termination.length());
 }
 
+void KVPrimaryThread::respond_(DispatcherResponse &response, int client_fd)
+{
+    int respond_to_fd = client_fd;
+
+    if (response.status == DispatcherStatusCode::TO_PT)
+    {
+        // We need to find the corresponding private fd based on the public port of the replica node
+        // Get the host and port from the message. Note that any DispatcherStatusCode::TO_PT response, it must have the first argument to be the host and port of the request initiator
+        string message = response.message;
+        size_t space_pos = message.find(' ');
+        size_t second_space_pos = message.find(' ', space_pos + 1);
+        std::string host_port = message.substr(space_pos + 1, second_space_pos - space_pos - 1);
+
+        // If its me, then I need to dispatch the message directly instead of resending it to myself
+        if (host_port == config_.host + ":" + std::to_string(config_.portno))
+        {
+            command_dispatcher_.dispatch(message);
+            return;
+        }
+
+        if (port_to_private_fd_map_.find(host_port) == port_to_private_fd_map_.end())
+        {
+            fprintf(stderr, "KVPrimaryThread: Failed to find private fd for host and port %s\n", host_port.c_str());
+            return;
+        }
+
+        // Use the host and port to find the corresponding private fd
+        respond_to_fd = port_to_private_fd_map_[host_port];
+    }
+
+    if (response.body)
+    {
+        SocketWriter writer(respond_to_fd);
+        writer.write_message(response.message, response.body->parts());
+        if (DEBUG) truncated_print("KVPrimaryThread S:", response.message, respond_to_fd);
+    }
+    else if (response.message != "")
+    {
+        SocketWriter writer(respond_to_fd);
+        writer.write_message(response.message);
+        if (DEBUG) truncated_print("KVPrimaryThread S:", response.message, respond_to_fd);
+    }
+}
+
 void KVPrimaryThread::bind_and_listen_()
 {
     int serverSocket = socket(AF_INET, SOCK_STREAM, 0);
@@ -12,11 +12,16 @@ public:
 private:
     ServerConfig config_;
     KvStorageCommandDispatcher command_dispatcher_;
+    // Each connection has a dispatcher of its own, so a command waiting for its payload is not completed by a
+    // message of another replica
+    std::map<int, KvStorageCommandDispatcher> connection_dispatchers_;
     int socket_fd_{-1};
     KVServer primary_node_;
     std::map<string, int> port_to_private_fd_map_; // Maps public host and port of a replica to the socket open to its internal port
 
     void bind_and_listen_();
+    // Writes a response to the connection it came from, a TO_PT response goes to the initiator named in it instead
+    void respond_(DispatcherResponse &response, int client_fd);
     std::string read_data_(const int sockfd);
     KVServer get_primary_node_();
 
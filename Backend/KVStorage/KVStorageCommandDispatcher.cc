@@ -9,8 +9,36 @@
 #include "SharedStructures.h"
 #include "RemoteWriteRequestAssembler.h"
 #include "Globals.h"
+#include "Server.h"
 #include "IStorageService.h"
 #include "SocketWriter.h"
+#include "ReplicationLog.h"
+
+namespace
+{
+    // Bytes of a value, e.g. to copy them into a log record
+    std::string_view value_view(const tablet_value &value)
+    {
+        return {reinterpret_cast<const char *>(value.data()), value.size()};
+    }
+
+    // Returns true if the arguments of a write command end with a consistency level
+    // Writes forwarded to the primary always carry one after the initiator and the message id
+    bool has_consistency(const std::string &cmd, size_t args, CommandOrigin origin)
+    {
+        if (cmd == "CROW")
+            return args == 2 || args == 4;
+        if (cmd == "PUT" || cmd == "MOVE")
+            return args == 4 || args == 6;
+        if (cmd == "CPUT")
+            return args == 5 || args == 7;
+        if (cmd == "DEL")
+            return args == 3 || args == 5;
+        if (cmd == "MPUT")
+            return args > 3 && (args % 3 == 1 || (args % 3 == 0 && origin == CommandOrigin::REPLICA));
+        return false;
+    }
+}
 
 KvStorageCommandDispatcher::KvStorageCommandDispatcher() {}
 
@@ -25,15 +53,7 @@ DispatcherResponse KvStorageCommandDispatcher::dispatch(const string &message)
     {
         // Continue reading data
         data_receiver.read_data(message);
-
-        // Execute command if all data has been received
-        if (data_receiver.finished())
-        {
-            NewCommand<KVServerCommand> cmd = data_receiver.get_command();
-            return execute_command(cmd);
-        }
-        else
-            return {DispatcherStatusCode::READING_DATA, ""};
+        return execute_received_command();
     }
     else
     {
@@ -45,6 +65,71 @@ DispatcherResponse KvStorageCommandDispatcher::dispatch(const string &message)
     }
 }
 
+void KvStorageCommandDispatcher::payload_sizes(const string &message, vector<size_t> &sizes) const
+{
+    // Mirrors the data requested by execute_command, a command it rejects announces no payload
+    NewCommand<KVServerCommand> cmd = parse_message(message);
+    try
+    {
+        switch (cmd.cmd)
+        {
+        case KVServerCommand::PUT:
+            sizes.push_back(std::stoul(cmd.args[2]));
+            break;
+        case KVServerCommand::CPUT:
+        {
+            size_t conditional_size = std::stoul(cmd.args[2]);
+            size_t value_size = std::stoul(cmd.args[3]);
+            sizes.push_back(conditional_size);
+            sizes.push_back(value_size);
+            break;
+        }
+        case KVServerCommand::MPUT:
+            for (size_t i = 2; i < cmd.args.size(); i += 3)
+                sizes.push_back(std::stoul(cmd.args[i]));
+            break;
+        case KVServerCommand::LOG:
+            sizes.push_back(std::stoul(cmd.args[1]));
+            break;
+        case KVServerCommand::SYNCF:
+            if (cmd.origin == CommandOrigin::PRIMARY && cmd.args.size() > 5)
+            {
+                size_t bin_size = std::stoul(cmd.args[2]);
+                size_t idx_size = std::stoul(cmd.args[3]);
+                size_t log_size = std::stoul(cmd.args[5]);
+                sizes.insert(sizes.end(), {bin_size, idx_size, log_size});
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    catch (...)
+    {
+    }
+}
+
+DispatcherResponse KvStorageCommandDispatcher::dispatch_payload(vector<std::byte> &&payload)
+{
+    if (!receiving_data)
+        return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Unexpected data"};
+
+    data_receiver.read_payload(std::move(payload));
+    return execute_received_command();
+}
+
+DispatcherResponse KvStorageCommandDispatcher::execute_received_command()
+{
+    // Execute command if all data has been received
+    if (data_receiver.finished())
+    {
+        NewCommand<KVServerCommand> cmd = data_receiver.get_command();
+        return execute_command(cmd);
+    }
+    else
+        return {DispatcherStatusCode::READING_DATA, ""};
+}
+
 DispatcherResponse KvStorageCommandDispatcher::execute_command(NewCommand<KVServerCommand> &cmd)
 {
     switch (cmd.cmd)
@@ -71,7 +156,10 @@ DispatcherResponse KvStorageCommandDispatcher::execute_command(NewCommand<KVServ
             size_t tablet_id = std::stoul(cmd.args[1]);
             size_t version = std::stoul(cmd.args[2]);
 
-            return {DispatcherStatusCode::TO_PT, tablets.send_remote_files(cmd.args[0], tablet_id, version)};
+            // The checkpoint and log files are streamed after the header instead of being read into it
+            auto body = std::make_unique<ResponseBody>();
+            string header = tablets.send_remote_files(cmd.args[0], tablet_id, version, *body);
+            return {DispatcherStatusCode::TO_PT, std::move(header), std::move(body)};
         }
         else if (cmd.origin == CommandOrigin::PRIMARY)
         {
@@ -130,6 +218,7 @@ DispatcherResponse KvStorageCommandDispatcher::execute_command(NewCommand<KVServ
 
         // Signal Server.cc that it should bring up the server again
         IS_ALIVE.store(true);
+        Server::notify_state_change();
 
         // NOTE: We cant wait intil SS_FD is set to -1 because this will block the server from
         // receiving data from the primary when its booting up!
@@ -150,6 +239,7 @@ DispatcherResponse KvStorageCommandDispatcher::execute_command(NewCommand<KVServ
         IS_ALIVE.store(false);
         close(SS_FD.load());
         SS_FD.store(-1);
+        Server::notify_state_change();
         return {DispatcherStatusCode::DISPATCHER_OK, "+OK Shutting down KVStorage Node"};
 
     case KVServerCommand::CROW:
@@ -157,24 +247,21 @@ DispatcherResponse KvStorageCommandDispatcher::execute_command(NewCommand<KVServ
         {
             // We need to forward to internal port of the primary node to start the remote write process
             string message_id = RemoteWriteRequestAssembler::create_message_id();
-            return remote_write(message_id, RemoteWriteRequestAssembler::assemble_create_row(message_id, cmd.args[0]));
+            return remote_write(message_id, RemoteWriteRequestAssembler::assemble_create_row(message_id, cmd.args[0], cmd.consistency));
         }
         else if (cmd.origin == CommandOrigin::REPLICA)
         {
-            // Only primary thread of primary node can receive this command. We need to send requests to all replicas and wait for their response
+            // Only primary thread of primary node can receive this command. We apply the write and ship its log record to all replicas
             std::string row_key = cmd.args[0];
             std::string host_port = cmd.args[1];
             std::string message_id = cmd.args[2];
 
-            IStorageService storage_service(COORDINATOR_SERVICE->get_kv_servers_map());
-            BroadcastResult result = storage_service.broadcast_create_row(RG_ID, message_id, row_key);
+            std::vector<TabletLogRecord> records;
+            bool applied = tablets.create_row(row_key) == TabletStatus::OK;
+            if (applied)
+                records.emplace_back(TabletLoggerCmdType::ROW, row_key);
 
-            if (DEBUG) // truncated_print("KVStorageCommandDispatcher: Finished using Forwarder to write request", result.formatted_response, message_id);
-            {
-                fprintf(stderr, "RW_RESULT (%s):\n %s\n", message_id.c_str(), result.formatted_response.c_str());
-            }
-
-            return {DispatcherStatusCode::TO_PT, RemoteWriteRequestAssembler::assemble_remote_write_result(host_port, result)};
+            return replicate(host_port, message_id, applied, records, cmd.consistency);
         }
 
         switch (tablets.create_row(cmd.args[0]))
@@ -183,6 +270,8 @@ DispatcherResponse KvStorageCommandDispatcher::execute_command(NewCommand<KVServ
             return {DispatcherStatusCode::DISPATCHER_OK, "+OK"};
         case TabletStatus::ROW_KEY_ERR:
             return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Row already exists"};
+        default:
+            return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Internal error"};
         }
 
     case KVServerCommand::PUT:
@@ -197,27 +286,24 @@ DispatcherResponse KvStorageCommandDispatcher::execute_command(NewCommand<KVServ
             {
                 // We need to forward to internal port of the primary node to start the remote write process
                 string message_id = RemoteWriteRequestAssembler::create_message_id();
-                return remote_write(message_id, RemoteWriteRequestAssembler::assemble_put(message_id, cmd.args[0], cmd.args[1], value));
+                return remote_write(message_id, RemoteWriteRequestAssembler::assemble_put(message_id, cmd.args[0], cmd.args[1], value, cmd.consistency));
             }
             else if (cmd.origin == CommandOrigin::REPLICA)
             {
-
-                // Only primary thread of primary node can receive this command. We need to send requests to all replicas and wait for their response
+                // Only primary thread of primary node can receive this command. We apply the write and ship its log record to all replicas
                 std::string row_key = cmd.args[0];
                 std::string column_key = cmd.args[1];
-                std::string value_size = cmd.args[2];
                 std::string host_port = cmd.args[3];
                 std::string message_id = cmd.args[4];
 
-                IStorageService storage_service(COORDINATOR_SERVICE->get_kv_servers_map());
-                BroadcastResult result = storage_service.broadcast_put(RG_ID, message_id, row_key, column_key, value);
-
-                if (DEBUG)
-                {
-                    fprintf(stderr, "RW_RESULT (%s):\n %s\n", message_id.c_str(), result.formatted_response.c_str());
-                }
+                // The record copies the value before the write takes it
+                std::vector<TabletLogRecord> records;
+                records.emplace_back(TabletLoggerCmdType::PUT, row_key, column_key, value_view(value));
+                bool applied = tablets.write(row_key, column_key, value) == TabletStatus::OK;
+                if (!applied)
+                    records.clear();
 
-                return {DispatcherStatusCode::TO_PT, RemoteWriteRequestAssembler::assemble_remote_write_result(host_port, result)};
+                return replicate(host_port, message_id, applied, records, cmd.consistency);
             }
 
             // If it reaches here then its a command that comes from the primary node. So we just need to execute the command on our own storage and return the response
@@ -267,26 +353,24 @@ DispatcherResponse KvStorageCommandDispatcher::execute_command(NewCommand<KVServ
             if (cmd.origin == CommandOrigin::CLIENT)
             {
                 string message_id = RemoteWriteRequestAssembler::create_message_id();
-                return remote_write(message_id, RemoteWriteRequestAssembler::assemble_cput(message_id, cmd.args[0], cmd.args[1], conditional_value, value));
+                return remote_write(message_id, RemoteWriteRequestAssembler::assemble_cput(message_id, cmd.args[0], cmd.args[1], conditional_value, value, cmd.consistency));
             }
             else if (cmd.origin == CommandOrigin::REPLICA)
             {
                 std::string row_key = cmd.args[0];
                 std::string column_key = cmd.args[1];
-                std::string value_size = cmd.args[2];
-                std::string cvalue_size = cmd.args[3];
                 std::string host_port = cmd.args[4];
                 std::string message_id = cmd.args[5];
 
-                IStorageService storage_service(COORDINATOR_SERVICE->get_kv_servers_map());
-                BroadcastResult result = storage_service.broadcast_cput(RG_ID, message_id, row_key, column_key, conditional_value, value);
+                // The condition is only checked here, the replicas get the value as a put if it was written
+                std::vector<TabletLogRecord> records;
+                records.emplace_back(TabletLoggerCmdType::PUT, row_key, column_key, value_view(value));
+                bool is_conditional_value = false;
+                bool applied = tablets.conditional_write(row_key, column_key, conditional_value, value, is_conditional_value) == TabletStatus::OK;
+                if (!applied || !is_conditional_value)
+                    records.clear();
 
-                if (DEBUG)
-                {
-                    fprintf(stderr, "RW_RESULT (%s):\n %s\n", message_id.c_str(), result.formatted_response.c_str());
-                }
-
-                return {DispatcherStatusCode::TO_PT, RemoteWriteRequestAssembler::assemble_remote_write_result(host_port, result)};
+                return replicate(host_port, message_id, applied, records, cmd.consistency);
             }
 
             bool is_conditional_value;
@@ -336,7 +420,7 @@ DispatcherResponse KvStorageCommandDispatcher::execute_command(NewCommand<KVServ
         if (cmd.origin == CommandOrigin::CLIENT)
         {
             string message_id = RemoteWriteRequestAssembler::create_message_id();
-            return remote_write(message_id, RemoteWriteRequestAssembler::assemble_move(message_id, cmd.args[0], cmd.args[1], cmd.args[2]));
+            return remote_write(message_id, RemoteWriteRequestAssembler::assemble_move(message_id, cmd.args[0], cmd.args[1], cmd.args[2], cmd.consistency));
         }
         else if (cmd.origin == CommandOrigin::REPLICA)
         {
@@ -346,15 +430,12 @@ DispatcherResponse KvStorageCommandDispatcher::execute_command(NewCommand<KVServ
             std::string host_port = cmd.args[3];
             std::string message_id = cmd.args[4];
 
-            IStorageService storage_service(COORDINATOR_SERVICE->get_kv_servers_map());
-            BroadcastResult result = storage_service.broadcast_move(RG_ID, message_id, row_key, column_key, new_column_key);
+            std::vector<TabletLogRecord> records;
+            bool applied = tablets.move(row_key, column_key, new_column_key) == TabletStatus::OK;
+            if (applied)
+                records.emplace_back(TabletLoggerCmdType::MOV, row_key, column_key, new_column_key);
 
-            if (DEBUG)
-            {
-                fprintf(stderr, "RW_RESULT (%s):\n %s\n", message_id.c_str(), result.formatted_response.c_str());
-            }
-
-            return {DispatcherStatusCode::TO_PT, RemoteWriteRequestAssembler::assemble_remote_write_result(host_port, result)};
+            return replicate(host_port, message_id, applied, records, cmd.consistency);
         }
 
         switch (tablets.move(cmd.args[0], cmd.args[1], cmd.args[2]))
@@ -365,13 +446,15 @@ DispatcherResponse KvStorageCommandDispatcher::execute_command(NewCommand<KVServ
             return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Row not found"};
         case TabletStatus::COLUMN_KEY_ERR:
             return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Column not found"};
+        default:
+            return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Internal error"};
         }
 
     case KVServerCommand::DEL:
         if (cmd.origin == CommandOrigin::CLIENT)
         {
             string message_id = RemoteWriteRequestAssembler::create_message_id();
-            return remote_write(message_id, RemoteWriteRequestAssembler::assemble_del(message_id, cmd.args[0], cmd.args[1]));
+            return remote_write(message_id, RemoteWriteRequestAssembler::assemble_del(message_id, cmd.args[0], cmd.args[1], cmd.consistency));
         }
         else if (cmd.origin == CommandOrigin::REPLICA)
         {
@@ -380,15 +463,12 @@ DispatcherResponse KvStorageCommandDispatcher::execute_command(NewCommand<KVServ
             std::string host_port = cmd.args[2];
             std::string message_id = cmd.args[3];
 
-            IStorageService storage_service(COORDINATOR_SERVICE->get_kv_servers_map());
-            BroadcastResult result = storage_service.broadcast_remove(RG_ID, message_id, row_key, column_key);
+            std::vector<TabletLogRecord> records;
+            bool applied = tablets.remove(row_key, column_key) == TabletStatus::OK;
+            if (applied)
+                records.emplace_back(TabletLoggerCmdType::DEL, row_key, column_key);
 
-            if (DEBUG)
-            {
-                fprintf(stderr, "RW_RESULT (%s):\n %s\n", message_id.c_str(), result.formatted_response.c_str());
-            }
-
-            return {DispatcherStatusCode::TO_PT, RemoteWriteRequestAssembler::assemble_remote_write_result(host_port, result)};
+            return replicate(host_port, message_id, applied, records, cmd.consistency);
         }
 
         switch (tablets.remove(cmd.args[0], cmd.args[1]))
@@ -399,26 +479,224 @@ DispatcherResponse KvStorageCommandDispatcher::execute_command(NewCommand<KVServ
             return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Row not found"};
         case TabletStatus::COLUMN_KEY_ERR:
             return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Column not found"};
+        default:
+            return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Internal error"};
         }
 
     case KVServerCommand::GET:
     {
         tablet_value value;
+        if (cmd.args.size() == 4)
+        {
+            size_t offset;
+            size_t length;
+            try
+            {
+                offset = std::stoul(cmd.args[2]);
+                length = std::stoul(cmd.args[3]);
+            }
+            catch (...)
+            {
+                return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Invalid range argument"};
+            }
+
+            // Only the range is read, the header also carries the size of the whole value
+            size_t value_size;
+            switch (tablets.read(cmd.args[0], cmd.args[1], offset, length, value, value_size))
+            {
+            case TabletStatus::OK:
+            {
+                if (offset > value_size)
+                    return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Range not satisfiable"};
+
+                DispatcherResponse response{DispatcherStatusCode::DISPATCHER_OK, "+OK " + std::to_string(value.size()) + " " + std::to_string(value_size)};
+                response.body = std::make_unique<ResponseBody>();
+                response.body->add(std::move(value));
+                response.body->add("\r\n");
+                return response;
+            }
+            case TabletStatus::ROW_KEY_ERR:
+                return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Row not found"};
+            case TabletStatus::COLUMN_KEY_ERR:
+                return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Column not found"};
+            default:
+                return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Internal error"};
+            }
+        }
+
         switch (tablets.read(cmd.args[0], cmd.args[1], value))
         {
+        case TabletStatus::OK:
+        {
+            // The value is written after the header as it is
+            DispatcherResponse response{DispatcherStatusCode::DISPATCHER_OK, "+OK " + std::to_string(value.size())};
+            response.body = std::make_unique<ResponseBody>();
+            response.body->add(std::move(value));
+            response.body->add("\r\n");
+            return response;
+        }
+        case TabletStatus::ROW_KEY_ERR:
+            return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Row not found"};
+        case TabletStatus::COLUMN_KEY_ERR:
+            return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Column not found"};
+        default:
+            return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Internal error"};
+        }
+    }
+
+    case KVServerCommand::MPUT:
+        if (receiving_data)
+        {
+            receiving_data = false;
+
+            // The values arrive in the order of their cells
+            std::vector<KVCell> cells(cmd.args.size() / 3);
+            for (size_t i = 0; i < cells.size(); ++i)
+            {
+                cells[i].row_key = cmd.args[3 * i];
+                cells[i].column_key = cmd.args[3 * i + 1];
+                data_receiver.retrieve_data(cells[i].value);
+            }
+            data_receiver.reset();
+
+            if (cmd.origin == CommandOrigin::CLIENT)
+            {
+                // All cells are forwarded to the primary node as a single remote write
+                string message_id = RemoteWriteRequestAssembler::create_message_id();
+                return remote_write(message_id, RemoteWriteRequestAssembler::assemble_multi_put(message_id, cells, cmd.consistency));
+            }
+            else if (cmd.origin == CommandOrigin::REPLICA)
+            {
+                std::string host_port = cmd.args[cmd.args.size() - 2];
+                std::string message_id = cmd.args[cmd.args.size() - 1];
+
+                // The cells written before one that fails stay written, so their records are shipped as well
+                std::vector<TabletLogRecord> records;
+                bool applied = true;
+                for (KVCell &cell : cells)
+                {
+                    records.emplace_back(TabletLoggerCmdType::PUT, cell.row_key, cell.column_key, value_view(cell.value));
+                    if (tablets.write(cell.row_key, cell.column_key, cell.value) != TabletStatus::OK)
+                    {
+                        records.pop_back();
+                        applied = false;
+                        break;
+                    }
+                }
+
+                return replicate(host_port, message_id, applied, records, cmd.consistency);
+            }
+
+            // The cells are written in order, the first one that fails ends the command and the ones before it stay written
+            for (KVCell &cell : cells)
+            {
+                switch (tablets.write(cell.row_key, cell.column_key, cell.value))
+                {
+                case TabletStatus::OK:
+                    break;
+                case TabletStatus::ROW_KEY_ERR:
+                    return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Row not found"};
+                case TabletStatus::SPLITTING_ERR:
+                    return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Tablet splitting in progress"};
+                case TabletStatus::CACHING_ERR:
+                    return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Tablet caching in progress"};
+                default:
+                    return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Internal error"};
+                }
+            }
+            return {DispatcherStatusCode::DISPATCHER_OK, "+OK " + std::to_string(cells.size())};
+        }
+        else
+        {
+            std::vector<size_t> value_sizes;
+            try
+            {
+                for (size_t i = 2; i < cmd.args.size(); i += 3)
+                    value_sizes.push_back(std::stoul(cmd.args[i]));
+            }
+            catch (...)
+            {
+                return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Invalid size argument"};
+            }
+
+            receiving_data = true;
+            data_receiver.set_command(cmd);
+            for (size_t value_size : value_sizes)
+                data_receiver.request_data(value_size);
+
+            return {DispatcherStatusCode::DISPATCHER_OK, ""};
+        }
+
+    case KVServerCommand::MGET:
+    {
+        // Every cell is answered like a GET, the values are written after their headers as they are
+        DispatcherResponse response{DispatcherStatusCode::DISPATCHER_OK, "+OK " + std::to_string(cmd.args.size() / 2)};
+        response.body = std::make_unique<ResponseBody>();
+        for (size_t i = 0; i < cmd.args.size(); i += 2)
+        {
+            tablet_value value;
+            switch (tablets.read(cmd.args[i], cmd.args[i + 1], value))
+            {
+            case TabletStatus::OK:
+                response.body->add(IStorageService::from_string("+OK " + std::to_string(value.size()) + "\r\n"));
+                response.body->add(std::move(value));
+                response.body->add("\r\n");
+                break;
+            case TabletStatus::ROW_KEY_ERR:
+                response.body->add("-ERR Row not found\r\n");
+                break;
+            case TabletStatus::COLUMN_KEY_ERR:
+                response.body->add("-ERR Column not found\r\n");
+                break;
+            default:
+                response.body->add("-ERR Internal error\r\n");
+                break;
+            }
+        }
+        return response;
+    }
+
+    case KVServerCommand::STAT:
+    {
+        size_t value_size;
+        size_t tablet_version;
+        switch (tablets.stat(cmd.args[0], cmd.args[1], value_size, tablet_version))
+        {
         case TabletStatus::OK:
             return {DispatcherStatusCode::DISPATCHER_OK,
-                    "+OK " + std::to_string(value.size()) + "\r\n" + Tablet::to_string(value)};
+                    "+OK " + std::to_string(value_size) + " " + std::to_string(tablet_version)};
         case TabletStatus::ROW_KEY_ERR:
             return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Row not found"};
         case TabletStatus::COLUMN_KEY_ERR:
             return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Column not found"};
+        default:
+            return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Internal error"};
         }
     }
 
     case KVServerCommand::LISTC:
     {
         std::string msg{"+OK\r\n"};
+        if (cmd.args.size() == 2)
+        {
+            // One line per column with the size of its value and the tablet version, the values are not read
+            std::map<std::string, size_t> column_sizes;
+            size_t tablet_version;
+            switch (tablets.list_columns(cmd.args[0], column_sizes, tablet_version))
+            {
+            case TabletStatus::OK:
+                for (const auto &[column_key, value_size] : column_sizes)
+                    msg += column_key + " " + std::to_string(value_size) + " " + std::to_string(tablet_version) + "\r\n";
+
+                msg += ".";
+                return {DispatcherStatusCode::DISPATCHER_OK, msg};
+            case TabletStatus::ROW_KEY_ERR:
+                return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Row not found"};
+            default:
+                return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Internal error"};
+            }
+        }
+
         std::set<std::string> column_keys;
         switch (tablets.list_columns(cmd.args[0], column_keys))
         {
@@ -455,6 +733,51 @@ DispatcherResponse KvStorageCommandDispatcher::execute_command(NewCommand<KVServ
         return {DispatcherStatusCode::DISPATCHER_OK, msg};
     }
 
+    case KVServerCommand::CACHE:
+    {
+        std::string msg{"+OK\r\n"};
+        std::vector<std::string> stats;
+        tablets.list_cache_stats(stats);
+        for (const auto &stat : stats)
+            msg += stat + "\r\n";
+        msg += ".";
+        return {DispatcherStatusCode::DISPATCHER_OK, msg};
+    }
+
+    case KVServerCommand::LOG:
+        if (receiving_data)
+        {
+            receiving_data = false;
+            tablet_value records;
+            data_receiver.retrieve_data(records);
+            data_receiver.reset();
+
+            // Only the primary thread of a replica receives log records, they come from the primary node
+            if (cmd.origin != CommandOrigin::PRIMARY)
+                return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Log records are only accepted from the primary"};
+
+            return {DispatcherStatusCode::DISPATCHER_OK, replication_log.apply(std::stoull(cmd.args[0]), value_view(records))};
+        }
+        else
+        {
+            size_t records_size;
+            try
+            {
+                std::stoull(cmd.args[0]);
+                records_size = std::stoul(cmd.args[1]);
+            }
+            catch (...)
+            {
+                return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Invalid stream or size argument"};
+            }
+
+            receiving_data = true;
+            data_receiver.set_command(cmd);
+            data_receiver.request_data(records_size);
+
+            return {DispatcherStatusCode::DISPATCHER_OK, ""};
+        }
+
     case KVServerCommand::RW_RESULT:
     {
         std::string host_port = cmd.args[0];
@@ -491,7 +814,7 @@ DispatcherResponse KvStorageCommandDispatcher::execute_command(NewCommand<KVServ
     }
 }
 
-NewCommand<KVServerCommand> KvStorageCommandDispatcher::parse_message(std::string_view message)
+NewCommand<KVServerCommand> KvStorageCommandDispatcher::parse_message(std::string_view message) const
 {
     size_t cmd_end = message.find_first_of(" ");
     std::string cmd_str(message.substr(0, cmd_end));
@@ -511,46 +834,76 @@ NewCommand<KVServerCommand> KvStorageCommandDispatcher::parse_message(std::strin
     if (cmd_end != std::string::npos)
         parse_arguments(message.substr(cmd_end), args);
 
+    // Consistency level of a write, the servers that must apply it before it succeeds
+    WriteConsistency consistency{WriteConsistency::ALL};
+    if (has_consistency(cmd_str, args.size(), origin))
+    {
+        if (!string_to_consistency(to_upper(args.back()), consistency))
+            return {KVServerCommand::ERR, {"Invalid consistency level"}};
+        args.pop_back();
+    }
+
     if (cmd_str == "CROW")
     {
         if (!(args.size() == 1 || args.size() == 3))
             return {KVServerCommand::ERR, {"Invalid number of arguments"}};
-        return {KVServerCommand::CROW, std::move(args), origin};
+        return {KVServerCommand::CROW, std::move(args), origin, consistency};
     }
     if (cmd_str == "PUT")
     {
         if (!(args.size() == 3 || args.size() == 5))
             return {KVServerCommand::ERR, {"Invalid number of arguments"}};
-        return {KVServerCommand::PUT, std::move(args), origin};
+        return {KVServerCommand::PUT, std::move(args), origin, consistency};
     }
     if (cmd_str == "CPUT")
     {
         if (!(args.size() == 4 || args.size() == 6))
             return {KVServerCommand::ERR, {"Invalid number of arguments"}};
-        return {KVServerCommand::CPUT, std::move(args), origin};
+        return {KVServerCommand::CPUT, std::move(args), origin, consistency};
     }
     if (cmd_str == "MOVE")
     {
         if (!(args.size() == 3 || args.size() == 5))
             return {KVServerCommand::ERR, {"Invalid number of arguments"}};
-        return {KVServerCommand::MOVE, std::move(args), origin};
+        return {KVServerCommand::MOVE, std::move(args), origin, consistency};
     }
     else if (cmd_str == "DEL")
     {
         if (!(args.size() == 2 || args.size() == 4))
             return {KVServerCommand::ERR, {"Invalid number of arguments"}};
-        return {KVServerCommand::DEL, std::move(args), origin};
+        return {KVServerCommand::DEL, std::move(args), origin, consistency};
     }
     else if (cmd_str == "GET")
+    {
+        // GET row col offset length reads a range of the value
+        if (!(args.size() == 2 || args.size() == 4))
+            return {KVServerCommand::ERR, {"Invalid number of arguments, 2 or 4 expected"}};
+        return {KVServerCommand::GET, std::move(args), origin};
+    }
+    else if (cmd_str == "MPUT")
+    {
+        // Row, column and size of every cell, followed by the initiator and message id when forwarded to the primary
+        if (args.size() < 3 || !(args.size() % 3 == 0 || args.size() % 3 == 2))
+            return {KVServerCommand::ERR, {"Invalid number of arguments"}};
+        return {KVServerCommand::MPUT, std::move(args), origin, consistency};
+    }
+    else if (cmd_str == "MGET")
+    {
+        if (args.size() < 2 || args.size() % 2 != 0)
+            return {KVServerCommand::ERR, {"Invalid number of arguments, row and column pairs expected"}};
+        return {KVServerCommand::MGET, std::move(args), origin};
+    }
+    else if (cmd_str == "STAT")
     {
         if (args.size() != 2)
             return {KVServerCommand::ERR, {"Invalid number of arguments, 2 expected"}};
-        return {KVServerCommand::GET, std::move(args), origin};
+        return {KVServerCommand::STAT, std::move(args), origin};
     }
     else if (cmd_str == "LISTC")
     {
-        if (args.size() != 1)
-            return {KVServerCommand::ERR, {"Invalid number of arguments, 1 expected"}};
+        // LISTC row SIZES also lists the size and version of every value
+        if (!(args.size() == 1 || (args.size() == 2 && to_upper(args[1]) == "SIZES")))
+            return {KVServerCommand::ERR, {"Invalid arguments, row and optional SIZES expected"}};
         return {KVServerCommand::LISTC, std::move(args), origin};
     }
     else if (cmd_str == "LISTR")
@@ -565,6 +918,12 @@ NewCommand<KVServerCommand> KvStorageCommandDispatcher::parse_message(std::strin
             return {KVServerCommand::ERR, {"Invalid number of arguments, none expected"}};
         return {KVServerCommand::LISTT, std::move(args), origin};
     }
+    else if (cmd_str == "CACHE")
+    {
+        if (args.size() != 0)
+            return {KVServerCommand::ERR, {"Invalid number of arguments, none expected"}};
+        return {KVServerCommand::CACHE, std::move(args), origin};
+    }
     else if (cmd_str == "QUIT")
     {
         if (args.size() != 0)
@@ -589,6 +948,13 @@ NewCommand<KVServerCommand> KvStorageCommandDispatcher::parse_message(std::strin
             return {KVServerCommand::ERR, {"Invalid number of arguments, three expected"}};
         return {KVServerCommand::RW_RESULT, std::move(args), origin};
     }
+    else if (cmd_str == "LOG")
+    {
+        // Stream of the primary and size of the records that follow
+        if (args.size() != 2)
+            return {KVServerCommand::ERR, {"Invalid number of arguments, two expected"}};
+        return {KVServerCommand::LOG, std::move(args), origin};
+    }
     else if (cmd_str == "SYNCV")
     {
         // if (args.size() != 3)
@@ -605,7 +971,7 @@ NewCommand<KVServerCommand> KvStorageCommandDispatcher::parse_message(std::strin
     return {KVServerCommand::ERR, {"Unknown command"}, origin};
 }
 
-CommandOrigin KvStorageCommandDispatcher::get_command_origin(std::string_view message)
+CommandOrigin KvStorageCommandDispatcher::get_command_origin(std::string_view message) const
 {
     if (message[0] == '#')
         return CommandOrigin::PRIMARY;
@@ -617,7 +983,7 @@ CommandOrigin KvStorageCommandDispatcher::get_command_origin(std::string_view me
         return CommandOrigin::CLIENT;
 }
 
-void KvStorageCommandDispatcher::parse_arguments(std::string_view message, std::vector<std::string> &args)
+void KvStorageCommandDispatcher::parse_arguments(std::string_view message, std::vector<std::string> &args) const
 {
     size_t start{0}, end{0};
     while (true)
@@ -673,6 +1039,14 @@ void DataReceiver::reset()
     _finished_data = false;
 }
 
+void DataReceiver::read_payload(std::vector<std::byte> &&payload)
+{
+    data.push_front(std::move(payload));
+    _finished_data = true;
+    if (data.size() == data_requests.size())
+        _finished = true;
+}
+
 void DataReceiver::read_data(const string &message)
 {
     size_t idx;
@@ -740,6 +1114,15 @@ std::string random_reader(int fd)
 
 DispatcherResponse KvStorageCommandDispatcher::remote_write(const std::string message_id, const std::string &remote_write_request)
 {
+    // Clients send writes to the primary, a replica names the primary instead of forwarding the write to it
+    std::string primary_address;
+    if (!is_primary(primary_address))
+    {
+        if (primary_address.empty())
+            return {DispatcherStatusCode::DISPATCHER_OK, "-ERR No primary in replication group"};
+        return {DispatcherStatusCode::DISPATCHER_OK, "-ERR REDIRECT " + primary_address};
+    }
+
     // Open pipe
     int pipe_fds[2];
     if (pipe(pipe_fds) == -1)
@@ -759,7 +1142,17 @@ DispatcherResponse KvStorageCommandDispatcher::remote_write(const std::string me
     if (DEBUG) truncated_print("KVStorageCommandDispatcher: Using Forwarder to write request", remote_write_request);
 
     // Sends the request to the primary thread of the primary node (who will coordinate the write operation)
-    UPDATE_FORWARDER->forward_update(remote_write_request);
+    // Without the request no result is written to the pipe
+    if (!UPDATE_FORWARDER->forward_update(remote_write_request))
+    {
+        {
+            std::unique_lock<std::shared_mutex> lock(pipe_map_mutex);
+            PIPE_MAP.erase(message_id);
+        }
+        close(write_fd);
+        close(read_fd);
+        return {DispatcherStatusCode::DISPATCHER_OK, "-ERR Remote write forwarding error"};
+    }
 
     if (DEBUG) truncated_print("KVStorageCommandDispatcher: Finished using Forwarder to write request", remote_write_request);
 
@@ -788,3 +1181,53 @@ DispatcherResponse KvStorageCommandDispatcher::remote_write(const std::string me
 
     return {DispatcherStatusCode::DISPATCHER_OK, response_str};
 }
+
+bool KvStorageCommandDispatcher::is_primary(std::string &primary_address) const
+{
+    primary_address.clear();
+    std::map<int, std::vector<KVServer>> kv_servers_map = COORDINATOR_SERVICE->get_kv_servers_map();
+    for (const KVServer &server : kv_servers_map[RG_ID])
+    {
+        if (server.is_primary)
+        {
+            primary_address = server.host + ":" + std::to_string(server.port);
+            return server.host == HOST && server.port == PORT_NO;
+        }
+    }
+    return false;
+}
+
+DispatcherResponse KvStorageCommandDispatcher::replicate(const std::string &host_port, const std::string &message_id, bool applied,
+                                                         std::vector<TabletLogRecord> &records, WriteConsistency consistency)
+{
+    // Splits made since the last write go ahead of its records, so replicas split their tablets where the primary did
+    std::vector<TabletSplit> splits = tablets.take_shipped_splits();
+    for (auto it = splits.rbegin(); it != splits.rend(); ++it)
+        records.emplace(records.begin(), TabletLoggerCmdType::SPL, it->split_key, "", std::to_string(it->new_tablet_id));
+
+    auto write_result = [host_port, message_id, applied](BroadcastResult &result) -> DispatcherResponse
+    {
+        result.success = result.success && applied;
+
+        if (DEBUG)
+        {
+            fprintf(stderr, "RW_RESULT (%s):\n %s\n", message_id.c_str(), result.formatted_response.c_str());
+        }
+
+        return {DispatcherStatusCode::TO_PT, RemoteWriteRequestAssembler::assemble_remote_write_result(host_port, result)};
+    };
+
+    if (!result_sender)
+    {
+        BroadcastResult result = replication_log.ship(message_id, records, consistency);
+        return write_result(result);
+    }
+
+    // The primary thread goes on with the next write while the replicas acknowledge this one
+    auto send_result = [sender = result_sender, write_result](BroadcastResult &result)
+    {
+        sender(write_result(result));
+    };
+    replication_log.ship_async(message_id, records, consistency, send_result);
+    return {DispatcherStatusCode::DISPATCHER_OK, ""};
+}
@@ -2,9 +2,11 @@
 
 #include <list>
 #include <algorithm>
+#include <functional>
 #include "ICommandDispatcher.h"
 #include "Tablet.h"
 #include "KVServerCommand.h"
+#include "TabletLogRecord.h"
 #include "Globals.h"
 
 enum class CommandOrigin
@@ -21,6 +23,8 @@ struct NewCommand
     T cmd;
     std::vector<std::string> args;
     CommandOrigin origin;
+    // Servers that must apply a write before it succeeds
+    WriteConsistency consistency{WriteConsistency::ALL};
 };
 
 class DataReceiver
@@ -47,6 +51,8 @@ public:
     void reset();
     // Reads and distributes data to arguments
     void read_data(const string &message);
+    // Takes a complete payload of the next requested size
+    void read_payload(std::vector<std::byte> &&payload);
 };
 
 class KvStorageCommandDispatcher : public ICommandDispatcher
@@ -54,22 +60,43 @@ class KvStorageCommandDispatcher : public ICommandDispatcher
 public:
     KvStorageCommandDispatcher();
     DispatcherResponse dispatch(const string &message) override;
+    void payload_sizes(const string &message, vector<size_t> &sizes) const override;
+    bool accepts_tags() const override { return true; }
+    DispatcherResponse dispatch_payload(vector<std::byte> &&payload) override;
+
+    // Sends the result of a replicated write to its initiator
+    typedef std::function<void(DispatcherResponse)> ResultSender;
+    // Primary thread: lets replicated writes return before their replicas acknowledged them, the result is sent
+    // with sender once they did
+    inline void set_result_sender(ResultSender sender) { result_sender = std::move(sender); }
 
 private:
     bool receiving_data{false};
+    ResultSender result_sender{};
     size_t server_id{0};
     DataReceiver data_receiver{};
 
     // Parse message and return command with arguments
-    NewCommand<KVServerCommand> parse_message(std::string_view message);
+    NewCommand<KVServerCommand> parse_message(std::string_view message) const;
     // Parse arguments from message
-    void parse_arguments(std::string_view message, std::vector<std::string> &args);
+    void parse_arguments(std::string_view message, std::vector<std::string> &args) const;
     // Execute command and return response
     DispatcherResponse execute_command(NewCommand<KVServerCommand> &cmd);
-    // Performs remote write operation
+    // Executes the command waiting for data once all of it was received
+    DispatcherResponse execute_received_command();
+    // Performs remote write operation on the primary, a replica answers with a redirect to the primary instead
     DispatcherResponse remote_write(const std::string message_id, const std::string &remote_write_request);
+    // Returns true if this server is the primary of its replication group
+    // primary_address gets the host and port of the primary, it stays empty if no primary is known
+    bool is_primary(std::string &primary_address) const;
+    // Ships the log records of a write applied by the primary to the replicas and returns the result for the initiator
+    // The records of cells written before a failing one are shipped as well, applied is false if any cell failed
+    // Returns once the servers required by the consistency level applied the records, with a result sender it
+    // returns right away and the sender gets the result
+    DispatcherResponse replicate(const std::string &host_port, const std::string &message_id, bool applied,
+                                 std::vector<TabletLogRecord> &records, WriteConsistency consistency);
     // Based on the message, gets the origin of the command
-    CommandOrigin get_command_origin(std::string_view message);
+    CommandOrigin get_command_origin(std::string_view message) const;
 };
 
 // Inserts capitalized string in into out
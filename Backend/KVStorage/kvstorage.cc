@@ -60,10 +60,6 @@ int main(int argc, char *argv[])
     sa.sa_flags = 0; // Ensures SA_RESTART is not set, system calls should return EINTR
     sigaction(SIGINT, &sa, NULL);
 
-    // Setup SIGUSR1 handler for worker threads
-    sa.sa_handler = Server::sigusr1_handler;
-    sigaction(SIGUSR1, &sa, NULL);
-
     config.server_type = ServerType::KVSTORE;
 
     // Initialize KVPrimaryStorageThread in a background thread
@@ -72,7 +68,6 @@ int main(int argc, char *argv[])
     auto primary_thread_runner = [](void *arg) -> void * // Wrapper function for CoordinatorService::start
     {
         // Block all signals from being received to KVPrimaryThread.
-        // ClientHandler should be the only one to receive SIGUSR1.
         sigset_t sigset;
         sigfillset(&sigset);                       // Add all signals to the set
         pthread_sigmask(SIG_BLOCK, &sigset, NULL); // Block all signals for this thread
@@ -100,7 +95,9 @@ int main(int argc, char *argv[])
     }
 
     // Initialize the tablet array
-    tablets.init(config.tablet_init_dir, config.tablet_work_dir);
+    tablets.init(config.tablet_init_dir, config.tablet_work_dir,
+                 config.checkpoint_frequency, config.checkpoint_log_bytes,
+                 config.cache_memory_bytes, config.cache_policy, config.block_cache_bytes);
 
     fprintf(stderr, "Server initialized\n");
     /* Step 3: Start the server */
@@ -4,9 +4,9 @@
 #include <sstream>
 #include "Globals.h"
 
-std::string RemoteWriteRequestAssembler::assemble_put(const std::string message_id, const std::string &row_key, const std::string &column_key, const tablet_value &value)
+std::string RemoteWriteRequestAssembler::assemble_put(const std::string message_id, const std::string &row_key, const std::string &column_key, const tablet_value &value, WriteConsistency consistency)
 {
-    std::string response{"?" + command_to_string(KVServerCommand::PUT) + " " + row_key + " " + column_key + " " + std::to_string(value.size()) + " " + HOST + ":" + to_string(PORT_NO) + " " + message_id + "\r\n"};
+    std::string response{"?" + command_to_string(KVServerCommand::PUT) + " " + row_key + " " + column_key + " " + std::to_string(value.size()) + " " + HOST + ":" + to_string(PORT_NO) + " " + message_id + " " + consistency_to_string(consistency) + "\r\n"};
     response.reserve(response.size() + value.size());
     response.append(reinterpret_cast<const char *>(value.data()), value.size());
     return response;
@@ -14,9 +14,9 @@ std::string RemoteWriteRequestAssembler::assemble_put(const std::string message_
 }
 
 std::string RemoteWriteRequestAssembler::assemble_cput(const std::string message_id, const std::string &row_key, const std::string &column_key, const tablet_value &cvalue,
-                                                       const tablet_value &value)
+                                                       const tablet_value &value, WriteConsistency consistency)
 {
-    std::string response{"?" + command_to_string(KVServerCommand::CPUT) + " " + row_key + " " + column_key + " " + std::to_string(to_string_(cvalue).size()) + " " + std::to_string(to_string_(value).size()) + " " + HOST + ":" + to_string(PORT_NO) + " " + message_id + "\r\n"};
+    std::string response{"?" + command_to_string(KVServerCommand::CPUT) + " " + row_key + " " + column_key + " " + std::to_string(to_string_(cvalue).size()) + " " + std::to_string(to_string_(value).size()) + " " + HOST + ":" + to_string(PORT_NO) + " " + message_id + " " + consistency_to_string(consistency) + "\r\n"};
     response.reserve(response.size() + cvalue.size() + 2 + value.size());
     response.append(reinterpret_cast<const char *>(cvalue.data()), cvalue.size());
     response.append("\r\n");
@@ -25,19 +25,41 @@ std::string RemoteWriteRequestAssembler::assemble_cput(const std::string message
     // return "?" + command_to_string(KVServerCommand::CPUT) + " " + row_key + " " + column_key + " " + std::to_string(to_string_(cvalue).size()) + " " + std::to_string(to_string_(value).size()) + " " + HOST + ":" + to_string(PORT_NO) + " " + message_id + "\r\n" + to_string_(cvalue) + "\r\n" + to_string_(value);
 }
 
-std::string RemoteWriteRequestAssembler::assemble_move(const std::string message_id, const std::string &row_key, const std::string &column_key, const std::string &new_column_key)
+std::string RemoteWriteRequestAssembler::assemble_multi_put(const std::string message_id, const std::vector<KVCell> &cells, WriteConsistency consistency)
 {
-    return "?" + command_to_string(KVServerCommand::MOVE) + " " + row_key + " " + column_key + " " + new_column_key + " " + HOST + ":" + to_string(PORT_NO) + " " + message_id;
+    std::string response{"?" + command_to_string(KVServerCommand::MPUT)};
+    size_t values_size = 0;
+    for (const KVCell &cell : cells)
+    {
+        response += " " + cell.row_key + " " + cell.column_key + " " + std::to_string(cell.value.size());
+        values_size += cell.value.size() + 2;
+    }
+    response += " " + HOST + ":" + to_string(PORT_NO) + " " + message_id + " " + consistency_to_string(consistency) + "\r\n";
+
+    // The forwarder terminates the last value
+    response.reserve(response.size() + values_size);
+    for (size_t i = 0; i < cells.size(); ++i)
+    {
+        if (i > 0)
+            response.append("\r\n");
+        response.append(reinterpret_cast<const char *>(cells[i].value.data()), cells[i].value.size());
+    }
+    return response;
+}
+
+std::string RemoteWriteRequestAssembler::assemble_move(const std::string message_id, const std::string &row_key, const std::string &column_key, const std::string &new_column_key, WriteConsistency consistency)
+{
+    return "?" + command_to_string(KVServerCommand::MOVE) + " " + row_key + " " + column_key + " " + new_column_key + " " + HOST + ":" + to_string(PORT_NO) + " " + message_id + " " + consistency_to_string(consistency);
 }
 
-std::string RemoteWriteRequestAssembler::assemble_del(const std::string message_id, const std::string &row_key, const std::string &column_key)
+std::string RemoteWriteRequestAssembler::assemble_del(const std::string message_id, const std::string &row_key, const std::string &column_key, WriteConsistency consistency)
 {
-    return "?" + command_to_string(KVServerCommand::DEL) + " " + row_key + " " + column_key + " " + HOST + ":" + to_string(PORT_NO) + " " + message_id;
+    return "?" + command_to_string(KVServerCommand::DEL) + " " + row_key + " " + column_key + " " + HOST + ":" + to_string(PORT_NO) + " " + message_id + " " + consistency_to_string(consistency);
 }
 
-std::string RemoteWriteRequestAssembler::assemble_create_row(const std::string message_id, const std::string &row_key)
+std::string RemoteWriteRequestAssembler::assemble_create_row(const std::string message_id, const std::string &row_key, WriteConsistency consistency)
 {
-    return "?" + command_to_string(KVServerCommand::CROW) + " " + row_key + " " + HOST + ":" + to_string(PORT_NO) + " " + message_id;
+    return "?" + command_to_string(KVServerCommand::CROW) + " " + row_key + " " + HOST + ":" + to_string(PORT_NO) + " " + message_id + " " + consistency_to_string(consistency);
 }
 
 std::string RemoteWriteRequestAssembler::assemble_remote_write_result(const std::string initiator_address, const BroadcastResult &result)
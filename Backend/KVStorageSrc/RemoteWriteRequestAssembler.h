@@ -12,11 +12,13 @@ public:
     RemoteWriteRequestAssembler() = default;
     ~RemoteWriteRequestAssembler() = default;
 
-    static std::string assemble_put(const std::string message_id, const std::string &row_key, const std::string &column_key, const tablet_value &value);
-    static std::string assemble_cput(const std::string message_id, const std::string &row_key, const std::string &column_key, const tablet_value &cvalue, const tablet_value &value);
-    static std::string assemble_move(const std::string message_id, const std::string &row_key, const std::string &column_key, const std::string &new_column_key);
-    static std::string assemble_del(const std::string message_id, const std::string &row_key, const std::string &column_key);
-    static std::string assemble_create_row(const std::string message_id, const std::string &row_key);
+    // Write requests forwarded to the primary end with the initiator, the message id and the consistency level
+    static std::string assemble_put(const std::string message_id, const std::string &row_key, const std::string &column_key, const tablet_value &value, WriteConsistency consistency);
+    static std::string assemble_cput(const std::string message_id, const std::string &row_key, const std::string &column_key, const tablet_value &cvalue, const tablet_value &value, WriteConsistency consistency);
+    static std::string assemble_multi_put(const std::string message_id, const std::vector<KVCell> &cells, WriteConsistency consistency);
+    static std::string assemble_move(const std::string message_id, const std::string &row_key, const std::string &column_key, const std::string &new_column_key, WriteConsistency consistency);
+    static std::string assemble_del(const std::string message_id, const std::string &row_key, const std::string &column_key, WriteConsistency consistency);
+    static std::string assemble_create_row(const std::string message_id, const std::string &row_key, WriteConsistency consistency);
     static std::string assemble_remote_write_result(const std::string initiator_address, const BroadcastResult &result);
     static std::string create_message_id();
 
@@ -0,0 +1,451 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "ReplicationLog.h"
+#include "TabletArray.h"
+#include "KVServerCommand.h"
+#include "Globals.h"
+
+ReplicationLog replication_log;
+
+namespace
+{
+    // Random identifier of a stream, never 0
+    uint64_t new_stream_id()
+    {
+        std::random_device rd;
+        uint64_t id = (static_cast<uint64_t>(rd()) << 32) | rd();
+        return id != 0 ? id : 1;
+    }
+
+    // Applies a single record to the tablets, the same way the write was applied by the primary
+    TabletStatus apply_record(const TabletLogEntry &entry)
+    {
+        const std::string row_key{entry.row_key};
+        switch (entry.cmd)
+        {
+        case TabletLoggerCmdType::PUT:
+        {
+            tablet_value value(reinterpret_cast<const std::byte *>(entry.payload.data()),
+                               reinterpret_cast<const std::byte *>(entry.payload.data() + entry.payload.size()));
+            return tablets.write(row_key, std::string{entry.column_key}, value);
+        }
+        case TabletLoggerCmdType::MOV:
+            return tablets.move(row_key, std::string{entry.column_key}, std::string{entry.payload});
+        case TabletLoggerCmdType::DEL:
+            return tablets.remove(row_key, std::string{entry.column_key});
+        case TabletLoggerCmdType::ROW:
+            return tablets.create_row(row_key);
+        case TabletLoggerCmdType::SPL:
+            tablets.apply_split(row_key, std::strtoull(std::string{entry.payload}.c_str(), nullptr, 10));
+            return TabletStatus::OK;
+        }
+        return TabletStatus::OK;
+    }
+}
+
+ReplicationLog::ReplicationLog() : stream_id(new_stream_id())
+{
+}
+
+ReplicationLog::~ReplicationLog()
+{
+    for (auto &[address, stream] : replicas)
+        close_stream(stream);
+}
+
+BroadcastResult ReplicationLog::ship(const std::string &message_id, std::vector<TabletLogRecord> &records,
+                                     WriteConsistency consistency)
+{
+    BroadcastResult result;
+    bool completed = false;
+    auto done = [&](BroadcastResult &write_result)
+    {
+        result = std::move(write_result);
+        completed = true;
+    };
+    ship_async(message_id, records, consistency, done);
+
+    // A write is completed at its deadline at the latest
+    while (!completed)
+    {
+        std::vector<struct pollfd> fds;
+        for (int sockfd : ack_sockets())
+            fds.push_back({sockfd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), REPLICATION_ACK_TIMEOUT_MS) < 0 && errno != EINTR)
+            break;
+        process_acks();
+    }
+    return result;
+}
+
+void ReplicationLog::ship_async(const std::string &message_id, std::vector<TabletLogRecord> &records,
+                                WriteConsistency consistency, ShipDone done)
+{
+    const std::string my_address = HOST + ":" + std::to_string(PORT_NO);
+
+    // Nothing to ship, e.g. for a conditional put whose condition did not hold
+    if (records.empty())
+    {
+        BroadcastResult result{.message_id = message_id, .success = true, .status_codes = {{my_address, 0}}, .results_strings = {{my_address, "+OK"}}};
+        done(result);
+        return;
+    }
+
+    // Number the records and keep them for replicas that miss them
+    std::string batch;
+    for (TabletLogRecord &record : records)
+    {
+        std::string sealed = record.seal(++sequence);
+        batch += sealed;
+        backlog_bytes += sealed.size();
+        backlog.emplace_back(sequence, std::move(sealed));
+    }
+    while (backlog_bytes > REPLICATION_BACKLOG_BYTES && backlog.size() > 1)
+    {
+        backlog_bytes -= backlog.front().second.size();
+        backlog.pop_front();
+    }
+
+    const std::string message = "#" + command_to_string(KVServerCommand::LOG) + " " + std::to_string(stream_id) + " " +
+                                std::to_string(batch.size()) + "\r\n" + batch + "\r\n";
+    const uint64_t last = sequence;
+
+    // Acknowledgements of earlier writes that were not waited for
+    for (auto &[address, stream] : replicas)
+    {
+        if (stream.sockfd != -1)
+            receive_acks(stream);
+    }
+    expire_streams();
+
+    // Send the records to all live replicas first, so they apply them at the same time
+    std::map<int, std::vector<KVServer>> kv_servers_map = COORDINATOR_SERVICE->get_kv_servers_map();
+    const std::vector<KVServer> &group = kv_servers_map[RG_ID];
+    std::vector<ReplicaStream *> streams;
+    for (const KVServer &server : group)
+    {
+        std::string address = server.host + ":" + std::to_string(server.port);
+        if (address == my_address)
+            continue;
+
+        // A replica that is down gets a new connection once it is back
+        if (!server.is_alive)
+        {
+            auto it = replicas.find(address);
+            if (it != replicas.end())
+                close_stream(it->second);
+            continue;
+        }
+
+        ReplicaStream &stream = replicas[address];
+        stream.server = server;
+        if (!send_records(stream, message, last))
+            stream.failed = last;
+        streams.push_back(&stream);
+    }
+
+    size_t required = 1 + streams.size();
+    if (consistency == WriteConsistency::ONE)
+        required = 1;
+    else if (consistency == WriteConsistency::QUORUM)
+        required = group.size() / 2 + 1;
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(REPLICATION_ACK_TIMEOUT_MS);
+    pending.push_back({message_id, last, required, std::move(streams), deadline, std::move(done)});
+    complete_writes();
+}
+
+std::vector<int> ReplicationLog::ack_sockets() const
+{
+    std::vector<int> sockets;
+    for (const auto &[address, stream] : replicas)
+    {
+        if (stream.sockfd != -1 && !stream.in_flight.empty())
+            sockets.push_back(stream.sockfd);
+    }
+    return sockets;
+}
+
+void ReplicationLog::process_acks()
+{
+    for (auto &[address, stream] : replicas)
+    {
+        if (stream.sockfd != -1)
+            receive_acks(stream);
+    }
+    expire_streams();
+    complete_writes();
+}
+
+void ReplicationLog::complete_writes()
+{
+    // Writes complete in any order, a write waiting for all replicas does not hold up one that needs fewer
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<std::pair<PendingWrite, size_t>> completed;
+    for (auto it = pending.begin(); it != pending.end();)
+    {
+        // Replicas that may still acknowledge the write
+        size_t acknowledgements = 1;
+        bool waiting = false;
+        for (ReplicaStream *stream : it->streams)
+        {
+            if (stream->acknowledged >= it->last)
+                ++acknowledgements;
+            else if (stream->failed < it->last && stream->sockfd != -1 && !stream->in_flight.empty())
+                waiting = true;
+        }
+
+        if (acknowledgements >= it->required || !waiting || now >= it->deadline)
+        {
+            completed.emplace_back(std::move(*it), acknowledgements);
+            it = pending.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // Results are handed out once the pending writes are consistent again
+    for (auto &[write, acknowledgements] : completed)
+    {
+        BroadcastResult result = write_result(write, acknowledgements);
+        write.done(result);
+    }
+}
+
+BroadcastResult ReplicationLog::write_result(const PendingWrite &write, size_t acknowledgements) const
+{
+    const std::string my_address = HOST + ":" + std::to_string(PORT_NO);
+    std::map<std::string, int> status_codes{{my_address, 0}};
+    std::map<std::string, std::string> results_strings{{my_address, "+OK " + std::to_string(write.last)}};
+    for (const ReplicaStream *stream : write.streams)
+    {
+        std::string address = stream->server.host + ":" + std::to_string(stream->server.port);
+        if (stream->acknowledged >= write.last)
+            results_strings[address] = "+OK " + std::to_string(stream->acknowledged);
+        else if (stream->failed >= write.last || stream->sockfd == -1)
+            results_strings[address] = "Error";
+        else
+            results_strings[address] = "Pending";
+        status_codes[address] = stream->acknowledged >= write.last ? 0 : 1;
+    }
+
+    std::ostringstream oss;
+    for (const auto &[address, code] : status_codes)
+        oss << "[" << address << "] => Status: " << code << ", Result: " << results_strings[address] << "\n";
+
+    return {
+        .message_id = write.message_id,
+        .success = acknowledgements >= write.required,
+        .formatted_response = oss.str(),
+        .status_codes = status_codes,
+        .results_strings = results_strings};
+}
+
+bool ReplicationLog::send_records(ReplicaStream &stream, const std::string &message, uint64_t last)
+{
+    const KVServer &server = stream.server;
+    if (stream.sockfd == -1)
+    {
+        stream.sockfd = socket(AF_INET, SOCK_STREAM, 0);
+        if (stream.sockfd < 0)
+        {
+            fprintf(stderr, "ReplicationLog: Failed to create socket (%s)\n", strerror(errno));
+            stream.sockfd = -1;
+            return false;
+        }
+
+        struct sockaddr_in server_addr{};
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(server.port_gc);
+        inet_pton(AF_INET, server.host.c_str(), &server_addr.sin_addr);
+        if (connect(stream.sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+        {
+            fprintf(stderr, "ReplicationLog: Failed to connect to replica %s:%d\n", server.host.c_str(), server.port);
+            close_stream(stream);
+            return false;
+        }
+
+        // Acknowledgements are small and awaited right away
+        int nodelay = 1;
+        setsockopt(stream.sockfd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+
+    size_t sent = 0;
+    while (sent < message.size())
+    {
+        ssize_t n = send(stream.sockfd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            fprintf(stderr, "ReplicationLog: Failed to send records to replica %s:%d\n", server.host.c_str(), server.port);
+            close_stream(stream);
+            return false;
+        }
+        sent += n;
+    }
+
+    stream.in_flight.emplace_back(last, std::chrono::steady_clock::now());
+    return true;
+}
+
+void ReplicationLog::receive_acks(ReplicaStream &stream)
+{
+    char buffer[256];
+    while (stream.sockfd != -1)
+    {
+        ssize_t n = recv(stream.sockfd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (n <= 0)
+        {
+            // The replica closed the connection, e.g. while it was down
+            close_stream(stream);
+            return;
+        }
+        stream.ack.append(buffer, n);
+
+        // Every message is answered with one line, in the order the messages were sent
+        size_t end;
+        while ((end = stream.ack.find("\r\n")) != std::string::npos && !stream.in_flight.empty())
+        {
+            std::string response = stream.ack.substr(0, end);
+            stream.ack.erase(0, end + 2);
+            uint64_t message_last = stream.in_flight.front().first;
+            stream.in_flight.pop_front();
+
+            const std::string ok = "+OK ";
+            const std::string gap = "-ERR GAP ";
+            if (response.compare(0, ok.size(), ok) == 0)
+            {
+                stream.acknowledged = std::max<uint64_t>(stream.acknowledged, std::strtoull(response.c_str() + ok.size(), nullptr, 10));
+            }
+            else if (response.compare(0, gap.size(), gap) == 0)
+            {
+                // The replica missed records since its last acknowledgement, later messages report the same gap
+                uint64_t applied = std::strtoull(response.c_str() + gap.size(), nullptr, 10);
+                if (stream.resent > applied)
+                    continue;
+
+                std::string resend = backlog_message(applied);
+                if (resend.empty())
+                {
+                    fprintf(stderr, "ReplicationLog: Replica %s:%d misses records after %s that are not in the backlog anymore\n",
+                            stream.server.host.c_str(), stream.server.port, std::to_string(applied).c_str());
+                    stream.failed = std::max(stream.failed, sequence);
+                    continue;
+                }
+                stream.resent = sequence;
+                if (!send_records(stream, resend, sequence))
+                    return;
+            }
+            else
+            {
+                stream.failed = std::max(stream.failed, message_last);
+            }
+        }
+    }
+}
+
+void ReplicationLog::expire_streams()
+{
+    // A late acknowledgement must not be taken for the one of a later message
+    const auto now = std::chrono::steady_clock::now();
+    for (auto &[address, stream] : replicas)
+    {
+        if (stream.sockfd == -1 || stream.in_flight.empty())
+            continue;
+        if (now - stream.in_flight.front().second < std::chrono::milliseconds(REPLICATION_ACK_TIMEOUT_MS))
+            continue;
+
+        fprintf(stderr, "ReplicationLog: Replica %s did not acknowledge records up to %s\n", address.c_str(),
+                std::to_string(stream.in_flight.back().first).c_str());
+        close_stream(stream);
+    }
+}
+
+std::string ReplicationLog::backlog_message(uint64_t after) const
+{
+    if (backlog.empty() || backlog.front().first > after + 1)
+        return "";
+
+    std::string batch;
+    for (const auto &[record_sequence, record] : backlog)
+    {
+        if (record_sequence > after)
+            batch += record;
+    }
+    return "#" + command_to_string(KVServerCommand::LOG) + " " + std::to_string(stream_id) + " " +
+           std::to_string(batch.size()) + "\r\n" + batch + "\r\n";
+}
+
+void ReplicationLog::close_stream(ReplicaStream &stream)
+{
+    if (stream.sockfd != -1)
+        close(stream.sockfd);
+    stream.sockfd = -1;
+    stream.ack.clear();
+    if (!stream.in_flight.empty())
+        stream.failed = std::max(stream.failed, stream.in_flight.back().first);
+    stream.in_flight.clear();
+    stream.resent = 0;
+}
+
+std::string ReplicationLog::apply(uint64_t stream, std::string_view records)
+{
+    std::lock_guard lock(applied_mutex);
+
+    // A new primary numbers its records from the start
+    if (stream != applied_stream)
+    {
+        applied_stream = stream;
+        applied_sequence = 0;
+    }
+
+    uint64_t failed = 0;
+    TabletLogEntry entry;
+    while (!records.empty())
+    {
+        size_t record_size = parse_log_record(records, entry);
+        if (record_size == 0)
+            return "-ERR Invalid log record after " + std::to_string(applied_sequence);
+        records.remove_prefix(record_size);
+
+        // Records shipped again after an acknowledgement got lost
+        if (applied_sequence != 0 && entry.version <= applied_sequence)
+            continue;
+        if (applied_sequence != 0 && entry.version != applied_sequence + 1)
+            return "-ERR GAP " + std::to_string(applied_sequence);
+
+        // A record that fails is not applied again, the primary reports the write as failed on this replica
+        if (apply_record(entry) != TabletStatus::OK && failed == 0)
+            failed = entry.version;
+        applied_sequence = entry.version;
+    }
+
+    if (failed != 0)
+        return "-ERR Failed to apply record " + std::to_string(failed);
+    return "+OK " + std::to_string(applied_sequence);
+}
+
+void ReplicationLog::reset()
+{
+    std::lock_guard lock(applied_mutex);
+    applied_stream = 0;
+    applied_sequence = 0;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "TabletLogRecord.h"
+#include "IStorageService.h"
+#include "KVServerCommand.h"
+
+class ReplicationLog;
+extern ReplicationLog replication_log;
+
+// Bytes of shipped records kept by the primary to resend them to a replica that missed some (64 MB)
+constexpr size_t REPLICATION_BACKLOG_BYTES{64ul * 1024ul * 1024ul};
+// Time a replica has to acknowledge a message before the primary closes its connection and the records fail on it
+constexpr int REPLICATION_ACK_TIMEOUT_MS{5000};
+
+// Stream of log records from the primary to the replicas of its replication group
+// The primary applies a write to its own tablets first and then ships the log records of the write, numbered by
+// a sequence of its own, to every live replica over one connection to the internal port of the replica. Replicas
+// apply the records in sequence order and acknowledge the last one, so all of them apply the same writes in the
+// same order as the primary. A write completes once as many servers as its consistency level requires acknowledged
+// it, the acknowledgements of the other replicas are read while later writes are shipped. The primary thread ships
+// the next write while earlier ones still wait for their acknowledgements.
+class ReplicationLog
+{
+public:
+    // Called with the result of a shipped write once it completed
+    typedef std::function<void(BroadcastResult &)> ShipDone;
+
+private:
+    // Connection of the primary to a replica
+    struct ReplicaStream
+    {
+        KVServer server;
+        int sockfd{-1};
+        // Bytes of acknowledgements read so far that do not form a complete line yet
+        std::string ack;
+        // Last record of every message sent and not acknowledged yet with the time it was sent, oldest first
+        std::deque<std::pair<uint64_t, std::chrono::steady_clock::time_point>> in_flight;
+        // Last record acknowledged by the replica
+        uint64_t acknowledged{0};
+        // Last record the replica failed to apply or that cannot be sent to it anymore
+        uint64_t failed{0};
+        // Last record sent again after the replica reported a gap
+        uint64_t resent{0};
+    };
+
+    // Identifies the stream of this server as primary, a replica starts over when the primary changes
+    const uint64_t stream_id;
+    // Sequence number of the last shipped record
+    uint64_t sequence{0};
+    // Records recently shipped with their sequence numbers, oldest first
+    std::deque<std::pair<uint64_t, std::string>> backlog;
+    size_t backlog_bytes{0};
+    // Connections to the replicas by public host and port
+    std::map<std::string, ReplicaStream> replicas;
+
+    // Shipped write waiting for the acknowledgements its consistency level requires
+    struct PendingWrite
+    {
+        std::string message_id;
+        // Last record of the write
+        uint64_t last;
+        // Servers that must acknowledge it, the primary included
+        size_t required;
+        // Replicas it was sent to
+        std::vector<ReplicaStream *> streams;
+        std::chrono::steady_clock::time_point deadline;
+        ShipDone done;
+    };
+    // Writes in the order they were shipped
+    std::deque<PendingWrite> pending;
+
+    // Stream the records applied as a replica come from
+    std::mutex applied_mutex;
+    uint64_t applied_stream{0};
+    // Sequence number of the last applied record, 0 before the first record of a stream
+    uint64_t applied_sequence{0};
+
+    // Sends a message ending with record last to a replica, connecting to its internal port first if needed
+    bool send_records(ReplicaStream &stream, const std::string &message, uint64_t last);
+    // Reads the acknowledgements that arrived from a replica without waiting for more
+    // Records the replica reports missing are sent again from the backlog
+    void receive_acks(ReplicaStream &stream);
+    // Completes the pending writes that the required servers acknowledged, that every replica acknowledged or
+    // failed, or whose timeout expired
+    void complete_writes();
+    // Result of a write, acknowledgements is the number of servers that acknowledged it
+    BroadcastResult write_result(const PendingWrite &write, size_t acknowledgements) const;
+    // Closes the connections of replicas that did not acknowledge a message in time
+    void expire_streams();
+    // Assembles the message carrying the records of the backlog after the given sequence number
+    // Returns an empty message if some of them are not in the backlog anymore
+    std::string backlog_message(uint64_t after) const;
+    // Closes the connection to a replica, the records in flight on it fail
+    void close_stream(ReplicaStream &stream);
+
+public:
+    ReplicationLog();
+    ~ReplicationLog();
+
+    ReplicationLog(const ReplicationLog &) = delete;
+    ReplicationLog &operator=(const ReplicationLog &) = delete;
+
+    // Primary: ships the records of a write it applied to all live replicas and waits until the servers required by
+    // the consistency level acknowledged them
+    // Only called by the primary thread, so records are numbered in the order the writes were applied
+    BroadcastResult ship(const std::string &message_id, std::vector<TabletLogRecord> &records,
+                         WriteConsistency consistency = WriteConsistency::ALL);
+    // Primary: ships the records of a write like ship without waiting, done is called once the write completed,
+    // right away if it needs no acknowledgements or later from process_acks
+    void ship_async(const std::string &message_id, std::vector<TabletLogRecord> &records, WriteConsistency consistency,
+                    ShipDone done);
+    // Primary: sockets of the replicas that have messages in flight, readable once acknowledgements arrive
+    std::vector<int> ack_sockets() const;
+    // Primary: reads the acknowledgements that arrived and completes the writes waiting for them or timed out
+    void process_acks();
+
+    // Replica: applies the records of a LOG message in sequence order and returns the response to the primary
+    // Records it already applied are skipped, a gap in the sequence is answered with the last applied record
+    std::string apply(uint64_t stream, std::string_view records);
+    // Replica: starts over with the next record of any stream, after the tablets were recovered from the primary
+    void reset();
+};
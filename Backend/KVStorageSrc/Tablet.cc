@@ -5,33 +5,126 @@
 #include <string>
 #include <fstream>
 #include <numeric>
+#include <limits>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "Tablet.h"
 
-void Tablet::set_value(tablet_value &target, tablet_value &value)
+namespace fs = std::filesystem;
+
+namespace
 {
-    // Resize target to size of value
-    target.resize(value.size());
-    // Actually deallocate memory if target is larger than value
-    target.shrink_to_fit();
-    // No copy needed if value is empty
-    if (value.size() == 0)
-        return;
-    // Move value into target, value is destroyed
-    target = std::move(value);
+    // Magic number at the start of a single-file checkpoint
+    constexpr char CHECKPOINT_MAGIC[8] = {'T', 'B', 'L', 'T', 'C', 'H', 'K', '1'};
+
+    // Header of a single-file checkpoint, stored in host byte order
+    // It is followed by the sorted key directory, the key region and the value region
+    struct CheckpointHeader
+    {
+        char magic[8];
+        uint64_t entry_count;
+        uint64_t keys_offset;
+        uint64_t values_offset;
+    };
+
+    // Directory entry of a column (or of a row without columns)
+    // Key offsets are relative to the key region, value offsets to the value region
+    struct CheckpointEntry
+    {
+        uint64_t row_key_offset;
+        uint64_t column_key_offset;
+        uint64_t value_offset;
+        uint64_t value_size;
+        uint32_t row_key_size;
+        uint32_t column_key_size;
+    };
+
+    // Column key size marking a row without columns
+    constexpr uint32_t EMPTY_ROW{std::numeric_limits<uint32_t>::max()};
+
+    // Size of the values of a row that are still in a checkpoint file
+    size_t row_stored_size(const TabletRow &row)
+    {
+        size_t size{0};
+        for (auto const &column_kv : row.data)
+            if (column_kv.second.is_stored()) size += column_kv.second.size();
+        return size;
+    }
+
+    // Pages of a loaded checkpoint are dropped from its mapping once this much has been copied out of a region
+    constexpr size_t CHECKPOINT_RELEASE_CHUNK{1024ul * 1024ul};
+
+    // Drops the pages of a region of a read-only mapping that lie below consumed, released tracks the dropped part
+    // Pages shared with a neighbouring region may be dropped as well, they are read again from the page cache when used
+    void release_mapped(const char *map, size_t &released, size_t consumed)
+    {
+        if (consumed < released + CHECKPOINT_RELEASE_CHUNK) return;
+
+        static const size_t page_size = sysconf(_SC_PAGESIZE);
+        const size_t release_start = released / page_size * page_size;
+        const size_t release_end = consumed / page_size * page_size;
+        if (release_end <= release_start) return;
+        ::madvise(const_cast<char *>(map) + release_start, release_end - release_start, MADV_DONTNEED);
+        released = release_end;
+    }
+}
+
+void Tablet::set_value(TabletCell &target, tablet_value &value)
+{
+    // Move value into a new cell, snapshots still holding the old one are not affected
+    target = TabletCell{std::move(value)};
     // Clear value
     value.clear();
 }
 
-TabletStatus Tablet::create_row(const std::string &row_key)
+void Tablet::preserve_row(const std::string &row_key, const TabletRow &row)
+{
+    if (!snapshot_running) return;
+
+    // Only the first change of a row is saved, the row is not copied again
+    std::lock_guard lock{snapshot_mutex};
+    snapshot_rows.try_emplace(row_key, row);
+}
+
+void Tablet::begin_snapshot()
+{
+    std::lock_guard lock{snapshot_mutex};
+    snapshot_rows.clear();
+    snapshot_running = true;
+}
+
+void Tablet::snapshot_row(const std::string &row_key, const TabletRow &row, tablet_data &snapshot)
+{
+    {
+        std::lock_guard lock{snapshot_mutex};
+        auto saved_it = snapshot_rows.find(row_key);
+        if (saved_it != snapshot_rows.end())
+        {
+            snapshot.try_emplace(snapshot.end(), row_key, std::move(saved_it->second));
+            snapshot_rows.erase(saved_it);
+            return;
+        }
+    }
+
+    // The row has not changed since the snapshot started
+    snapshot.try_emplace(snapshot.end(), row_key, row);
+}
+
+void Tablet::end_snapshot()
 {
-    // Noop if row exists
-    if (has_row(row_key)) return TabletStatus::ROW_KEY_ERR;
+    std::lock_guard lock{snapshot_mutex};
+    snapshot_running = false;
+    snapshot_rows.clear();
+}
 
-    // Else, add row
-    data.emplace(std::piecewise_construct,
-                 std::forward_as_tuple(row_key),
-                 std::forward_as_tuple());
-    row_mutexes.try_emplace(row_key);
+TabletStatus Tablet::create_row(const std::string &row_key)
+{
+    // Noop if row exists, else add row
+    if (!data.try_emplace(row_key).second) return TabletStatus::ROW_KEY_ERR;
 
     return TabletStatus::OK;
 }
@@ -47,33 +140,37 @@ void Tablet::clear()
 {
     // Clear all data
     data.clear();
-    row_mutexes.clear();
+    stored_size = 0;
 }
 
 TabletStatus Tablet::create_column(const std::string &row_key, const std::string &column_key)
 {
     // Throw error if row does not exist
-    if (!has_row(row_key))
+    TabletRow *row{find_row(row_key)};
+    if (!row)
         return TabletStatus::ROW_KEY_ERR;
+    preserve_row(row_key, *row);
 
     // Add column, noop if it already exists
-    data[row_key].data.try_emplace(column_key);
+    row->data.try_emplace(column_key);
 
     return TabletStatus::OK;
 }
 
 TabletStatus Tablet::write(const std::string &row_key, const std::string &column_key, tablet_value &value)
 {
-    // Create column if it does not exist
-    if (create_column(row_key, column_key) != TabletStatus::OK)
+    TabletRow *row{find_row(row_key)};
+    if (!row)
         return TabletStatus::ROW_KEY_ERR;
+    preserve_row(row_key, *row);
 
-    // Get current value size incase of overwrite
-    size_t old_value_size{data[row_key].data[column_key].size()};
+    // Create column if it does not exist
+    TabletCell &cell{row->data.try_emplace(column_key).first->second};
 
-    // Insert value in column and keep track of size
-    data[row_key].size += value.size() - old_value_size;
-    set_value(data[row_key].data[column_key], value);
+    // Insert value in column and keep track of size incase of overwrite
+    row->size += value.size() - cell.size();
+    if (cell.is_stored()) stored_size -= cell.size();
+    set_value(cell, value);
 
     return TabletStatus::OK;
 }
@@ -81,28 +178,30 @@ TabletStatus Tablet::write(const std::string &row_key, const std::string &column
 TabletStatus Tablet::compare(const std::string &row_key, const std::string &column_key,
     const tablet_value &value, bool &result)
 {
-    if (!has_row(row_key)) return TabletStatus::ROW_KEY_ERR;
-    if (!has_column(row_key, column_key)) return TabletStatus::COLUMN_KEY_ERR;
+    const TabletRow *row{find_row(row_key)};
+    if (!row) return TabletStatus::ROW_KEY_ERR;
+    auto column_it = row->data.find(column_key);
+    if (column_it == row->data.end()) return TabletStatus::COLUMN_KEY_ERR;
 
-    result = (data[row_key].data[column_key] == value);
+    result = (column_it->second == value);
 
     return TabletStatus::OK;
 }
 
 TabletStatus Tablet::move(const std::string &row_key, const std::string &column_key, const std::string &new_column_key)
 {
-    if (!has_row(row_key))
+    TabletRow *row{find_row(row_key)};
+    if (!row)
         return TabletStatus::ROW_KEY_ERR;
-    if (!has_column(row_key, column_key))
+    auto column_it = row->data.find(column_key);
+    if (column_it == row->data.end())
         return TabletStatus::COLUMN_KEY_ERR;
+    preserve_row(row_key, *row);
 
-    // Create column if it does not exist
-    // (existance of row has already been checked)
-    create_column(row_key, new_column_key);
-
-    // Move column to new column key
-    set_value(data[row_key].data[new_column_key], data[row_key].data[column_key]);
-    data[row_key].data.erase(column_key);
+    // Move column to new column key, large values are shared and not copied
+    TabletCell cell{std::move(column_it->second)};
+    row->data.erase(column_it);
+    row->data.try_emplace(new_column_key).first->second = std::move(cell);
 
     return TabletStatus::OK;
 }
@@ -110,16 +209,20 @@ TabletStatus Tablet::move(const std::string &row_key, const std::string &column_
 TabletStatus Tablet::conditional_write(const std::string &row_key, const std::string &column_key,
                                        const tablet_value &cvalue, tablet_value &value, bool &result)
 {
-    if (!has_row(row_key))
+    TabletRow *row{find_row(row_key)};
+    if (!row)
         return TabletStatus::ROW_KEY_ERR;
-    if (!has_column(row_key, column_key))
+    auto column_it = row->data.find(column_key);
+    if (column_it == row->data.end())
         return TabletStatus::COLUMN_KEY_ERR;
 
-    if (data[row_key].data[column_key] == cvalue)
+    if (column_it->second == cvalue)
     {
         result = true;
-        data[row_key].size += value.size() - cvalue.size();
-        set_value(data[row_key].data[column_key], value);
+        preserve_row(row_key, *row);
+        row->size += value.size() - cvalue.size();
+        if (column_it->second.is_stored()) stored_size -= cvalue.size();
+        set_value(column_it->second, value);
     }
     else
         result = false;
@@ -129,71 +232,147 @@ TabletStatus Tablet::conditional_write(const std::string &row_key, const std::st
 
 TabletStatus Tablet::remove(const std::string &row_key, const std::string &column_key, size_t &value_size)
 {
-    if (!has_row(row_key))
+    TabletRow *row{find_row(row_key)};
+    if (!row)
         return TabletStatus::ROW_KEY_ERR;
-    if (!has_column(row_key, column_key))
+    auto column_it = row->data.find(column_key);
+    if (column_it == row->data.end())
         return TabletStatus::COLUMN_KEY_ERR;
 
+    preserve_row(row_key, *row);
+
     // Remove column from row
-    value_size = data[row_key].data[column_key].size();
-    data[row_key].size -= value_size;
-    data[row_key].data.erase(column_key);
+    value_size = column_it->second.size();
+    row->size -= value_size;
+    if (column_it->second.is_stored()) stored_size -= value_size;
+    row->data.erase(column_it);
 
     return TabletStatus::OK;
 }
 
-void Tablet::split(Tablet &tablet)
+bool Tablet::split_point(const tablet_data &data, std::string &row_key)
 {
-    tablet.clear();
-
-    const size_t total_size{this->size()};
-
-    std::set<std::string> row_keys;
-    this->list_rows(row_keys);
+    const size_t total_size{std::accumulate(data.begin(), data.end(), size_t{0},
+        [](const size_t &size, const auto &row_kv) { return size + row_kv.second.size; })};
 
     size_t new_size{0};
-    auto it{row_keys.begin()};
-    for (; it != row_keys.end(); ++it)
+    auto split_it{data.begin()};
+    for (; split_it != data.end(); ++split_it)
     {
-        if (new_size + this->data[*it].size > total_size / 2)
+        if (new_size + split_it->second.size > total_size / 2)
             break;
 
-        // keep row in this tablet
-        new_size += this->data[*it].size;
+        // keep row in the lower half
+        new_size += split_it->second.size;
     }
 
-    tablet.first_row_key = *it;
-    for (; it != row_keys.end(); ++it)
+    // The lower half keeps at least the first row, so both halves shrink
+    if (split_it == data.begin() && split_it != data.end()) ++split_it;
+    if (split_it == data.end()) return false;
+
+    row_key = split_it->first;
+    return true;
+}
+
+void Tablet::take_rows(tablet_data &data, const std::string &row_key)
+{
+    clear();
+
+    first_row_key = row_key;
+    auto split_it{data.lower_bound(row_key)};
+    for (auto it{split_it}; it != data.end(); ++it)
     {
-        // move row and mutex to new tablet
-        tablet.data.insert(this->data.extract(*it));
-        tablet.row_mutexes.insert(this->row_mutexes.extract(*it));
+        // move row to this tablet, rows arrive in order
+        stored_size += row_stored_size(it->second);
+        this->data.try_emplace(this->data.end(), it->first, std::move(it->second));
     }
+    data.erase(split_it, data.end());
+}
+
+size_t Tablet::erase_rows(const std::string &row_key)
+{
+    auto split_it{data.lower_bound(row_key)};
+    const size_t removed_size{std::accumulate(split_it, data.end(), size_t{0},
+        [](const size_t &size, const auto &row_kv) { return size + row_kv.second.size; })};
+    stored_size -= std::accumulate(split_it, data.end(), size_t{0},
+        [](const size_t &size, const auto &row_kv) { return size + row_stored_size(row_kv.second); });
+    data.erase(split_it, data.end());
+
+    return removed_size;
 }
 
 TabletStatus Tablet::read(const std::string &row_key, const std::string &column_key, tablet_value &value) const
 {
-    if (!has_row(row_key))
+    const TabletRow *row{find_row(row_key)};
+    if (!row)
         return TabletStatus::ROW_KEY_ERR;
-    if (!has_column(row_key, column_key))
+    auto column_it = row->data.find(column_key);
+    if (column_it == row->data.end())
         return TabletStatus::COLUMN_KEY_ERR;
 
-    value = data.at(row_key).data.at(column_key);
+    // Paged values are read from the checkpoint file
+    if (!column_it->second.copy_to(value))
+        return TabletStatus::READ_ERR;
+
+    return TabletStatus::OK;
+}
+
+TabletStatus Tablet::read(const std::string &row_key, const std::string &column_key, size_t offset, size_t length,
+    tablet_value &value, size_t &value_size) const
+{
+    const TabletRow *row{find_row(row_key)};
+    if (!row)
+        return TabletStatus::ROW_KEY_ERR;
+    auto column_it = row->data.find(column_key);
+    if (column_it == row->data.end())
+        return TabletStatus::COLUMN_KEY_ERR;
+
+    value_size = column_it->second.size();
+    if (!column_it->second.copy_range_to(offset, length, value))
+        return TabletStatus::READ_ERR;
+
+    return TabletStatus::OK;
+}
+
+TabletStatus Tablet::stat(const std::string &row_key, const std::string &column_key, size_t &value_size) const
+{
+    const TabletRow *row{find_row(row_key)};
+    if (!row)
+        return TabletStatus::ROW_KEY_ERR;
+    auto column_it = row->data.find(column_key);
+    if (column_it == row->data.end())
+        return TabletStatus::COLUMN_KEY_ERR;
+
+    // Paged values are not read, their size is kept with their file offset
+    value_size = column_it->second.size();
 
     return TabletStatus::OK;
 }
 
 TabletStatus Tablet::list_columns(const std::string &row_key, std::set<std::string> &column_keys) const
 {
-    if (!has_row(row_key))
+    const TabletRow *row{find_row(row_key)};
+    if (!row)
         return TabletStatus::ROW_KEY_ERR;
 
-    for (auto const &column_kv : data.at(row_key).data)
+    for (auto const &column_kv : row->data)
         column_keys.insert(column_kv.first);
 
     return TabletStatus::OK;
 }
 
+TabletStatus Tablet::list_columns(const std::string &row_key, std::map<std::string, size_t> &column_sizes) const
+{
+    const TabletRow *row{find_row(row_key)};
+    if (!row)
+        return TabletStatus::ROW_KEY_ERR;
+
+    for (auto const &column_kv : row->data)
+        column_sizes.emplace(column_kv.first, column_kv.second.size());
+
+    return TabletStatus::OK;
+}
+
 void Tablet::list_rows(std::set<std::string> &row_keys) const
 {
     for (auto const &row_kv : data)
@@ -202,37 +381,224 @@ void Tablet::list_rows(std::set<std::string> &row_keys) const
 
 void Tablet::save_to_file(const std::string &filename) const
 {
-    // save binary data to filename.bin.tablet
-    std::ofstream ofs_bin{filename + ".bin.tblt", std::ios::binary};
-    // save index data to filename.idx.tablet
-    std::ofstream ofs_idx{filename + ".idx.tblt"};
+    save_to_file(data, filename);
+}
 
-    size_t pos{0};
+void Tablet::save_to_file(const tablet_data &data, const std::string &filename)
+{
+    write_checkpoint(data, filename + ".chk.tblt");
+}
+
+bool Tablet::write_checkpoint(const tablet_data &data, const std::string &checkpoint_file)
+{
+    // Build directory and key region, values are written straight from the tablet afterwards
+    std::vector<CheckpointEntry> directory;
+    std::string keys;
+    uint64_t value_offset{0};
     for (auto const &row_kv : data)
     {
-        if (row_kv.second.size == 0)
+        const uint64_t row_key_offset{keys.size()};
+        keys += row_kv.first;
+
+        if (row_kv.second.data.empty())
         {
-            ofs_idx << row_kv.first << ",\n";
+            directory.push_back({row_key_offset, 0, 0, 0, static_cast<uint32_t>(row_kv.first.size()), EMPTY_ROW});
+            continue;
         }
         for (auto const &column_kv : row_kv.second.data)
         {
-            // Write row key, column key and data size to index file
-            ofs_idx << row_kv.first << "," << column_kv.first << "," << column_kv.second.size() << "\n";
-            // Write binary data to binary file
-            ofs_bin.write(reinterpret_cast<const char *>(column_kv.second.data()), column_kv.second.size());
+            directory.push_back({row_key_offset, keys.size(), value_offset, column_kv.second.size(),
+                                 static_cast<uint32_t>(row_kv.first.size()), static_cast<uint32_t>(column_kv.first.size())});
+            keys += column_kv.first;
+            value_offset += column_kv.second.size();
         }
     }
 
-    // Close files
-    ofs_bin.close();
-    ofs_idx.close();
+    CheckpointHeader header{};
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.entry_count = directory.size();
+    header.keys_offset = sizeof(header) + directory.size() * sizeof(CheckpointEntry);
+    header.values_offset = header.keys_offset + keys.size();
+
+    // Write to a unique temporary file, so a crash never leaves a partial checkpoint behind
+    std::string tmp_file{checkpoint_file + ".XXXXXX"};
+    int fd = ::mkstemp(tmp_file.data());
+    if (fd >= 0) ::fchmod(fd, 0644);
+    FILE *file = fd < 0 ? nullptr : fdopen(fd, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "Failed to create checkpoint %s: %s\n", tmp_file.c_str(), strerror(errno));
+        if (fd >= 0)
+        {
+            ::close(fd);
+            fs::remove(tmp_file);
+        }
+        return false;
+    }
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(directory.data(), sizeof(CheckpointEntry), directory.size(), file);
+    fwrite(keys.data(), 1, keys.size(), file);
+    bool stored_ok{true};
+    tablet_value stored;
+    for (auto const &row_kv : data)
+        for (auto const &column_kv : row_kv.second.data)
+        {
+            if (!column_kv.second.is_stored())
+            {
+                fwrite(column_kv.second.data(), 1, column_kv.second.size(), file);
+                continue;
+            }
+
+            // Values of paged tablets are copied from the previous checkpoint without filling the block cache
+            stored_ok = stored_ok && column_kv.second.copy_to(stored, false);
+            fwrite(stored.data(), 1, stored.size(), file);
+        }
+
+    // The log covered by the checkpoint is deleted afterwards, so the checkpoint has to be durable
+    const bool ok = stored_ok && fflush(file) == 0 && !ferror(file) && fsync(fileno(file)) == 0;
+    fclose(file);
+    if (!ok)
+    {
+        fprintf(stderr, "Failed to write checkpoint %s: %s\n", tmp_file.c_str(), strerror(errno));
+        fs::remove(tmp_file);
+        return false;
+    }
+
+    fs::rename(tmp_file, checkpoint_file);
+    return true;
 }
 
-void Tablet::read_from_file(const std::string &filename)
+void Tablet::read_from_file(const std::string &filename, bool paged)
 {
     // Clear tablet
     clear();
 
+    if (fs::exists(filename + ".chk.tblt"))
+        read_checkpoint(filename + ".chk.tblt", paged);
+    else
+        read_legacy_checkpoint(filename);
+
+    if (!data.empty())
+        first_row_key = data.begin()->first;
+}
+
+bool Tablet::is_checkpoint(std::string_view contents)
+{
+    return contents.size() >= sizeof(CheckpointHeader) &&
+           contents.compare(0, sizeof(CHECKPOINT_MAGIC), std::string_view{CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)}) == 0;
+}
+
+void Tablet::read_checkpoint(const std::string &filename, bool paged)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open checkpoint %s: %s\n", filename.c_str(), strerror(errno));
+        return;
+    }
+
+    struct stat st;
+    void *map{MAP_FAILED};
+    if (::fstat(fd, &st) == 0 && st.st_size > 0)
+        map = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map checkpoint %s\n", filename.c_str());
+        return;
+    }
+
+    const size_t length = st.st_size;
+    const char *contents = static_cast<const char *>(map);
+    // Unmapped once the tablet no longer holds any of its values
+    auto mapping = std::make_shared<const CheckpointMapping>(map, length);
+    ::madvise(map, length, MADV_SEQUENTIAL);
+
+    // Values of paged tablets are read through a separate descriptor, which stays open after the mapping is gone
+    std::shared_ptr<const CheckpointFile> stored_file;
+    if (paged)
+    {
+        stored_file = std::make_shared<const CheckpointFile>(filename);
+        if (!stored_file->is_open()) stored_file.reset();
+    }
+
+    CheckpointHeader header;
+    std::memcpy(&header, contents, std::min(length, sizeof(header)));
+    const bool valid_header = is_checkpoint({contents, length}) &&
+        header.entry_count <= (length - sizeof(header)) / sizeof(CheckpointEntry) &&
+        header.keys_offset == sizeof(header) + header.entry_count * sizeof(CheckpointEntry) &&
+        header.keys_offset <= header.values_offset && header.values_offset <= length;
+    if (!valid_header)
+    {
+        fprintf(stderr, "Invalid checkpoint header in %s\n", filename.c_str());
+        return;
+    }
+
+    const char *keys = contents + header.keys_offset;
+    const char *values = contents + header.values_offset;
+    const size_t keys_size = header.values_offset - header.keys_offset;
+    const size_t values_size = length - header.values_offset;
+    // The directory, key and value regions are read front to back, the part of each region that has been passed is
+    // dropped from memory, values that stay in the mapping are paged in again when they are read
+    size_t directory_released{0}, keys_released{header.keys_offset}, values_released{header.values_offset};
+
+    // Entries are sorted, so every row and column is appended at the end of its map
+    auto row_it = data.end();
+    for (size_t i{0}; i < header.entry_count; ++i)
+    {
+        CheckpointEntry entry;
+        std::memcpy(&entry, contents + sizeof(header) + i * sizeof(CheckpointEntry), sizeof(entry));
+
+        const size_t column_key_size = entry.column_key_size == EMPTY_ROW ? 0 : entry.column_key_size;
+        if (entry.row_key_offset + entry.row_key_size > keys_size ||
+            entry.column_key_offset + column_key_size > keys_size ||
+            entry.value_offset + entry.value_size > values_size)
+        {
+            fprintf(stderr, "Invalid checkpoint entry %zu in %s\n", i, filename.c_str());
+            clear();
+            break;
+        }
+
+        const std::string_view row_key{keys + entry.row_key_offset, entry.row_key_size};
+        if (row_it == data.end() || row_it->first != row_key)
+            row_it = data.try_emplace(data.end(), std::string{row_key});
+
+        if (entry.column_key_size == EMPTY_ROW) continue;
+
+        TabletRow &row = row_it->second;
+        row.size += entry.value_size;
+
+        // Small values are copied, they are no larger than a reference to the file
+        const std::byte *value = reinterpret_cast<const std::byte *>(values + entry.value_offset);
+        std::string column_key{keys + entry.column_key_offset, entry.column_key_size};
+        if (entry.value_size <= TabletCell::INLINE_SIZE)
+            row.data.try_emplace(row.data.end(), std::move(column_key), value, entry.value_size);
+        else if (stored_file)
+        {
+            row.data.try_emplace(row.data.end(), std::move(column_key),
+                                 stored_file, header.values_offset + entry.value_offset, entry.value_size);
+            stored_size += entry.value_size;
+        }
+        else
+            row.data.try_emplace(row.data.end(), std::move(column_key), mapping, value, entry.value_size);
+
+        release_mapped(contents, directory_released, sizeof(header) + (i + 1) * sizeof(CheckpointEntry));
+        release_mapped(contents, keys_released, header.keys_offset + entry.column_key_offset + column_key_size);
+        release_mapped(contents, values_released, header.values_offset + entry.value_offset + entry.value_size);
+    }
+
+    // Values are read in any order from now on
+    ::madvise(map, length, MADV_NORMAL);
+}
+
+CheckpointMapping::~CheckpointMapping()
+{
+    ::munmap(map, length);
+}
+
+void Tablet::read_legacy_checkpoint(const std::string &filename)
+{
     // save binary data to filename.bin.tablet
     std::ifstream ifs_bin{filename + ".bin.tblt", std::ios::binary};
     // save index data to filename.idx.tablet
@@ -249,11 +615,9 @@ void Tablet::read_from_file(const std::string &filename)
         size_t sep2 = line.find(",", sep1);
 
         // Add empty row
-        if (sep2 == std::string::npos && data.count(row_key) == 0)
+        if (sep2 == std::string::npos)
         {
-            data.emplace(std::piecewise_construct,
-                         std::forward_as_tuple(row_key),
-                         std::forward_as_tuple());
+            data.try_emplace(row_key);
             continue;
         }
 
@@ -262,23 +626,16 @@ void Tablet::read_from_file(const std::string &filename)
         size = std::stoul(line.substr(sep2 + 1));
 
         // Ensure that row exists
-        if (data.count(row_key) == 0)
-            data.emplace(std::piecewise_construct,
-                         std::forward_as_tuple(row_key),
-                         std::forward_as_tuple());
-
-        // Create column
-        data[row_key].data.try_emplace(column_key);
+        TabletRow &row{data.try_emplace(row_key).first->second};
 
         // Read binary data into tablet
-        data[row_key].size += size;
-        data[row_key].data.at(column_key).resize(size);
-        ifs_bin.read(reinterpret_cast<char *>(data[row_key].data.at(column_key).data()), size);
+        tablet_value value(size);
+        ifs_bin.read(reinterpret_cast<char *>(value.data()), size);
+        row.size += size;
+        row.data.try_emplace(column_key).first->second = TabletCell{std::move(value)};
     }
 
-    first_row_key = data.begin()->first;
-
     // Close files
     ifs_bin.close();
     ifs_idx.close();
-}
\ No newline at end of file
+}
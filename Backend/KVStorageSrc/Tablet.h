@@ -5,14 +5,189 @@
 #include <map>
 #include <set>
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <iostream>
 #include <shared_mutex>
+#include <mutex>
 #include <cstddef>
+#include <cstdint>
+#include <array>
+#include <variant>
+#include <atomic>
+#include <algorithm>
 #include "Globals.h"
+#include "TabletBlockCache.h"
+#ifdef TABLET_ENGINE_BTREE
+#include "TabletBTree.h"
+#endif
 
 typedef std::vector<std::byte> tablet_value;
-typedef std::map<std::string, tablet_value> tablet_row;
+// Stored values are never modified in place, a write replaces the pointer
+// This lets checkpoint snapshots share the values with the live tablet (copy-on-write)
+typedef std::shared_ptr<const tablet_value> tablet_value_ptr;
+
+// Read-only mapping of a checkpoint file, values loaded from the checkpoint are read from it until they are replaced
+// The mapping stays valid after the file has been replaced by a newer checkpoint and removed
+class CheckpointMapping
+{
+private:
+    void *map;
+    size_t length;
+
+public:
+    CheckpointMapping(void *map, size_t length) : map(map), length(length) {}
+    ~CheckpointMapping();
+    CheckpointMapping(const CheckpointMapping &) = delete;
+    CheckpointMapping &operator=(const CheckpointMapping &) = delete;
+};
+
+// Value stored in a column
+// Small values are kept inline, larger values are shared with checkpoint snapshots
+// Values loaded from a checkpoint stay in its mapping, values of paged tablets are read through the block cache instead
+class TabletCell
+{
+public:
+    // Values up to this size are stored without a separate allocation
+    static constexpr size_t INLINE_SIZE{22};
+
+private:
+    struct InlineValue
+    {
+        uint8_t size;
+        std::array<std::byte, INLINE_SIZE> bytes;
+    };
+
+    struct StoredValue
+    {
+        std::shared_ptr<const CheckpointFile> file;
+        uint64_t offset;
+        uint32_t size;
+    };
+
+    struct MappedValue
+    {
+        std::shared_ptr<const CheckpointMapping> mapping;
+        const std::byte *bytes;
+        uint32_t size;
+    };
+
+    std::variant<InlineValue, tablet_value_ptr, StoredValue, MappedValue> value;
+
+public:
+    TabletCell() : value{InlineValue{}} {}
+
+    // Refers to a value in a checkpoint file
+    TabletCell(std::shared_ptr<const CheckpointFile> file, uint64_t offset, size_t size)
+        : value{StoredValue{std::move(file), offset, static_cast<uint32_t>(size)}} {}
+
+    // Refers to a value in a mapped checkpoint file
+    TabletCell(std::shared_ptr<const CheckpointMapping> mapping, const std::byte *bytes, size_t size)
+        : value{MappedValue{std::move(mapping), bytes, static_cast<uint32_t>(size)}} {}
+
+    // Stores a copy of the given bytes
+    TabletCell(const std::byte *data, size_t size)
+    {
+        if (size <= INLINE_SIZE)
+        {
+            InlineValue &small = value.emplace<InlineValue>(InlineValue{});
+            small.size = static_cast<uint8_t>(size);
+            std::copy(data, data + size, small.bytes.begin());
+        }
+        else
+            value = std::make_shared<const tablet_value>(data, data + size);
+    }
+
+    // Takes over the given value
+    explicit TabletCell(tablet_value &&data)
+    {
+        if (data.size() <= INLINE_SIZE)
+            *this = TabletCell{data.data(), data.size()};
+        else
+            value = std::make_shared<const tablet_value>(std::move(data));
+    }
+
+    // Returns true if the value is still in a checkpoint file
+    inline bool is_stored() const
+    {
+        return std::holds_alternative<StoredValue>(value);
+    }
+
+    // Only valid for values in memory
+    inline const std::byte *data() const
+    {
+        if (auto small = std::get_if<InlineValue>(&value))
+            return small->bytes.data();
+        if (auto mapped = std::get_if<MappedValue>(&value))
+            return mapped->bytes;
+        return std::get<tablet_value_ptr>(value)->data();
+    }
+
+    inline size_t size() const
+    {
+        if (auto small = std::get_if<InlineValue>(&value))
+            return small->size;
+        if (auto stored = std::get_if<StoredValue>(&value))
+            return stored->size;
+        if (auto mapped = std::get_if<MappedValue>(&value))
+            return mapped->size;
+        return std::get<tablet_value_ptr>(value)->size();
+    }
+
+    // Values that cannot be read from their checkpoint file compare unequal
+    inline bool operator==(const tablet_value &other) const
+    {
+        if (size() != other.size()) return false;
+        if (!is_stored()) return std::equal(other.begin(), other.end(), data());
+
+        tablet_value stored;
+        return copy_to(stored) && stored == other;
+    }
+
+    // Copies the value, values in a checkpoint file are read through the block cache unless cached is false
+    // Returns false if the value could not be read
+    inline bool copy_to(tablet_value &other, bool cached = true) const
+    {
+        auto stored = std::get_if<StoredValue>(&value);
+        if (!stored)
+        {
+            other.assign(data(), data() + size());
+            return true;
+        }
+
+        other.resize(stored->size);
+        if (cached) return block_cache.read(*stored->file, stored->offset, stored->size, other.data());
+        return stored->file->read(stored->offset, stored->size, other.data()) == static_cast<ssize_t>(stored->size);
+    }
+
+    // Copies up to length bytes of the value from start on, only that part of a value in a checkpoint file is read
+    // Returns false if the value could not be read
+    inline bool copy_range_to(size_t start, size_t length, tablet_value &other) const
+    {
+        start = std::min(start, size());
+        length = std::min(length, size() - start);
+        auto stored = std::get_if<StoredValue>(&value);
+        if (!stored)
+        {
+            other.assign(data() + start, data() + start + length);
+            return true;
+        }
+
+        other.resize(length);
+        return block_cache.read(*stored->file, stored->offset + start, length, other.data());
+    }
+};
+
+#ifdef TABLET_ENGINE_BTREE
+// Rows and columns are stored in flat sorted leaves (see TabletBTree.h)
+template <typename V>
+using tablet_map = TabletBTree<V>;
+#else
+template <typename V>
+using tablet_map = std::map<std::string, V>;
+#endif
+
+typedef tablet_map<TabletCell> tablet_row;
 
 struct TabletRow
 {
@@ -20,7 +195,7 @@ struct TabletRow
     size_t size{0};
 };
 
-typedef std::map<std::string, TabletRow> tablet_data;
+typedef tablet_map<TabletRow> tablet_data;
 
 enum class TabletStatus
 {
@@ -38,6 +213,10 @@ enum class TabletStatus
     VALUE_SIZE_ERR,
     // Row size is too large
     ROW_SIZE_ERR,
+    // Cannot write to tablet because the log record could not be made durable
+    LOG_ERR,
+    // Cannot read value because it could not be loaded from the checkpoint
+    READ_ERR,
 };
 
 class Tablet
@@ -45,18 +224,44 @@ class Tablet
 private:
     tablet_data data;
     std::string first_row_key;
+    // Size of the values that are still in a checkpoint file
+    std::atomic<size_t> stored_size{0};
+    // Set while a snapshot is copied row by row
+    std::atomic<bool> snapshot_running{false};
+    // Rows as they were when the running snapshot started, saved before their first change
+    std::map<std::string, TabletRow> snapshot_rows;
+    // Protects the saved rows, writers of different rows save them concurrently
+    std::mutex snapshot_mutex;
 
     // Helper function to set value in tablet, `value` will be consumed
-    void set_value(tablet_value &target, tablet_value &value);
+    void set_value(TabletCell &target, tablet_value &value);
+    // Saves a row for the running snapshot before it is changed, the caller holds the lock of the row
+    void preserve_row(const std::string &row_key, const TabletRow &row);
+
+    // Returns the row or nullptr if it does not exist
+    inline TabletRow *find_row(const std::string &row_key)
+    {
+        auto row_it = data.find(row_key);
+        return row_it == data.end() ? nullptr : &row_it->second;
+    }
+    inline const TabletRow *find_row(const std::string &row_key) const
+    {
+        auto row_it = data.find(row_key);
+        return row_it == data.end() ? nullptr : &row_it->second;
+    }
 
     // Creates column, noop if it already exists
     TabletStatus create_column(const std::string &row_key, const std::string &column_key);
 
+    // Loads a single-file checkpoint by mapping it into memory, only the keys and small values are copied
+    // Larger values are read from the mapping, or for paged tablets from the file through the block cache
+    void read_checkpoint(const std::string &filename, bool paged);
+    // Loads a checkpoint stored as separate index and binary files
+    void read_legacy_checkpoint(const std::string &filename);
+
 public:
     // Lock for the entire tablet
     std::shared_mutex tablet_mutex;
-    // Lock for each row
-    std::map<std::string, std::shared_mutex> row_mutexes;
 
     // Creates row, noop if it already exists
     TabletStatus create_row(const std::string &row_key);
@@ -64,6 +269,12 @@ public:
     // Returns size of tablet
     size_t size() const;
 
+    // Returns the size of the values that are still in a checkpoint file
+    inline size_t get_stored_size() const
+    {
+        return stored_size;
+    }
+
     // Clears all data
     void clear();
 
@@ -76,6 +287,13 @@ public:
     // Gets value from a given row and column key
     TabletStatus read(const std::string &row_key, const std::string &column_key, tablet_value &value) const;
 
+    // Gets up to length bytes of the value in a given row and column key from offset on and the size of the value
+    TabletStatus read(const std::string &row_key, const std::string &column_key, size_t offset, size_t length,
+        tablet_value &value, size_t &value_size) const;
+
+    // Gets the size of the value in a given row and column key without reading it
+    TabletStatus stat(const std::string &row_key, const std::string &column_key, size_t &value_size) const;
+
     // Moves value from one column to another
     // If new column does not exist, it will be created
     // Existing value in the new column will be overwritten
@@ -94,7 +312,15 @@ public:
     // Removes value for a given row and column key
     TabletStatus remove(const std::string &row_key, const std::string &column_key, size_t &value_size);
 
-    void split(Tablet &tablet);
+    // Finds the first row of the upper half of the rows (by size), the lower half keeps at least one row
+    // Returns false if the data has less than two rows and cannot be split
+    static bool split_point(const tablet_data &data, std::string &row_key);
+
+    // Moves all rows from row_key on out of data into this tablet, which starts at row_key afterwards
+    void take_rows(tablet_data &data, const std::string &row_key);
+
+    // Removes all rows from row_key on, returns the size of the removed rows
+    size_t erase_rows(const std::string &row_key);
 
     std::string get_first_row_key() const
     {
@@ -106,26 +332,61 @@ public:
     // Checks if row exists
     inline bool has_row(const std::string &row_key) const
     {
-        return data.count(row_key);
+        return find_row(row_key) != nullptr;
     }
 
     // Checks if column exists
     inline bool has_column(const std::string &row_key, const std::string &column_key) const
     {
-        return has_row(row_key) && data.at(row_key).data.count(column_key);
+        const TabletRow *row{find_row(row_key)};
+        return row && row->data.count(column_key);
+    }
+
+    // Returns the number of rows
+    inline size_t row_count() const
+    {
+        return data.size();
+    }
+
+    // Returns the size of all values in a row, 0 if it does not exist
+    inline size_t row_size(const std::string &row_key) const
+    {
+        const TabletRow *row{find_row(row_key)};
+        return row ? row->size : 0;
     }
 
     // Lists all columns for a given row key
     TabletStatus list_columns(const std::string &row_key, std::set<std::string> &column_keys) const;
 
+    // Lists all columns for a given row key with the sizes of their values
+    TabletStatus list_columns(const std::string &row_key, std::map<std::string, size_t> &column_sizes) const;
+
     // Lists all rows
     void list_rows(std::set<std::string> &row_keys) const;
 
-    // Saves tablet to file
+    // Saves tablet to a single checkpoint file (filename.chk.tblt)
     void save_to_file(const std::string &filename) const;
+    // Saves a snapshot of tablet data to a single checkpoint file (filename.chk.tblt)
+    static void save_to_file(const tablet_data &data, const std::string &filename);
+    // Saves a snapshot of tablet data to the given checkpoint file, returns false if it could not be written
+    static bool write_checkpoint(const tablet_data &data, const std::string &checkpoint_file);
+
+    // Starts a snapshot of the current state, which is then copied row by row while writes continue
+    // Rows are saved before their first change until end_snapshot, so later writes do not show up in the snapshot
+    // The caller has to make sure that no writes are in progress and that no rows are added or removed until end_snapshot
+    void begin_snapshot();
+    // Appends a row to the snapshot as it was when the snapshot started, the caller holds the lock of the row
+    // Rows have to be appended in order, the snapshot shares all values with the tablet
+    void snapshot_row(const std::string &row_key, const TabletRow &row, tablet_data &snapshot);
+    // Ends the running snapshot
+    void end_snapshot();
+
+    // Reads data from the checkpoint file, falls back to the older .bin.tblt/.idx.tblt pair
+    // Paged tablets keep their values in the checkpoint file, the older format is always read completely
+    void read_from_file(const std::string &filename, bool paged = false);
 
-    // Reads data from file
-    void read_from_file(const std::string &filename);
+    // Checks if the contents start with the header of a single-file checkpoint
+    static bool is_checkpoint(std::string_view contents);
 
     // Converts tablet_value to string, data will be copied
     static inline std::string to_string(const tablet_value &data, size_t start=0, size_t len=std::string::npos)
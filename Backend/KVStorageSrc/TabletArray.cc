@@ -5,65 +5,398 @@
 #include <limits>
 #include "Globals.h"
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <filesystem>
 
 namespace fs = std::filesystem;
 
 TabletArray tablets;
 
-size_t TabletArray::get_tablet_id(const std::string &row_key)
+const TabletSortInfo &TabletDirectory::find(const std::string &row_key) const
 {
-    size_t idx = std::upper_bound(tablet_sort_info.begin(), tablet_sort_info.end(), row_key,
-        [this](const std::string &key, const TabletSortInfo &info)
-        {return key < info.first_row_key;}) - tablet_sort_info.begin();
+    size_t idx = std::upper_bound(sorted.begin(), sorted.end(), row_key,
+        [](const std::string &key, const TabletSortInfo &info)
+        {return key < info.first_row_key;}) - sorted.begin();
 
     if (idx > 0) --idx;
 
     if (DEBUG)
         fprintf(stdout, "Found tablet id %zu (%zu, %s) for row key %s\n", idx,
-                tablet_sort_info[idx].index, tablet_sort_info[idx].first_row_key.c_str(), row_key.c_str());
+                sorted[idx].index, sorted[idx].first_row_key.c_str(), row_key.c_str());
 
-    return idx;
+    return sorted[idx];
 }
 
-void TabletArray::save_checkpoint(const std::list<TabletInfo>::iterator &tablet_it, const size_t tablet_id)
+void TabletArray::publish_directory(std::vector<TabletSortInfo> sorted)
 {
-    // Remove old checkpoint(s)
-    fs::remove(work_path / (tablet_file(tablet_id, loggers[tablet_id].get_last_checkpoint()) + ".bin.tblt"));
-    fs::remove(work_path / (tablet_file(tablet_id, loggers[tablet_id].get_last_checkpoint()) + ".idx.tblt"));
-    // Remove old log file
-    fs::remove(work_path / (tablet_file(tablet_id, loggers[tablet_id].get_version()) + ".log.tblt"));
-
-    // Save tablet to disk
-    tablet_it->tablet.save_to_file(work_path / tablet_file(tablet_id, loggers[tablet_id].get_version()));
-    // Save new checkpoint
-    loggers[tablet_id].record_checkpoint();
+    auto next_directory{std::make_unique<TabletDirectory>()};
+    next_directory->sorted = std::move(sorted);
+    next_directory->positions.resize(next_directory->sorted.size());
+    for (size_t i{0}; i < next_directory->sorted.size(); ++i)
+        next_directory->positions[next_directory->sorted[i].index] = i;
+
+    directory.store(next_directory.get(), std::memory_order_release);
+    // Readers may still use the replaced directory, it is freed by the checkpointer once they are done
+    if (published_directory)
+        retired_directories.push_back({directory_epoch.load(), std::move(published_directory)});
+    published_directory = std::move(next_directory);
 }
 
-void TabletArray::initiate_checkpoint(const std::list<TabletInfo>::iterator &tablet_it, const size_t tablet_id)
+TabletArray::DirectoryPin::DirectoryPin(const TabletArray &array) : array(array)
 {
-    if (loggers[tablet_id].get_last_checkpoint() + CHECKPOINT_FREQUENCY <= loggers[tablet_id].get_version())
-        save_checkpoint(tablet_it, tablet_id);
+    // Enter the current epoch, a reader that raced with the start of a new epoch enters again
+    while (true)
+    {
+        epoch = array.directory_epoch.load();
+        array.directory_readers[epoch & 1].fetch_add(1);
+        if (array.directory_epoch.load() == epoch) return;
+        array.directory_readers[epoch & 1].fetch_sub(1);
+    }
 }
 
-size_t TabletArray::cache_inactive()
+TabletArray::DirectoryPin::~DirectoryPin()
 {
-    // Find the tablet that hasn't been used for the longest
-    const auto it_oldest_tablet{std::min_element(tablet_list.begin(), tablet_list.end(),
-            [](const TabletInfo &a, const TabletInfo &b) {return a.in_memory < b.in_memory;})
-    };
-    const size_t idx_oldest_tablet{
-        static_cast<size_t>(std::distance(tablet_list.begin(), it_oldest_tablet))
-    };
-    
-    // Save tablet to disk
-    save_checkpoint(it_oldest_tablet, idx_oldest_tablet);
-    // Clear tablet from memory
-    it_oldest_tablet->tablet.clear();
-    // Mark tablet as cached
-    it_oldest_tablet->in_memory = std::numeric_limits<size_t>::max();
-
-    return idx_oldest_tablet;
+    array.directory_readers[epoch & 1].fetch_sub(1);
+}
+
+void TabletArray::reclaim_directories()
+{
+    std::lock_guard lock{tablets_mutex};
+    if (retired_directories.empty()) return;
+
+    // Epochs only advance once the readers of the previous one are gone, so all readers of earlier epochs are done
+    // when the previous epoch has no readers left
+    const size_t epoch{directory_epoch.load()};
+    if (directory_readers[(epoch + 1) & 1].load() != 0) return;
+
+    // Directories retired before the current epoch were replaced before any current reader entered
+    retired_directories.erase(std::remove_if(retired_directories.begin(), retired_directories.end(),
+                                             [epoch](const RetiredDirectory &retired) { return retired.epoch < epoch; }),
+                              retired_directories.end());
+
+    // The others are freed once the readers of the current epoch are done
+    if (!retired_directories.empty()) directory_epoch.store(epoch + 1);
+}
+
+template <typename Lock>
+TabletSortInfo TabletArray::lock_tablet(const std::string &row_key, Lock &tablet_lock)
+{
+    DirectoryPin pin{*this};
+    bool loaded{false};
+    while (true)
+    {
+        const TabletDirectory *current{directory.load(std::memory_order_acquire)};
+        const TabletSortInfo &tablet{current->find(row_key)};
+        tablet_lock = Lock{tablet.info->tablet.tablet_mutex};
+
+        // A split may have moved the row to a new tablet before the lock was acquired
+        const TabletDirectory *latest{directory.load(std::memory_order_acquire)};
+        if (latest != current && latest->find(row_key).info != tablet.info)
+        {
+            tablet_lock.unlock();
+            continue;
+        }
+
+        // Load tablet if it has been cached to disk
+        if (tablet.info->in_memory == std::numeric_limits<size_t>::max())
+        {
+            tablet_lock.unlock();
+            std::lock_guard lock{tablets_mutex};
+            load_tablet(tablet);
+            loaded = true;
+            continue;
+        }
+
+        if (loaded)
+        {
+            ++cache_stats.misses;
+        }
+        else
+        {
+            ++cache_stats.hits;
+            eviction_policy->accessed(*tablet.info, activity_counter);
+        }
+        return tablet;
+    }
+}
+
+size_t TabletArray::snapshot_tablet(TabletInfo &tablet_info, TabletLogger &logger, tablet_data &snapshot)
+{
+    Tablet &tablet{tablet_info.tablet};
+    const size_t version{logger.rotate(tablet)};
+
+    // Rows cannot be added or removed while the tablet lock is held, writers to a row save it before changing it
+    for (auto const &row_kv : tablet.data)
+    {
+        std::shared_lock row_lock{row_mutex(row_kv.first)};
+        tablet.snapshot_row(row_kv.first, row_kv.second, snapshot);
+    }
+    tablet.end_snapshot();
+
+    return version;
+}
+
+bool TabletArray::checkpoint_tablet(TabletInfo &tablet_info, const size_t tablet_id, TabletLogger &logger)
+{
+    tablet_data snapshot;
+    size_t checkpoint;
+    {
+        // Shared lock on the tablet, so it is not evicted while the snapshot is taken
+        std::shared_lock tablet_lock{tablet_info.tablet.tablet_mutex};
+
+        // Tablets on disk are checkpointed when they are evicted
+        if (tablet_info.in_memory == std::numeric_limits<size_t>::max()) return false;
+
+        // Snapshot shares all values with the tablet, writes from now on replace them and go to a new log segment
+        checkpoint = snapshot_tablet(tablet_info, logger, snapshot);
+    }
+
+    // Nothing has been logged since the last checkpoint
+    if (checkpoint > 0 && checkpoint == logger.get_last_checkpoint()) return true;
+
+    if (DEBUG) fprintf(stderr, "Writing checkpoint %zu for tablet %zu\n", checkpoint, tablet_id);
+
+    if (!Tablet::write_checkpoint(snapshot, work_path / (tablet_file(tablet_id, checkpoint) + ".chk.tblt")))
+        return false;
+    finish_checkpoint(tablet_id, logger, checkpoint);
+    return true;
+}
+
+void TabletArray::finish_checkpoint(const size_t tablet_id, TabletLogger &logger, const size_t checkpoint)
+{
+    // Save new checkpoint, this also removes the log segments that it covers
+    size_t old_checkpoint;
+    if (logger.record_checkpoint(work_path, checkpoint, old_checkpoint))
+    {
+        // Remove old checkpoint(s) once the new one is written
+        if (old_checkpoint != checkpoint)
+            remove_checkpoint_files(tablet_id, old_checkpoint);
+    }
+    else if (logger.get_last_checkpoint() != checkpoint)
+    {
+        // A newer checkpoint has been saved while this one was written
+        remove_checkpoint_files(tablet_id, checkpoint);
+    }
+}
+
+void TabletArray::remove_checkpoint_files(size_t tablet_id, size_t version) const
+{
+    fs::remove(work_path / (tablet_file(tablet_id, version) + ".chk.tblt"));
+    fs::remove(work_path / (tablet_file(tablet_id, version) + ".bin.tblt"));
+    fs::remove(work_path / (tablet_file(tablet_id, version) + ".idx.tblt"));
+}
+
+void TabletArray::initiate_checkpoint(const TabletSortInfo &tablet)
+{
+    if (tablet.logger->get_segment_versions() < checkpoint_frequency &&
+        tablet.logger->get_segment_bytes() < checkpoint_log_bytes)
+        return;
+
+    {
+        std::lock_guard lock{checkpoint_mutex};
+        checkpoint_queue.insert(tablet.index);
+    }
+    checkpoint_cv.notify_one();
+}
+
+void TabletArray::checkpoint_loop()
+{
+    std::unique_lock lock{checkpoint_mutex};
+    while (true)
+    {
+        checkpoint_cv.wait(lock, [this]
+            { return stop_checkpointer || eviction_pending || !checkpoint_queue.empty() || !split_queue.empty() ||
+                     !replica_splits.empty(); });
+        if (stop_checkpointer) return;
+
+        // Splits shipped by the primary go first, later ones assume the tablets they created
+        if (!replica_splits.empty())
+        {
+            const TabletSplit shipped{std::move(replica_splits.front())};
+            replica_splits.pop_front();
+            checkpoint_running = true;
+
+            lock.unlock();
+            split_tablet(0, &shipped);
+            reclaim_directories();
+            lock.lock();
+
+            checkpoint_running = false;
+            checkpoint_done_cv.notify_all();
+            continue;
+        }
+
+        // Evictions go first, the request that filled the cache does not wait for them
+        if (eviction_pending && split_queue.empty())
+        {
+            eviction_pending = false;
+            checkpoint_running = true;
+
+            lock.unlock();
+            evict_tablets();
+            reclaim_directories();
+            lock.lock();
+
+            checkpoint_running = false;
+            checkpoint_done_cv.notify_all();
+            continue;
+        }
+
+        // Splits go first, the tablets keep growing until they are split
+        const bool split{!split_queue.empty()};
+        std::set<size_t> &queue{split ? split_queue : checkpoint_queue};
+        const size_t tablet_id{*queue.begin()};
+        queue.erase(queue.begin());
+        checkpoint_running = true;
+
+        lock.unlock();
+        if (split)
+            split_tablet(tablet_id);
+        else
+            background_checkpoint(tablet_id);
+        reclaim_directories();
+        lock.lock();
+
+        checkpoint_running = false;
+        checkpoint_done_cv.notify_all();
+    }
+}
+
+void TabletArray::background_checkpoint(const size_t tablet_id)
+{
+    const TabletDirectory *current{directory.load(std::memory_order_acquire)};
+    if (!current || tablet_id >= current->positions.size()) return;
+    const TabletSortInfo &tablet{current->at(tablet_id)};
+
+    checkpoint_tablet(*tablet.info, tablet_id, *tablet.logger);
+}
+
+TabletArray::~TabletArray()
+{
+    {
+        std::lock_guard lock{checkpoint_mutex};
+        stop_checkpointer = true;
+    }
+    checkpoint_cv.notify_one();
+    if (checkpointer.joinable()) checkpointer.join();
+}
+
+void TabletArray::count_resident(TabletInfo &tablet_info)
+{
+    // Only the difference to the last count is added, so concurrent updates of a tablet never count it twice
+    const size_t resident{tablet_info.in_memory != std::numeric_limits<size_t>::max() ? tablet_info.resident_size() : 0};
+    resident_total += resident - tablet_info.counted_resident.exchange(resident);
+}
+
+void TabletArray::initiate_eviction()
+{
+    if (eviction_pending) return;
+
+    {
+        std::lock_guard lock{checkpoint_mutex};
+        eviction_pending = true;
+    }
+    checkpoint_cv.notify_one();
+}
+
+void TabletArray::evict_tablets()
+{
+    while (true)
+    {
+        const TabletSortInfo *victim{nullptr};
+        {
+            // No tablets are loaded or split while the victim is chosen
+            std::lock_guard lock{tablets_mutex};
+            const TabletDirectory *current{directory.load(std::memory_order_relaxed)};
+            if (!current || resident_bytes() <= memory_budget) return;
+
+            std::vector<TabletInfo *> candidates;
+            for (size_t tablet_id{0}; tablet_id < current->positions.size(); ++tablet_id)
+            {
+                TabletInfo *tablet{current->at(tablet_id).info};
+                if (tablet->in_memory != std::numeric_limits<size_t>::max() && !tablet->splitting &&
+                    tablet->resident_size() > 0)
+                    candidates.push_back(tablet);
+            }
+
+            // The last tablet would be loaded again right away, unless it keeps its key directory
+            if (candidates.size() < (block_cache.enabled() ? 1 : 2)) return;
+
+            TabletInfo *tablet{eviction_policy->victim(candidates)};
+            for (size_t tablet_id{0}; tablet && tablet_id < current->positions.size(); ++tablet_id)
+            {
+                if (current->at(tablet_id).info == tablet)
+                    victim = &current->at(tablet_id);
+            }
+        }
+
+        if (!victim || !evict_tablet(*victim->info, victim->index, *victim->logger)) return;
+    }
+}
+
+bool TabletArray::evict_tablet(TabletInfo &tablet_info, const size_t tablet_id, TabletLogger &logger)
+{
+    // Operations on the tablet continue while the checkpoint is written
+    if (!checkpoint_tablet(tablet_info, tablet_id, logger)) return false;
+
+    if (DEBUG) fprintf(stderr, "Evicting tablet %zu\n", tablet_id);
+
+    // Wait for operations on the tablet to finish, records logged since the checkpoint are replayed when it is loaded
+    std::lock_guard tablet_lock{tablet_info.tablet.tablet_mutex};
+    if (block_cache.enabled())
+    {
+        // The tablet stays in memory with its values in the new checkpoint, only the records since are kept in memory
+        read_cached_tablet(tablet_id, logger, tablet_info);
+    }
+    else
+    {
+        tablet_info.tablet.clear();
+        tablet_info.in_memory = std::numeric_limits<size_t>::max();
+    }
+    count_resident(tablet_info);
+    ++cache_stats.evictions;
+
+    return true;
+}
+
+void TabletArray::read_cached_tablet(const size_t tablet_id, const TabletLogger &logger, TabletInfo &tablet_info)
+{
+    size_t version{logger.get_last_checkpoint()};
+    tablet_info.tablet.read_from_file(work_path / tablet_file(tablet_id, version), block_cache.enabled());
+
+    // All records of a tablet on disk are complete, no operation can log to it
+    logger.replay(work_path, version,
+                  [&tablet_info](const TabletLogEntry &entry) { TabletLogger::apply(entry, tablet_info); });
+    tablet_info.size = tablet_info.tablet.size();
+}
+
+void TabletArray::load_tablet(const TabletSortInfo &tablet)
+{
+    // Another operation may have loaded the tablet in the meantime
+    if (tablet.info->in_memory != std::numeric_limits<size_t>::max()) return;
+
+    {
+        std::lock_guard tablet_lock{tablet.info->tablet.tablet_mutex};
+        read_cached_tablet(tablet.index, *tablet.logger, *tablet.info);
+        drop_moved_rows(tablet);
+        tablet.info->in_memory = activity_counter++;
+        eviction_policy->loaded(*tablet.info);
+        count_resident(*tablet.info);
+    }
+
+    // Make room for the tablet in the background
+    if (resident_bytes() > memory_budget) initiate_eviction();
+}
+
+void TabletArray::drop_moved_rows(const TabletSortInfo &tablet)
+{
+    // Rows from the first row of the next tablet on belong to the next tablet
+    const TabletDirectory *current{directory.load(std::memory_order_acquire)};
+    const size_t next{current->positions[tablet.index] + 1};
+    if (next < current->sorted.size())
+        tablet.info->size -= tablet.info->tablet.erase_rows(current->sorted[next].first_row_key);
+    count_resident(*tablet.info);
 }
 
 // Check if adding the value to the tablet would exceed the maximum size
@@ -114,14 +447,11 @@ void TabletArray::get_remote_checkpoint_files(std::map<int, CheckpointFiles> &ch
         size_t tablet_id = it->first;
         const auto &checkpoint = it->second;
 
-        if (checkpoint.log > 0)
-            fs::remove(work_path / (tablet_file(tablet_id, checkpoint.log) + ".log.tblt"));
+        for (size_t segment : checkpoint.segments)
+            fs::remove(work_path / (tablet_file(tablet_id, segment) + ".log.tblt"));
         
         if (checkpoint.tblt > 0)
-        {
-            fs::remove(work_path / (tablet_file(tablet_id, checkpoint.tblt) + ".bin.tblt"));
-            fs::remove(work_path / (tablet_file(tablet_id, checkpoint.tblt) + ".idx.tblt"));
-        }
+            remove_checkpoint_files(tablet_id, checkpoint.tblt);
 
         it = checkpoint_versions.erase(it);
     }
@@ -231,12 +561,15 @@ void TabletArray::get_remote_versions(std::vector<size_t> &remote_tablet_version
 
 std::string TabletArray::send_remote_versions(std::string host_port)
 {
+    DirectoryPin pin{*this};
+    const TabletDirectory *current{directory.load(std::memory_order_acquire)};
+
     std::string message{"#SYNCV " + host_port + " "};
-    for (size_t i{0}; i < tablet_list.size() - 1; ++i)
+    for (size_t i{0}; i < current->positions.size() - 1; ++i)
     {
-        message += std::to_string(loggers[i].get_version()) + ",";
+        message += std::to_string(current->at(i).logger->get_version()) + ",";
     }
-    message += std::to_string(loggers[tablet_list.size() - 1].get_version());
+    message += std::to_string(current->at(current->positions.size() - 1).logger->get_version());
 
     return message;
 }
@@ -271,44 +604,42 @@ void TabletArray::parse_recover_reply(size_t tablet_id, CheckpointFiles &local_v
     if (checkpoint_version > 0)
     {
         // Remove old checkpoint and log files
-        fs::remove(work_path / (tablet_file(tablet_id, local_versions.tblt) + ".bin.tblt"));
-        fs::remove(work_path / (tablet_file(tablet_id, local_versions.tblt) + ".idx.tblt"));
-        fs::remove(work_path / (tablet_file(tablet_id, local_versions.log) + ".log.tblt"));
+        remove_checkpoint_files(tablet_id, local_versions.tblt);
+        for (size_t segment : local_versions.segments)
+            fs::remove(work_path / (tablet_file(tablet_id, segment) + ".log.tblt"));
+        local_versions.segments.clear();
 
-        if (log_version > 0)
+        reader(RECOVERY_PIPE_R, bin, bin_file_length);
+        reader(RECOVERY_PIPE_R, idx, idx_file_length);
+
+        // Create new checkpoint files, a single-file checkpoint is sent in place of the binary file
+        if (Tablet::is_checkpoint(bin))
+        {
+            std::ofstream ifs_chk(work_path / (tablet_file(tablet_id, checkpoint_version) + ".chk.tblt"), std::ios::binary);
+            ifs_chk.write(bin.data(), bin_file_length);
+            ifs_chk.close();
+        }
+        else
         {
-            // Create new checkpoint and log files
             std::ofstream ifs_bin(work_path / (tablet_file(tablet_id, checkpoint_version) + ".bin.tblt"), std::ios::binary);
             std::ofstream ifs_idx(work_path / (tablet_file(tablet_id, checkpoint_version) + ".idx.tblt"));
-            std::ofstream ifs_log(work_path / (tablet_file(tablet_id, log_version) + ".log.tblt"), std::ios::binary);
 
-            // Write received data to the files
-            reader(RECOVERY_PIPE_R, bin, bin_file_length);
             ifs_bin.write(bin.data(), bin_file_length);
             ifs_bin.close();
 
-            reader(RECOVERY_PIPE_R, idx, idx_file_length);
             ifs_idx.write(idx.data(), idx_file_length);
             ifs_idx.close();
+        }
+
+        if (log_version > 0)
+        {
+            // Create new log file
+            std::ofstream ifs_log(work_path / (tablet_file(tablet_id, log_version) + ".log.tblt"), std::ios::binary);
 
             reader(RECOVERY_PIPE_R, log, log_file_length);
             ifs_log.write(log.data(), log_file_length);
             ifs_log.close();
-        }
-        else
-        {
-            // Create new checkpoint and log files
-            std::ofstream ifs_bin(work_path / (tablet_file(tablet_id, checkpoint_version) + ".bin.tblt"), std::ios::binary);
-            std::ofstream ifs_idx(work_path / (tablet_file(tablet_id, checkpoint_version) + ".idx.tblt"));
-
-            // Write received data to the files
-            reader(RECOVERY_PIPE_R, bin, bin_file_length);
-            ifs_bin.write(bin.data(), bin_file_length);
-            ifs_bin.close();
-
-            reader(RECOVERY_PIPE_R, idx, idx_file_length);
-            ifs_idx.write(idx.data(), idx_file_length);
-            ifs_idx.close();
+            local_versions.segments.insert(log_version);
         }
     }
     else
@@ -324,6 +655,8 @@ void TabletArray::parse_recover_reply(size_t tablet_id, CheckpointFiles &local_v
             work_path / (tablet_file(tablet_id, local_versions.log) + ".log.tblt"),
             work_path / (tablet_file(tablet_id, log_version) + ".log.tblt")
         );
+        local_versions.segments.erase(local_versions.log);
+        local_versions.segments.insert(log_version);
     }
 
     if (checkpoint_version) local_versions.tblt = checkpoint_version;
@@ -337,129 +670,113 @@ void TabletArray::parse_recover_reply(size_t tablet_id, CheckpointFiles &local_v
 <idx-data>\r\n
 <log-data>\r\n
 */
-std::string TabletArray::send_remote_files(std::string host_port, size_t tablet_id, size_t version)
+std::string TabletArray::send_remote_files(std::string host_port, size_t tablet_id, size_t version, ResponseBody &body)
 {
     std::string reply{"#SYNCF " + host_port + " "};
-    size_t checkpoint_version = loggers[tablet_id].get_last_checkpoint();
-    size_t log_version = loggers[tablet_id].get_version();
+    DirectoryPin pin{*this};
+    const TabletDirectory *current{directory.load(std::memory_order_acquire)};
+    if (tablet_id >= current->positions.size())
+    {
+        fprintf(stderr, "Cannot send files of unknown tablet %zu\n", tablet_id);
+        body.add("\r\n\r\n\r\n");
+        return reply + "0 0 0 0 0";
+    }
+    TabletLogger &logger{*current->at(tablet_id).logger};
+
+    // Make sure every logged record is in the segment before it is read
+    logger.flush();
+    size_t checkpoint_version = logger.get_last_checkpoint();
+    size_t log_version = logger.get_version();
+
+    // Map all log segments after the last checkpoint, their records are sent back to back
+    std::deque<TabletLogReader> segments;
+    for (const fs::path &segment_file : logger.segment_files(work_path))
+        segments.emplace_back(segment_file);
+
+    // The files are streamed to the socket with sendfile once the header is written, the body keeps them open
+    // until then so a checkpoint replaced in the meantime is still sent as announced
+    auto add_file = [&body](const fs::path &file) -> size_t {
+        int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return 0;
+        struct stat st;
+        size_t length = ::fstat(fd, &st) == 0 ? st.st_size : 0;
+        if (!body.add_file(fd, 0, length)) length = 0;
+        ::close(fd);
+        return length;
+    };
+
     if (checkpoint_version > version)
     {
         // Checkpoint on primary needs to be sent because data before that is not available
-        if (checkpoint_version == log_version)
+        // A single-file checkpoint takes the place of the binary file and leaves the index empty
+        const fs::path chk_file{work_path / (tablet_file(tablet_id, checkpoint_version) + ".chk.tblt")};
+        const bool single_file{fs::exists(chk_file)};
+        const fs::path bin_file{single_file ? chk_file : work_path / (tablet_file(tablet_id, checkpoint_version) + ".bin.tblt")};
+        const fs::path idx_file{work_path / (tablet_file(tablet_id, checkpoint_version) + ".idx.tblt")};
+        // Don't need to send log file if the checkpoint is up to date
+        const bool send_log{checkpoint_version != log_version};
+
+        size_t bin_file_length = add_file(bin_file);
+        body.add("\r\n");
+        size_t idx_file_length = single_file ? 0 : add_file(idx_file);
+        body.add("\r\n");
+
+        size_t log_file_length{0};
+        if (send_log)
         {
-            // Don't need to send log file
-            // Open and read the checkpoint files
-            std::ifstream ifs_bin(work_path / (tablet_file(tablet_id, checkpoint_version) + ".bin.tblt"), std::ios::binary | std::ios::ate);
-            std::ifstream ifs_idx(work_path / (tablet_file(tablet_id, checkpoint_version) + ".idx.tblt"), std::ios::ate);
-
-            // Get the file sizes
-            size_t bin_file_length = ifs_bin.tellg();
-            size_t idx_file_length = ifs_idx.tellg();
-
-            reply += std::to_string(checkpoint_version) + " " +
-                     std::to_string(bin_file_length) + " " +
-                     std::to_string(idx_file_length) + " 0 0\r\n";
-
-            // Read the file contents into the string without issuing multiple resizes
-            size_t reply_pos = reply.size();
-            reply.resize(reply_pos + bin_file_length + idx_file_length + 4);
-
-            ifs_bin.seekg(0);
-            ifs_bin.read(&reply[reply_pos], bin_file_length);
-            reply_pos += bin_file_length;
-            reply[reply_pos++] = '\r';
-            reply[reply_pos++] = '\n';
-            ifs_bin.close();
-
-            ifs_idx.seekg(0);
-            ifs_idx.read(&reply[reply_pos], idx_file_length);
-            reply_pos += idx_file_length;
-            reply[reply_pos++] = '\r';
-            reply[reply_pos++] = '\n';
-            ifs_idx.close();
+            for (const auto &segment : segments)
+            {
+                size_t length = segment.contents().size();
+                if (body.add_file(segment.file_descriptor(), 0, length))
+                    log_file_length += length;
+            }
         }
-        else
-        {
-            // Checkpoint and entire log file of the primary need to be sent
-            std::ifstream ifs_bin(work_path / (tablet_file(tablet_id, checkpoint_version) + ".bin.tblt"), std::ios::binary | std::ios::ate);
-            std::ifstream ifs_idx(work_path / (tablet_file(tablet_id, checkpoint_version) + ".idx.tblt"), std::ios::ate);
-            std::ifstream ifs_log(work_path / (tablet_file(tablet_id, log_version) + ".log.tblt"), std::ios::binary | std::ios::ate);
-
-            // Get the file sizes
-            size_t bin_file_length = ifs_bin.tellg();
-            size_t idx_file_length = ifs_idx.tellg();
-            size_t log_file_length = ifs_log.tellg();
-
-            reply += std::to_string(checkpoint_version) + " " +
-                    std::to_string(bin_file_length) + " " +
-                    std::to_string(idx_file_length) + " " +
-                    std::to_string(log_version) + " " +
-                    std::to_string(log_file_length) + "\r\n";
-
-            // Read the file contents into the string without issuing multiple resizes
-            size_t reply_pos = reply.size();
-            reply.resize(reply_pos + bin_file_length + idx_file_length + log_file_length + 4);
-
-            ifs_bin.seekg(0);
-            ifs_bin.read(&reply[reply_pos], bin_file_length);
-            reply_pos += bin_file_length;
-            reply[reply_pos++] = '\r';
-            reply[reply_pos++] = '\n';
-            ifs_bin.close();
-
-            ifs_idx.seekg(0);
-            ifs_idx.read(&reply[reply_pos], idx_file_length);
-            reply_pos += idx_file_length;
-            reply[reply_pos++] = '\r';
-            reply[reply_pos++] = '\n';
-            ifs_idx.close();
+        body.add("\r\n");
 
-            ifs_log.seekg(0);
-            ifs_log.read(&reply[reply_pos], log_file_length);
-            ifs_log.close();
-        }
+        reply += std::to_string(checkpoint_version) + " " +
+                 std::to_string(bin_file_length) + " " +
+                 std::to_string(idx_file_length) + " " +
+                 std::to_string(send_log ? log_version : 0) + " " +
+                 std::to_string(log_file_length);
     }
     else
     {
-        // Only the log file needs to be (potentially partially) sent
-        std::string line;
-        std::ifstream ifs_log(work_path / (tablet_file(tablet_id, log_version) + ".log.tblt"), std::ios::binary);
-
-        reply += "0 0 0 ";
-        // Parse the log file line by line until the version number is greater than the version of the recovering node
-        while (std::getline(ifs_log, line))
+        // Only the log needs to be (potentially partially) sent
+        std::vector<std::pair<const TabletLogReader *, size_t>> log_data;
+        size_t log_size{0};
+        for (auto &segment : segments)
         {
-            size_t line_version = std::stoul(line.substr(4, line.find(",", 4)));
-            if (line_version > version)
+            if (!log_data.empty())
             {
-                // Save current position
-                std::streampos pos{ifs_log.tellg()};
-                ifs_log.seekg(0, std::ios::end);
-                // Get the remaining size of the log file
-                std::streamsize log_size{ifs_log.tellg() - pos};
-                ifs_log.seekg(pos);
-                
-                // Read the rest of the log file from the current position
-                reply += std::to_string(log_version) + " " + std::to_string(log_size + line.size() + 1) + "\r\n\r\n\r\n" + line + "\n";
-                
-                size_t header_size = reply.size();
-
-                reply.resize(header_size + log_size);
-                ifs_log.read(&reply[header_size], log_size);
-                break;
+                // Segments after the first missing record are sent entirely
+                log_data.emplace_back(&segment, 0);
+                log_size += segment.contents().size();
+                continue;
             }
 
-            // If a put command is found we need to skip the value
-            if (line.substr(0, 3) == "put")
+            // Skip records until the version number is greater than the version of the recovering node
+            TabletLogEntry entry;
+            while (segment.next(entry))
             {
-                size_t sep{0};
-                for (int i{0}; i<4; ++i) sep = line.find(",", sep) + 1;
-
-                size_t value_size = std::stoul(line.substr(sep));
-                // Skip value and newline character
-                ifs_log.seekg(value_size + 1, std::ios::cur);
+                if (entry.version > version)
+                {
+                    log_data.emplace_back(&segment, entry.offset);
+                    log_size += segment.contents(entry.offset).size();
+                    break;
+                }
             }
         }
+
+        reply += "0 0 0 ";
+        if (!log_data.empty())
+        {
+            // Send the rest of the log from the first missing record
+            reply += std::to_string(log_version) + " " + std::to_string(log_size);
+            body.add("\r\n\r\n");
+            for (const auto &[segment, from] : log_data)
+                body.add_file(segment->file_descriptor(), from, segment->contents(from).size());
+            body.add("\r\n");
+        }
     }
 
     return reply;
@@ -467,16 +784,48 @@ std::string TabletArray::send_remote_files(std::string host_port, size_t tablet_
 
 void TabletArray::reset()
 {
+    // Drop queued checkpoints and wait for the running one
+    {
+        std::unique_lock lock{checkpoint_mutex};
+        checkpoint_queue.clear();
+        split_queue.clear();
+        replica_splits.clear();
+        shipped_splits.clear();
+        eviction_pending = false;
+        checkpoint_done_cv.wait(lock, [this] { return !checkpoint_running; });
+    }
+
+    directory.store(nullptr);
+    published_directory.reset();
+    retired_directories.clear();
     tablet_list.clear();
-    tablet_sort_info.clear();
     loggers.clear();
     activity_counter = 0;
+    resident_total = 0;
+    eviction_policy = TabletEvictionPolicy::create(cache_policy);
+    cache_stats.hits = 0;
+    cache_stats.misses = 0;
+    cache_stats.evictions = 0;
+    block_cache.clear();
 }
 
-void TabletArray::init(const std::string &init_path, const std::string &work_path)
+void TabletArray::init(const std::string &init_path, const std::string &work_path,
+                       size_t checkpoint_frequency, size_t checkpoint_log_bytes,
+                       size_t memory_budget, const std::string &cache_policy, size_t block_cache_budget)
 {
     this->init_path = init_path;
     this->work_path = work_path;
+    if (checkpoint_frequency) this->checkpoint_frequency = checkpoint_frequency;
+    if (checkpoint_log_bytes) this->checkpoint_log_bytes = checkpoint_log_bytes;
+    if (memory_budget) this->memory_budget = memory_budget;
+    block_cache.set_budget(block_cache_budget);
+    if (!cache_policy.empty() && !parse_cache_policy(cache_policy, this->cache_policy))
+        fprintf(stderr, "Unknown cache policy %s, using %s\n", cache_policy.c_str(),
+                cache_policy_to_string(this->cache_policy).c_str());
+    eviction_policy = TabletEvictionPolicy::create(this->cache_policy);
+
+    if (!checkpointer.joinable())
+        checkpointer = std::thread(&TabletArray::checkpoint_loop, this);
 }
 
 void TabletArray::load(bool recovery)
@@ -495,7 +844,7 @@ void TabletArray::load(bool recovery)
     {
         tablet_list.emplace_back();
         loggers.emplace_back(0);
-        tablet_sort_info.emplace_back(TabletSortInfo{0, num_to_row(get_first_row_hash())});
+        publish_directory({{0, num_to_row(get_first_row_hash()), &tablet_list.back(), &loggers.back()}});
         if (DEBUG) fprintf(stderr, "Initialized empty TabletArray\n");
         return;
     }
@@ -509,19 +858,20 @@ void TabletArray::load(bool recovery)
     {
         for (const auto& [tablet_id, checkpoint] : checkpoint_versions)
         {
-            if (checkpoint.log > 0)
-                fs::copy(init_path / (tablet_file(tablet_id, checkpoint.log) + ".log.tblt"),
-                         work_path / (tablet_file(tablet_id, checkpoint.log) + ".log.tblt"),
+            for (size_t segment : checkpoint.segments)
+                fs::copy(init_path / (tablet_file(tablet_id, segment) + ".log.tblt"),
+                         work_path / (tablet_file(tablet_id, segment) + ".log.tblt"),
                          fs::copy_options::overwrite_existing);
             
             if (checkpoint.tblt > 0)
             {
-                fs::copy(init_path / (tablet_file(tablet_id, checkpoint.tblt) + ".bin.tblt"),
-                         work_path / (tablet_file(tablet_id, checkpoint.tblt) + ".bin.tblt"),
-                         fs::copy_options::overwrite_existing);
-                fs::copy(init_path / (tablet_file(tablet_id, checkpoint.tblt) + ".idx.tblt"),
-                         work_path / (tablet_file(tablet_id, checkpoint.tblt) + ".idx.tblt"),
-                         fs::copy_options::overwrite_existing);
+                for (const char *extension : {".chk.tblt", ".bin.tblt", ".idx.tblt"})
+                {
+                    if (fs::exists(init_path / (tablet_file(tablet_id, checkpoint.tblt) + extension)))
+                        fs::copy(init_path / (tablet_file(tablet_id, checkpoint.tblt) + extension),
+                                 work_path / (tablet_file(tablet_id, checkpoint.tblt) + extension),
+                                 fs::copy_options::overwrite_existing);
+                }
             }
         }
     }
@@ -536,7 +886,7 @@ void TabletArray::load(bool recovery)
     {
         tablet_list.emplace_back();
         loggers.emplace_back(0);
-        tablet_sort_info.emplace_back(TabletSortInfo{0, num_to_row(get_first_row_hash())});
+        publish_directory({{0, num_to_row(get_first_row_hash()), &tablet_list.back(), &loggers.back()}});
         if (DEBUG) fprintf(stderr, "Initialized empty TabletArray\n");
         return;
     }
@@ -546,14 +896,12 @@ void TabletArray::load(bool recovery)
 
 void TabletArray::load_from_checkpoint_files(std::map<int, CheckpointFiles> &checkpoint_versions)
 {
+    std::vector<TabletSortInfo> sorted;
     for (int tablet_id{0}; tablet_id < checkpoint_versions.size(); ++tablet_id)
     {
         // No checkpoint or logging files for this tablet, end loading process
         if (checkpoint_versions.count(tablet_id) == 0) break;
 
-        // Cache tablets if the maximum number of tablets in memory is reached
-        if (tablet_id >= MAX_IN_MEMORY) cache_inactive();
-
         if (checkpoint_versions[tablet_id].tblt > 0)
         {
             // Load tablet from last checkpoint
@@ -565,20 +913,11 @@ void TabletArray::load_from_checkpoint_files(std::map<int, CheckpointFiles> &che
             // Create logger for tablet
             loggers.emplace_back(tablet_id, checkpoint_versions[tablet_id].tblt, checkpoint_versions[tablet_id].tblt);
 
+            // The first tablet covers the start of the row range of the replication group
             if (tablet_id == 0)
-            {
-                const std::string first_row_key{num_to_row(get_first_row_hash())};
-
-                tablet_list.back().tablet.first_row_key = first_row_key;
-                tablet_sort_info.insert(tablet_sort_info.begin(),  {tablet_list.size() - 1, first_row_key});
-            }
-            else
-            {
-                const std::string first_row_key{tablet_list.back().tablet.get_first_row_key()};
-                size_t insert_index = get_tablet_id(first_row_key) + 1;
-                tablet_sort_info.insert(tablet_sort_info.begin() + insert_index, 
-                    {tablet_list.size() - 1, first_row_key});
-            }
+                tablet_list.back().tablet.first_row_key = num_to_row(get_first_row_hash());
+            sorted.push_back({tablet_list.size() - 1, tablet_list.back().tablet.get_first_row_key(),
+                              &tablet_list.back(), &loggers.back()});
 
             if (DEBUG) fprintf(stderr, "Successfully loaded checkpoint %zu for tablet %zu\n",
                 checkpoint_versions[tablet_id].tblt, tablet_id);
@@ -589,23 +928,59 @@ void TabletArray::load_from_checkpoint_files(std::map<int, CheckpointFiles> &che
             {
                 tablet_list.emplace_back();
                 loggers.emplace_back(0);
-                tablet_sort_info.emplace_back(TabletSortInfo{0, num_to_row(get_first_row_hash())});
+                sorted.push_back({0, num_to_row(get_first_row_hash()), &tablet_list.back(), &loggers.back()});
             }
             else
             {
+                // A split that did not finish leaves the log of the new tablet without a checkpoint,
+                // the records are still in the log of the split tablet
                 fprintf(stderr, "Cannot recover tablet %d without checkpoint file\n", tablet_id);
+                for (size_t segment : checkpoint_versions[tablet_id].segments)
+                    fs::remove(work_path / (tablet_file(tablet_id, segment) + ".log.tblt"));
                 break;
             }
         }
 
-        if (checkpoint_versions[tablet_id].log > checkpoint_versions[tablet_id].tblt)
+        // Log segments are named after the version they follow, older log files after their last version
+        for (size_t segment : checkpoint_versions[tablet_id].segments)
         {
-            loggers[tablet_id].load(work_path, std::prev(tablet_list.end()), checkpoint_versions[tablet_id].log);
+            if (segment < checkpoint_versions[tablet_id].tblt)
+            {
+                // Records of a stale segment are all covered by the checkpoint
+                fs::remove(work_path / (tablet_file(tablet_id, segment) + ".log.tblt"));
+                continue;
+            }
+
+            loggers[tablet_id].load(work_path, std::prev(tablet_list.end()), segment);
             tablet_list.back().size = tablet_list.back().tablet.size();
-            if (DEBUG) fprintf(stderr, "Successfully loaded log entires up to %zu for tablet %zu\n",
-                checkpoint_versions[tablet_id].log, tablet_id);
+            if (DEBUG) fprintf(stderr, "Successfully loaded log entires of segment %zu for tablet %zu\n",
+                segment, tablet_id);
+        }
+
+        count_resident(tablet_list.back());
+
+        // Keep within the memory budget while loading, the tablets loaded first are evicted first
+        for (const TabletSortInfo &tablet : sorted)
+        {
+            if (resident_bytes() <= memory_budget || tablet.info == &tablet_list.back()) break;
+            if (tablet.info->in_memory == std::numeric_limits<size_t>::max() || !tablet.info->resident_size()) continue;
+
+            evict_tablet(*tablet.info, tablet.index, *tablet.logger);
         }
     }
+
+    if (sorted.empty()) return;
+
+    std::sort(sorted.begin(), sorted.end(),
+        [](const TabletSortInfo &a, const TabletSortInfo &b) {return a.first_row_key < b.first_row_key;});
+    publish_directory(std::move(sorted));
+
+    // Tablets split after their last checkpoint still hold the moved rows, cached tablets drop them when loaded
+    for (const TabletSortInfo &tablet : directory.load(std::memory_order_relaxed)->sorted)
+    {
+        if (tablet.info->in_memory != std::numeric_limits<size_t>::max())
+            drop_moved_rows(tablet);
+    }
 }
 
 void TabletArray::parse_local_checkpoint_files(const fs::path &path, std::map<int, CheckpointFiles> &checkpoint_versions)
@@ -624,571 +999,571 @@ void TabletArray::parse_local_checkpoint_files(const fs::path &path, std::map<in
             {
                 if (filename.stem().extension() == ".log")
                 {
-                    checkpoint_versions[tablet_id].log = std::max(
-                        std::stoul(filename.stem().string().substr(sep + 1)),
-                        checkpoint_versions[tablet_id].log
-                    );
+                    version = std::stoul(filename.stem().string().substr(sep + 1));
+                    checkpoint_versions[tablet_id].log = std::max(version, checkpoint_versions[tablet_id].log);
+                    checkpoint_versions[tablet_id].segments.insert(version);
+                }
+                else if (filename.stem().extension() == ".chk" || filename.stem().extension() == ".idx")
+                {
+                    version = std::stoul(filename.stem().stem().string().substr(sep + 1));
+                    size_t &checkpoint = checkpoint_versions[tablet_id].tblt;
+
+                    // Only the newest checkpoint is used, older ones are left over if cleaning up was interrupted
+                    if (path == work_path && checkpoint > 0 && checkpoint != version)
+                        remove_checkpoint_files(tablet_id, std::min(checkpoint, version));
+                    checkpoint = std::max(version, checkpoint);
                 }
-                else if (filename.stem().extension() == ".idx")
+                else if (filename.stem().extension() == ".split" && path == work_path)
                 {
-                    checkpoint_versions[tablet_id].tblt = std::max(
-                        std::stoul(filename.stem().stem().string().substr(sep + 1)),
-                        checkpoint_versions[tablet_id].tblt
-                    );
+                    // Checkpoint of the new tablet of a split that was not finished
+                    fs::remove(file.path());
                 }
             }
+            else if (filename.stem().extension() == ".tblt" && path == work_path)
+            {
+                // Temporary file of a checkpoint that was not finished
+                fs::remove(file.path());
+            }
         }
     }
 }
 
 
-int TabletArray::handle_tablet_split(
-    size_t &tablet_id,
-    std::list<TabletInfo>::iterator &tablet_it,
-    const size_t &value_size,
-    const std::string &row_key,
-    const bool tablet_on_disk)
+void TabletArray::reserve_size(const TabletSortInfo &tablet, const size_t value_size)
 {
-    // Check if splitting of the tablet is needed
-    if (!atomic_size_check(value_size, tablet_it->size))
-        return 0;
-
-    // Upgrade mutex to exclusive lock if tablet in memory
-    if (!tablet_on_disk && tablets_mutex.try_upgrade())
+    if (atomic_size_check(value_size, tablet.info->size))
     {
-        tablets_mutex.unlock_shared();
-        tablet_it->size -= value_size;
-        return -1;
+        // The write goes ahead, the tablet is split in the background
+        tablet.info->size += value_size;
+        initiate_split(tablet);
     }
+    count_resident(*tablet.info);
 
-    // Create new tablet
-    tablet_list.emplace_back();
-    // Split current tablet into new tablet
-    tablet_it->tablet.split(tablet_list.back().tablet);
-    // Copy activity counter to new tablet
-    tablet_list.back().in_memory = tablet_it->in_memory;
+    // Growing tablets fill the cache as well
+    if (resident_bytes() > memory_budget) initiate_eviction();
+}
 
-    loggers.emplace_back(tablet_list.size() - 1, 1);
+void TabletArray::release_size(const TabletSortInfo &tablet, const size_t value_size)
+{
+    tablet.info->size -= value_size;
+    count_resident(*tablet.info);
+}
+
+void TabletArray::initiate_split(const TabletSortInfo &tablet)
+{
+    if (tablet.info->splitting) return;
 
-    if (DEBUG)
     {
-        std::set<std::string> row_keys;
-        fprintf(stdout, "Splitting tablet %zu\n", tablet_id);
-
-        fprintf(stdout, "Tablet %zu: ", tablet_id);
-        row_keys.clear();
-        tablet_it->tablet.list_rows(row_keys);
-        for (const auto &row : row_keys)
-            fprintf(stdout, "%s ", row.c_str());
-        
-        fprintf(stdout, "\nTablet %zu: ", tablet_list.size()-1);
-        row_keys.clear();
-        tablet_list.back().tablet.list_rows(row_keys);
-        for (const auto &row : row_keys)
-            fprintf(stdout, "%s ", row.c_str());
-        fprintf(stdout, "\n");
+        std::lock_guard lock{checkpoint_mutex};
+        split_queue.insert(tablet.index);
     }
+    checkpoint_cv.notify_one();
+}
 
-    // Update tablet sizes
-    tablet_list.back().size = tablet_list.back().tablet.size();
-    tablet_it->size = tablet_it->tablet.size();
-
-    // Get the insertion index for the new tablet
-    const std::string first_row_key{tablet_list.back().tablet.get_first_row_key()};
-    const size_t insert_index = get_tablet_id(first_row_key) + 1;
-    // Insert sorted index in index map
-    tablet_sort_info.insert(tablet_sort_info.begin() + insert_index, 
-        {tablet_list.size() - 1, first_row_key});
-
-    // Get new tablet id
-    size_t new_tablet_id = tablet_sort_info[get_tablet_id(row_key)].index;
-    std::list<TabletInfo>::iterator new_tablet_it = tablet_list.begin();
-    std::advance(new_tablet_it, new_tablet_id);
-
-    new_tablet_it->size += value_size;
-
-    // Update activity counter for tablet
-    new_tablet_it->in_memory = activity_counter++;
-
-    // Increase version number of split tablet
-    loggers[tablet_id].log_noop();
-
-    // Check if any other tablet needs to be saved to disk
-    if (active_tablet_count() > MAX_IN_MEMORY)
+bool TabletArray::is_primary() const
+{
+    std::map<int, std::vector<KVServer>> kv_servers_map = COORDINATOR_SERVICE->get_kv_servers_map();
+    for (const KVServer &server : kv_servers_map[RG_ID])
     {
-        if (cache_inactive() == tablet_id)
-            save_checkpoint(std::prev(tablet_list.end()), tablet_list.size() - 1);
-        else
-            save_checkpoint(tablet_it, tablet_id);
+        if (server.host == HOST && server.port == PORT_NO)
+            return server.is_primary;
     }
-    else
+    return false;
+}
+
+void TabletArray::apply_split(const std::string &split_key, size_t new_tablet_id)
+{
     {
-        save_checkpoint(tablet_it, tablet_id);
-        save_checkpoint(std::prev(tablet_list.end()), tablet_list.size() - 1);
+        std::lock_guard lock{checkpoint_mutex};
+        replica_splits.push_back({split_key, new_tablet_id});
     }
+    checkpoint_cv.notify_one();
+}
 
-    tablet_it = new_tablet_it;
-    tablet_id = new_tablet_id;
-    
-    return 1;
+std::vector<TabletSplit> TabletArray::take_shipped_splits()
+{
+    std::lock_guard lock{checkpoint_mutex};
+    std::vector<TabletSplit> splits;
+    splits.swap(shipped_splits);
+    return splits;
 }
 
-TabletStatus TabletArray::write(const std::string &row_key, const std::string &column_key, tablet_value &value)
+void TabletArray::split_tablet(size_t tablet_id, const TabletSplit *shipped)
 {
-    if (value.size() > MAX_VALUE_SIZE)
-        return TabletStatus::VALUE_SIZE_ERR;
-    
-    // Shared lock on tablet array for safe reading
-    tablets_mutex.lock_shared();
-
-    // Get tablet id
-    size_t tablet_id{tablet_sort_info[get_tablet_id(row_key)].index};
-    auto tablet_it{tablet_list.begin()};
-    std::advance(tablet_it, tablet_id);
-
-    // Check if tablet is on disk
-    const bool tablet_on_disk{tablet_it->in_memory == std::numeric_limits<size_t>::max()};
-    if (tablet_on_disk)
+    // Replicas split their tablets only where the primary did, so recovery finds the same tablets on all servers
+    if (!shipped && !is_primary()) return;
+
+    const TabletSortInfo *tablet;
     {
-        if (tablets_mutex.try_upgrade())
+        std::lock_guard lock{tablets_mutex};
+        const TabletDirectory *current{directory.load(std::memory_order_relaxed)};
+        if (!current) return;
+        if (shipped)
         {
-            tablets_mutex.unlock_shared();
-            return TabletStatus::CACHING_ERR;
+            // A replica that recovered from the primary already has the tablets of earlier splits
+            if (shipped->new_tablet_id < tablet_list.size()) return;
+            if (shipped->new_tablet_id != tablet_list.size())
+            {
+                fprintf(stderr, "Cannot split into tablet %zu, only %zu tablets exist\n",
+                        shipped->new_tablet_id, tablet_list.size());
+                return;
+            }
+
+            tablet = &current->find(shipped->split_key);
+            tablet_id = tablet->index;
+            if (tablet->first_row_key == shipped->split_key) return;
+            load_tablet(*tablet);
         }
+        else
+        {
+            if (tablet_id >= current->positions.size()) return;
+            tablet = &current->at(tablet_id);
 
-        // Check if any other tablet needs to be saved to disk
-        if (active_tablet_count() >= MAX_IN_MEMORY) cache_inactive();
- 
-        tablet_it->tablet.read_from_file(work_path / tablet_file(tablet_id, loggers[tablet_id].get_version()));
-        tablet_it->in_memory = activity_counter++;
+            // Another split may have shrunk the tablet in the meantime, tablets on disk are split once they are loaded again
+            if (tablet->info->in_memory == std::numeric_limits<size_t>::max() || tablet->info->size <= MAX_TABLET_SIZE)
+                return;
+        }
+        tablet->info->splitting = true;
     }
 
-    std::shared_lock tablet_lock{tablet_it->tablet.tablet_mutex};
+    // Snapshot shares all values with the tablet, writes from now on go to a new log segment
+    tablet_data snapshot;
+    size_t version;
+    {
+        std::shared_lock tablet_lock{tablet->info->tablet.tablet_mutex};
 
-    if (!tablet_it->tablet.has_row(row_key))
+        // A single row cannot be split, the tablet grows beyond its maximum size
+        if (!shipped && tablet->info->tablet.row_count() < 2)
+        {
+            tablet->info->splitting = false;
+            return;
+        }
+        version = snapshot_tablet(*tablet->info, *tablet->logger, snapshot);
+    }
+
+    std::string split_key;
+    if (shipped)
+        split_key = shipped->split_key;
+    else if (!Tablet::split_point(snapshot, split_key))
     {
-        if (tablet_on_disk)
-            tablets_mutex.unlock();
-        else
-            tablets_mutex.unlock_shared();
+        tablet->info->splitting = false;
+        return;
+    }
 
-        return TabletStatus::ROW_KEY_ERR;
+    TabletInfo *new_tablet;
+    TabletLogger *new_logger;
+    size_t new_tablet_id;
+    {
+        std::lock_guard lock{tablets_mutex};
+        new_tablet = &tablet_list.emplace_back();
+        new_tablet->splitting = true;
+        new_tablet_id = tablet_list.size() - 1;
+        // The new tablet starts at checkpoint 1, records copied from the split tablet follow it
+        new_logger = &loggers.emplace_back(new_tablet_id, 1, 1);
     }
 
-    int split_result = handle_tablet_split(tablet_id, tablet_it,
-                                           value.size(), row_key, tablet_on_disk);
+    if (DEBUG) fprintf(stderr, "Splitting tablet %zu at row %s into tablet %zu\n",
+                       tablet_id, split_key.c_str(), new_tablet_id);
+
+    // Build the new tablet from the upper rows of the snapshot
+    // Its checkpoint is ignored by recovery until the split is published
+    new_tablet->tablet.take_rows(snapshot, split_key);
+    snapshot.clear();
+    const fs::path split_file{work_path / (tablet_file(new_tablet_id, 1) + ".split.tblt")};
+    if (!Tablet::write_checkpoint(new_tablet->tablet.data, split_file))
+    {
+        std::lock_guard lock{tablets_mutex};
+        loggers.pop_back();
+        tablet_list.pop_back();
+        tablet->info->splitting = false;
+        return;
+    }
 
-    if (split_result == -1)
-        return TabletStatus::SPLITTING_ERR;
-    const bool split_needed = split_result == 1;
+    // The new tablet is dropped if records copied to it cannot be logged, the split tablet still holds all rows
+    auto abort_split = [&]()
+    {
+        for (const fs::path &segment_file : new_logger->segment_files(work_path))
+            fs::remove(segment_file);
+        fs::remove(split_file);
+        loggers.pop_back();
+        tablet_list.pop_back();
+        tablet->info->splitting = false;
+    };
 
-    std::lock_guard row_lock{tablet_it->tablet.row_mutexes[row_key]};
+    // Copy the writes that happened meanwhile without blocking the tablet, until only few are left
+    size_t records;
+    for (size_t round{0}; round < SPLIT_CATCH_UP_ROUNDS; ++round)
+    {
+        if (!catch_up_split(*tablet, split_key, version, *new_tablet, *new_logger, records))
+        {
+            std::lock_guard lock{tablets_mutex};
+            abort_split();
+            return;
+        }
+        if (records <= SPLIT_CATCH_UP_RECORDS)
+            break;
+    }
 
-    if (tablet_it->tablet.data[row_key].size + value.size() > MAX_ROW_SIZE)
     {
-        if (tablet_on_disk)
-            tablets_mutex.unlock();
-        else
-            tablets_mutex.unlock_shared();
+        std::lock_guard lock{tablets_mutex};
+        {
+            // Wait for operations on the tablet to finish and copy the remaining records
+            std::lock_guard tablet_lock{tablet->info->tablet.tablet_mutex};
+            if (!catch_up_split(*tablet, split_key, version, *new_tablet, *new_logger, records))
+            {
+                abort_split();
+                return;
+            }
+
+            // Recovery picks up the new tablet from now on and drops its rows from the split tablet
+            fs::rename(split_file, work_path / (tablet_file(new_tablet_id, 1) + ".chk.tblt"));
+
+            tablet->info->tablet.erase_rows(split_key);
+            tablet->info->size = tablet->info->tablet.size();
+            new_tablet->size = new_tablet->tablet.size();
+            // Copy activity counter and eviction state to new tablet
+            new_tablet->in_memory = tablet->info->in_memory.load();
+            new_tablet->referenced = tablet->info->referenced.load();
+            count_resident(*tablet->info);
+            count_resident(*new_tablet);
+
+            // Publish the new tablet right after the split one, operations waiting for the tablet look up their row again
+            const TabletDirectory *current{directory.load(std::memory_order_relaxed)};
+            std::vector<TabletSortInfo> sorted{current->sorted};
+            sorted.insert(sorted.begin() + current->positions[tablet_id] + 1,
+                          {new_tablet_id, split_key, new_tablet, new_logger});
+            publish_directory(std::move(sorted));
+
+            new_tablet->splitting = false;
+            tablet->info->splitting = false;
+        }
 
-        return TabletStatus::ROW_SIZE_ERR;
     }
 
-    // Write value to tablet
-    loggers[tablet_id].log_write(work_path, row_key, column_key, value);
-    initiate_checkpoint(tablet_it, tablet_id);
-    TabletStatus status = tablet_it->tablet.write(row_key, column_key, value);
+    // The replicas make the same split once it is shipped ahead of the next write
+    if (!shipped)
+    {
+        std::lock_guard lock{checkpoint_mutex};
+        shipped_splits.push_back({split_key, new_tablet_id});
+    }
 
-    if (tablet_on_disk || split_needed)
-        tablets_mutex.unlock();
-    else
-        tablets_mutex.unlock_shared();
+    // The checkpoint and log of the split tablet still hold the moved rows
+    background_checkpoint(tablet_id);
 
-    return status;
+    // Writes during the split may have grown both halves beyond the maximum size again
+    const TabletDirectory *current{directory.load(std::memory_order_acquire)};
+    for (const size_t id : {tablet_id, new_tablet_id})
+    {
+        if (current->at(id).info->size > MAX_TABLET_SIZE)
+            initiate_split(current->at(id));
+    }
 }
 
-TabletStatus TabletArray::conditional_write(const std::string &row_key, const std::string &column_key,
-                                            const tablet_value &cvalue, tablet_value &value, bool &result)
+bool TabletArray::catch_up_split(const TabletSortInfo &tablet, const std::string &split_key, size_t &version,
+                                 TabletInfo &new_tablet, TabletLogger &new_logger, size_t &records)
 {
-    if (value.size() > MAX_VALUE_SIZE || cvalue.size() > MAX_VALUE_SIZE)
+    // Records are read from the segments, the last record may still be partially written
+    tablet.logger->flush();
+
+    std::shared_future<void> durable;
+    records = tablet.logger->replay(work_path, version, [&](const TabletLogEntry &entry)
+        {
+            if (entry.row_key < split_key) return;
+            durable = new_logger.log_entry(work_path, entry);
+            TabletLogger::apply(entry, new_tablet);
+            new_logger.applied();
+        });
+
+    // Records are committed in order, so the last one being durable covers all of them
+    return !durable.valid() || TabletLogger::wait_durable(durable);
+}
+
+TabletStatus TabletArray::write(const std::string &row_key, const std::string &column_key, tablet_value &value)
+{
+    if (value.size() > MAX_VALUE_SIZE)
         return TabletStatus::VALUE_SIZE_ERR;
 
-    // Shared lock on tablet array for safe reading
-    tablets_mutex.lock_shared();
+    // Shared lock on the tablet of the row
+    std::shared_lock<std::shared_mutex> tablet_lock;
+    const TabletSortInfo &tablet{lock_tablet(row_key, tablet_lock)};
 
-    // Get tablet id
-    size_t tablet_id{tablet_sort_info[get_tablet_id(row_key)].index};
-    auto tablet_it{tablet_list.begin()};
-    std::advance(tablet_it, tablet_id);
+    if (!tablet.info->tablet.has_row(row_key))
+        return TabletStatus::ROW_KEY_ERR;
+
+    reserve_size(tablet, value.size());
+
+    std::lock_guard row_lock{row_mutex(row_key)};
 
-    // Check if tablet is on disk
-    const bool tablet_on_disk{tablet_it->in_memory == std::numeric_limits<size_t>::max()};
-    if (tablet_on_disk)
+    if (tablet.info->tablet.row_size(row_key) + value.size() > MAX_ROW_SIZE)
     {
-        if (tablets_mutex.try_upgrade())
-        {
-            tablets_mutex.unlock_shared();
-            return TabletStatus::CACHING_ERR;
-        }
+        release_size(tablet, value.size());
+        return TabletStatus::ROW_SIZE_ERR;
+    }
 
-        // Check if any other tablet needs to be saved to disk
-        if (active_tablet_count() >= MAX_IN_MEMORY) cache_inactive();
- 
-        tablet_it->tablet.read_from_file(work_path / tablet_file(tablet_id, loggers[tablet_id].get_version()));
-        tablet_it->in_memory = activity_counter++;
+    // Write value to tablet once it is durable in the log
+    if (!TabletLogger::wait_durable(tablet.logger->log_write(work_path, row_key, column_key, value)))
+    {
+        release_size(tablet, value.size());
+        tablet.logger->applied();
+        return TabletStatus::LOG_ERR;
     }
+    TabletStatus status = tablet.info->tablet.write(row_key, column_key, value);
+    tablet.logger->applied();
+    // Overwritten values of a paged tablet leave the checkpoint for memory
+    count_resident(*tablet.info);
+    initiate_checkpoint(tablet);
 
-    std::shared_lock tablet_lock{tablet_it->tablet.tablet_mutex};
+    return status;
+}
 
-    if (!tablet_it->tablet.has_row(row_key))
-    {
-        if (tablet_on_disk)
-            tablets_mutex.unlock();
-        else
-            tablets_mutex.unlock_shared();
+TabletStatus TabletArray::conditional_write(const std::string &row_key, const std::string &column_key,
+                                            const tablet_value &cvalue, tablet_value &value, bool &result)
+{
+    if (value.size() > MAX_VALUE_SIZE || cvalue.size() > MAX_VALUE_SIZE)
+        return TabletStatus::VALUE_SIZE_ERR;
 
-        return TabletStatus::ROW_KEY_ERR;
-    }
+    // Shared lock on the tablet of the row
+    std::shared_lock<std::shared_mutex> tablet_lock;
+    const TabletSortInfo &tablet{lock_tablet(row_key, tablet_lock)};
 
-    int split_result = handle_tablet_split(tablet_id, tablet_it,
-                                           value.size(), row_key, tablet_on_disk);
+    if (!tablet.info->tablet.has_row(row_key))
+        return TabletStatus::ROW_KEY_ERR;
 
-    if (split_result == -1)
-        return TabletStatus::SPLITTING_ERR;
-    const bool split_needed = split_result == 1;
+    reserve_size(tablet, value.size());
 
-    std::lock_guard row_lock{tablet_it->tablet.row_mutexes[row_key]};
+    std::lock_guard row_lock{row_mutex(row_key)};
 
-    if (tablet_it->tablet.data[row_key].size + value.size() - cvalue.size() > MAX_ROW_SIZE)
+    if (tablet.info->tablet.row_size(row_key) + value.size() - cvalue.size() > MAX_ROW_SIZE)
     {
-        if (tablet_on_disk)
-            tablets_mutex.unlock();
-        else
-            tablets_mutex.unlock_shared();
-
+        release_size(tablet, value.size());
         return TabletStatus::ROW_SIZE_ERR;
     }
 
     // Write value to tablet
-    TabletStatus status = tablet_it->tablet.compare(row_key, column_key, cvalue, result);
+    TabletStatus status = tablet.info->tablet.compare(row_key, column_key, cvalue, result);
     if (result)
     {
-        loggers[tablet_id].log_write(work_path, row_key, column_key, value);
-        initiate_checkpoint(tablet_it, tablet_id);
-        tablet_it->tablet.write(row_key, column_key, value);
+        if (!TabletLogger::wait_durable(tablet.logger->log_write(work_path, row_key, column_key, value)))
+        {
+            release_size(tablet, value.size());
+            tablet.logger->applied();
+            return TabletStatus::LOG_ERR;
+        }
+        tablet.info->tablet.write(row_key, column_key, value);
+        tablet.logger->applied();
+        count_resident(*tablet.info);
+        initiate_checkpoint(tablet);
     }
-
-    if (tablet_on_disk || split_needed)
-        tablets_mutex.unlock();
     else
-        tablets_mutex.unlock_shared();
+        release_size(tablet, value.size());
 
     return status;
 }
 
 TabletStatus TabletArray::read(const std::string &row_key, const std::string &column_key, tablet_value &value)
 {
-    // Shared lock on tablet array for safe reading
-    tablets_mutex.lock_shared();
-
-    // Get tablet id
-    size_t tablet_id{tablet_sort_info[get_tablet_id(row_key)].index};
-    auto tablet_it{tablet_list.begin()};
-    std::advance(tablet_it, tablet_id);
+    // Shared lock on the tablet of the row
+    std::shared_lock<std::shared_mutex> tablet_lock;
+    const TabletSortInfo &tablet{lock_tablet(row_key, tablet_lock)};
 
-    // Check if tablet is on disk
-    const bool tablet_on_disk{tablet_it->in_memory == std::numeric_limits<size_t>::max()};
-    if (tablet_on_disk)
-    {
-        if (tablets_mutex.try_upgrade())
-        {
-            tablets_mutex.unlock_shared();
-            return TabletStatus::CACHING_ERR;
-        }
+    if (!tablet.info->tablet.has_row(row_key))
+        return TabletStatus::ROW_KEY_ERR;
 
-        // Check if any other tablet needs to be saved to disk
-        if (active_tablet_count() >= MAX_IN_MEMORY) cache_inactive();
- 
-        tablet_it->tablet.read_from_file(work_path / tablet_file(tablet_id, loggers[tablet_id].get_version()));
-        tablet_it->in_memory = activity_counter++;
-    }
+    std::shared_lock row_lock{row_mutex(row_key)};
 
-    std::shared_lock tablet_lock{tablet_it->tablet.tablet_mutex};
+    // Read value from tablet
+    return tablet.info->tablet.read(row_key, column_key, value);
+}
 
-    if (!tablet_it->tablet.has_row(row_key))
-    {
-        if (tablet_on_disk)
-            tablets_mutex.unlock();
-        else
-            tablets_mutex.unlock_shared();
+TabletStatus TabletArray::read(const std::string &row_key, const std::string &column_key, size_t offset, size_t length,
+                               tablet_value &value, size_t &value_size)
+{
+    // Shared lock on the tablet of the row
+    std::shared_lock<std::shared_mutex> tablet_lock;
+    const TabletSortInfo &tablet{lock_tablet(row_key, tablet_lock)};
 
+    if (!tablet.info->tablet.has_row(row_key))
         return TabletStatus::ROW_KEY_ERR;
-    }
-
-    std::shared_lock row_lock{tablet_it->tablet.row_mutexes[row_key]};
 
-    // Read value from tablet
-    TabletStatus status = tablet_it->tablet.read(row_key, column_key, value);
+    std::shared_lock row_lock{row_mutex(row_key)};
 
-    if (tablet_on_disk)
-        tablets_mutex.unlock();
-    else
-        tablets_mutex.unlock_shared();
-
-    return status;
+    // Read the range of the value from tablet
+    return tablet.info->tablet.read(row_key, column_key, offset, length, value, value_size);
 }
 
-TabletStatus TabletArray::move(const std::string &row_key, const std::string &column_key, const std::string &new_column_key)
+TabletStatus TabletArray::stat(const std::string &row_key, const std::string &column_key, size_t &value_size,
+                               size_t &tablet_version)
 {
-    // Shared lock on tablet array for safe reading
-    tablets_mutex.lock_shared();
-
-    // Get tablet id
-    size_t tablet_id{tablet_sort_info[get_tablet_id(row_key)].index};
-    auto tablet_it{tablet_list.begin()};
-    std::advance(tablet_it, tablet_id);
+    // Shared lock on the tablet of the row
+    std::shared_lock<std::shared_mutex> tablet_lock;
+    const TabletSortInfo &tablet{lock_tablet(row_key, tablet_lock)};
 
-    // Check if tablet is on disk
-    const bool tablet_on_disk{tablet_it->in_memory == std::numeric_limits<size_t>::max()};
-    if (tablet_on_disk)
-    {
-        if (tablets_mutex.try_upgrade())
-        {
-            tablets_mutex.unlock_shared();
-            return TabletStatus::CACHING_ERR;
-        }
+    if (!tablet.info->tablet.has_row(row_key))
+        return TabletStatus::ROW_KEY_ERR;
 
-        // Check if any other tablet needs to be saved to disk
-        if (active_tablet_count() >= MAX_IN_MEMORY) cache_inactive();
- 
-        tablet_it->tablet.read_from_file(work_path / tablet_file(tablet_id, loggers[tablet_id].get_version()));
-        tablet_it->in_memory = activity_counter++;
-    }
+    std::shared_lock row_lock{row_mutex(row_key)};
 
-    std::shared_lock tablet_lock{tablet_it->tablet.tablet_mutex};
+    // Writes to the row wait for the row lock, so the value did not change as long as the tablet version stays the same
+    tablet_version = tablet.logger->get_version();
+    return tablet.info->tablet.stat(row_key, column_key, value_size);
+}
 
-    if (!tablet_it->tablet.has_row(row_key))
-    {
-        if (tablet_on_disk)
-            tablets_mutex.unlock();
-        else
-            tablets_mutex.unlock_shared();
+TabletStatus TabletArray::move(const std::string &row_key, const std::string &column_key, const std::string &new_column_key)
+{
+    // Shared lock on the tablet of the row
+    std::shared_lock<std::shared_mutex> tablet_lock;
+    const TabletSortInfo &tablet{lock_tablet(row_key, tablet_lock)};
 
+    if (!tablet.info->tablet.has_row(row_key))
         return TabletStatus::ROW_KEY_ERR;
-    }
 
-    std::lock_guard row_lock{tablet_it->tablet.row_mutexes[row_key]};
+    std::lock_guard row_lock{row_mutex(row_key)};
 
-    if (!tablet_it->tablet.has_column(row_key, column_key))
-    {
-        tablets_mutex.unlock();
+    if (!tablet.info->tablet.has_column(row_key, column_key))
         return TabletStatus::COLUMN_KEY_ERR;
-    }
 
     // Move columns
-    loggers[tablet_id].log_move(work_path, row_key, column_key, new_column_key);
-    initiate_checkpoint(tablet_it, tablet_id);
-    TabletStatus status = tablet_it->tablet.move(row_key, column_key, new_column_key);
-
-    if (tablet_on_disk)
-        tablets_mutex.unlock();
-    else
-        tablets_mutex.unlock_shared();
+    if (!TabletLogger::wait_durable(tablet.logger->log_move(work_path, row_key, column_key, new_column_key)))
+    {
+        tablet.logger->applied();
+        return TabletStatus::LOG_ERR;
+    }
+    TabletStatus status = tablet.info->tablet.move(row_key, column_key, new_column_key);
+    tablet.logger->applied();
+    initiate_checkpoint(tablet);
 
     return status;
 }
 
 TabletStatus TabletArray::remove(const std::string &row_key, const std::string &column_key)
 {
-    // Shared lock on tablet array for safe reading
-    tablets_mutex.lock_shared();
-
-    // Get tablet id
-    size_t tablet_id{tablet_sort_info[get_tablet_id(row_key)].index};
-    auto tablet_it{tablet_list.begin()};
-    std::advance(tablet_it, tablet_id);
-
-    // Check if tablet is on disk
-    const bool tablet_on_disk{tablet_it->in_memory == std::numeric_limits<size_t>::max()};
-    if (tablet_on_disk)
-    {
-        if (tablets_mutex.try_upgrade())
-        {
-            tablets_mutex.unlock_shared();
-            return TabletStatus::CACHING_ERR;
-        }
-
-        // Check if any other tablet needs to be saved to disk
-        if (active_tablet_count() >= MAX_IN_MEMORY) cache_inactive();
- 
-        tablet_it->tablet.read_from_file(work_path / tablet_file(tablet_id, loggers[tablet_id].get_version()));
-        tablet_it->in_memory = activity_counter++;
-    }
-
-    std::shared_lock tablet_lock{tablet_it->tablet.tablet_mutex};
-
-    if (!tablet_it->tablet.has_row(row_key))
-    {
-        if (tablet_on_disk)
-            tablets_mutex.unlock();
-        else
-            tablets_mutex.unlock_shared();
+    // Shared lock on the tablet of the row
+    std::shared_lock<std::shared_mutex> tablet_lock;
+    const TabletSortInfo &tablet{lock_tablet(row_key, tablet_lock)};
 
+    if (!tablet.info->tablet.has_row(row_key))
         return TabletStatus::ROW_KEY_ERR;
-    }
 
-    std::lock_guard row_lock{tablet_it->tablet.row_mutexes[row_key]};
+    std::lock_guard row_lock{row_mutex(row_key)};
 
     // Remove value from tablet
     size_t value_size{0};
-    loggers[tablet_id].log_remove(work_path, row_key, column_key);
-    initiate_checkpoint(tablet_it, tablet_id);
-    TabletStatus status = tablet_it->tablet.remove(row_key, column_key, value_size);
-    tablet_it->size -= value_size;
-
-    if (tablet_on_disk)
-        tablets_mutex.unlock();
-    else
-        tablets_mutex.unlock_shared();
+    if (!TabletLogger::wait_durable(tablet.logger->log_remove(work_path, row_key, column_key)))
+    {
+        tablet.logger->applied();
+        return TabletStatus::LOG_ERR;
+    }
+    TabletStatus status = tablet.info->tablet.remove(row_key, column_key, value_size);
+    release_size(tablet, value_size);
+    tablet.logger->applied();
+    initiate_checkpoint(tablet);
 
     return status;
 }
 
 TabletStatus TabletArray::list_columns(const std::string &row_key, std::set<std::string> &column_keys)
 {
-    // Shared lock on tablet array for safe reading
-    tablets_mutex.lock_shared();
-
-    // Get tablet id
-    size_t tablet_id{tablet_sort_info[get_tablet_id(row_key)].index};
-    auto tablet_it{tablet_list.begin()};
-    std::advance(tablet_it, tablet_id);
+    // Shared lock on the tablet of the row
+    std::shared_lock<std::shared_mutex> tablet_lock;
+    const TabletSortInfo &tablet{lock_tablet(row_key, tablet_lock)};
 
-    // Check if tablet is on disk
-    const bool tablet_on_disk{tablet_it->in_memory == std::numeric_limits<size_t>::max()};
-    if (tablet_on_disk)
-    {
-        if (tablets_mutex.try_upgrade())
-        {
-            tablets_mutex.unlock_shared();
-            return TabletStatus::CACHING_ERR;
-        }
+    if (!tablet.info->tablet.has_row(row_key))
+        return TabletStatus::ROW_KEY_ERR;
 
-        // Check if any other tablet needs to be saved to disk
-        if (active_tablet_count() >= MAX_IN_MEMORY) cache_inactive();
- 
-        tablet_it->tablet.read_from_file(work_path / tablet_file(tablet_id, loggers[tablet_id].get_version()));
-        tablet_it->in_memory = activity_counter++;
-    }
+    std::shared_lock row_lock{row_mutex(row_key)};
 
-    std::shared_lock tablet_lock{tablet_it->tablet.tablet_mutex};
+    column_keys.clear();
+    return tablet.info->tablet.list_columns(row_key, column_keys);
+}
 
-    if (!tablet_it->tablet.has_row(row_key))
-    {
-        if (tablet_on_disk)
-            tablets_mutex.unlock();
-        else
-            tablets_mutex.unlock_shared();
+TabletStatus TabletArray::list_columns(const std::string &row_key, std::map<std::string, size_t> &column_sizes,
+                                       size_t &tablet_version)
+{
+    // Shared lock on the tablet of the row
+    std::shared_lock<std::shared_mutex> tablet_lock;
+    const TabletSortInfo &tablet{lock_tablet(row_key, tablet_lock)};
 
+    if (!tablet.info->tablet.has_row(row_key))
         return TabletStatus::ROW_KEY_ERR;
-    }
-
-    std::shared_lock row_lock{tablet_it->tablet.row_mutexes[row_key]};
 
-    column_keys.clear();
-    TabletStatus status = tablet_it->tablet.list_columns(row_key, column_keys);
+    std::shared_lock row_lock{row_mutex(row_key)};
 
-    if (tablet_on_disk)
-        tablets_mutex.unlock();
-    else
-        tablets_mutex.unlock_shared();
-
-    return status;
+    column_sizes.clear();
+    tablet_version = tablet.logger->get_version();
+    return tablet.info->tablet.list_columns(row_key, column_sizes);
 }
 
 void TabletArray::list_rows(std::set<std::string> &row_keys)
 {
-    // Exclusive lock on tablet array
-    tablets_mutex.lock_shared();
-    while (tablets_mutex.try_upgrade());
+    // No tablets are loaded or split meanwhile
+    std::lock_guard lock{tablets_mutex};
 
     row_keys.clear();
-    int idx{0};
-    for (auto it{tablet_list.begin()}; it != tablet_list.end(); ++it)
+    for (const TabletSortInfo &tablet : directory.load(std::memory_order_relaxed)->sorted)
     {
-        if (it->in_memory == std::numeric_limits<size_t>::max())
+        std::shared_lock tablet_lock{tablet.info->tablet.tablet_mutex};
+        if (tablet.info->in_memory != std::numeric_limits<size_t>::max())
         {
-            cache_inactive();
-            it->tablet.read_from_file(work_path / tablet_file(idx, loggers[idx].get_last_checkpoint()));
+            tablet.info->tablet.list_rows(row_keys);
+            continue;
         }
 
-        it->tablet.list_rows(row_keys);
-        it->in_memory = activity_counter++;
-        idx++;
+        // Tablets on disk are read without loading them, so listing all rows does not evict the working set
+        TabletInfo scan;
+        read_cached_tablet(tablet.index, *tablet.logger, scan);
+        scan.tablet.list_rows(row_keys);
     }
-
-    tablets_mutex.unlock();
 }
 
 void TabletArray::list_tablets(std::set<std::string> &tablet_infos)
 {
-    // Exclusive lock on tablet array
-    tablets_mutex.lock_shared();
-    while (tablets_mutex.try_upgrade())
-        ;
-
     tablet_infos.clear();
-    int idx{0};
-    for (const auto &tablet_info : tablet_sort_info)
+    DirectoryPin pin{*this};
+    for (const TabletSortInfo &tablet : directory.load(std::memory_order_acquire)->sorted)
     {
-        auto it{tablet_list.begin()};
-        std::advance(it, tablet_info.index);
-        tablet_infos.insert(tablet_info.first_row_key +
-                            " " + std::to_string(it->size.load()) +
-                            " " + std::to_string(it->in_memory != std::numeric_limits<size_t>::max()));
+        tablet_infos.insert(tablet.first_row_key +
+                            " " + std::to_string(tablet.info->size.load()) +
+                            " " + std::to_string(tablet.info->in_memory != std::numeric_limits<size_t>::max()));
     }
+}
 
-    tablets_mutex.unlock();
+void TabletArray::list_cache_stats(std::vector<std::string> &stats)
+{
+    DirectoryPin pin{*this};
+    const TabletDirectory *current{directory.load(std::memory_order_acquire)};
+    size_t tablet_count{current ? current->sorted.size() : 0};
+    size_t in_memory{0};
+    for (size_t i{0}; i < tablet_count; ++i)
+        in_memory += current->sorted[i].info->in_memory != std::numeric_limits<size_t>::max();
+
+    stats.clear();
+    stats.push_back("policy " + cache_policy_to_string(cache_policy));
+    stats.push_back("budget " + std::to_string(memory_budget));
+    stats.push_back("resident " + std::to_string(resident_bytes()));
+    stats.push_back("tablets " + std::to_string(in_memory) + "/" + std::to_string(tablet_count));
+    stats.push_back("hits " + std::to_string(cache_stats.hits.load()));
+    stats.push_back("misses " + std::to_string(cache_stats.misses.load()));
+    stats.push_back("evictions " + std::to_string(cache_stats.evictions.load()));
+    stats.push_back("block_cache " + std::to_string(block_cache.size()) + "/" + std::to_string(block_cache.get_budget()));
+    stats.push_back("block_hits " + std::to_string(block_cache.hits.load()));
+    stats.push_back("block_misses " + std::to_string(block_cache.misses.load()));
 }
 
 TabletStatus TabletArray::create_row(const std::string &row_key)
 {
-    // Shared lock on tablet array for safe reading
-    tablets_mutex.lock_shared();
-
-    // Get tablet id
-    size_t tablet_id{tablet_sort_info[get_tablet_id(row_key)].index};
-    auto tablet_it{tablet_list.begin()};
-    std::advance(tablet_it, tablet_id);
+    // Exclusive lock on the tablet of the row, since the row is inserted into the tablet
+    std::unique_lock<std::shared_mutex> tablet_lock;
+    const TabletSortInfo &tablet{lock_tablet(row_key, tablet_lock)};
 
-    // Check if tablet is on disk
-    const bool tablet_on_disk{tablet_it->in_memory == std::numeric_limits<size_t>::max()};
-    if (tablet_on_disk)
+    // Create row in tablet
+    if (!TabletLogger::wait_durable(tablet.logger->log_create_row(work_path, row_key)))
     {
-        if (tablets_mutex.try_upgrade())
-        {
-            tablets_mutex.unlock_shared();
-            return TabletStatus::CACHING_ERR;
-        }
-
-        // Check if any other tablet needs to be saved to disk
-        if (active_tablet_count() >= MAX_IN_MEMORY) cache_inactive();
- 
-        tablet_it->tablet.read_from_file(work_path / tablet_file(tablet_id, loggers[tablet_id].get_version()));
-        tablet_it->in_memory = activity_counter++;
+        tablet.logger->applied();
+        return TabletStatus::LOG_ERR;
     }
-
-    std::lock_guard tablet_lock{tablet_it->tablet.tablet_mutex};
-
-    // Create row in tablet
-    loggers[tablet_id].log_create_row(work_path, row_key);
-    initiate_checkpoint(tablet_it, tablet_id);
-    TabletStatus status = tablet_it->tablet.create_row(row_key);
-
-    if (tablet_on_disk)
-        tablets_mutex.unlock();
-    else
-        tablets_mutex.unlock_shared();
+    TabletStatus status = tablet.info->tablet.create_row(row_key);
+    tablet.logger->applied();
+    initiate_checkpoint(tablet);
 
     return status;
-}
\ No newline at end of file
+}
@@ -3,8 +3,19 @@
 #include <filesystem>
 #include <atomic>
 #include <list>
+#include <deque>
+#include <set>
+#include <array>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <shared_mutex>
+#include <mutex>
+#include <condition_variable>
 #include "Tablet.h"
 #include "TabletLogger.h"
+#include "TabletCache.h"
+#include "ResponseBody.h"
 #include <algorithm>
 #include <cstring>
 
@@ -15,38 +26,39 @@ extern TabletArray tablets;
 
 // Set maximum size for tablet (200 MB)
 constexpr size_t MAX_TABLET_SIZE{200ul * 1000ul * 1000ul};
-// Maximum number of tablets available in memory
-constexpr int MAX_IN_MEMORY{5};
+// Default memory budget of the tablet cache, the values of all tablets in memory (1 GB)
+constexpr size_t CACHE_MEMORY_BUDGET{1000ul * 1000ul * 1000ul};
 // Maximum size of value (30 MB)
 constexpr size_t MAX_VALUE_SIZE{30ul * 1000ul * 1000ul};
 // Maximum size of a row (150 MB)
 constexpr size_t MAX_ROW_SIZE{150ul * 1000ul * 1000ul};
-// Frequency of checkpointing (in version updates)
-constexpr size_t CHECKPOINT_FREQUENCY{10};
+// Default frequency of checkpointing (in version updates)
+constexpr size_t CHECKPOINT_FREQUENCY{1000};
+// Default size of a log segment that triggers a checkpoint (64 MB)
+constexpr size_t CHECKPOINT_LOG_BYTES{64ul * 1024ul * 1024ul};
+// Number of row locks shared by all rows (power of two)
+constexpr size_t ROW_LOCK_STRIPES{1024};
+// Records logged during a split are copied to the new tablet in passes until a pass reads at most this many,
+// the remaining records are copied while the split tablet is locked
+constexpr size_t SPLIT_CATCH_UP_RECORDS{1000};
+// Maximum number of passes copying records to the new tablet of a split before the split tablet is locked
+constexpr size_t SPLIT_CATCH_UP_ROUNDS{8};
+// Size of a cache line on the supported platforms
+constexpr size_t CACHE_LINE_SIZE{64};
 
-// Class that provides a mutex that can safely be upgraded from shared to exclusive
-class upgradable_mutex
+// Row lock that occupies its own cache line, so threads locking neighbouring stripes do not contend
+struct alignas(CACHE_LINE_SIZE) RowLockStripe
 {
-public:
-    void lock() { mutex.lock(); }
-    void unlock() { mutex.unlock(); }
-    void lock_shared() { mutex.lock_shared(); }
-    void unlock_shared() { mutex.unlock_shared(); }
-    int try_upgrade()
-    {
-        bool expected{false};
-        bool desired{true};
-        if (!upgrading.compare_exchange_strong(expected, desired))
-            return 1;
-        mutex.unlock_shared();
-        mutex.lock();
-        upgrading = false;
-        return 0;
-    }
-
-private:
     std::shared_mutex mutex;
-    std::atomic<bool> upgrading{false};
+};
+
+// Split of a tablet by the primary, replicas split their tablets at the same row into the same tablet index
+struct TabletSplit
+{
+    // First row of the new tablet
+    std::string split_key;
+    // Index of the new tablet
+    size_t new_tablet_id;
 };
 
 // Struct for keeping track of log and checkpoint versions
@@ -54,26 +66,63 @@ struct CheckpointFiles
 {
     size_t log{0};
     size_t tblt{0};
+    // Versions of all log segments, a segment holds the records after its version
+    std::set<size_t> segments;
 };
 
 struct TabletInfo
 {
     // Actual tablet
     Tablet tablet;
-    // Counter representing last activity on tablet
+    // Counter representing last activity on tablet, maintained by the eviction policy
     // Set to MAX_SIZE_T if tablet is not in memory
-    size_t in_memory{0};
+    std::atomic<size_t> in_memory{0};
+    // Set when the tablet is used, cleared by the eviction policy
+    std::atomic<bool> referenced{false};
     // Size of the tablet
     std::atomic<size_t> size{0};
+    // Set while the tablet is split, it is neither cached nor checkpointed, so its log stays in place
+    std::atomic<bool> splitting{false};
+    // Resident size of the tablet as last counted in the resident bytes of the tablet array
+    std::atomic<size_t> counted_resident{0};
+
+    // Size of the values held in memory, values of paged tablets that are still in their checkpoint are not counted
+    inline size_t resident_size() const
+    {
+        const size_t tablet_size{size}, stored_size{tablet.get_stored_size()};
+        return tablet_size > stored_size ? tablet_size - stored_size : 0;
+    }
 };
 
+class TabletLogger;
+
 struct TabletSortInfo
 {
     size_t index;
     std::string first_row_key;
+    // Tablet and logger, both stay at the same address until the tablet array is reset
+    TabletInfo *info;
+    TabletLogger *logger;
 };
 
-class TabletLogger;
+// Immutable directory of all tablets
+// A new directory is published whenever tablets are added, so lookups need no lock
+// Replaced directories are freed once no reader can hold them anymore (see TabletArray::DirectoryPin)
+struct TabletDirectory
+{
+    // Tablets sorted by first row key
+    std::vector<TabletSortInfo> sorted;
+    // Position of each tablet in sorted, indexed by tablet id
+    std::vector<size_t> positions;
+
+    // Get the tablet that holds a row key
+    const TabletSortInfo &find(const std::string &row_key) const;
+
+    inline const TabletSortInfo &at(size_t tablet_id) const
+    {
+        return sorted[positions[tablet_id]];
+    }
+};
 
 // Class that implements the array of tablets
 class TabletArray
@@ -81,15 +130,55 @@ class TabletArray
 private:
     // Activity counter for tablets to know which ones have been recently used
     std::atomic<size_t> activity_counter{0};
-    // Lock for the entire tablet array
-    upgradable_mutex tablets_mutex;
+    // Serializes loading and splitting of tablets, operations on a single tablet only lock the tablet
+    std::mutex tablets_mutex;
+    // Memory budget of the tablet cache in bytes
+    size_t memory_budget{CACHE_MEMORY_BUDGET};
+    // Eviction policy of the tablet cache
+    TabletCachePolicy cache_policy{TabletCachePolicy::LRU};
+    std::unique_ptr<TabletEvictionPolicy> eviction_policy{TabletEvictionPolicy::create(TabletCachePolicy::LRU)};
+    // Hits, misses and evictions of the tablet cache
+    TabletCacheStats cache_stats;
+    // Bytes held in memory by loaded tablets, kept up to date as tablets are loaded, evicted and written
+    std::atomic<size_t> resident_total{0};
 
     // List of tablets
     std::list<TabletInfo> tablet_list;
-    // Vector of information about tablets that can be sorted by first row key
-    std::vector<TabletSortInfo> tablet_sort_info;
-    // Vector of loggers for each tablet
-    std::vector<TabletLogger> loggers;
+    // Current tablet directory
+    std::atomic<const TabletDirectory *> directory{nullptr};
+    // Owns the current tablet directory
+    std::unique_ptr<const TabletDirectory> published_directory;
+    // Replaced directory and the reader epoch in which it was replaced
+    struct RetiredDirectory
+    {
+        size_t epoch;
+        std::unique_ptr<const TabletDirectory> directory;
+    };
+    // Replaced directories that readers may still use, protected by tablets_mutex
+    std::vector<RetiredDirectory> retired_directories;
+    // Reader epoch, advanced by the checkpointer to free replaced directories
+    mutable std::atomic<size_t> directory_epoch{0};
+    // Number of readers that entered in an even or odd epoch
+    mutable std::array<std::atomic<size_t>, 2> directory_readers{};
+
+    // Keeps the directories a reader sees while it exists from being freed
+    // Readers that use a directory without holding tablets_mutex hold a pin meanwhile
+    class DirectoryPin
+    {
+    private:
+        const TabletArray &array;
+        size_t epoch;
+
+    public:
+        explicit DirectoryPin(const TabletArray &array);
+        ~DirectoryPin();
+        DirectoryPin(const DirectoryPin &) = delete;
+        DirectoryPin &operator=(const DirectoryPin &) = delete;
+    };
+    // Loggers for each tablet (deque, since loggers own their open log segment and cannot be moved)
+    std::deque<TabletLogger> loggers;
+    // Row locks, each row maps to a stripe by the hash of its key
+    std::array<RowLockStripe, ROW_LOCK_STRIPES> row_locks;
 
     // Working path for the tablet array
     std::filesystem::path work_path;
@@ -99,31 +188,114 @@ private:
     // Internal buffer for reading from pipes
     std::string pipe_buffer;
 
-    // Get tablet id from row key to know which tablet to access
-    size_t get_tablet_id(const std::string &row_key);
+    // Number of logged versions that triggers a checkpoint
+    size_t checkpoint_frequency{CHECKPOINT_FREQUENCY};
+    // Number of logged bytes that triggers a checkpoint
+    size_t checkpoint_log_bytes{CHECKPOINT_LOG_BYTES};
+    // Background thread writing checkpoints, splitting tablets and evicting tablets from memory
+    std::thread checkpointer;
+    // Protects the checkpoint and split queues and state of the checkpointer
+    std::mutex checkpoint_mutex;
+    // Signals the checkpointer that tablets are queued or that it should stop
+    std::condition_variable checkpoint_cv;
+    // Signals that the checkpointer finished a checkpoint
+    std::condition_variable checkpoint_done_cv;
+    // Tablets waiting for a checkpoint
+    std::set<size_t> checkpoint_queue;
+    // Tablets waiting for a split
+    std::set<size_t> split_queue;
+    // Splits shipped by the primary, applied in the order the primary made them
+    std::deque<TabletSplit> replica_splits;
+    // Splits made as primary that have not been shipped to the replicas yet
+    std::vector<TabletSplit> shipped_splits;
+    // Set when the tablet cache exceeds its memory budget, written while holding checkpoint_mutex
+    std::atomic<bool> eviction_pending{false};
+    // Set while the checkpointer is working on a tablet
+    bool checkpoint_running{false};
+    // Set when the checkpointer should stop
+    bool stop_checkpointer{false};
+
+    // Publish a new directory for the given tablets, the replaced one is retired
+    // Requires tablets_mutex (or no concurrent operations)
+    void publish_directory(std::vector<TabletSortInfo> sorted);
+    // Free the retired directories that no reader can hold anymore, and start a new reader epoch for the others
+    // Only called by the checkpointer thread, which publishes all directories after loading
+    void reclaim_directories();
+    // Look up the tablet of a row and lock it for an operation
+    // Tablets cached to disk are loaded first, the returned tablet is in memory and holds the row key
+    // Returns a copy of the directory entry, so it stays valid after the directory is replaced
+    template <typename Lock>
+    TabletSortInfo lock_tablet(const std::string &row_key, Lock &tablet_lock);
     // Convenience function to get the file prefix for a tablet
     inline std::string tablet_file(size_t tablet_id, size_t version) const
     {
         return std::to_string(SERVER_ID) + "_" + std::to_string(tablet_id) + "_" + std::to_string(version);
     }
-    // Convenience function to get the number of tablets in memory
-    inline size_t active_tablet_count() const
+    // Lock for a row, rows sharing a stripe also share the lock
+    inline std::shared_mutex &row_mutex(const std::string &row_key)
     {
-        return std::count_if(tablet_list.begin(), tablet_list.end(),
-                             [](const TabletInfo &tablet)
-                             { return tablet.in_memory != std::numeric_limits<size_t>::max(); });
+        return row_locks[std::hash<std::string>{}(row_key) & (ROW_LOCK_STRIPES - 1)].mutex;
     }
-    // Function for saving checkpoint files every 10 write updates
-    void initiate_checkpoint(const std::list<TabletInfo>::iterator &tablet_it, const size_t tablet_id);
-    // Save checkpoint files to disk and clean up old log and checkpoint files
-    void save_checkpoint(const std::list<TabletInfo>::iterator &tablet_it, const size_t tablet_id);
-    // Save tablet that hasn't been used for the longest time to disk
-    size_t cache_inactive();
+    // Remove the checkpoint of a tablet, in either the single-file or the older two-file format
+    void remove_checkpoint_files(size_t tablet_id, size_t version) const;
+    // Size of the values of all tablets in memory
+    inline size_t resident_bytes() const
+    {
+        return resident_total;
+    }
+    // Update the resident bytes after the resident size of a tablet changed
+    void count_resident(TabletInfo &tablet_info);
+    // Queue a background checkpoint once enough versions or bytes are logged since the last one
+    void initiate_checkpoint(const TabletSortInfo &tablet);
+    // Take a snapshot of a tablet that shares all values with it, writes continue in a new log segment meanwhile
+    // Rows are copied one at a time under their row lock, the caller holds a shared lock on the tablet
+    // Returns the version of the snapshot
+    size_t snapshot_tablet(TabletInfo &tablet_info, TabletLogger &logger, tablet_data &snapshot);
+    // Write a checkpoint from a snapshot of the tablet while writes continue in a new log segment
+    // Returns false if the tablet is not in memory or the checkpoint could not be written
+    bool checkpoint_tablet(TabletInfo &tablet_info, const size_t tablet_id, TabletLogger &logger);
+    // Record a written checkpoint and remove the files it replaces
+    void finish_checkpoint(const size_t tablet_id, TabletLogger &logger, const size_t checkpoint);
+    // Loop of the checkpointer thread
+    void checkpoint_loop();
+    // Checkpoint a tablet in the background
+    void background_checkpoint(const size_t tablet_id);
+    // Queue a background eviction once the tablet cache exceeds its memory budget
+    void initiate_eviction();
+    // Evict tablets chosen by the eviction policy until the tablet cache is within its memory budget
+    // Tablets being split are skipped and the last tablet in memory is kept
+    void evict_tablets();
+    // Save a tablet to disk and remove it from memory, records logged after its checkpoint are replayed when it is loaded
+    // With the block cache enabled only the values are removed and the key directory stays in memory
+    // The caller must not hold the tablet lock
+    bool evict_tablet(TabletInfo &tablet_info, const size_t tablet_id, TabletLogger &logger);
+    // Read a tablet on disk from its last checkpoint and the records logged after it
+    // With the block cache enabled the values are left in the checkpoint
+    void read_cached_tablet(const size_t tablet_id, const TabletLogger &logger, TabletInfo &tablet_info);
+    // Load a tablet that has been cached to disk, tablets are evicted in the background if the cache is full
+    // Requires tablets_mutex, the caller must not hold any tablet lock
+    void load_tablet(const TabletSortInfo &tablet);
+    // Remove rows beyond the range of a tablet, which a split moved after the last checkpoint of the tablet
+    // Requires exclusive access to the tablet
+    void drop_moved_rows(const TabletSortInfo &tablet);
     // Atomically check if adding a value to the tablet size would exceed the maximum size
     bool atomic_size_check(const size_t &value_size, std::atomic<size_t> &tablet_size);
-    // Split a tablet into two tablets if the size exceeds the maximum size
-    int handle_tablet_split(size_t &tablet_id, std::list<TabletInfo>::iterator &tablet_it,
-                            const size_t &value_size, const std::string &row_key, const bool tablet_on_disk);
+    // Add the size of a value to a tablet, a tablet exceeding the maximum size is queued for a split
+    void reserve_size(const TabletSortInfo &tablet, const size_t value_size);
+    // Take the size of a value off a tablet again
+    void release_size(const TabletSortInfo &tablet, const size_t value_size);
+    // Queue a background split of a tablet
+    void initiate_split(const TabletSortInfo &tablet);
+    // Returns true if this server is the primary of its replication group, only the primary decides on splits
+    bool is_primary() const;
+    // Split a tablet in two while operations on it continue, only publishing the new tablet locks the tablet
+    // The primary picks the split row itself, a split shipped by the primary is made at its row into its tablet index
+    void split_tablet(size_t tablet_id, const TabletSplit *shipped = nullptr);
+    // Copy the records logged by a tablet after the given version to the new tablet of a split
+    // Only records of rows from split_key on are copied and logged again for the new tablet
+    // Sets the number of records read and advances version to the last one, returns false if they could not be logged
+    bool catch_up_split(const TabletSortInfo &tablet, const std::string &split_key, size_t &version,
+                        TabletInfo &new_tablet, TabletLogger &new_logger, size_t &records);
     // Convenience function to get the first hash of replication group
     size_t get_first_row_hash() const;
 
@@ -147,17 +319,27 @@ private:
     void load_from_checkpoint_files(std::map<int, CheckpointFiles> &checkpoint_versions);
 
 public:
+    // Stop the checkpointer thread
+    ~TabletArray();
+
     // Send checkpoint versions from the primary
     std::string send_remote_versions(std::string host_port);
-    // Send checkpoint files from the primary
-    std::string send_remote_files(std::string host_port, size_t tablet_id, size_t version);
+    // Send checkpoint files from the primary, returns the header line and adds the file ranges to body
+    std::string send_remote_files(std::string host_port, size_t tablet_id, size_t version, ResponseBody &body);
 
     // Reset the tablet array
     void reset();
-    // Initialize paths
-    void init(const std::string &init_path, const std::string &work_path);
+    // Initialize paths, checkpoint triggers and the tablet cache (0 or empty keeps the default) and start the checkpointer thread
+    // A block cache budget enables partial residency, evicted tablets keep their key directory in memory
+    void init(const std::string &init_path, const std::string &work_path,
+              size_t checkpoint_frequency = 0, size_t checkpoint_log_bytes = 0,
+              size_t memory_budget = 0, const std::string &cache_policy = "", size_t block_cache_budget = 0);
     // Initialize the tablet array (local/remote recovery or simple initialization from files)
     void load(bool recovery);
+    // Queue a split shipped by the primary, it is made in the background in the order the splits arrive
+    void apply_split(const std::string &split_key, size_t new_tablet_id);
+    // Takes the splits made as primary since the last call, they are shipped to the replicas ahead of the next write
+    std::vector<TabletSplit> take_shipped_splits();
     // Write a value to a given row and column key
     TabletStatus write(const std::string &row_key, const std::string &column_key, tablet_value &value);
     // Conditionally write a value to a given row and column key
@@ -167,14 +349,25 @@ public:
     TabletStatus read(const std::string &row_key, const std::string &column_key, tablet_value &value);
     // Move a value from one column to another in a given row
     TabletStatus move(const std::string &row_key, const std::string &column_key, const std::string &new_column_key);
+    // Read up to length bytes of a value from offset on and the size of the value
+    TabletStatus read(const std::string &row_key, const std::string &column_key, size_t offset, size_t length,
+                      tablet_value &value, size_t &value_size);
+    // Get the size of a value without reading it and the tablet version, the log version of the tablet holding the row
+    TabletStatus stat(const std::string &row_key, const std::string &column_key, size_t &value_size,
+                      size_t &tablet_version);
     // Remove a value from a given row and column key
     TabletStatus remove(const std::string &row_key, const std::string &column_key);
     // List all columns in a given row
     TabletStatus list_columns(const std::string &row_key, std::set<std::string> &column_keys);
+    // List all columns in a given row with the sizes of their values and the tablet version
+    TabletStatus list_columns(const std::string &row_key, std::map<std::string, size_t> &column_sizes,
+                              size_t &tablet_version);
     // List all rows in the tablet array
     void list_rows(std::set<std::string> &row_keys);
     // List all tablets in the tablet array
     void list_tablets(std::set<std::string> &tablet_infos);
+    // List the policy, memory use and counters of the tablet cache
+    void list_cache_stats(std::vector<std::string> &stats);
     // Create a new row in the tablet array
     TabletStatus create_row(const std::string &row_key);
 };
\ No newline at end of file
@@ -0,0 +1,322 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+
+// Sorted map from string keys to values, the alternative tablet engine (see Tablet.h)
+// Entries are stored in place in sorted leaves of bounded size and the leaves are kept in a sorted
+// array, i.e. a B+-tree of height two. A lookup binary searches the leaf array and then one contiguous
+// leaf, short keys are compared in place instead of chasing a node pointer per level like std::map.
+// Unlike std::map, inserting or erasing invalidates all iterators and references into the map.
+template <typename V>
+class TabletBTree
+{
+public:
+    typedef std::string key_type;
+    typedef V mapped_type;
+    // Keys must not be modified through an iterator
+    typedef std::pair<std::string, V> value_type;
+
+private:
+    // Leaves are split once they grow beyond this number of entries
+    static constexpr size_t MAX_LEAF_SIZE{64};
+
+    typedef std::vector<value_type> leaf;
+
+    // Non-empty leaves ordered by key
+    std::vector<leaf> leaves;
+    // Number of entries in all leaves
+    size_t entry_count{0};
+
+    template <bool Const>
+    class basic_iterator
+    {
+    private:
+        typedef std::conditional_t<Const, const std::vector<leaf>, std::vector<leaf>> leaf_array;
+
+        leaf_array *leaves{nullptr};
+        size_t leaf_index{0};
+        size_t entry_index{0};
+
+        basic_iterator(leaf_array *leaves, size_t leaf_index, size_t entry_index)
+            : leaves(leaves), leaf_index(leaf_index), entry_index(entry_index) {}
+
+        friend class TabletBTree;
+        template <bool> friend class basic_iterator;
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef TabletBTree::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::conditional_t<Const, const value_type, value_type> &reference;
+        typedef std::conditional_t<Const, const value_type, value_type> *pointer;
+
+        basic_iterator() = default;
+
+        // Converts an iterator to a const_iterator
+        template <bool OtherConst, typename = std::enable_if_t<Const && !OtherConst>>
+        basic_iterator(const basic_iterator<OtherConst> &other)
+            : leaves(other.leaves), leaf_index(other.leaf_index), entry_index(other.entry_index) {}
+
+        reference operator*() const
+        {
+            return (*leaves)[leaf_index][entry_index];
+        }
+
+        pointer operator->() const
+        {
+            return &(*leaves)[leaf_index][entry_index];
+        }
+
+        basic_iterator &operator++()
+        {
+            if (++entry_index == (*leaves)[leaf_index].size())
+            {
+                ++leaf_index;
+                entry_index = 0;
+            }
+            return *this;
+        }
+
+        basic_iterator operator++(int)
+        {
+            basic_iterator it{*this};
+            ++*this;
+            return it;
+        }
+
+        bool operator==(const basic_iterator &other) const
+        {
+            return leaf_index == other.leaf_index && entry_index == other.entry_index;
+        }
+
+        bool operator!=(const basic_iterator &other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+public:
+    typedef basic_iterator<false> iterator;
+    typedef basic_iterator<true> const_iterator;
+
+private:
+    // Returns the leaf and entry index of the first entry whose key is not less than key
+    std::pair<size_t, size_t> locate(std::string_view key) const
+    {
+        // The first leaf whose last key is not less than key contains the position
+        const size_t leaf_index = std::partition_point(leaves.begin(), leaves.end(),
+            [&key](const leaf &entries) { return std::string_view{entries.back().first} < key; }) - leaves.begin();
+        if (leaf_index == leaves.size())
+            return {leaves.size(), 0};
+
+        const leaf &entries{leaves[leaf_index]};
+        const size_t entry_index = std::partition_point(entries.begin(), entries.end(),
+            [&key](const value_type &entry) { return std::string_view{entry.first} < key; }) - entries.begin();
+        return {leaf_index, entry_index};
+    }
+
+    // Inserts a new entry before the given position and splits the leaf if it overflows
+    template <typename... Args>
+    iterator insert_at(size_t leaf_index, size_t entry_index, const std::string &key, Args &&...args)
+    {
+        // Keys beyond the last leaf are appended to it
+        // The first leaf grows as needed, most rows hold far fewer columns than a full leaf
+        if (leaves.empty())
+            leaves.emplace_back();
+        if (leaf_index == leaves.size())
+        {
+            leaf_index = leaves.size() - 1;
+            entry_index = leaves.back().size();
+        }
+
+        leaf &entries{leaves[leaf_index]};
+        entries.emplace(entries.begin() + entry_index, std::piecewise_construct,
+                        std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+        ++entry_count;
+
+        if (entries.size() <= MAX_LEAF_SIZE)
+            return iterator{&leaves, leaf_index, entry_index};
+
+        // Appending in key order (e.g. loading a checkpoint) fills every leaf up completely,
+        // otherwise the leaf is split in half so both leaves have room for inserts
+        const bool append = leaf_index + 1 == leaves.size() && entry_index + 1 == entries.size();
+        const size_t split_index = append ? entries.size() - 1 : entries.size() / 2;
+
+        leaf upper;
+        upper.reserve(MAX_LEAF_SIZE + 1);
+        std::move(entries.begin() + split_index, entries.end(), std::back_inserter(upper));
+        entries.erase(entries.begin() + split_index, entries.end());
+        leaves.insert(leaves.begin() + leaf_index + 1, std::move(upper));
+
+        if (entry_index >= split_index)
+            return iterator{&leaves, leaf_index + 1, entry_index - split_index};
+        return iterator{&leaves, leaf_index, entry_index};
+    }
+
+public:
+    iterator begin()
+    {
+        return iterator{&leaves, 0, 0};
+    }
+
+    iterator end()
+    {
+        return iterator{&leaves, leaves.size(), 0};
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator{&leaves, 0, 0};
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator{&leaves, leaves.size(), 0};
+    }
+
+    size_t size() const
+    {
+        return entry_count;
+    }
+
+    bool empty() const
+    {
+        return entry_count == 0;
+    }
+
+    void clear()
+    {
+        leaves.clear();
+        entry_count = 0;
+    }
+
+    // Returns the first entry whose key is not less than key
+    iterator lower_bound(std::string_view key)
+    {
+        auto [leaf_index, entry_index] = locate(key);
+        return iterator{&leaves, leaf_index, entry_index};
+    }
+
+    const_iterator lower_bound(std::string_view key) const
+    {
+        auto [leaf_index, entry_index] = locate(key);
+        return const_iterator{&leaves, leaf_index, entry_index};
+    }
+
+    iterator find(std::string_view key)
+    {
+        iterator it{lower_bound(key)};
+        return it != end() && it->first == key ? it : end();
+    }
+
+    const_iterator find(std::string_view key) const
+    {
+        const_iterator it{lower_bound(key)};
+        return it != end() && it->first == key ? it : end();
+    }
+
+    size_t count(std::string_view key) const
+    {
+        return find(key) != end();
+    }
+
+    // Inserts a value constructed from args if the key does not exist yet
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const std::string &key, Args &&...args)
+    {
+        auto [leaf_index, entry_index] = locate(key);
+        if (leaf_index < leaves.size() && leaves[leaf_index][entry_index].first == key)
+            return {iterator{&leaves, leaf_index, entry_index}, false};
+
+        return {insert_at(leaf_index, entry_index, key, std::forward<Args>(args)...), true};
+    }
+
+    // Same as above, a hint at end() skips the search when keys are inserted in order
+    template <typename... Args>
+    iterator try_emplace(const_iterator hint, const std::string &key, Args &&...args)
+    {
+        if (hint == end() && (leaves.empty() || leaves.back().back().first < key))
+            return insert_at(leaves.size(), 0, key, std::forward<Args>(args)...);
+
+        return try_emplace(key, std::forward<Args>(args)...).first;
+    }
+
+    // Removes an entry, returns the position of the following entry
+    iterator erase(const_iterator pos)
+    {
+        size_t leaf_index{pos.leaf_index};
+        size_t entry_index{pos.entry_index};
+        leaves[leaf_index].erase(leaves[leaf_index].begin() + entry_index);
+        --entry_count;
+
+        // Merge sparse neighbours, so leaves do not degenerate into single entries
+        if (leaf_index > 0 && leaves[leaf_index - 1].size() + leaves[leaf_index].size() <= MAX_LEAF_SIZE / 2)
+        {
+            leaf &lower{leaves[leaf_index - 1]};
+            entry_index += lower.size();
+            std::move(leaves[leaf_index].begin(), leaves[leaf_index].end(), std::back_inserter(lower));
+            leaves.erase(leaves.begin() + leaf_index);
+            --leaf_index;
+        }
+        if (leaf_index + 1 < leaves.size() &&
+            leaves[leaf_index].size() + leaves[leaf_index + 1].size() <= MAX_LEAF_SIZE / 2)
+        {
+            leaf &upper{leaves[leaf_index + 1]};
+            std::move(upper.begin(), upper.end(), std::back_inserter(leaves[leaf_index]));
+            leaves.erase(leaves.begin() + leaf_index + 1);
+        }
+
+        if (leaves[leaf_index].empty())
+        {
+            leaves.erase(leaves.begin() + leaf_index);
+            return iterator{&leaves, leaf_index, 0};
+        }
+        if (entry_index == leaves[leaf_index].size())
+            return iterator{&leaves, leaf_index + 1, 0};
+        return iterator{&leaves, leaf_index, entry_index};
+    }
+
+    // Removes all entries in [first, last), returns the position of the following entry
+    iterator erase(const_iterator first, const_iterator last)
+    {
+        if (first == last)
+            return iterator{&leaves, first.leaf_index, first.entry_index};
+
+        // Cutting off the tail (tablet split) drops whole leaves at once
+        if (last == end())
+        {
+            leaf &entries{leaves[first.leaf_index]};
+            entry_count -= entries.size() - first.entry_index;
+            for (size_t i{first.leaf_index + 1}; i < leaves.size(); ++i)
+                entry_count -= leaves[i].size();
+
+            entries.erase(entries.begin() + first.entry_index, entries.end());
+            leaves.erase(leaves.begin() + first.leaf_index + 1, leaves.end());
+            if (entries.empty())
+                leaves.pop_back();
+            return end();
+        }
+
+        iterator it{&leaves, first.leaf_index, first.entry_index};
+        for (auto remaining = std::distance(first, last); remaining > 0; --remaining)
+            it = erase(it);
+        return it;
+    }
+
+    size_t erase(std::string_view key)
+    {
+        const_iterator it{find(key)};
+        if (it == end())
+            return 0;
+
+        erase(it);
+        return 1;
+    }
+};
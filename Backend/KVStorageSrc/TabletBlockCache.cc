@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "TabletBlockCache.h"
+
+TabletBlockCache block_cache;
+
+namespace
+{
+    // Source of checkpoint file ids
+    std::atomic<uint64_t> next_file_id{0};
+}
+
+CheckpointFile::CheckpointFile(const std::string &filename) : id(next_file_id++), filename(filename)
+{
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        fprintf(stderr, "Failed to open checkpoint %s: %s\n", filename.c_str(), strerror(errno));
+}
+
+CheckpointFile::~CheckpointFile()
+{
+    // Blocks of the file left in the block cache are evicted like any other
+    if (fd >= 0) ::close(fd);
+}
+
+ssize_t CheckpointFile::read(uint64_t offset, size_t size, std::byte *buffer) const
+{
+    size_t bytes_read{0};
+    while (bytes_read < size)
+    {
+        const ssize_t n = ::pread(fd, buffer + bytes_read, size - bytes_read, offset + bytes_read);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0)
+        {
+            fprintf(stderr, "Failed to read checkpoint %s: %s\n", filename.c_str(), strerror(errno));
+            return -1;
+        }
+        if (n == 0) break;
+        bytes_read += n;
+    }
+    return bytes_read;
+}
+
+void TabletBlockCache::set_budget(size_t bytes)
+{
+    budget = bytes;
+}
+
+size_t TabletBlockCache::size()
+{
+    std::lock_guard lock{cache_mutex};
+    return cached_bytes;
+}
+
+void TabletBlockCache::insert(const BlockKey &key, block_ptr data)
+{
+    // Another read may have added the block meanwhile
+    if (block_map.count(key)) return;
+
+    cached_bytes += data->size();
+    blocks.push_front({key, std::move(data)});
+    block_map.emplace(key, blocks.begin());
+
+    while (cached_bytes > budget && !blocks.empty())
+    {
+        cached_bytes -= blocks.back().data->size();
+        block_map.erase(blocks.back().key);
+        blocks.pop_back();
+    }
+}
+
+bool TabletBlockCache::read(const CheckpointFile &file, uint64_t offset, size_t size, std::byte *buffer)
+{
+    if (size == 0) return true;
+
+    // Values too large for the cache are read directly, so they do not flush it
+    if (size > budget / 4)
+    {
+        ++misses;
+        return file.read(offset, size, buffer) == static_cast<ssize_t>(size);
+    }
+
+    const uint64_t first_block{offset / BLOCK_SIZE};
+    const uint64_t last_block{(offset + size - 1) / BLOCK_SIZE};
+    std::vector<block_ptr> value_blocks(last_block - first_block + 1);
+
+    // Look up all blocks of the value, the missing ones are read together
+    uint64_t first_missing{last_block + 1};
+    uint64_t last_missing{0};
+    {
+        std::lock_guard lock{cache_mutex};
+        for (uint64_t index{first_block}; index <= last_block; ++index)
+        {
+            auto block_it = block_map.find({file.get_id(), index});
+            if (block_it == block_map.end())
+            {
+                first_missing = std::min(first_missing, index);
+                last_missing = index;
+                continue;
+            }
+
+            blocks.splice(blocks.begin(), blocks, block_it->second);
+            value_blocks[index - first_block] = block_it->second->data;
+        }
+    }
+
+    if (first_missing > last_block)
+    {
+        ++hits;
+    }
+    else
+    {
+        ++misses;
+
+        std::vector<std::byte> span((last_missing - first_missing + 1) * BLOCK_SIZE);
+        const ssize_t span_size = file.read(first_missing * BLOCK_SIZE, span.size(), span.data());
+        if (span_size < 0) return false;
+
+        std::lock_guard lock{cache_mutex};
+        for (uint64_t index{first_missing}; index <= last_missing; ++index)
+        {
+            // The last block of the file is shorter
+            const size_t begin{(index - first_missing) * BLOCK_SIZE};
+            const size_t end{std::min(begin + BLOCK_SIZE, static_cast<size_t>(span_size))};
+            if (begin >= end) return false;
+
+            auto data = std::make_shared<const std::vector<std::byte>>(span.begin() + begin, span.begin() + end);
+            value_blocks[index - first_block] = data;
+            insert({file.get_id(), index}, std::move(data));
+        }
+    }
+
+    // Copy the value out of its blocks
+    size_t copied{0};
+    for (uint64_t index{first_block}; index <= last_block; ++index)
+    {
+        const std::vector<std::byte> &data{*value_blocks[index - first_block]};
+        const size_t begin{index == first_block ? offset % BLOCK_SIZE : 0};
+        const size_t length{std::min(size - copied, BLOCK_SIZE - begin)};
+        if (begin + length > data.size()) return false;
+
+        std::copy(data.begin() + begin, data.begin() + begin + length, buffer + copied);
+        copied += length;
+    }
+    return true;
+}
+
+void TabletBlockCache::clear()
+{
+    std::lock_guard lock{cache_mutex};
+    blocks.clear();
+    block_map.clear();
+    cached_bytes = 0;
+    hits = 0;
+    misses = 0;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+
+class TabletBlockCache;
+extern TabletBlockCache block_cache;
+
+// Checkpoint file that the values of a paged tablet are read from
+// The file stays open while values refer to it, so it can be replaced by a newer checkpoint and removed meanwhile
+class CheckpointFile
+{
+private:
+    int fd{-1};
+    // Identifies the blocks of the file in the block cache, never reused
+    uint64_t id;
+    std::string filename;
+
+public:
+    explicit CheckpointFile(const std::string &filename);
+    ~CheckpointFile();
+    CheckpointFile(const CheckpointFile &) = delete;
+    CheckpointFile &operator=(const CheckpointFile &) = delete;
+
+    inline bool is_open() const
+    {
+        return fd >= 0;
+    }
+
+    inline uint64_t get_id() const
+    {
+        return id;
+    }
+
+    // Reads up to size bytes at the given offset, returns the number of bytes read (less at the end of the file)
+    // or -1 on error
+    ssize_t read(uint64_t offset, size_t size, std::byte *buffer) const;
+};
+
+// Cache of fixed-size blocks of checkpoint files, bounded by a memory budget and evicted in LRU order
+// Values of paged tablets are read through it, missing blocks of a value are read with a single read
+class TabletBlockCache
+{
+public:
+    // Size of a cached block, the columns of a row are stored next to each other in a checkpoint
+    static constexpr size_t BLOCK_SIZE{16ul * 1024ul};
+
+private:
+    typedef std::shared_ptr<const std::vector<std::byte>> block_ptr;
+
+    struct BlockKey
+    {
+        uint64_t file_id;
+        uint64_t index;
+
+        inline bool operator==(const BlockKey &other) const
+        {
+            return file_id == other.file_id && index == other.index;
+        }
+    };
+
+    struct BlockKeyHash
+    {
+        inline size_t operator()(const BlockKey &key) const
+        {
+            return std::hash<uint64_t>{}(key.file_id * 0x9E3779B97F4A7C15ull ^ key.index);
+        }
+    };
+
+    struct Block
+    {
+        BlockKey key;
+        block_ptr data;
+    };
+
+    // Protects the blocks, reads from disk happen outside of it
+    std::mutex cache_mutex;
+    // Blocks ordered from most to least recently used
+    std::list<Block> blocks;
+    std::unordered_map<BlockKey, std::list<Block>::iterator, BlockKeyHash> block_map;
+    // Size of all cached blocks
+    size_t cached_bytes{0};
+    // Memory budget in bytes, 0 disables partial residency of tablets
+    std::atomic<size_t> budget{0};
+
+    // Adds a block read from disk, evicting the least recently used blocks beyond the budget
+    // Requires cache_mutex
+    void insert(const BlockKey &key, block_ptr data);
+
+public:
+    // Reads that found all their blocks in the cache
+    std::atomic<size_t> hits{0};
+    // Reads that had to read blocks from disk
+    std::atomic<size_t> misses{0};
+
+    // Sets the memory budget, 0 disables partial residency of tablets
+    void set_budget(size_t bytes);
+
+    inline size_t get_budget() const
+    {
+        return budget;
+    }
+
+    // Evicted tablets keep their key directory in memory and read their values through the cache
+    inline bool enabled() const
+    {
+        return budget != 0;
+    }
+
+    // Size of all cached blocks
+    size_t size();
+
+    // Reads size bytes at the given offset of a checkpoint file into buffer, returns false on error
+    bool read(const CheckpointFile &file, uint64_t offset, size_t size, std::byte *buffer);
+
+    // Removes all blocks and resets the counters
+    void clear();
+};
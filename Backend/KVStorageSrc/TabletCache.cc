@@ -0,0 +1,130 @@
+#include <algorithm>
+#include "TabletCache.h"
+#include "TabletArray.h"
+
+bool parse_cache_policy(const std::string &name, TabletCachePolicy &policy)
+{
+    if (name == "lru") policy = TabletCachePolicy::LRU;
+    else if (name == "clock") policy = TabletCachePolicy::CLOCK;
+    else if (name == "2q") policy = TabletCachePolicy::TWO_Q;
+    else return false;
+
+    return true;
+}
+
+std::string cache_policy_to_string(TabletCachePolicy policy)
+{
+    switch (policy)
+    {
+    case TabletCachePolicy::LRU:
+        return "lru";
+    case TabletCachePolicy::CLOCK:
+        return "clock";
+    case TabletCachePolicy::TWO_Q:
+        return "2q";
+    default:
+        return "unknown";
+    }
+}
+
+std::unique_ptr<TabletEvictionPolicy> TabletEvictionPolicy::create(TabletCachePolicy policy)
+{
+    switch (policy)
+    {
+    case TabletCachePolicy::CLOCK:
+        return std::make_unique<ClockEvictionPolicy>();
+    case TabletCachePolicy::TWO_Q:
+        return std::make_unique<TwoQueueEvictionPolicy>();
+    default:
+        return std::make_unique<LruEvictionPolicy>();
+    }
+}
+
+// Returns the candidate with the lowest activity counter among those matching the filter
+template <typename Filter>
+static TabletInfo *least_recent(const std::vector<TabletInfo *> &candidates, Filter filter)
+{
+    TabletInfo *oldest{nullptr};
+    for (TabletInfo *tablet : candidates)
+    {
+        if (filter(*tablet) && (!oldest || tablet->in_memory < oldest->in_memory))
+            oldest = tablet;
+    }
+    return oldest;
+}
+
+void LruEvictionPolicy::accessed(TabletInfo &tablet, std::atomic<size_t> &activity_counter)
+{
+    tablet.in_memory = activity_counter++;
+}
+
+TabletInfo *LruEvictionPolicy::victim(const std::vector<TabletInfo *> &candidates)
+{
+    return least_recent(candidates, [](const TabletInfo &) { return true; });
+}
+
+void ClockEvictionPolicy::loaded(TabletInfo &tablet)
+{
+    tablet.referenced = true;
+}
+
+void ClockEvictionPolicy::accessed(TabletInfo &tablet, std::atomic<size_t> &activity_counter)
+{
+    // Only setting the bit keeps the hot path free of writes to a shared counter
+    if (!tablet.referenced.load(std::memory_order_relaxed))
+        tablet.referenced.store(true, std::memory_order_relaxed);
+}
+
+TabletInfo *ClockEvictionPolicy::victim(const std::vector<TabletInfo *> &candidates)
+{
+    if (candidates.empty()) return nullptr;
+
+    // Every tablet passed once has its bit cleared, so the second round always finds a victim
+    for (size_t step{0}; step <= 2 * candidates.size(); ++step)
+    {
+        TabletInfo *tablet{candidates[hand++ % candidates.size()]};
+        if (!tablet->referenced.exchange(false))
+            return tablet;
+    }
+    return candidates[hand++ % candidates.size()];
+}
+
+void TwoQueueEvictionPolicy::loaded(TabletInfo &tablet)
+{
+    // A tablet loaded again shortly after it left probation is used repeatedly
+    auto ghost_it{std::find(ghosts.begin(), ghosts.end(), &tablet)};
+    tablet.referenced = ghost_it != ghosts.end();
+    if (ghost_it != ghosts.end()) ghosts.erase(ghost_it);
+}
+
+void TwoQueueEvictionPolicy::accessed(TabletInfo &tablet, std::atomic<size_t> &activity_counter)
+{
+    // Tablets in probation keep the activity counter of their load, so they are evicted in load order
+    if (!tablet.referenced.load(std::memory_order_relaxed))
+    {
+        tablet.referenced.store(true, std::memory_order_relaxed);
+        return;
+    }
+    tablet.in_memory = activity_counter++;
+}
+
+TabletInfo *TwoQueueEvictionPolicy::victim(const std::vector<TabletInfo *> &candidates)
+{
+    const size_t probation{static_cast<size_t>(std::count_if(candidates.begin(), candidates.end(),
+        [](const TabletInfo *tablet) { return !tablet->referenced; }))};
+
+    // Probation goes first while it is large, or if no tablet has been used repeatedly
+    const bool from_probation{probation > candidates.size() / 4 || probation == candidates.size()};
+    TabletInfo *tablet{least_recent(candidates,
+        [from_probation](const TabletInfo &tablet) { return tablet.referenced != from_probation; })};
+
+    if (tablet && !tablet->referenced)
+    {
+        // Remember about as many evicted tablets as half the tablets in memory
+        ghosts.push_back(tablet);
+        while (ghosts.size() > candidates.size() / 2 + 1)
+            ghosts.pop_front();
+    }
+
+    return tablet;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct TabletInfo;
+
+// Eviction policies of the tablet cache
+enum class TabletCachePolicy
+{
+    // Evicts the tablet that hasn't been used for the longest time
+    LRU,
+    // Second chance: a hand sweeps over the tablets and evicts the first one not used since its last visit
+    CLOCK,
+    // Tablets used once since they were loaded are evicted before tablets used repeatedly,
+    // so a scan over cold tablets does not push out the working set
+    TWO_Q
+};
+
+// Parses a policy name (lru, clock or 2q), returns false if the name is unknown
+bool parse_cache_policy(const std::string &name, TabletCachePolicy &policy);
+// Returns the name of a policy
+std::string cache_policy_to_string(TabletCachePolicy policy);
+
+// Counters of the tablet cache
+struct TabletCacheStats
+{
+    // Operations that found their tablet in memory
+    std::atomic<size_t> hits{0};
+    // Operations that had to load their tablet from disk
+    std::atomic<size_t> misses{0};
+    // Tablets saved to disk and removed from memory
+    std::atomic<size_t> evictions{0};
+};
+
+// Decides which tablet leaves memory once the tablet cache exceeds its memory budget
+// The activity counter of a tablet (TabletInfo::in_memory) is set by the tablet array when it is loaded
+class TabletEvictionPolicy
+{
+public:
+    virtual ~TabletEvictionPolicy() = default;
+
+    // Called once a tablet has been loaded into memory
+    // Requires tablets_mutex and exclusive access to the tablet
+    virtual void loaded(TabletInfo &tablet) {}
+    // Called for every operation that finds its tablet in memory, runs concurrently under a shared tablet lock
+    virtual void accessed(TabletInfo &tablet, std::atomic<size_t> &activity_counter) = 0;
+    // Picks the tablet to evict among the given tablets in memory (ordered by tablet id), nullptr to keep all
+    // Requires tablets_mutex
+    virtual TabletInfo *victim(const std::vector<TabletInfo *> &candidates) = 0;
+
+    // Creates a policy
+    static std::unique_ptr<TabletEvictionPolicy> create(TabletCachePolicy policy);
+};
+
+class LruEvictionPolicy : public TabletEvictionPolicy
+{
+public:
+    void accessed(TabletInfo &tablet, std::atomic<size_t> &activity_counter) override;
+    TabletInfo *victim(const std::vector<TabletInfo *> &candidates) override;
+};
+
+class ClockEvictionPolicy : public TabletEvictionPolicy
+{
+private:
+    // Position of the clock hand in the candidates
+    size_t hand{0};
+
+public:
+    void loaded(TabletInfo &tablet) override;
+    void accessed(TabletInfo &tablet, std::atomic<size_t> &activity_counter) override;
+    TabletInfo *victim(const std::vector<TabletInfo *> &candidates) override;
+};
+
+// Simplified 2Q for whole tablets
+// Tablets start in the probation queue (A1) and are promoted to the main queue (Am) when used again
+// The probation queue is evicted in load order while it holds more than a quarter of the tablets,
+// otherwise the least recently used tablet of the main queue is evicted
+// Tablets evicted from probation are remembered, if they are loaded again soon they go to the main queue directly
+class TwoQueueEvictionPolicy : public TabletEvictionPolicy
+{
+private:
+    // Tablets recently evicted from the probation queue (A1out)
+    std::deque<const TabletInfo *> ghosts;
+
+public:
+    void loaded(TabletInfo &tablet) override;
+    void accessed(TabletInfo &tablet, std::atomic<size_t> &activity_counter) override;
+    TabletInfo *victim(const std::vector<TabletInfo *> &candidates) override;
+};
@@ -0,0 +1,256 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include "TabletLogRecord.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define HAS_HW_CRC32C 1
+#endif
+
+namespace
+{
+    // Lookup table for the reflected Castagnoli polynomial
+    constexpr std::array<uint32_t, 256> make_crc32c_table()
+    {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i{0}; i < 256; ++i)
+        {
+            uint32_t crc{i};
+            for (int bit{0}; bit < 8; ++bit)
+                crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+            table[i] = crc;
+        }
+        return table;
+    }
+    constexpr std::array<uint32_t, 256> crc32c_table{make_crc32c_table()};
+
+    uint32_t crc32c_sw(uint32_t crc, const uint8_t *data, size_t length)
+    {
+        for (size_t i{0}; i < length; ++i)
+            crc = (crc >> 8) ^ crc32c_table[(crc ^ data[i]) & 0xFF];
+        return crc;
+    }
+
+#ifdef HAS_HW_CRC32C
+    __attribute__((target("sse4.2")))
+    uint32_t crc32c_hw(uint32_t crc, const uint8_t *data, size_t length)
+    {
+        uint64_t crc64{crc};
+        for (; length >= 8; data += 8, length -= 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof(word));
+            crc64 = _mm_crc32_u64(crc64, word);
+        }
+        crc = static_cast<uint32_t>(crc64);
+        for (; length > 0; ++data, --length)
+            crc = _mm_crc32_u8(crc, *data);
+        return crc;
+    }
+
+    const bool use_hw_crc32c{__builtin_cpu_supports("sse4.2") != 0};
+#endif
+
+    // Parses an unsigned number from the start of str
+    bool parse_number(std::string_view str, size_t &number)
+    {
+        auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), number);
+        return ec == std::errc{} && ptr == str.data() + str.size();
+    }
+}
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t length)
+{
+    crc = ~crc;
+#ifdef HAS_HW_CRC32C
+    if (use_hw_crc32c)
+        return ~crc32c_hw(crc, static_cast<const uint8_t *>(data), length);
+#endif
+    return ~crc32c_sw(crc, static_cast<const uint8_t *>(data), length);
+}
+
+TabletLogRecord::TabletLogRecord(TabletLoggerCmdType cmd, std::string_view row_key, std::string_view column_key,
+                                 std::string_view payload)
+{
+    TabletLogRecordHeader header{};
+    header.magic = LOG_RECORD_MAGIC;
+    header.format = LOG_RECORD_FORMAT;
+    header.cmd = static_cast<uint8_t>(cmd);
+    header.row_key_size = static_cast<uint32_t>(row_key.size());
+    header.column_key_size = static_cast<uint32_t>(column_key.size());
+    header.payload_size = payload.size();
+
+    // Assemble the record in one allocation
+    record.reserve(sizeof(header) + row_key.size() + column_key.size() + payload.size());
+    record.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    record.append(row_key);
+    record.append(column_key);
+    record.append(payload);
+
+    body_crc = crc32c(0, record.data() + sizeof(header), record.size() - sizeof(header));
+}
+
+std::string TabletLogRecord::seal(size_t version)
+{
+    TabletLogRecordHeader header;
+    std::memcpy(&header, record.data(), sizeof(header));
+    header.version = version;
+    header.crc = crc32c(body_crc, &header, sizeof(header));
+    std::memcpy(record.data(), &header, sizeof(header));
+
+    return std::move(record);
+}
+
+size_t parse_log_record(std::string_view data, TabletLogEntry &entry)
+{
+    if (data.size() < sizeof(TabletLogRecordHeader)) return 0;
+
+    TabletLogRecordHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    if (header.magic != LOG_RECORD_MAGIC || header.format != LOG_RECORD_FORMAT ||
+        header.cmd > static_cast<uint8_t>(TabletLoggerCmdType::SPL))
+    {
+        fprintf(stderr, "Unknown log record format %u or command %u\n", header.format, header.cmd);
+        return 0;
+    }
+
+    const size_t body_size = static_cast<size_t>(header.row_key_size) + header.column_key_size;
+    if (header.payload_size > data.size() - sizeof(header) ||
+        body_size > data.size() - sizeof(header) - header.payload_size)
+        return 0;
+
+    const char *body = data.data() + sizeof(header);
+    const uint32_t stored_crc = header.crc;
+    header.crc = 0;
+    uint32_t crc = crc32c(0, body, body_size + header.payload_size);
+    crc = crc32c(crc, &header, sizeof(header));
+    if (crc != stored_crc)
+    {
+        fprintf(stderr, "Checksum mismatch in log record\n");
+        return 0;
+    }
+
+    entry.cmd = static_cast<TabletLoggerCmdType>(header.cmd);
+    entry.version = header.version;
+    entry.row_key = std::string_view{body, header.row_key_size};
+    entry.column_key = std::string_view{body + header.row_key_size, header.column_key_size};
+    entry.payload = std::string_view{body + body_size, header.payload_size};
+
+    return sizeof(header) + body_size + header.payload_size;
+}
+
+TabletLogReader::TabletLogReader(const fs::path &file)
+{
+    fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (::fstat(fd, &st) < 0 || st.st_size == 0) return;
+
+    void *map = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map log file %s: %s\n", file.c_str(), strerror(errno));
+        return;
+    }
+
+    // The log is read once from front to back
+    ::madvise(map, st.st_size, MADV_SEQUENTIAL);
+    data = static_cast<const char *>(map);
+    length = st.st_size;
+}
+
+TabletLogReader::~TabletLogReader()
+{
+    if (data) ::munmap(const_cast<char *>(data), length);
+    if (fd >= 0) ::close(fd);
+}
+
+bool TabletLogReader::next(TabletLogEntry &entry)
+{
+    if (corrupt || offset >= length) return false;
+
+    entry.offset = offset;
+    bool ok = static_cast<uint8_t>(data[offset]) == LOG_RECORD_MAGIC ? next_binary(entry) : next_text(entry);
+    if (!ok) corrupt = true;
+
+    return ok;
+}
+
+bool TabletLogReader::next_binary(TabletLogEntry &entry)
+{
+    const size_t record_size = parse_log_record(contents(offset), entry);
+    if (record_size == 0) return false;
+
+    offset += record_size;
+    return true;
+}
+
+// Legacy format: <cmd>,<version>,<row>,[<column>,][<size>|<new-column>]\n[<value>\n]
+bool TabletLogReader::next_text(TabletLogEntry &entry)
+{
+    static const size_t cmd_len{3};
+
+    std::string_view rest{data + offset, length - offset};
+    size_t line_end = rest.find('\n');
+    if (line_end == std::string_view::npos) return false;
+    std::string_view line{rest.substr(0, line_end)};
+
+    // Extract command
+    std::string_view cmd_str = line.substr(0, cmd_len);
+    if (cmd_str == "put") entry.cmd = TabletLoggerCmdType::PUT;
+    else if (cmd_str == "mov") entry.cmd = TabletLoggerCmdType::MOV;
+    else if (cmd_str == "del") entry.cmd = TabletLoggerCmdType::DEL;
+    else if (cmd_str == "row") entry.cmd = TabletLoggerCmdType::ROW;
+    else
+    {
+        fprintf(stderr, "Unknown command: %s\n", std::string(cmd_str).c_str());
+        return false;
+    }
+
+    // Split off the comma separated fields following the command
+    auto next_field = [&line](std::string_view &field) {
+        size_t sep = line.find(',');
+        if (sep == std::string_view::npos) return false;
+        line.remove_prefix(sep + 1);
+        sep = line.find(',');
+        field = line.substr(0, sep);
+        return true;
+    };
+
+    std::string_view version_str;
+    if (!next_field(version_str) || !parse_number(version_str, entry.version)) return false;
+    if (!next_field(entry.row_key)) return false;
+
+    entry.column_key = {};
+    entry.payload = {};
+    size_t record_size = line_end + 1;
+    if (entry.cmd != TabletLoggerCmdType::ROW)
+    {
+        std::string_view last;
+        if (!next_field(entry.column_key) || !next_field(last)) return false;
+
+        if (entry.cmd == TabletLoggerCmdType::PUT)
+        {
+            // Value follows the line and is terminated by a newline character
+            size_t value_size;
+            if (!parse_number(last, value_size) || value_size + 1 > rest.size() - record_size) return false;
+            entry.payload = rest.substr(record_size, value_size);
+            record_size += value_size + 1;
+        }
+        else if (entry.cmd == TabletLoggerCmdType::MOV)
+        {
+            // New column key extends to the end of the line
+            entry.payload = line;
+        }
+    }
+
+    offset += record_size;
+    return true;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+enum class TabletLoggerCmdType : uint8_t {
+    PUT,
+    MOV,
+    DEL,
+    ROW,
+    // Split of a tablet at the row key into the tablet index in the payload, only shipped to replicas
+    SPL
+};
+
+// First byte of a binary record, it can never start a record of the legacy text format
+constexpr uint8_t LOG_RECORD_MAGIC{0xC5};
+// Version of the binary record format
+constexpr uint8_t LOG_RECORD_FORMAT{1};
+
+// Fixed-width header in front of every binary record, stored in host byte order
+// It is followed by the row key, the column key and the payload (value for put, new column key for mov)
+// The checksum covers the keys and payload followed by the header with the checksum field set to zero
+struct TabletLogRecordHeader
+{
+    uint8_t magic;
+    uint8_t format;
+    uint8_t cmd;
+    uint8_t reserved;
+    uint32_t crc;
+    uint64_t version;
+    uint32_t row_key_size;
+    uint32_t column_key_size;
+    uint64_t payload_size;
+};
+static_assert(sizeof(TabletLogRecordHeader) == 32, "Log record header must be 32 bytes");
+
+// Computes the CRC32C (Castagnoli) checksum of a buffer, continuing from crc
+uint32_t crc32c(uint32_t crc, const void *data, size_t length);
+
+// Binary log record that is assembled before its version number is known
+// The checksum of the keys and payload is computed up front, so sealing only has to cover the header
+class TabletLogRecord
+{
+private:
+    std::string record;
+    uint32_t body_crc{0};
+
+public:
+    TabletLogRecord(TabletLoggerCmdType cmd, std::string_view row_key, std::string_view column_key = {},
+                    std::string_view payload = {});
+
+    // Stores the version and the final checksum, the record can be appended to the log afterwards
+    std::string seal(size_t version);
+};
+
+// Single record of a log file, keys and payload point into the mapped file
+struct TabletLogEntry
+{
+    TabletLoggerCmdType cmd;
+    size_t version;
+    std::string_view row_key;
+    std::string_view column_key;
+    // Value for put, new column key for mov
+    std::string_view payload;
+    // Byte offset of the record in the file
+    size_t offset;
+};
+
+// Parses the binary record at the start of data, keys and payload of entry point into data
+// Returns the size of the record, or 0 if it is truncated, unknown or fails its checksum
+size_t parse_log_record(std::string_view data, TabletLogEntry &entry);
+
+// Read-only view of a log file mapped into memory
+// Iterates over binary records as well as records in the legacy text format
+class TabletLogReader
+{
+private:
+    int fd{-1};
+    const char *data{nullptr};
+    size_t length{0};
+    size_t offset{0};
+    bool corrupt{false};
+
+    bool next_binary(TabletLogEntry &entry);
+    bool next_text(TabletLogEntry &entry);
+
+public:
+    TabletLogReader(const fs::path &file);
+    ~TabletLogReader();
+
+    TabletLogReader(const TabletLogReader &) = delete;
+    TabletLogReader &operator=(const TabletLogReader &) = delete;
+
+    // Parses the record at the current position
+    // Returns false at the end of the log or if the record is truncated or fails its checksum
+    bool next(TabletLogEntry &entry);
+
+    // Returns true if reading stopped at a truncated or corrupt record
+    inline bool is_corrupt() const
+    {
+        return corrupt;
+    }
+    // Returns the number of bytes of valid records read so far
+    inline size_t position() const
+    {
+        return offset;
+    }
+    // Returns the descriptor of the mapped file, e.g. to send a range of it with sendfile
+    inline int file_descriptor() const
+    {
+        return fd;
+    }
+    // Returns the mapped file contents starting at the given offset
+    inline std::string_view contents(size_t from = 0) const
+    {
+        return from < length ? std::string_view{data + from, length - from} : std::string_view{};
+    }
+};
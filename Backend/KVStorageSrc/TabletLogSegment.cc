@@ -0,0 +1,179 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <climits>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include "TabletLogSegment.h"
+
+TabletLogSegment::TabletLogSegment(const fs::path &file, size_t version)
+    : file(file), pending_future(pending_promise.get_future().share()), durable_version(version), pending_version(version)
+{
+    fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+        fprintf(stderr, "Failed to open log segment %s: %s\n", file.c_str(), strerror(errno));
+    else
+        bytes = durable_bytes = ::lseek(fd, 0, SEEK_END);
+
+    committer = std::thread(&TabletLogSegment::commit_loop, this);
+}
+
+TabletLogSegment::~TabletLogSegment()
+{
+    {
+        std::lock_guard lock{batch_mutex};
+        stop = true;
+    }
+    batch_cv.notify_one();
+    committer.join();
+
+    if (fd >= 0) ::close(fd);
+}
+
+std::shared_future<void> TabletLogSegment::append(std::string record, size_t version)
+{
+    std::shared_future<void> committed;
+    {
+        std::lock_guard lock{batch_mutex};
+        bytes += record.size();
+        pending_version = version;
+        pending_records.push_back(std::move(record));
+        committed = pending_future;
+    }
+    batch_cv.notify_one();
+
+    return committed;
+}
+
+void TabletLogSegment::flush()
+{
+    std::unique_lock lock{batch_mutex};
+    flushed_cv.wait(lock, [this] { return pending_records.empty() && in_flight == 0; });
+}
+
+size_t TabletLogSegment::size()
+{
+    std::lock_guard lock{batch_mutex};
+    return bytes;
+}
+
+bool TabletLogSegment::has_failed()
+{
+    std::lock_guard lock{batch_mutex};
+    return failed;
+}
+
+size_t TabletLogSegment::recover()
+{
+    // Batches queued behind the failed one fail without being written
+    std::unique_lock lock{batch_mutex};
+    flushed_cv.wait(lock, [this] { return pending_records.empty() && in_flight == 0; });
+
+    // A partially written batch would end the log at its torn record on recovery
+    if (fd >= 0 && ::ftruncate(fd, durable_bytes) == 0)
+        failed = false;
+    else
+        fprintf(stderr, "Failed to truncate log segment %s: %s\n", file.c_str(), strerror(errno));
+
+    bytes = durable_bytes;
+    pending_version = durable_version;
+    return durable_version;
+}
+
+void TabletLogSegment::commit_loop()
+{
+    std::unique_lock lock{batch_mutex};
+    while (true)
+    {
+        batch_cv.wait(lock, [this] { return stop || !pending_records.empty(); });
+
+        // Only exit once every queued record has been committed
+        if (pending_records.empty()) return;
+
+        // Take the whole batch, writers arriving from now on join the next one
+        std::vector<std::string> records;
+        records.swap(pending_records);
+        std::promise<void> committed{std::move(pending_promise)};
+        pending_promise = std::promise<void>{};
+        pending_future = pending_promise.get_future().share();
+        const size_t batch_version{pending_version};
+        size_t batch_bytes{0};
+        for (const auto &record : records)
+            batch_bytes += record.size();
+        // Records behind a failed commit would leave a gap in the versions, they fail as well
+        const bool write{!failed};
+        ++in_flight;
+
+        lock.unlock();
+        const bool durable{write && commit(records)};
+        lock.lock();
+
+        if (durable)
+        {
+            durable_bytes += batch_bytes;
+            durable_version = batch_version;
+            committed.set_value();
+        }
+        else
+        {
+            failed = true;
+            bytes -= batch_bytes;
+            committed.set_exception(std::make_exception_ptr(std::runtime_error("Failed to commit log segment " + file.string())));
+        }
+        --in_flight;
+        flushed_cv.notify_all();
+    }
+}
+
+bool TabletLogSegment::commit(std::vector<std::string> &records)
+{
+    if (fd < 0) return false;
+
+    std::vector<struct iovec> iov;
+    iov.reserve(records.size());
+    for (auto &record : records)
+        iov.push_back({record.data(), record.size()});
+
+    size_t idx{0};
+    while (idx < iov.size())
+    {
+        const int count = static_cast<int>(std::min<size_t>(iov.size() - idx, IOV_MAX));
+        ssize_t written = ::writev(fd, &iov[idx], count);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Failed to write log segment %s: %s\n", file.c_str(), strerror(errno));
+            return false;
+        }
+
+        // Skip fully written records and continue inside a partially written one
+        while (written > 0)
+        {
+            if (static_cast<size_t>(written) >= iov[idx].iov_len)
+            {
+                written -= iov[idx].iov_len;
+                ++idx;
+            }
+            else
+            {
+                iov[idx].iov_base = static_cast<char *>(iov[idx].iov_base) + written;
+                iov[idx].iov_len -= written;
+                written = 0;
+            }
+        }
+    }
+
+#ifdef __APPLE__
+    const int sync_result = ::fsync(fd);
+#else
+    const int sync_result = ::fdatasync(fd);
+#endif
+    if (sync_result < 0)
+    {
+        fprintf(stderr, "Failed to sync log segment %s: %s\n", file.c_str(), strerror(errno));
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <condition_variable>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Append-only log file of a tablet that is kept open between writes
+// Records of concurrent writers are collected by a background thread and
+// committed together with a single write and sync (group commit)
+class TabletLogSegment
+{
+private:
+    // File descriptor of the open segment
+    int fd{-1};
+    // Path of the segment file
+    const fs::path file;
+
+    // Protects the pending batch and the stop flag
+    std::mutex batch_mutex;
+    // Signals the commit thread that records are pending or that it should stop
+    std::condition_variable batch_cv;
+    // Records waiting for the next group commit
+    std::vector<std::string> pending_records;
+    // Promise fulfilled once the pending records are durable
+    std::promise<void> pending_promise;
+    // Future handed out to all writers of the pending batch
+    std::shared_future<void> pending_future;
+    // Number of batches handed to the commit thread that are not yet durable
+    size_t in_flight{0};
+    // Signals writers waiting in flush() that a batch has been committed
+    std::condition_variable flushed_cv;
+    // Set when the segment is closed
+    bool stop{false};
+    // Number of bytes in the segment
+    size_t bytes{0};
+    // Number of bytes and version of the records that are durable
+    size_t durable_bytes{0};
+    size_t durable_version{0};
+    // Version of the last pending record
+    size_t pending_version{0};
+    // Set when a commit failed, later batches fail as well until the segment is recovered
+    bool failed{false};
+
+    // Background thread committing batches to disk
+    std::thread committer;
+
+    // Loop of the commit thread
+    void commit_loop();
+    // Writes a batch of records to the segment file and syncs it
+    bool commit(std::vector<std::string> &records);
+
+public:
+    // Opens (or creates) the segment file for appending and starts the commit thread
+    // The version is the one of the last record already in the file
+    TabletLogSegment(const fs::path &file, size_t version);
+    // Commits all pending records and closes the file
+    ~TabletLogSegment();
+
+    TabletLogSegment(const TabletLogSegment &) = delete;
+    TabletLogSegment &operator=(const TabletLogSegment &) = delete;
+
+    // Queues a record with the given version for the next group commit
+    // The returned future becomes ready once the record is durable, or holds an error if the commit failed
+    std::shared_future<void> append(std::string record, size_t version);
+
+    // Returns true if a commit failed and the records after the last durable one were dropped
+    bool has_failed();
+    // Truncates the records of failed commits from the file so appending can go on
+    // Returns the version of the last durable record, the segment stays failed if the file cannot be truncated
+    size_t recover();
+
+    // Blocks until all queued records are durable
+    void flush();
+
+    // Returns the number of bytes appended to the segment so far
+    size_t size();
+
+    inline const fs::path &path() const
+    {
+        return file;
+    }
+};
@@ -1,5 +1,4 @@
 #include <string>
-#include <fstream>
 #include <string_view>
 #include <filesystem>
 #include "TabletLogger.h"
@@ -8,179 +7,232 @@
 #include "Globals.h"
 
 TabletLogger::TabletLogger(size_t tablet_id, size_t version, size_t last_checkpoint)
-    : version(version), last_checkpoint(last_checkpoint), file_prefix(std::to_string(SERVER_ID) + "_" + std::to_string(tablet_id) + "_")
+    : version(version), last_checkpoint(last_checkpoint), file_prefix(std::to_string(SERVER_ID) + "_" + std::to_string(tablet_id) + "_"),
+      segment_start(version)
 {}
 
 void TabletLogger::load(const fs::path &path, const std::list<TabletInfo>::iterator &tablet_it, size_t max_version)
 {
-    static const size_t cmd_len{3};
-    std::ifstream ifs_log{path / (file_prefix + std::to_string(max_version) + ".log.tblt"), std::ios::binary};
-
-    std::string line;
-    while (std::getline(ifs_log, line))
+    const fs::path log_file{path / (file_prefix + std::to_string(max_version) + ".log.tblt")};
+    size_t valid_length{0};
+    bool corrupt{false};
     {
-        // Extract command
-        std::string_view cmd_str = std::string_view(line).substr(0, cmd_len);
-
-        TabletLoggerCmdType cmd;
-        if (cmd_str == "put") cmd = TabletLoggerCmdType::PUT;
-        else if (cmd_str == "mov") cmd = TabletLoggerCmdType::MOV;
-        else if (cmd_str == "del") cmd = TabletLoggerCmdType::DEL;
-        else if (cmd_str == "row") cmd = TabletLoggerCmdType::ROW;
-        else
+        // Records are applied straight from the mapped file
+        TabletLogReader reader{log_file};
+        TabletLogEntry entry;
+        while (reader.next(entry))
         {
-            fprintf(stderr, "Unknown command: %s\n", std::string(cmd_str).c_str());
-            return;
+            if (entry.version > this->version + 1)
+            {
+                fprintf(stderr, "Missing entries in log: local version %zu << log version %zu\n", this->version, entry.version);
+                break;
+            }
+            if (entry.version <= this->version) continue;
+
+            ++this->version;
+            apply(entry, *tablet_it);
         }
+        valid_length = reader.position();
+        corrupt = reader.is_corrupt();
+    }
 
-        size_t sep_version = line.find(",", cmd_len + 1) + 1;
-        size_t log_version = std::stoul(line.substr(cmd_len + 1, sep_version - cmd_len));
+    // A torn or corrupt record ends the log, records appended behind it would never be replayed
+    if (corrupt)
+    {
+        fprintf(stderr, "Truncating log %s to %zu bytes after invalid record\n", log_file.c_str(), valid_length);
+        fs::resize_file(log_file, valid_length);
+    }
 
-        if (log_version > this->version + 1)
-        {
-            fprintf(stderr, "Missing entries in log: local version %zu << log version %zu\n", this->version, log_version);
-            return;
-        }
+    // Log segments are named after the checkpoint they follow, so only older files named after their last version can fall short
+    if (this->version < max_version)
+    {
+        fprintf(stderr, "Missing entries in log: local version %zu << log version %zu\n", this->version, max_version);
+    }
 
-        size_t sep_row_key = line.find(",", sep_version) + 1;
-        std::string row_key = line.substr(sep_version, sep_row_key - sep_version - 1);
+    // Continue appending to the replayed segment
+    std::lock_guard lock{log_mutex};
+    segment_start = max_version;
+    segment_starts.insert(max_version);
+}
 
-        size_t sep_column_key;
-        std::string column_key;
-        if (cmd != TabletLoggerCmdType::ROW)
+void TabletLogger::apply(const TabletLogEntry &entry, TabletInfo &tablet_info)
+{
+    switch (entry.cmd)
+    {
+        case TabletLoggerCmdType::PUT:
         {
-            sep_column_key = line.find(",", sep_row_key) + 1;
-            column_key = line.substr(sep_row_key, sep_column_key - sep_row_key - 1);
+            // Copy value out of the log
+            tablet_value value(reinterpret_cast<const std::byte *>(entry.payload.data()),
+                               reinterpret_cast<const std::byte *>(entry.payload.data() + entry.payload.size()));
+
+            // Write value to tablet
+            tablet_info.tablet.write(std::string{entry.row_key}, std::string{entry.column_key}, value);
+            tablet_info.size += entry.payload.size();
+            break;
         }
-
-        switch (cmd)
+        case TabletLoggerCmdType::MOV:
         {
-            case TabletLoggerCmdType::PUT:
-            {
-                // Extract size of value
-                size_t value_size{std::stoul(line.substr(sep_column_key))};
-
-                if (log_version <= this->version)
-                {
-                    ifs_log.ignore(value_size + 1);
-                    continue;
-                }
-
-                ++this->version;
-                // Allocate memory for value
-                tablet_value value;
-                value.resize(value_size);
-
-                // Read value from log
-                ifs_log.read(reinterpret_cast<char *>(value.data()), value_size);
-                // Skip newline character
-                ifs_log.ignore(1);
-
-                // Write value to tablet
-                tablet_it->tablet.write(row_key, column_key, value);
-                tablet_it->size += value_size;
-                break;
-            }
-            case TabletLoggerCmdType::MOV:
-            {
-                if (log_version <= this->version) continue;
+            tablet_info.tablet.move(std::string{entry.row_key}, std::string{entry.column_key}, std::string{entry.payload});
+            break;
+        }
+        case TabletLoggerCmdType::DEL:
+        {
+            size_t value_size{0};
+            tablet_info.tablet.remove(std::string{entry.row_key}, std::string{entry.column_key}, value_size);
+            tablet_info.size -= value_size;
+            break;
+        }
+        case TabletLoggerCmdType::ROW:
+        {
+            tablet_info.tablet.create_row(std::string{entry.row_key});
+            break;
+        }
+        case TabletLoggerCmdType::SPL:
+            // Splits are not logged by tablets
+            break;
+    }
+}
 
-                ++this->version;
-                std::string new_column_key = line.substr(sep_column_key);
-                tablet_it->tablet.move(row_key, column_key, new_column_key);
-                break;
-            }
-            case TabletLoggerCmdType::DEL:
-            {
-                if (log_version <= this->version) continue;
+bool TabletLogger::wait_durable(const std::shared_future<void> &committed)
+{
+    try
+    {
+        committed.get();
+        return true;
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+}
 
-                ++this->version;
-                size_t value_size{0};
-                tablet_it->tablet.remove(row_key, column_key, value_size);
-                tablet_it->size -= value_size;
-                break;
-            }
-            case TabletLoggerCmdType::ROW:
-            {
-                if (log_version <= this->version) continue;
+std::shared_future<void> TabletLogger::append(const fs::path &path, TabletLogRecord &record)
+{
+    std::lock_guard lock{log_mutex};
 
-                ++this->version;
-                tablet_it->tablet.create_row(row_key);
-                break;
-            }
-        }
+    // Open the current segment, it stays open until the next rotation or checkpoint
+    if (!segment)
+    {
+        segment = std::make_unique<TabletLogSegment>(segment_path(path, segment_start), version);
+        segment_starts.insert(segment_start);
+    }
+    else if (segment->has_failed())
+    {
+        // The records after the last durable one were not applied, their versions are handed out again
+        version = segment->recover();
     }
 
-    if (this->version != max_version)
+    if (DEBUG) printf("Writing to log file: %s\n", segment->path().c_str());
+
     {
-        fprintf(stderr, "Missing entries in log: local version %zu << log version %zu\n", this->version, max_version);
+        std::lock_guard apply_lock{apply_mutex};
+        ++unapplied;
     }
+
+    ++version;
+    return segment->append(record.seal(version), version);
 }
 
-void TabletLogger::log_write(const fs::path &path, const std::string &row_key, const std::string &column_key, const tablet_value &value)
+void TabletLogger::flush()
 {
-    const fs::path old_file{path / (file_prefix + std::to_string(version) + ".log.tblt")};
-    const fs::path new_file{path / (file_prefix + std::to_string(version + 1) + ".log.tblt")};
-    std::ofstream ofs_log{old_file, std::ios::app | std::ios::binary};
+    std::lock_guard lock{log_mutex};
+    if (segment) segment->flush();
+}
 
-    if (DEBUG) printf("Writing to log file: %s\n", (old_file.string() + " -> " + new_file.string()).c_str());
+std::vector<fs::path> TabletLogger::segment_files(const fs::path &path) const
+{
+    std::lock_guard lock{log_mutex};
+    std::vector<fs::path> files;
+    for (size_t start : segment_starts)
+        files.push_back(segment_path(path, start));
 
-    // Write command to log
-    ++version;
-    ofs_log << "put," << version << "," << row_key << "," << column_key << "," << value.size() << "\n";
-    // Write value to log
-    ofs_log.write(reinterpret_cast<const char *>(value.data()), value.size());
-    // Write newline character
-    ofs_log << "\n";
-    ofs_log.close();
-
-    fs::rename(old_file, new_file);
+    return files;
+}
+
+void TabletLogger::applied()
+{
+    std::lock_guard lock{apply_mutex};
+    if (--unapplied == 0) apply_cv.notify_all();
 }
 
-void TabletLogger::log_move(const fs::path &path, const std::string &row_key, const std::string &column_key, const std::string &new_column_key)
+size_t TabletLogger::rotate(Tablet &tablet)
 {
-    const fs::path old_file{path / (file_prefix + std::to_string(version) + ".log.tblt")};
-    const fs::path new_file{path / (file_prefix + std::to_string(version + 1) + ".log.tblt")};
-    std::ofstream ofs_log{old_file, std::ios::app | std::ios::binary};
+    std::lock_guard lock{log_mutex};
+    {
+        // Records that are logged but not yet applied would be missing in the snapshot
+        std::unique_lock apply_lock{apply_mutex};
+        apply_cv.wait(apply_lock, [this] { return unapplied == 0; });
+    }
 
-    if (DEBUG) printf("Writing to log file: %s\n", (old_file.string() + " -> " + new_file.string()).c_str());
+    // Versions of records whose commit failed are not part of the snapshot
+    if (segment && segment->has_failed())
+        version = segment->recover();
 
-    // Write command to log
-    ++version;
-    ofs_log << "mov," << version << "," << row_key << "," << column_key << "," << new_column_key << "\n";
-    ofs_log.close();
-    
-    fs::rename(old_file, new_file);
+    // Only the cut is made while writers are blocked, the rows are copied afterwards
+    tablet.begin_snapshot();
+    if (segment_start != version)
+    {
+        // Commit outstanding records, the next record opens a new segment
+        segment.reset();
+        segment_start = version;
+    }
+
+    return version;
 }
 
-void TabletLogger::log_remove(const fs::path &path, const std::string &row_key, const std::string &column_key)
+bool TabletLogger::record_checkpoint(const fs::path &path, size_t checkpoint, size_t &old_checkpoint)
 {
-    const fs::path old_file{path / (file_prefix + std::to_string(version) + ".log.tblt")};
-    const fs::path new_file{path / (file_prefix + std::to_string(version + 1) + ".log.tblt")};
-    std::ofstream ofs_log{old_file, std::ios::app | std::ios::binary};
+    std::lock_guard lock{log_mutex};
+    if (checkpoint <= last_checkpoint) return false;
 
-    if (DEBUG) printf("Writing to log file: %s\n", (old_file.string() + " -> " + new_file.string()).c_str());
+    old_checkpoint = last_checkpoint;
+    last_checkpoint = checkpoint;
 
-    // Write command to log
-    ++version;
-    ofs_log << "del," << version << "," << row_key << "," << column_key << ",\n";
-    ofs_log.close();
-    
-    fs::rename(old_file, new_file);
+    // Checkpoint taken without rotation, the open segment is covered as well
+    if (segment_start < checkpoint)
+    {
+        segment.reset();
+        segment_start = checkpoint;
+    }
+
+    // Segments before the checkpoint only hold records up to it
+    while (!segment_starts.empty() && *segment_starts.begin() < checkpoint)
+    {
+        fs::remove(segment_path(path, *segment_starts.begin()));
+        segment_starts.erase(segment_starts.begin());
+    }
+
+    return true;
+}
+
+std::shared_future<void> TabletLogger::log_write(const fs::path &path, const std::string &row_key, const std::string &column_key, const tablet_value &value)
+{
+    // Records are assembled before taking the lock, only the version is filled in afterwards
+    TabletLogRecord record{TabletLoggerCmdType::PUT, row_key, column_key,
+                           std::string_view{reinterpret_cast<const char *>(value.data()), value.size()}};
+    return append(path, record);
 }
 
-void TabletLogger::log_create_row(const fs::path &path, const std::string &row_key)
+std::shared_future<void> TabletLogger::log_move(const fs::path &path, const std::string &row_key, const std::string &column_key, const std::string &new_column_key)
 {
-    const fs::path old_file{path / (file_prefix + std::to_string(version) + ".log.tblt")};
-    const fs::path new_file{path / (file_prefix + std::to_string(version + 1) + ".log.tblt")};
-    std::ofstream ofs_log{old_file, std::ios::app | std::ios::binary};
+    TabletLogRecord record{TabletLoggerCmdType::MOV, row_key, column_key, new_column_key};
+    return append(path, record);
+}
 
-    if (DEBUG) printf("Writing to log file: %s\n", (old_file.string() + " -> " + new_file.string()).c_str());
+std::shared_future<void> TabletLogger::log_remove(const fs::path &path, const std::string &row_key, const std::string &column_key)
+{
+    TabletLogRecord record{TabletLoggerCmdType::DEL, row_key, column_key};
+    return append(path, record);
+}
 
-    // Write command to log
-    ++version;
-    ofs_log << "row," << version << "," << row_key << ",\n";
-    ofs_log.close();
-    
-    fs::rename(old_file, new_file);
-}
\ No newline at end of file
+std::shared_future<void> TabletLogger::log_create_row(const fs::path &path, const std::string &row_key)
+{
+    TabletLogRecord record{TabletLoggerCmdType::ROW, row_key};
+    return append(path, record);
+}
+
+std::shared_future<void> TabletLogger::log_entry(const fs::path &path, const TabletLogEntry &entry)
+{
+    TabletLogRecord record{entry.cmd, entry.row_key, entry.column_key, entry.payload};
+    return append(path, record);
+}
@@ -1,18 +1,19 @@
 #pragma once
 
 #include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+#include <vector>
 #include "TabletArray.h"
 #include "Tablet.h"
+#include "TabletLogSegment.h"
+#include "TabletLogRecord.h"
 
 namespace fs = std::filesystem;
 
-enum class TabletLoggerCmdType {
-    PUT,
-    MOV,
-    DEL,
-    ROW
-};
-
 class TabletInfo;
 
 class TabletLogger {
@@ -23,36 +24,111 @@ private:
     size_t last_checkpoint{0};
     // Convenience variable to get the file prefix for a tablet
     const std::string file_prefix;
+    // Version after which the open log segment starts, the segment file is named after it
+    size_t segment_start{0};
+    // Start versions of all log segments on disk, the last one is the open segment
+    std::set<size_t> segment_starts;
+    // Open log segment
+    std::unique_ptr<TabletLogSegment> segment;
+    // Serializes version numbers and the order of records in the segment
+    mutable std::mutex log_mutex;
+    // Number of logged records that have not been applied to the tablet yet
+    size_t unapplied{0};
+    // Protects the number of unapplied records
+    std::mutex apply_mutex;
+    // Signals that all logged records have been applied
+    std::condition_variable apply_cv;
+
+    // Assigns the next version to a record and queues it in the segment (opened on first use)
+    std::shared_future<void> append(const fs::path &path, TabletLogRecord &record);
+
+    inline fs::path segment_path(const fs::path &path, size_t start) const
+    {
+        return path / (file_prefix + std::to_string(start) + ".log.tblt");
+    }
 
 public:
     // Constructor setting the tablet id, current version and last checkpoint
     TabletLogger(size_t tablet_id, size_t version = 0, size_t last_checkpoint = 0);
-    // Apply a log file to the given tablet
-    void load(const fs::path &path, const std::list<TabletInfo>::iterator &tablet_it, size_t version);
+    // Apply a log segment to the given tablet, later records are appended to the last loaded segment
+    void load(const fs::path &path, const std::list<TabletInfo>::iterator &tablet_it, size_t segment_version);
+    // Apply a single log record to the given tablet
+    static void apply(const TabletLogEntry &entry, TabletInfo &tablet_info);
+    // Waits until a logged record is durable, returns false if its commit failed
+    static bool wait_durable(const std::shared_future<void> &committed);
+
+    // Paths of all log segments holding records after the last checkpoint, in order
+    std::vector<fs::path> segment_files(const fs::path &path) const;
+    // Calls apply for each record in the log segments with a version after the given one, in order
+    // Reading stops at a record that is still being written, returns the number of records passed to apply
+    template <typename Apply>
+    size_t replay(const fs::path &path, size_t &after_version, Apply apply) const
+    {
+        size_t records{0};
+        for (const fs::path &segment_file : segment_files(path))
+        {
+            TabletLogReader reader{segment_file};
+            TabletLogEntry entry;
+            while (reader.next(entry))
+            {
+                if (entry.version <= after_version) continue;
+                after_version = entry.version;
+                ++records;
+                apply(entry);
+            }
+        }
+        return records;
+    }
 
     inline size_t get_version() const
     {
+        std::lock_guard lock{log_mutex};
         return version;
     }
     inline size_t get_last_checkpoint() const
     {
+        std::lock_guard lock{log_mutex};
         return last_checkpoint;
     }
-    inline void record_checkpoint()
+    // Number of versions logged to the open segment
+    inline size_t get_segment_versions() const
+    {
+        std::lock_guard lock{log_mutex};
+        return version - segment_start;
+    }
+    // Number of bytes logged to the open segment
+    inline size_t get_segment_bytes() const
     {
-        last_checkpoint = version;
+        std::lock_guard lock{log_mutex};
+        return segment ? segment->size() : 0;
     }
+
+    // Marks a logged record as applied to the tablet, must follow every log operation
+    void applied();
+    // Starts a snapshot of the tablet once all logged records are applied, new records are blocked only meanwhile
+    // Later records go to a new segment, returns the version of the snapshot
+    size_t rotate(Tablet &tablet);
+    // Saves a checkpoint written at the given version and removes the log segments it covers
+    // Returns false if a newer checkpoint has been recorded in the meantime, otherwise old_checkpoint is set to the replaced one
+    bool record_checkpoint(const fs::path &path, size_t checkpoint, size_t &old_checkpoint);
     inline void log_noop()
     {
+        std::lock_guard lock{log_mutex};
         ++version;
     }
 
+    // Blocks until all logged records are durable
+    void flush();
+
+    // Each log operation returns a future that becomes ready once the record is durable
     // Log a write operation (conditional write is not needed, because it will result in a noop or write operation, that can be logged)
-    void log_write(const fs::path &path, const std::string &row_key, const std::string &column_key, const tablet_value &value);
+    std::shared_future<void> log_write(const fs::path &path, const std::string &row_key, const std::string &column_key, const tablet_value &value);
     // Log a move operation
-    void log_move(const fs::path &path, const std::string &row_key, const std::string &column_key, const std::string &new_column_key);
+    std::shared_future<void> log_move(const fs::path &path, const std::string &row_key, const std::string &column_key, const std::string &new_column_key);
     // Log a delete operation
-    void log_remove(const fs::path &path, const std::string &row_key, const std::string &column_key);
+    std::shared_future<void> log_remove(const fs::path &path, const std::string &row_key, const std::string &column_key);
     // Log a create row operation
-    void log_create_row(const fs::path &path, const std::string &row_key);
-};
\ No newline at end of file
+    std::shared_future<void> log_create_row(const fs::path &path, const std::string &row_key);
+    // Log a record read from the log of another tablet (records move along with their rows when a tablet is split)
+    std::shared_future<void> log_entry(const fs::path &path, const TabletLogEntry &entry);
+};
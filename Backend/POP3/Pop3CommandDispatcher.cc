@@ -312,18 +312,13 @@ Command<Pop3ServerCommand> Pop3CommandDispatcher::parse_message(const std::strin
 int Pop3CommandDispatcher::get_email_infos()
 {
 
-    std::set<std::string> email_ids;
-    tablet_value email_data;
+    // The sizes of all emails are listed with the mailbox, the emails are only read by RETR
+    std::map<std::string, ValueInfo> emails;
     IStorageService storage(COORDINATOR_SERVICE->get_kv_servers_map());
-    if (storage.list_columns(user_to_row(user_name) + "-MAILBOX", email_ids)) return 1;
+    if (storage.list_columns(user_to_row(user_name) + "-MAILBOX", emails)) return 1;
 
-    for (auto &email_id : email_ids)
-    {
-        if (storage.get(user_to_row(user_name) + "-MAILBOX", email_id, email_data))
-            return 1;
-
-        email_infos.push_back({email_data.size(), false, email_id});
-    }
+    for (auto &[email_id, info] : emails)
+        email_infos.push_back({info.size, false, email_id});
 
     return 0;
 }
\ No newline at end of file
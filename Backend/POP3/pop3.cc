@@ -39,10 +39,6 @@ int main(int argc, char *argv[])
     sa.sa_flags = 0; // Ensures SA_RESTART is not set, system calls should return EINTR
     sigaction(SIGINT, &sa, NULL);
 
-    // Setup SIGUSR1 handler for worker threads
-    sa.sa_handler = Server::sigusr1_handler;
-    sigaction(SIGUSR1, &sa, NULL);
-
     /* Step 3: Start the server */
     Server server = Server();
     server.startServer(config);
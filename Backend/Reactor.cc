@@ -0,0 +1,277 @@
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include "Reactor.h"
+#include "Globals.h"
+
+using namespace std;
+
+namespace
+{
+    // Maximum number of events handled per epoll_wait
+    constexpr int MAX_EVENTS{256};
+
+    // Block all signals, only the main thread handles SIGINT
+    void block_signals()
+    {
+        sigset_t sigset;
+        sigfillset(&sigset);
+        pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+    }
+}
+
+Reactor::Reactor(ServerType server_type, size_t worker_count) : server_type_(server_type)
+{
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    resume_event_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = resume_event_fd_;
+    if (epoll_fd_ == -1 || resume_event_fd_ == -1 || epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, resume_event_fd_, &event) == -1)
+    {
+        fprintf(stderr, "Reactor: Failed to create epoll instance or eventfd (%s)\n", strerror(errno));
+        exit(1);
+    }
+
+    std::thread(&Reactor::event_loop_, this).detach();
+    for (size_t i = 0; i < worker_count; ++i)
+        std::thread(&Reactor::worker_loop_, this).detach();
+}
+
+void Reactor::add_connection(int socket_fd)
+{
+    auto handler = std::make_shared<ClientHandler>(socket_fd, server_type_);
+    handler->welcome();
+
+    {
+        lock_guard lock(connections_mutex_);
+        connections_[socket_fd] = handler;
+    }
+
+    if (!watch_(socket_fd))
+        close_connection_(handler);
+}
+
+bool Reactor::watch_(int socket_fd)
+{
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.fd = socket_fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, socket_fd, &event) == -1)
+    {
+        fprintf(stderr, "[%d] Reactor: Failed to watch socket (%s)\n", socket_fd, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void Reactor::watch_resumed_()
+{
+    eventfd_t value;
+    eventfd_read(resume_event_fd_, &value);
+
+    std::vector<std::shared_ptr<ClientHandler>> resumed;
+    {
+        lock_guard lock(resumed_mutex_);
+        resumed.swap(resumed_);
+    }
+
+    // A connection closed meanwhile is not in the map anymore and its socket number may belong to a new client
+    lock_guard lock(connections_mutex_);
+    for (const auto &handler : resumed)
+    {
+        auto it = connections_.find(handler->socket_fd);
+        if (it != connections_.end() && it->second == handler)
+            watch_(handler->socket_fd);
+    }
+}
+
+void Reactor::event_loop_()
+{
+    block_signals();
+
+    epoll_event events[MAX_EVENTS];
+    while (true)
+    {
+        int event_count = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+        if (event_count == -1)
+        {
+            if (errno != EINTR)
+                fprintf(stderr, "Reactor: epoll_wait failed (%s)\n", strerror(errno));
+            continue;
+        }
+
+        for (int i = 0; i < event_count; ++i)
+        {
+            int socket_fd = events[i].data.fd;
+            if (socket_fd == resume_event_fd_)
+            {
+                watch_resumed_();
+                continue;
+            }
+
+            std::shared_ptr<ClientHandler> handler;
+            {
+                lock_guard lock(connections_mutex_);
+                auto it = connections_.find(socket_fd);
+                if (it == connections_.end())
+                    continue;
+                handler = it->second;
+            }
+
+            // Stop watching the socket once the client is gone, TQUIT is queued as its last message
+            // or while its queue is full, a worker hands it back once it made room
+            if (!handler->read_messages() || handler->pause_reading())
+                epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, socket_fd, nullptr);
+
+            if (!handler->message_queue.empty())
+                schedule_(handler);
+        }
+    }
+}
+
+void Reactor::worker_loop_()
+{
+    block_signals();
+
+    while (true)
+    {
+        std::shared_ptr<ClientHandler> handler;
+        TaggedRequest request;
+        bool is_request = false;
+        {
+            unique_lock lock(ready_mutex_);
+            ready_cv_.wait(lock, [this]() { return !ready_.empty() || !requests_.empty(); });
+            if (!requests_.empty())
+            {
+                handler = std::move(requests_.front().first);
+                request = std::move(requests_.front().second);
+                requests_.pop_front();
+                is_request = true;
+            }
+            else
+            {
+                handler = std::move(ready_.front());
+                ready_.pop_front();
+            }
+        }
+
+        if (is_request)
+            execute_request_(handler, request);
+        else
+            process_connection_(handler);
+    }
+}
+
+void Reactor::process_connection_(const std::shared_ptr<ClientHandler> &handler)
+{
+    std::vector<TaggedRequest> requests;
+    while (true)
+    {
+        bool open = handler->process_messages(requests);
+        if (!requests.empty())
+        {
+            {
+                lock_guard lock(ready_mutex_);
+                for (TaggedRequest &request : requests)
+                    requests_.emplace_back(handler, std::move(request));
+            }
+            if (requests.size() == 1)
+                ready_cv_.notify_one();
+            else
+                ready_cv_.notify_all();
+            requests.clear();
+        }
+
+        if (!open)
+        {
+            // The connection stays scheduled, so no other worker picks it up again
+            // Tagged requests still in flight close it once the last one was answered
+            if (handler->stop_processing())
+                close_connection_(handler);
+            return;
+        }
+
+        // The socket is watched by the event thread only, so it cannot be added back before it was removed
+        if (handler->resume_reading())
+        {
+            {
+                lock_guard lock(resumed_mutex_);
+                resumed_.push_back(handler);
+            }
+            eventfd_write(resume_event_fd_, 1);
+        }
+
+        // A message may have been queued after the queue was found empty
+        // A throttled connection is scheduled again once one of its tagged requests was answered
+        handler->scheduled = false;
+        if (handler->message_queue.empty() || handler->throttled() || handler->scheduled.exchange(true))
+            return;
+    }
+}
+
+void Reactor::execute_request_(const std::shared_ptr<ClientHandler> &handler, TaggedRequest &request)
+{
+    if (!handler->execute_request(request))
+    {
+        close_connection_(handler);
+        return;
+    }
+
+    // Frames left in the queue while the connection was throttled
+    if (!handler->message_queue.empty())
+        schedule_(handler);
+}
+
+void Reactor::schedule_(const std::shared_ptr<ClientHandler> &handler)
+{
+    if (handler->scheduled.exchange(true))
+        return;
+
+    {
+        lock_guard lock(ready_mutex_);
+        ready_.push_back(handler);
+    }
+    ready_cv_.notify_one();
+}
+
+void Reactor::close_connection_(const std::shared_ptr<ClientHandler> &handler)
+{
+    int socket_fd = handler->socket_fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, socket_fd, nullptr);
+    {
+        lock_guard lock(connections_mutex_);
+        connections_.erase(socket_fd);
+    }
+    handler->closeClient();
+    connections_cv_.notify_all();
+}
+
+void Reactor::close_connections()
+{
+    std::vector<std::shared_ptr<ClientHandler>> handlers;
+    {
+        lock_guard lock(connections_mutex_);
+        for (const auto &pair : connections_)
+            handlers.push_back(pair.second);
+    }
+
+    // The event thread reads EOF from each socket and the workers close the connections
+    for (const auto &handler : handlers)
+        handler->shutdown_socket();
+
+    unique_lock lock(connections_mutex_);
+    connections_cv_.wait(lock, [this]() { return connections_.empty(); });
+}
+
+void Reactor::shutdown_connections(const string &message)
+{
+    lock_guard lock(connections_mutex_);
+    for (const auto &pair : connections_)
+        pair.second->shutdown_socket(message);
+}
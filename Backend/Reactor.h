@@ -0,0 +1,76 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "ClientHandler.h"
+#include "ServerConfig.h"
+
+// Number of worker threads dispatching client messages
+// Dispatchers block on remote writes and storage requests, so there are more workers than cores
+constexpr size_t REACTOR_WORKER_THREADS{64};
+
+/*
+ * Drives all client connections of a server with one epoll thread and a fixed pool of worker threads
+ * The epoll thread reads from the sockets and queues complete messages on their ClientHandler. A worker
+ * dispatches the messages of one connection at a time and in order, so dispatchers keep their per-connection
+ * state without a thread per connection. A connection whose queue is full is not read until a worker made room.
+ * Tagged requests of a connection are executed by any worker, concurrently with its other requests.
+ */
+class Reactor
+{
+public:
+    Reactor(ServerType server_type, size_t worker_count = REACTOR_WORKER_THREADS);
+    ~Reactor() = default;
+
+    // Sends the welcome message to a new client and starts reading from its socket
+    void add_connection(int socket_fd);
+    // Shuts down all client connections and waits until the workers have closed them
+    void close_connections();
+    // Sends message to all clients and shuts down their sockets without waiting (used on SIGINT)
+    void shutdown_connections(const string &message);
+
+private:
+    ServerType server_type_;
+    int epoll_fd_{-1};
+
+    // Open connections by socket, a socket is removed before it is closed so its number cannot be reused meanwhile
+    std::mutex connections_mutex_;
+    std::unordered_map<int, std::shared_ptr<ClientHandler>> connections_;
+    // Notified when a connection is closed
+    std::condition_variable connections_cv_;
+
+    // Connections whose socket is watched again once the event thread wakes up through resume_event_fd_
+    std::mutex resumed_mutex_;
+    std::vector<std::shared_ptr<ClientHandler>> resumed_;
+    int resume_event_fd_{-1};
+
+    // Connections with queued messages and tagged requests waiting for a worker
+    std::mutex ready_mutex_;
+    std::deque<std::shared_ptr<ClientHandler>> ready_;
+    std::deque<std::pair<std::shared_ptr<ClientHandler>, TaggedRequest>> requests_;
+    std::condition_variable ready_cv_;
+
+    // Waits for readable sockets and queues their messages
+    void event_loop_();
+    // Dispatches the messages of ready connections and executes tagged requests
+    void worker_loop_();
+    // Dispatches the queued messages of a connection until none are left
+    void process_connection_(const std::shared_ptr<ClientHandler> &handler);
+    // Executes a tagged request of a connection
+    void execute_request_(const std::shared_ptr<ClientHandler> &handler, TaggedRequest &request);
+    // Watches the socket of a connection for incoming data, returns false on failure
+    bool watch_(int socket_fd);
+    // Watches the sockets of the connections that had room in their queue again
+    void watch_resumed_();
+    // Hands a connection with queued messages to a worker unless one already has it
+    void schedule_(const std::shared_ptr<ClientHandler> &handler);
+    // Stops reading from a connection and closes it
+    void close_connection_(const std::shared_ptr<ClientHandler> &handler);
+};
+
+#endif
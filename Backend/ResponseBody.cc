@@ -0,0 +1,43 @@
+#include <fcntl.h>
+#include <cstring>
+#include "ResponseBody.h"
+
+using namespace std;
+
+ResponseBody::~ResponseBody()
+{
+    for (int fd : this->files_)
+        close(fd);
+}
+
+void ResponseBody::add(vector<std::byte> &&bytes)
+{
+    if (bytes.empty())
+        return;
+
+    const vector<std::byte> &buffer = this->buffers_.emplace_back(std::move(bytes));
+    this->parts_.push_back({std::string_view(reinterpret_cast<const char *>(buffer.data()), buffer.size())});
+}
+
+void ResponseBody::add(std::string_view bytes)
+{
+    if (!bytes.empty())
+        this->parts_.push_back({bytes});
+}
+
+bool ResponseBody::add_file(int fd, off_t offset, size_t size)
+{
+    if (size == 0)
+        return true;
+
+    int file_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (file_fd < 0)
+    {
+        fprintf(stderr, "Error duplicating file descriptor %d (%s)\n", fd, strerror(errno));
+        return false;
+    }
+
+    this->files_.push_back(file_fd);
+    this->parts_.push_back({{}, file_fd, offset, size});
+    return true;
+}
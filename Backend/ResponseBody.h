@@ -0,0 +1,44 @@
+#ifndef RESPONSEBODY_H
+#define RESPONSEBODY_H
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+#include "SocketWriter.h"
+
+using namespace std;
+
+// Binary data written after the message of a response without copying it into the message
+// Keeps the bytes and files its parts refer to until the response is written
+class ResponseBody
+{
+public:
+    ResponseBody() = default;
+    ~ResponseBody();
+
+    ResponseBody(const ResponseBody &) = delete;
+    ResponseBody &operator=(const ResponseBody &) = delete;
+
+    // Appends bytes owned by the body
+    void add(vector<std::byte> &&bytes);
+    // Appends bytes that outlive the body, e.g. a line end literal
+    void add(std::string_view bytes);
+    // Appends size bytes of an open file starting at offset, the body keeps its own duplicate of fd
+    // Returns false if fd cannot be duplicated
+    bool add_file(int fd, off_t offset, size_t size);
+
+    // Parts in the order they are written
+    const vector<MessagePart> &parts() const
+    {
+        return parts_;
+    }
+
+private:
+    // Element addresses stay the same when more are added
+    deque<vector<std::byte>> buffers_;
+    vector<int> files_;
+    vector<MessagePart> parts_;
+};
+
+#endif
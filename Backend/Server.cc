@@ -5,12 +5,14 @@
 #include <signal.h>
 #include <pthread.h>
 #include "Server.h"
-#include "ClientHandler.h"
+#include "Reactor.h"
 #include "ServerConfig.h"
-#include "NewClientArgs.h"
 #include "Globals.h"
 #include "TabletArray.h"
+#include "ReplicationLog.h"
 #include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 using namespace std;
 
@@ -66,10 +68,23 @@ void Server::startServer(const ServerConfig &config)
         tablets.load(config.recovery);
     }
 
+    // Wait for connections and state changes of the node with epoll instead of polling
+    accept_epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    SERVER_EVENT_FD = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (accept_epoll_fd_ == -1 || SERVER_EVENT_FD == -1)
+    {
+        fprintf(stderr, "Main thread (%ld): Failed to create epoll instance or eventfd (%s)\n", pthread_self(), strerror(errno));
+        exit(1);
+    }
+    watch_fd_(SERVER_EVENT_FD);
+
     // Create a socket and bind to it
     force_bind_and_listen_(config);
 
-    // Accept connections and create threads
+    // Start the event thread and worker threads that serve all client connections
+    REACTOR = new Reactor(config.server_type);
+
+    // Accept connections and hand them to the reactor
     while (true)
     {
         // if (DEBUG)
@@ -77,6 +92,13 @@ void Server::startServer(const ServerConfig &config)
 
         if (IS_ALIVE.load() && SS_FD.load() == -1)
         {
+            // Recover from another node, the coordinator only notices that we were down on its next heartbeat
+            if (listed_as_primary_())
+            {
+                wait_for_events_(STATE_CHECK_INTERVAL_MS);
+                continue;
+            }
+
             if (DEBUG)
                 fprintf(stderr, "Main thread (%ld): Starting state syncronization...\n", pthread_self());
 
@@ -84,6 +106,8 @@ void Server::startServer(const ServerConfig &config)
             // Only ever reached by KVStorage servers
             tablets.reset();
             tablets.load(true);
+            // The tablets were recovered from the primary, so the next log record is applied whatever its sequence number
+            replication_log.reset();
 
             if (DEBUG)
                 fprintf(stderr, "Main thread (%ld): Finished state syncronization...\n", pthread_self());
@@ -93,69 +117,66 @@ void Server::startServer(const ServerConfig &config)
         }
         else if (!IS_ALIVE.load())
         {
-            std::unique_lock<std::shared_mutex> lock(mtx);
-            if (THREAD2SOCKET.empty())
-            {
-                // Do nothing, wait until we come back up
-                lock.unlock();
-                sleep(1);
-                continue;
-            }
+            // Close all client connections, then wait until we are brought back up
+            REACTOR->close_connections();
+            wait_for_events_();
+            continue;
+        }
 
-            // for (const auto &pair : THREAD2SOCKET)
-            // {
-            //     fprintf(stderr, "Main thread (%ld): Closing socket %d...\n", pthread_self(), pair.second);
-            //     pthread_kill(pair.first, SIGUSR1);
-            // }
-
-            // THREAD2SOCKET.clear(); // Clear the map of threads and sockets
-            // lock.unlock();
-
-            // If we have open clients, we need to close them.
-            // Ideal process: Reader thread receives EOF, pushes
-            // TQUIT to ClientHandler and finally ClientHandler
-            // closes the socket and exits. That way we close off all
-            // running threads.
-            while (!THREAD2SOCKET.empty())
-            {
-                // for (const auto &pair : THREAD2SOCKET)
-                // {
-                //     fprintf(stderr, "Main thread (%ld): Closing socket %d...\n", pthread_self(), pair.second);
-                //     pthread_kill(pair.first, SIGUSR1);
-                // }
-                // lock.unlock();
-                for (const auto &pair : THREAD2SOCKET)
-                {
-                    if (pair.second != -1)
-                    {
-                        shutdown(pair.second, SHUT_RDWR); // Unblocks the reader thread (so it gets EOF)
-                        // close(pair.second);
-                    }
-                }
-                lock.unlock();
-                sleep(1); // Gives time for threads to clean up
-                lock.lock();
-            }
-            lock.unlock();
+        if (wait_for_events_())
+            accept_connections_();
+    }
+}
 
-            continue;
+bool Server::wait_for_events_(int timeout_ms)
+{
+    epoll_event events[2];
+    int event_count = epoll_wait(accept_epoll_fd_, events, 2, timeout_ms);
+    if (event_count == -1)
+    {
+        if (errno != EINTR)
+            fprintf(stderr, "Main thread (%ld): epoll_wait failed (%s)\n", pthread_self(), strerror(errno));
+        return false;
+    }
+
+    bool listener_ready = false;
+    for (int i = 0; i < event_count; ++i)
+    {
+        if (events[i].data.fd == SERVER_EVENT_FD)
+        {
+            // Reset the counter, the loop re-checks IS_ALIVE
+            eventfd_t value;
+            eventfd_read(SERVER_EVENT_FD, &value);
+        }
+        else
+        {
+            listener_ready = true;
         }
+    }
+    return listener_ready;
+}
+
+void Server::accept_connections_()
+{
+    // Accept the whole backlog, the listener is non-blocking
+    while (true)
+    {
+        int listener_fd = SS_FD.load();
+        if (listener_fd == -1)
+            return;
 
         sockaddr_in client_addr;
         socklen_t addr_len = sizeof(client_addr);
-        int client_fd = accept(SS_FD.load(), (struct sockaddr *)&client_addr, &addr_len);
+        int client_fd = accept(listener_fd, (struct sockaddr *)&client_addr, &addr_len);
         if (client_fd == -1)
         {
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
-            {
-                // No connections ready to accept right now
-                usleep(100000);
+            if (errno == EINTR || errno == ECONNABORTED)
                 continue;
-            }
-            else
-            {
+
+            // EAGAIN: no connections left to accept, anything else: the listener was closed by SHUT_DOWN
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
                 fprintf(stderr, "Main thread (%ld): Failed to accept client connection.\n", pthread_self());
-            }
+            return;
         }
 
         // Unset flags for non-blocking mode (MACOS)
@@ -163,19 +184,45 @@ void Server::startServer(const ServerConfig &config)
         flags &= ~O_NONBLOCK;
         fcntl(client_fd, F_SETFL, flags);
 
-        // TODO: Since we have multiple types of servers, each might take different arguments
-        // We should build NewClientArgs with some type of Factory. The factory would take ServerConfig
-        // as an argument and populate a NewClientArgs object with necessary fields.
-        NewClientArgs *nca = new NewClientArgs();
-        nca->socket_fd = client_fd;
-        nca->server_type = config.server_type;
-        pthread_t threadId;
-        if (pthread_create(&threadId, nullptr, ClientHandler::handleClientThreadWrapper, nca) != 0)
-        {
-            fprintf(stderr, "Failed to create thread for client %d", client_fd);
-            close(client_fd);
-        }
+        // The reactor reads from the client and dispatches its messages on a worker thread
+        REACTOR->add_connection(client_fd);
+    }
+}
+
+void Server::watch_fd_(int fd)
+{
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(accept_epoll_fd_, EPOLL_CTL_ADD, fd, &event) == -1)
+        fprintf(stderr, "Main thread (%ld): Failed to watch socket %d (%s)\n", pthread_self(), fd, strerror(errno));
+}
+
+bool Server::listed_as_primary_()
+{
+    std::map<int, std::vector<KVServer>> kv_servers_map = COORDINATOR_SERVICE->get_kv_servers_map();
+    auto it = kv_servers_map.find(RG_ID);
+    if (it == kv_servers_map.end())
+        return false;
+
+    bool is_primary = false;
+    bool other_alive = false;
+    for (const auto &server : it->second)
+    {
+        if (server.host == HOST && server.port == PORT_NO)
+            is_primary = server.is_primary;
+        else if (server.is_alive)
+            other_alive = true;
     }
+
+    // Without another live node in the replication group there is no one to recover from
+    return is_primary && other_alive;
+}
+
+void Server::notify_state_change()
+{
+    if (SERVER_EVENT_FD != -1)
+        eventfd_write(SERVER_EVENT_FD, 1);
 }
 
 void Server::sigint_handler(int signum)
@@ -211,24 +258,15 @@ void Server::sigint_handler(int signum)
     if (DEBUG)
         fprintf(stderr, "Main thread (%ld): Finished closing Coordinator Service...\n", pthread_self());
 
-    ///////////////////////////// Closing Worker Threads //////////////////////////////
+    ///////////////////////////// Closing Client Connections //////////////////////////////
     if (DEBUG)
-        fprintf(stderr, "Main thread (%ld): Cleaning Worker Threads...\n", pthread_self());
-
-    std::shared_lock<std::shared_mutex> lock2(mtx);
-    for (const auto &pair : THREAD2SOCKET)
-    {
-        pthread_kill(pair.first, SIGUSR1);
-    }
-    lock2.unlock();
+        fprintf(stderr, "Main thread (%ld): Closing client connections...\n", pthread_self());
 
-    for (const auto &pair : THREAD2SOCKET)
-    {
-        pthread_join(pair.first, NULL);
-    }
+    if (REACTOR != nullptr)
+        REACTOR->shutdown_connections("-ERR Server shutting down");
 
     if (DEBUG)
-        fprintf(stderr, "Main thread (%ld): Finished cleaning worker threads...\n", pthread_self());
+        fprintf(stderr, "Main thread (%ld): Finished closing client connections...\n", pthread_self());
     ///////////////////////////// Closing Main Thread //////////////////////////////
     if (DEBUG)
         fprintf(stderr, "Main thread (%ld): Closing listener Socket...\n", pthread_self());
@@ -244,51 +282,23 @@ void Server::sigint_handler(int signum)
     exit(130);
 }
 
-void Server::sigusr1_handler(int signum)
-{
-    pthread_t thread_id = pthread_self();
-    if (DEBUG)
-        fprintf(stderr, "--> Worker thread (%ld): Cleaning up ...\n", thread_id);
-
-    // Close sockets
-    std::shared_lock<std::shared_mutex> lock(mtx);
-    auto it = THREAD2SOCKET.find(thread_id);
-    if (it != THREAD2SOCKET.end())
-    {
-        int socket_fd = it->second;
-        string message = "-ERR Server shutting down\r\n";
-        write(socket_fd, message.c_str(), message.size());
-        string debug_msj = message;
-
-        if (DEBUG)
-            fprintf(stderr, "--> Worker thread (%ld): Closing socket...\n", thread_id);
-
-        if (socket_fd != -1)
-        {
-            shutdown(socket_fd, SHUT_RDWR);
-            close(socket_fd);
-        }
-    }
-    lock.unlock();
-
-    if (DEBUG)
-        fprintf(stderr, "--> Worker thread (%ld): Finished cleaning up...\n", thread_id);
-
-    return;
-}
-
 void Server::force_bind_and_listen_(const ServerConfig &config)
 {
-    while (SS_FD.load() == -1)
+    for (int attempt = 0; SS_FD.load() == -1; ++attempt)
     {
-        sleep(1);
+        // Retry once a second, e.g. while the port is still taken
+        if (attempt > 0)
+            sleep(1);
 
         if (DEBUG)
             fprintf(stderr, "Main thread (%ld): Attempting to bind and listen on port %d...\n", pthread_self(), config.portno);
 
         int serverSocket = socket(AF_INET, SOCK_STREAM, 0);
         if (serverSocket == -1)
+        {
             fprintf(stderr, "Main thread (%ld): Failed to create socket\n", pthread_self());
+            continue;
+        }
 
         struct sockaddr_in serverAddr;
         memset(&serverAddr, 0, sizeof(serverAddr));
@@ -302,18 +312,21 @@ void Server::force_bind_and_listen_(const ServerConfig &config)
         {
             fprintf(stderr, "Main thread (%ld): Failed to set socket options\n", pthread_self());
             close(serverSocket);
+            continue;
         }
 
         if (::bind(serverSocket, (struct sockaddr *)&serverAddr, sizeof(serverAddr)) == -1)
         {
             fprintf(stderr, "Main thread (%ld): Failed to bind the socket\n", pthread_self());
             close(serverSocket);
+            continue;
         }
 
-        if (listen(serverSocket, 5) == -1)
+        if (listen(serverSocket, SOMAXCONN) == -1)
         {
             fprintf(stderr, "Main thread (%ld): Failed to listen\n", pthread_self());
             close(serverSocket);
+            continue;
         }
 
         // Store the server socket file descriptor in a shared atomic variable
@@ -330,6 +343,8 @@ void Server::force_bind_and_listen_(const ServerConfig &config)
             fprintf(stderr, "Main thread (%ld): Failed to set socket to non-blocking\n", pthread_self());
         }
 
+        // The listener is removed from the epoll instance when it is closed
+        watch_fd_(SS_FD.load());
 
         if (DEBUG)
             fprintf(stderr, "Main thread (%ld): Finished binding and listening on port %d...\n", pthread_self(), config.portno);
@@ -13,6 +13,9 @@ using namespace std;
 
 struct ServerConfig; // Forward declaration of ServerConfig
 
+// Interval in which a node that is brought back up checks whether the coordinator elected another primary
+constexpr int STATE_CHECK_INTERVAL_MS{500};
+
 /*
  * Class for handling server logic
  */
@@ -23,12 +26,24 @@ public:
     void startServer(const ServerConfig &config);
     // Signal handler for SIGINT (main listener/dispatcher thread cleanup)
     static void sigint_handler(int signum);
-    // Signal handler for SIGUSR1 (reader + worker threads cleanup)
-    static void sigusr1_handler(int signum);
+    // Wakes the main thread after IS_ALIVE changed, so it shuts the node down or brings it back up
+    static void notify_state_change();
 
 private:
+    // Watches the listener socket and SERVER_EVENT_FD
+    int accept_epoll_fd_{-1};
+
     // Binds to server port and listens for incoming connections (wrapped in while loop until success)
     void force_bind_and_listen_(const ServerConfig &config);
+    // Blocks until a connection is ready, the main thread is woken up or timeout_ms passed (-1 waits forever)
+    // Returns true if a connection is ready
+    bool wait_for_events_(int timeout_ms = -1);
+    // Returns true while the coordinator still lists this node as the primary of its replication group
+    bool listed_as_primary_();
+    // Accepts all pending connections and hands them to the reactor
+    void accept_connections_();
+    // Adds fd to the epoll instance of the main thread
+    void watch_fd_(int fd);
 };
 
 #endif
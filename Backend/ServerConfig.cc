@@ -6,7 +6,7 @@
 void ServerConfig::parse_args(int argc, char *argv[])
 {
     int opt;
-    while ((opt = getopt(argc, argv, "p:avc:i:w:r")) != -1)
+    while ((opt = getopt(argc, argv, "p:avc:i:w:rk:l:m:e:b:")) != -1)
     {
         switch (opt)
         {
@@ -31,6 +31,21 @@ void ServerConfig::parse_args(int argc, char *argv[])
         case 'r':
             recovery = true;
             break;
+        case 'k':
+            checkpoint_frequency = std::stoul(std::string(optarg));
+            break;
+        case 'l':
+            checkpoint_log_bytes = std::stoul(std::string(optarg));
+            break;
+        case 'm':
+            cache_memory_bytes = std::stoul(std::string(optarg));
+            break;
+        case 'e':
+            cache_policy = std::string(optarg);
+            break;
+        case 'b':
+            block_cache_bytes = std::stoul(std::string(optarg));
+            break;
         default:
             // TODO: Print Usage message per type of server
             fprintf(stderr,
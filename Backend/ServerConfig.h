@@ -45,6 +45,11 @@ struct ServerConfig
     bool recovery = false; // Recovery flag
     int recovery_pipe_w = -1; // Pipe write fd for recovery
     int recovery_pipe_r = -1; // Pipe read fd for recovery
+    size_t checkpoint_frequency = 0; // Logged versions that trigger a checkpoint (0 uses the default)
+    size_t checkpoint_log_bytes = 0; // Logged bytes that trigger a checkpoint (0 uses the default)
+    size_t cache_memory_bytes = 0; // Memory budget of the tablet cache in bytes (0 uses the default)
+    std::string cache_policy = ""; // Eviction policy of the tablet cache: lru, clock or 2q (empty uses lru)
+    size_t block_cache_bytes = 0; // Memory budget of the block cache, enables partial residency of tablets (0 disables it)
     void get_rg_id(const std::vector<std::string> &servers);
 
     // Parse the servers config file
@@ -1,66 +1,191 @@
 #include <unistd.h>
 #include <string.h>
+#include <algorithm>
+#include <string_view>
+#include <sys/socket.h>
 #include "Server.h" // Needed for DEBUG flag global variable
 #include "SocketReader.h"
 
-SocketReader::SocketReader(int socket_fd, ThreadSafeQueue &message_queue) : message_queue_(message_queue)
+SocketReader::SocketReader(int socket_fd, ThreadSafeQueue &message_queue, const ICommandDispatcher &dispatcher)
+    : message_queue_(message_queue), dispatcher_(dispatcher), accepts_tags_(dispatcher.accepts_tags())
 {
     this->socket_fd_ = socket_fd;
 }
 
-void SocketReader::read_data()
+bool SocketReader::read_available()
 {
-    string message;
-    char buffer[2048];
-    ssize_t bytes_read;
+    // Frames already received wait for room first, the socket is read again once they were queued
+    if (this->message_queue_.full())
+        return true;
 
-    while (true)
+    ssize_t bytes_read = this->receive_();
+
+    if (bytes_read > 0)
+    {
+        this->push_frames_();
+        return true;
+    }
+    else if (bytes_read == 0)
+    {
+        if (DEBUG)
+        {
+            fprintf(stderr, "[%d] (SocketReader): Connection closed by the client\n", this->socket_fd_);
+        }
+    }
+    else
+    {
+        // Nothing to read yet
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return true;
+
+        if (errno == ECONNRESET || errno == EPIPE)
+        {
+            fprintf(stderr, "[%d] (SocketReader): Connection reset by peer\n", this->socket_fd_);
+        }
+        else
+        {
+            fprintf(stderr, "[%d] (SocketReader): Error reading data from socket: %s\n", this->socket_fd_, strerror(errno));
+        }
+    }
+
+    // Notify clientHandler to exit processing loop
+    // The socket is only read while the queue has room, so TQUIT always fits
+    this->message_queue_.push({"TQUIT"});
+    return false;
+}
+
+void SocketReader::push_buffered()
+{
+    this->push_frames_();
+}
+
+ssize_t SocketReader::receive_()
+{
+    if (this->begin_ == this->end_)
     {
-        bytes_read = read(this->socket_fd_, buffer, sizeof(buffer));
+        this->begin_ = 0;
+        this->end_ = 0;
+        this->scanned_ = 0;
+    }
 
+    // Payloads are received in place once the bytes before them were pushed
+    if (!this->payload_sizes_.empty() && this->payload_received_ < this->payload_sizes_.front() &&
+        this->begin_ == this->end_ && !this->skip_line_end_)
+    {
+        size_t remaining = this->payload_sizes_.front() - this->payload_received_;
+        size_t size = std::min(remaining, std::max(this->payload_.capacity() - this->payload_received_, READ_SIZE));
+        ssize_t bytes_read = recv(this->socket_fd_, this->reserve_payload_(size), size, MSG_DONTWAIT);
         if (bytes_read > 0)
+            this->payload_received_ += bytes_read;
+        return bytes_read;
+    }
+
+    // Move the bytes not pushed yet to the front once the free space runs low
+    if (this->buffer_.size() - this->end_ < READ_SIZE)
+    {
+        if (this->begin_ > 0)
         {
-            message.append(buffer, bytes_read);
-
-            size_t newline_pos;
-            while ((newline_pos = message.find("\r\n")) != std::string::npos)
-            {
-                string complete_message = message.substr(0, newline_pos);
-                this->message_queue_.push(complete_message);
-                message.erase(0, newline_pos + 2);
-
-                // Optionally clear the buffer explicitly, though it's generally overwritten with the next read
-                // Clear the buffer (for safety)
-                // memset(buffer, 0, sizeof(buffer));
-            }
+            std::copy(this->buffer_.begin() + this->begin_, this->buffer_.begin() + this->end_, this->buffer_.begin());
+            this->end_ -= this->begin_;
+            this->scanned_ = std::max(this->scanned_, this->begin_) - this->begin_;
+            this->begin_ = 0;
         }
-        else if (bytes_read == 0)
+
+        if (this->buffer_.size() - this->end_ < READ_SIZE)
+            this->buffer_.resize(this->end_ + READ_SIZE);
+    }
+
+    ssize_t bytes_read = recv(this->socket_fd_, this->buffer_.data() + this->end_, this->buffer_.size() - this->end_, MSG_DONTWAIT);
+    if (bytes_read > 0)
+        this->end_ += bytes_read;
+    return bytes_read;
+}
+
+std::byte *SocketReader::reserve_payload_(size_t size)
+{
+    // The payload only grows, so every byte is initialized once
+    if (this->payload_.size() < this->payload_received_ + size)
+        this->payload_.resize(this->payload_received_ + size);
+    return this->payload_.data() + this->payload_received_;
+}
+
+void SocketReader::start_payload_()
+{
+    // A bogus size only allocates memory for the data that actually arrives
+    this->payload_ = vector<std::byte>();
+    this->payload_.reserve(std::min(this->payload_sizes_.front(), MAX_PAYLOAD_RESERVE));
+    this->payload_received_ = 0;
+}
+
+void SocketReader::push_frames_()
+{
+    while (!this->message_queue_.full())
+    {
+        if (this->skip_line_end_)
         {
-            if (DEBUG)
-            {
-                fprintf(stderr, "[%d] (SocketReader): Connection closed by the client\n", this->socket_fd_);
-            }
-            // TODO: Handle this with a singal to the clientHandler thread
-            // to shut down the connection.
-
-            // Notify clientHandler to exit processing loop
-            this->message_queue_.push("TQUIT");
-            return;
+            // Wait for both bytes, a CR may be followed by the LF of the next read
+            size_t available = this->end_ - this->begin_;
+            if (available == 0 || (available == 1 && this->buffer_[this->begin_] == '\r'))
+                return;
+
+            if (this->buffer_[this->begin_] == '\r' && this->buffer_[this->begin_ + 1] == '\n')
+                this->begin_ += 2;
+            this->skip_line_end_ = false;
         }
-        else
+
+        if (!this->payload_sizes_.empty())
         {
-            if (errno == ECONNRESET || errno == EPIPE)
-            {
-                fprintf(stderr, "[%d] (SocketReader): Connection reset by peer\n", this->socket_fd_);
-            }
-            else
-            {
-                // When a client requests to close connection with QUIT, this might be printed
-                // because clientHandler closed connection and read command got "Bad file descriptor" error.
-                fprintf(stderr, "[%d] (SocketReader): Error reading data from socket: %s\n", this->socket_fd_, strerror(errno));
-            }
-            this->message_queue_.push("TQUIT");
+            size_t length = std::min(this->end_ - this->begin_, this->payload_sizes_.front() - this->payload_received_);
+            std::copy_n(reinterpret_cast<const std::byte *>(this->buffer_.data() + this->begin_), length, this->reserve_payload_(length));
+            this->payload_received_ += length;
+            this->begin_ += length;
+
+            if (this->payload_received_ < this->payload_sizes_.front())
+                return;
+
+            Frame frame;
+            this->payload_.resize(this->payload_received_);
+            frame.payload = std::move(this->payload_);
+            frame.is_payload = true;
+            this->message_queue_.push(std::move(frame));
+
+            this->payload_sizes_.pop_front();
+            this->skip_line_end_ = true;
+            if (!this->payload_sizes_.empty())
+                this->start_payload_();
+            continue;
+        }
+
+        // Only search the bytes received since the last search
+        std::string_view data(this->buffer_.data(), this->end_);
+        size_t newline_pos = data.find("\r\n", std::max(this->scanned_, this->begin_));
+        if (newline_pos == std::string_view::npos)
+        {
+            // The last byte may be the CR of a line end
+            this->scanned_ = this->end_ > this->begin_ ? this->end_ - 1 : this->begin_;
             return;
         }
+
+        Frame frame;
+        std::string_view line = data.substr(this->begin_, newline_pos - this->begin_);
+        this->begin_ = newline_pos + 2;
+
+        size_t tag_end = this->accepts_tags_ && line.size() > 1 && line[0] == '@' ? line.find(' ') : std::string_view::npos;
+        if (tag_end != std::string_view::npos)
+        {
+            frame.tag.assign(line.substr(1, tag_end - 1));
+            line.remove_prefix(tag_end + 1);
+        }
+        frame.message.assign(line);
+
+        vector<size_t> sizes;
+        this->dispatcher_.payload_sizes(frame.message, sizes);
+        this->message_queue_.push(std::move(frame));
+
+        if (!sizes.empty())
+        {
+            this->payload_sizes_.insert(this->payload_sizes_.end(), sizes.begin(), sizes.end());
+            this->start_payload_();
+        }
     }
-}
\ No newline at end of file
+}
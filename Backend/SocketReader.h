@@ -1,21 +1,59 @@
 #ifndef SOCKETREADER_H
 #define SOCKETREADER_H
 
+#include <deque>
+#include <vector>
 #include "ThreadSafeQueue.h"
+#include "ICommandDispatcher.h"
 #include "Globals.h"
 
 class SocketReader
 {
 public:
-    SocketReader(int socket_fd_, ThreadSafeQueue &queue);
+    SocketReader(int socket_fd_, ThreadSafeQueue &queue, const ICommandDispatcher &dispatcher);
     ~SocketReader() = default;
 
-    // Continuously read data from socket and pushes new messages to ThreadSafeQueue, if not it blocks
-    void read_data();
+    // Reads the data available on the socket without blocking and pushes new frames to ThreadSafeQueue
+    // Returns false once the connection is closed, TQUIT is pushed as the last message
+    bool read_available();
+    // Pushes the complete frames received while ThreadSafeQueue was full, as many as fit now
+    void push_buffered();
 
 private:
+    // Free space of the buffer for each read from the socket
+    static constexpr size_t READ_SIZE{16384};
+    // Payloads are allocated up front up to this size, larger ones grow with the received data
+    static constexpr size_t MAX_PAYLOAD_RESERVE{64ul * 1024ul * 1024ul};
+
     int socket_fd_;
     ThreadSafeQueue &message_queue_;
+    // Announces the binary payloads that follow a message
+    const ICommandDispatcher &dispatcher_;
+    // Lines starting with '@' carry a tag, which is split off the message
+    bool accepts_tags_;
+
+    // Received bytes that are not queued yet are buffer_[begin_, end_)
+    vector<char> buffer_;
+    size_t begin_{0};
+    size_t end_{0};
+    // Bytes before this position were already searched for a line end
+    size_t scanned_{0};
+
+    // Sizes of the announced payloads not received yet, the first one is received into payload_
+    deque<size_t> payload_sizes_;
+    vector<std::byte> payload_;
+    size_t payload_received_{0};
+    // Set after a payload, its CRLF does not start a new message
+    bool skip_line_end_{false};
+
+    // Receives into the payload directly while nothing else is buffered, into the buffer otherwise
+    ssize_t receive_();
+    // Makes room for at least size bytes of the current payload, returns the writable part
+    std::byte *reserve_payload_(size_t size);
+    // Starts receiving the first announced payload
+    void start_payload_();
+    // Pushes the complete lines and payloads of the buffer until the queue is full
+    void push_frames_();
 };
 
 #endif
@@ -1,5 +1,8 @@
 #include "SocketWriter.h"
 #include <cstring>
+#include <climits>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
 
 using namespace std;
 
@@ -10,41 +13,109 @@ SocketWriter::SocketWriter(int socket_fd)
 
 ssize_t SocketWriter::write_message(const string &message, bool add_termination)
 {
-    string message_termination = message;
-    if (add_termination) message_termination += "\r\n";
+    // The termination is gathered with the message instead of being appended to a copy of it
+    vector<MessagePart> parts{{message}};
+    if (add_termination) parts.push_back({"\r\n"});
+    return this->write_parts(parts);
+}
+
+ssize_t SocketWriter::write_message(const tablet_value &message)
+{
+    return this->write_parts({{std::string_view(reinterpret_cast<const char *>(message.data()), message.size())}});
+}
+
+ssize_t SocketWriter::write_message(const string &message, const vector<MessagePart> &body)
+{
+    vector<MessagePart> parts{{message}, {"\r\n"}};
+    parts.insert(parts.end(), body.begin(), body.end());
+    return this->write_parts(parts);
+}
+
+ssize_t SocketWriter::write_parts(const vector<MessagePart> &parts)
+{
     size_t total_bytes_written = 0;
-    size_t message_length = message_termination.size();
-    const char *data = message_termination.c_str();
+    vector<struct iovec> iov;
+    iov.reserve(std::min(parts.size(), static_cast<size_t>(IOV_MAX)));
 
-    while (total_bytes_written < message_length)
+    for (size_t i = 0; i < parts.size(); i++)
     {
-        ssize_t bytes_written = write(this->socket_fd_, data + total_bytes_written, message_length - total_bytes_written);
+        const MessagePart &part = parts[i];
+        if (part.file_fd < 0 && !part.bytes.empty())
+            iov.push_back({const_cast<char *>(part.bytes.data()), part.bytes.size()});
+
+        // Flush the gathered bytes before a file range, at the end and once a single writev cannot take more
+        bool last = i + 1 == parts.size();
+        if (!iov.empty() && (last || parts[i + 1].file_fd >= 0 || iov.size() == IOV_MAX))
+        {
+            ssize_t bytes_written = this->write_vector_(iov.data(), iov.size());
+            if (bytes_written == -1)
+                return -1;
+            total_bytes_written += bytes_written;
+            iov.clear();
+        }
+
+        if (part.file_fd >= 0)
+        {
+            ssize_t bytes_written = this->send_file_(part.file_fd, part.file_offset, part.file_size);
+            if (bytes_written == -1)
+                return -1;
+            total_bytes_written += bytes_written;
+        }
+    }
+
+    return total_bytes_written;
+}
+
+ssize_t SocketWriter::write_vector_(struct iovec *iov, int count)
+{
+    size_t total_bytes_written = 0;
+
+    while (count > 0)
+    {
+        ssize_t bytes_written = writev(this->socket_fd_, iov, count);
 
         if (bytes_written == -1)
         {
+            if (errno == EINTR)
+                continue;
             fprintf(stderr, "[%d] Error writing message to socket (%s). (expected behaviour if Ctrl+C is executed on running server)\n", this->socket_fd_, strerror(errno));
             return -1;
         }
 
         total_bytes_written += bytes_written;
+
+        // Skip the parts that were written entirely and continue within a partially written one
+        size_t written = bytes_written;
+        while (count > 0 && written >= iov->iov_len)
+        {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = static_cast<char *>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
     }
 
     return total_bytes_written;
 }
 
-ssize_t SocketWriter::write_message(const tablet_value &message)
+ssize_t SocketWriter::send_file_(int file_fd, off_t offset, size_t size)
 {
     size_t total_bytes_written = 0;
-    size_t message_length = message.size();
-    const char *data = reinterpret_cast<const char *>(message.data());
 
-    while (total_bytes_written < message_length)
+    while (total_bytes_written < size)
     {
-        ssize_t bytes_written = write(this->socket_fd_, data + total_bytes_written, message_length - total_bytes_written);
+        ssize_t bytes_written = sendfile(this->socket_fd_, file_fd, &offset, size - total_bytes_written);
 
-        if (bytes_written == -1)
+        if (bytes_written == -1 && errno == EINTR)
+            continue;
+        if (bytes_written <= 0)
         {
-            fprintf(stderr, "[%d] Error writing binary message to socket. (expected behaviour if Ctrl+C is executed on running server)\n", this->socket_fd_);
+            // Nothing was sent, the file got shorter than announced
+            fprintf(stderr, "[%d] Error sending file to socket (%s)\n", this->socket_fd_, bytes_written == 0 ? "end of file" : strerror(errno));
             return -1;
         }
 
@@ -52,4 +123,4 @@ ssize_t SocketWriter::write_message(const tablet_value &message)
     }
 
     return total_bytes_written;
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #ifndef WRITER_H
 #define WRITER_H
 #include <string>
+#include <string_view>
 #include <unistd.h>
 #include <cstddef>
 #include <vector>
@@ -9,6 +10,16 @@ using namespace std;
 
 typedef std::vector<std::byte> tablet_value;
 
+// Part of a message written without copying it: bytes in memory or a range of an open file
+struct MessagePart
+{
+    std::string_view bytes;
+    // Set for a file range, which is sent with sendfile instead of bytes
+    int file_fd{-1};
+    off_t file_offset{0};
+    size_t file_size{0};
+};
+
 class SocketWriter
 {
 public:
@@ -18,9 +29,18 @@ public:
     // Writes message to the socket used at object instantiation
     ssize_t write_message(const string &message, bool add_termination = true);
     ssize_t write_message(const tablet_value &message);
+    // Writes message and its termination followed by the parts of a response body
+    ssize_t write_message(const string &message, const vector<MessagePart> &body);
+    // Writes the parts back to back, consecutive parts in memory with one writev and file ranges with sendfile
+    ssize_t write_parts(const vector<MessagePart> &parts);
 
 private:
     int socket_fd_;
+
+    // Writes all bytes of iov, continuing after partial writes
+    ssize_t write_vector_(struct iovec *iov, int count);
+    // Sends size bytes of file_fd starting at offset
+    ssize_t send_file_(int file_fd, off_t offset, size_t size);
 };
 
 #endif
@@ -2,25 +2,36 @@
 
 using namespace std;
 
-void ThreadSafeQueue::push(const std::string &message)
+static_assert((ThreadSafeQueue::CAPACITY & (ThreadSafeQueue::CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+bool ThreadSafeQueue::push(Frame &&frame)
 {
-    lock_guard<std::mutex> lock(this->mtx_);
-    this->queue_.push(message);
-    this->cond_.notify_one(); // Notify waiting thread (NewClientHandler) that a message is available
+    size_t tail = this->tail_.load(std::memory_order_relaxed);
+    if (tail - this->head_.load(std::memory_order_acquire) == CAPACITY)
+        return false;
+
+    this->slots_[tail & (CAPACITY - 1)] = std::move(frame);
+    this->tail_.store(tail + 1, std::memory_order_release); // Publishes the frame to the consumer
+    return true;
 }
 
-std::string ThreadSafeQueue::pop()
+bool ThreadSafeQueue::try_pop(Frame &frame)
 {
-    std::unique_lock<std::mutex> lock(this->mtx_);
-    this->cond_.wait(lock, [this]()
-                     { return !this->queue_.empty(); }); // Wait for a message to be available
-    std::string message = this->queue_.front();
-    this->queue_.pop();
-    return message;
+    size_t head = this->head_.load(std::memory_order_relaxed);
+    if (head == this->tail_.load(std::memory_order_acquire))
+        return false;
+
+    frame = std::move(this->slots_[head & (CAPACITY - 1)]);
+    this->head_.store(head + 1, std::memory_order_release); // Hands the slot back to the producer
+    return true;
 }
 
-bool ThreadSafeQueue::empty()
+bool ThreadSafeQueue::empty() const
 {
-    std::lock_guard<std::mutex> lock(this->mtx_);
-    return this->queue_.empty();
-}
\ No newline at end of file
+    return this->head_.load(std::memory_order_acquire) == this->tail_.load(std::memory_order_acquire);
+}
+
+bool ThreadSafeQueue::full() const
+{
+    return this->tail_.load(std::memory_order_acquire) - this->head_.load(std::memory_order_acquire) == CAPACITY;
+}
@@ -1,27 +1,55 @@
 #ifndef THREADSAFEQUEUE_H
 #define THREADSAFEQUEUE_H
-#include <mutex>
-#include <queue>
-#include <condition_variable>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
 
 using namespace std;
 
+// A message read from a client: a line without its CRLF, or a binary payload announced by the line before it
+struct Frame
+{
+    string message;
+    // Tag of a tagged request, without its '@'
+    string tag;
+    vector<std::byte> payload;
+    bool is_payload{false};
+};
+
+/*
+ * Bounded lock-free ring of frames between one producer and one consumer
+ * The threads may change as long as each change is synchronized (e.g. through a mutex or the reactor's scheduled
+ * flag), only one thread pushes and one thread pops at any time. A full ring rejects frames, so the producer
+ * stops reading from the client instead of buffering without limit.
+ */
 class ThreadSafeQueue
 {
 public:
+    // Number of frames the ring holds (a power of two)
+    static constexpr size_t CAPACITY{256};
+
     ThreadSafeQueue() = default;
     ~ThreadSafeQueue() = default;
-    // Push a message to the queue and notify waiting threads
-    void push(const std::string &message);
-    // Pop a message from the queue, blocking if the queue is empty
-    std::string pop();
-    // Check if the queue is empty
-    bool empty();
+    // Push a frame to the ring, returns false and leaves frame as it is if the ring is full
+    bool push(Frame &&frame);
+    // Pop a frame from the ring if there is one, without blocking
+    bool try_pop(Frame &frame);
+    // Check if the ring is empty
+    bool empty() const;
+    // Check if the ring is full
+    bool full() const;
 
 private:
-    queue<std::string> queue_; // Message queue
-    mutex mtx_;                // Mutex to protect the queue
-    condition_variable cond_;  // Condition variable to notify threads one new message is added
+    // Size of a cache line, keeps the indices written by different threads apart
+    static constexpr size_t CACHE_LINE_SIZE{64};
+
+    // Next frame to pop, written by the consumer
+    alignas(CACHE_LINE_SIZE) atomic<size_t> head_{0};
+    // Next slot to push to, written by the producer
+    alignas(CACHE_LINE_SIZE) atomic<size_t> tail_{0};
+    alignas(CACHE_LINE_SIZE) array<Frame, CAPACITY> slots_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -3,31 +3,79 @@
 #include "SocketWriter.h"
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
 
-void UpdateForwarder::forward_update(const std::string &message)
+UpdateForwarder::~UpdateForwarder()
 {
-    std::lock_guard<std::mutex> lock(mtx_);
+    for (Connection &connection : connections_)
+    {
+        if (connection.socket_fd != -1)
+            close(connection.socket_fd);
+    }
+}
+
+bool UpdateForwarder::forward_update(const std::string &message)
+{
+    std::unique_lock<std::mutex> lock;
+    Connection &connection = acquire_connection_(lock);
     try
     {
         // Get the primary node
-        primary_node_ = get_primary_node_(config_.rg_id);
+        KVServer primary_node = get_primary_node_(config_.rg_id);
+
+        // A connection to a former primary is replaced
+        if (connection.socket_fd != -1 && (connection.host != primary_node.host || connection.port != primary_node.port))
+        {
+            fprintf(stderr, "UpdateForwarder: Primary node changed to %s:%d\n", primary_node.host.c_str(), primary_node.port_gc);
+            close(connection.socket_fd);
+            connection.socket_fd = -1;
+        }
 
         // Connect to the primary node if not already connected
-        if (primary_changed_)
+        if (connection.socket_fd == -1)
         {
-            socket_fd_ = connect_to_server_(primary_node_);
-            fprintf(stderr, "UpdateForwarder: Connected to Primary %s:%d, socket %d\n", primary_node_.host.c_str(), primary_node_.port_gc, socket_fd_);
+            connection.socket_fd = connect_to_server_(primary_node);
+            connection.host = primary_node.host;
+            connection.port = primary_node.port;
+            fprintf(stderr, "UpdateForwarder: Connected to Primary %s:%d, socket %d\n", primary_node.host.c_str(), primary_node.port_gc, connection.socket_fd);
         }
 
         // Send the message to the primary node
-        SocketWriter writer(socket_fd_);
-        writer.write_message(message, false);
-        writer.write_message("\r\n", false);
+        SocketWriter writer(connection.socket_fd);
+        if (writer.write_message(message) == -1)
+            throw std::runtime_error("UpdateForwarder: Failed to send update to " + primary_node.host + ":" + std::to_string(primary_node.port_gc) + "\n");
+        return true;
     }
     catch (const std::exception &e)
     {
         fprintf(stderr, "UpdateForwarder: Exception while forwarding update: %s\n", e.what());
+
+        // The connection may have been left in the middle of a message
+        if (connection.socket_fd != -1)
+        {
+            close(connection.socket_fd);
+            connection.socket_fd = -1;
+        }
+        return false;
+    }
+}
+
+UpdateForwarder::Connection &UpdateForwarder::acquire_connection_(std::unique_lock<std::mutex> &lock)
+{
+    size_t first = next_connection_.fetch_add(1, std::memory_order_relaxed);
+    for (size_t i = 0; i < connections_.size(); ++i)
+    {
+        Connection &connection = connections_[(first + i) % connections_.size()];
+        lock = std::unique_lock<std::mutex>(connection.mtx, std::try_to_lock);
+        if (lock.owns_lock())
+            return connection;
     }
+
+    // All connections are in use, wait for the first one tried
+    Connection &connection = connections_[first % connections_.size()];
+    lock = std::unique_lock<std::mutex>(connection.mtx);
+    return connection;
 }
 
 KVServer UpdateForwarder::get_primary_node_(int rg_id)
@@ -35,32 +83,12 @@ KVServer UpdateForwarder::get_primary_node_(int rg_id)
     // Check if the current node is the primary node based on *COORDINATOR_SERVICE
     std::map<int, std::vector<KVServer>> map = COORDINATOR_SERVICE->get_kv_servers_map();
     auto it = map.find(rg_id);
-    if (it != COORD_KV_SERVERS_MAP.end())
+    if (it != map.end())
     {
         for (const auto &server : it->second)
         {
             if (server.is_primary)
-            {
-                // Check if the primary server changed or not
-                if (primary_node_.port != server.port)
-                {
-                    fprintf(stderr, "UpdateForwarder: Primary node changed to %s:%d\n", server.host.c_str(), server.port_gc);
-                    primary_changed_ = true;
-
-                    // Close the old socket if it exists
-                    if (socket_fd_ != -1)
-                    {
-                        close(socket_fd_);
-                        socket_fd_ = -1;
-                    }
-                }
-                else
-                {
-                    primary_changed_ = false;
-                }
-
                 return server;
-            }
         }
     }
     throw std::runtime_error("UpdateForwarder: No primary node found in the replication group\n");
@@ -81,8 +109,13 @@ int UpdateForwarder::connect_to_server_(const KVServer &server)
 
     if (connect(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
     {
+        close(sockfd);
         throw std::runtime_error("UpdateForwarder: Failed to connect to server " + server.host + ":" + std::to_string(server.port_gc) + "\n");
     }
 
+    // Every update is written with a single write and waited for by a client
+    int nodelay = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
     return sockfd;
 }
\ No newline at end of file
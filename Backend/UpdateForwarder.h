@@ -1,32 +1,55 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
+#include <vector>
 #include "ServerConfig.h"
 
+// Connections of the forwarder to the internal port of the primary, concurrent updates are written on different ones
+constexpr size_t FORWARDER_CONNECTIONS{8};
+
 /*
  * This class is going to be a singleton class.
  * It will be used by any thread of the KVStorage
  * server to forward updates to the primary node
  * of the replication group.
+ *
+ * Updates are written to one of several connections to the internal port of the primary, so a thread does not
+ * wait for the updates of other threads to be written. The result of an update is sent back with its message id,
+ * so it does not matter which connection carried the update.
  */
 class UpdateForwarder
 {
 public:
-    UpdateForwarder(const ServerConfig &config) : config_(config), socket_fd_(-1), primary_changed_(true) {}
+    UpdateForwarder(const ServerConfig &config) : config_(config), connections_(FORWARDER_CONNECTIONS) {}
     ~UpdateForwarder();
 
     // Thread safe method that finds the primary node of the replication group, connects to its internal port (if not already connected to it) and forwards the update message.
-    void forward_update(const std::string &message);
+    // Returns false if the message could not be sent
+    bool forward_update(const std::string &message);
 
 private:
+    // Connection to the internal port of the primary, used by one update at a time
+    struct Connection
+    {
+        std::mutex mtx;
+        int socket_fd{-1};
+        // Public host and port of the primary the connection is open to
+        std::string host;
+        int port{0};
+    };
+
     ServerConfig config_;
-    KVServer primary_node_;
-    int socket_fd_;
-    bool primary_changed_;
-    std::mutex mtx_;
+    std::vector<Connection> connections_;
+    // Connection the next update tries first, so the updates are spread over all of them
+    std::atomic<size_t> next_connection_{0};
 
     // Gets the primary node of the replication group
     KVServer get_primary_node_(int rg_id);
 
+    // Locks a free connection, or waits for one if all of them are in use
+    Connection &acquire_connection_(std::unique_lock<std::mutex> &lock);
+
     // Connects to the servers internal port and returns the socket file descriptor
     int connect_to_server_(const KVServer &server);
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "drive-handlers.h"
 #include <sstream>
 #include <set>
+#include <map>
 #include <iostream>
 #include <netinet/in.h>
 #include <unistd.h>
@@ -9,6 +10,59 @@
 #include "../../Shared/SharedStructures.h"
 #include "utils.h"
 
+namespace
+{
+    // Writes all bytes to the socket, returns false once the client is gone
+    bool sendAll(int fd, const char *data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+            if (sent <= 0)
+                return false;
+            data += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    // Parses a "bytes=first-last", "bytes=first-" or "bytes=-suffix" range of a file with the given size
+    // Returns false if the range cannot be served
+    bool parseRange(const std::string &range, size_t size, size_t &first, size_t &last)
+    {
+        if (range.rfind("bytes=", 0) != 0 || size == 0)
+            return false;
+        std::string spec = range.substr(6);
+        size_t dash = spec.find('-');
+        if (dash == std::string::npos)
+            return false;
+
+        try
+        {
+            if (dash == 0)
+            {
+                size_t suffix = std::stoull(spec.substr(1));
+                if (suffix == 0)
+                    return false;
+                first = size - std::min(suffix, size);
+                last = size - 1;
+                return true;
+            }
+            first = std::stoull(spec.substr(0, dash));
+            last = dash + 1 < spec.size() ? std::stoull(spec.substr(dash + 1)) : size - 1;
+        }
+        catch (...)
+        {
+            return false;
+        }
+
+        if (first >= size || last < first)
+            return false;
+        last = std::min(last, size - 1);
+        return true;
+    }
+}
+
 // std::string urlDecode(const std::string &s)
 // {
 //     std::string result;
@@ -37,7 +91,7 @@ void DriveHandler::handle(clientContext *client, const std::string &method, cons
     {
         if (path.rfind("/drive/download?", 0) == 0)
         {
-            handleDownload(client, path, username);
+            handleDownload(client, path, header, username);
         }
         else if (path.rfind("/drive/view", 0) == 0)
         {
@@ -156,7 +210,7 @@ void DriveHandler::handleRename(clientContext *client, const std::string &path,
         std::cout << "lack of Arguement" << std::endl;
     }
 }
-void DriveHandler::handleDownload(clientContext *client, const std::string &path, const std::string &username)
+void DriveHandler::handleDownload(clientContext *client, const std::string &path, const std::unordered_map<std::string, std::string> &header, const std::string &username)
 {
     size_t pos = path.find("filename=");
     if (pos == std::string::npos)
@@ -169,22 +223,21 @@ void DriveHandler::handleDownload(clientContext *client, const std::string &path
     while (!filename.empty() && filename[0] == '/')
         filename = filename.substr(1);
 
+    // Only the sizes are listed, the contents are streamed to the client chunk by chunk below
     std::string row = user_to_row(username) + "-STORAGE";
-    std::set<std::string> columns;
+    std::map<std::string, ValueInfo> columns;
     storage->list_columns(row, columns);
     std::cout << "[Download] list_columns for rowkey " << row << ":\n";
-    for (const std::string &col : columns)
-        std::cout << col << std::endl;
+    for (const auto &[col, info] : columns)
+        std::cout << col << " (" << info.size << " bytes)" << std::endl;
 
     std::vector<std::string> chunkNames;
-    for (const std::string &col : columns)
+    for (const auto &[col, info] : columns)
     {
         if (col.rfind(filename + "_part", 0) == 0) // starts with filename_part
             chunkNames.push_back(col);
     }
 
-    std::string fullContent;
-
     if (!chunkNames.empty())
     {
         std::sort(chunkNames.begin(), chunkNames.end(), [](const std::string &a, const std::string &b)
@@ -192,35 +245,80 @@ void DriveHandler::handleDownload(clientContext *client, const std::string &path
             int numA = std::stoi(a.substr(a.rfind("part") + 4));
             int numB = std::stoi(b.substr(b.rfind("part") + 4));
             return numA < numB; });
-
-        for (const std::string &chunkCol : chunkNames)
-        {
-            std::vector<std::byte> chunkVal;
-            if (storage->get(row, chunkCol, chunkVal) == 0)
-                fullContent += IStorageService::to_string(chunkVal);
-        }
+    }
+    else if (columns.count(filename))
+    {
+        chunkNames.push_back(filename);
     }
     else
     {
-        std::vector<std::byte> val;
-        if (storage->get(row, filename, val) != 0)
+        FrontendServer::sendResponse("<html><body><h1>404 File Not Found</h1></body></html>", client, "404 Not Found");
+        return;
+    }
+
+    size_t fileSize = 0;
+    for (const std::string &chunkCol : chunkNames)
+        fileSize += columns[chunkCol].size;
+
+    // A single byte range is served as 206 Partial Content, other range requests get the whole file
+    size_t first = 0;
+    size_t last = fileSize == 0 ? 0 : fileSize - 1;
+    bool partial = false;
+    auto rangeIt = header.find("Range");
+    if (rangeIt != header.end() && rangeIt->second.find(',') == std::string::npos)
+    {
+        if (!parseRange(rangeIt->second, fileSize, first, last))
         {
-            FrontendServer::sendResponse("<html><body><h1>404 File Not Found</h1></body></html>", client, "404 Not Found");
+            std::string response = "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                                   "Content-Range: bytes */" + std::to_string(fileSize) + "\r\n"
+                                   "Content-Length: 0\r\n"
+                                   "Connection: keep-alive\r\n\r\n";
+            sendAll(client->conn_fd, response.c_str(), response.size());
             return;
         }
-        fullContent = IStorageService::to_string(val);
+        partial = true;
     }
+    size_t contentLength = fileSize == 0 ? 0 : last - first + 1;
 
     std::ostringstream responseStream;
-    responseStream << "HTTP/1.1 200 OK\r\n"
+    responseStream << "HTTP/1.1 " << (partial ? "206 Partial Content" : "200 OK") << "\r\n"
                    << "Content-Type: application/octet-stream\r\n"
                    << "Content-Disposition: attachment; filename=\"" << filename << "\"\r\n"
-                   << "Content-Length: " << fullContent.size() << "\r\n"
+                   << "Accept-Ranges: bytes\r\n";
+    if (partial)
+        responseStream << "Content-Range: bytes " << first << "-" << last << "/" << fileSize << "\r\n";
+    responseStream << "Content-Length: " << contentLength << "\r\n"
                    << "Connection: keep-alive\r\n\r\n";
 
-    std::string header = responseStream.str();
-    send(client->conn_fd, header.c_str(), header.size(), 0);
-    send(client->conn_fd, fullContent.c_str(), fullContent.size(), 0);
+    std::string responseHeader = responseStream.str();
+    if (!sendAll(client->conn_fd, responseHeader.c_str(), responseHeader.size()))
+        return;
+
+    // Each chunk overlapping the range is passed on to the client as its bytes arrive from the storage
+    size_t chunkStart = 0;
+    for (const std::string &chunkCol : chunkNames)
+    {
+        size_t chunkEnd = chunkStart + columns[chunkCol].size;
+        if (contentLength > 0 && chunkEnd > first && chunkStart <= last)
+        {
+            size_t offset = std::max(first, chunkStart) - chunkStart;
+            size_t length = std::min(last + 1, chunkEnd) - chunkStart - offset;
+            // The range may be read from another replica than the listing, a chunk of a different size is not sent
+            const size_t expectedSize = columns[chunkCol].size;
+            size_t valueSize = 0;
+            int status = storage->get_range(row, chunkCol, offset, length, [client, &valueSize, expectedSize](const std::byte *data, size_t size)
+                                            { return valueSize == expectedSize &&
+                                                     sendAll(client->conn_fd, reinterpret_cast<const char *>(data), size); }, valueSize);
+            if (status != 0 || valueSize != expectedSize)
+            {
+                // The header promised more bytes, so the connection cannot be used for further responses
+                std::cout << "[Download] Failed to stream " << chunkCol << std::endl;
+                shutdown(client->conn_fd, SHUT_RDWR);
+                return;
+            }
+        }
+        chunkStart = chunkEnd;
+    }
 }
 
 void DriveHandler::handleView(clientContext *client, const std::string &path, const std::unordered_map<std::string, std::string> &header, const std::string &username)
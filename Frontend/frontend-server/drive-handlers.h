@@ -22,6 +22,7 @@ private:
 
     void handleDownload(clientContext *client,
                         const std::string &path,
+                        const std::unordered_map<std::string, std::string> &header,
                         const std::string &username);
 
     void handleView(clientContext *client,
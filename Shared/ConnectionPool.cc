@@ -0,0 +1,121 @@
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "ConnectionPool.h"
+
+namespace
+{
+    std::string server_address(const KVServer &server)
+    {
+        return server.host + ":" + std::to_string(server.port);
+    }
+}
+
+ConnectionPool &ConnectionPool::instance()
+{
+    static ConnectionPool pool;
+    return pool;
+}
+
+int ConnectionPool::acquire(const KVServer &server)
+{
+    std::vector<int> expired;
+    int sockfd = -1;
+    {
+        std::unique_lock lock(mutex_);
+        ServerConnections &connections = servers_[server_address(server)];
+        returned_cv_.wait(lock, [&connections]() { return connections.in_use < MAX_CONNECTIONS_PER_SERVER; });
+        ++connections.in_use;
+
+        // The most recently returned connection is the least likely to be closed by the server
+        auto now = std::chrono::steady_clock::now();
+        while (!connections.idle.empty())
+        {
+            IdleConnection connection = connections.idle.back();
+            connections.idle.pop_back();
+            if (now - connection.since < MAX_IDLE_TIME)
+            {
+                sockfd = connection.sockfd;
+                break;
+            }
+            expired.push_back(connection.sockfd);
+        }
+    }
+
+    for (int fd : expired)
+        close(fd);
+
+    if (sockfd != -1 && !is_healthy_(sockfd))
+    {
+        close(sockfd);
+        sockfd = -1;
+    }
+    return sockfd;
+}
+
+void ConnectionPool::release(const KVServer &server, int sockfd)
+{
+    {
+        std::lock_guard lock(mutex_);
+        ServerConnections &connections = servers_[server_address(server)];
+        --connections.in_use;
+        if (connections.idle.size() < MAX_IDLE_CONNECTIONS_PER_SERVER)
+        {
+            connections.idle.push_back({sockfd, std::chrono::steady_clock::now()});
+            sockfd = -1;
+        }
+    }
+    returned_cv_.notify_one();
+
+    if (sockfd != -1)
+        close(sockfd);
+}
+
+void ConnectionPool::discard(const KVServer &server, int sockfd)
+{
+    {
+        std::lock_guard lock(mutex_);
+        --servers_[server_address(server)].in_use;
+    }
+    returned_cv_.notify_one();
+
+    if (sockfd != -1)
+        close(sockfd);
+}
+
+bool ConnectionPool::is_healthy_(int sockfd)
+{
+    // An idle connection has nothing to read, EOF means the server closed it
+    char byte;
+    ssize_t received = recv(sockfd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+PooledConnection::PooledConnection(const KVServer &server)
+    : server(server), sockfd(ConnectionPool::instance().acquire(server)), reused(sockfd != -1)
+{
+}
+
+PooledConnection::PooledConnection(PooledConnection &&other) noexcept
+    : server(other.server), sockfd(other.sockfd), reused(other.reused), borrowed_(other.borrowed_)
+{
+    other.borrowed_ = false;
+}
+
+PooledConnection::~PooledConnection()
+{
+    if (borrowed_)
+        ConnectionPool::instance().discard(server, sockfd);
+}
+
+void PooledConnection::release()
+{
+    if (!borrowed_)
+        return;
+
+    borrowed_ = false;
+    if (sockfd == -1)
+        ConnectionPool::instance().discard(server, sockfd);
+    else
+        ConnectionPool::instance().release(server, sockfd);
+}
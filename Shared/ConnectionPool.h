@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include "SharedStructures.h"
+
+// Connections to a server open at the same time, further requests wait for one of them to be returned
+constexpr size_t MAX_CONNECTIONS_PER_SERVER{64};
+// Idle connections kept per server, connections returned to a full pool are closed
+constexpr size_t MAX_IDLE_CONNECTIONS_PER_SERVER{8};
+// Idle connections older than this are closed instead of being reused
+constexpr std::chrono::seconds MAX_IDLE_TIME{30};
+
+/*
+ * Persistent connections to the KVStorage servers shared by all IStorageService instances of a process
+ * A connection is borrowed for one request at a time and returned once its response was read completely,
+ * so the next request to the same server skips connecting and the welcome message
+ */
+class ConnectionPool
+{
+public:
+    // Pool of the process
+    static ConnectionPool &instance();
+
+    // Waits until fewer than MAX_CONNECTIONS_PER_SERVER connections to server are in use and takes one of them
+    // Returns an idle connection that is still open, or -1 if the caller has to connect itself
+    int acquire(const KVServer &server);
+
+    // Returns a connection with no unread bytes, it is kept idle unless the pool of the server is full
+    void release(const KVServer &server, int sockfd);
+
+    // Closes a connection that failed or was left in the middle of a response (sockfd may be -1)
+    void discard(const KVServer &server, int sockfd);
+
+private:
+    struct IdleConnection
+    {
+        int sockfd;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    // Connections to a server
+    struct ServerConnections
+    {
+        std::vector<IdleConnection> idle;
+        size_t in_use{0};
+    };
+
+    std::mutex mutex_;
+    std::condition_variable returned_cv_;
+    // Connections by host:port of the server
+    std::map<std::string, ServerConnections> servers_;
+
+    ConnectionPool() = default;
+
+    // Returns true if the idle connection was not closed by the server and has no unexpected bytes to read
+    static bool is_healthy_(int sockfd);
+};
+
+/*
+ * Connection borrowed from the ConnectionPool for a single request
+ * It is closed when it goes out of scope, unless it was released back to the pool after a complete response
+ */
+class PooledConnection
+{
+public:
+    // Takes a connection to server from the pool, sockfd is -1 if a new connection has to be opened
+    explicit PooledConnection(const KVServer &server);
+    ~PooledConnection();
+
+    PooledConnection(PooledConnection &&other) noexcept;
+    PooledConnection &operator=(PooledConnection &&other) = delete;
+    PooledConnection(const PooledConnection &) = delete;
+    PooledConnection &operator=(const PooledConnection &) = delete;
+
+    // Returns the connection to the pool, its response must have been read completely
+    void release();
+
+    const KVServer server;
+    int sockfd{-1};
+    // Set if the connection was idle in the pool, the server may have closed it since
+    bool reused{false};
+
+private:
+    bool borrowed_{true};
+};
@@ -1,11 +1,14 @@
 #include <string>
 #include <map>
+#include <algorithm>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <regex>
 #include <iostream>
+#include <thread>
+#include <optional>
 #include "IStorageService.h"
 #include "RequestAssembler.h"
 #include "ResponseParser.h"
@@ -14,17 +17,115 @@
 int IStorageService::get(const std::string &row_key, const std::string &column_key, tablet_value &value)
 {
     value.clear();
-    std::string request = RequestAssembler::assemble_get(row_key, column_key);
-    TryExecuteRequestParams params{
-        .command = KVServerCommand::GET,
-        .request = request,
-        .row_key = row_key,
-        .read_bytes_before_value = true};
-    std::string response = group_try_execute_request_(params);
-    if (response.empty())
-        return 1;
-    value = from_string(response);
-    return 0;
+    size_t value_size = 0;
+
+    // The value is received straight into value, which is allocated once its size is known
+    return get_range(row_key, column_key, 0, std::string::npos, [&value, &value_size](const std::byte *data, size_t size)
+                     {
+                         if (value.empty())
+                             value.reserve(value_size);
+                         value.insert(value.end(), data, data + size);
+                         return true; }, value_size, [&value]
+                     { value.clear(); });
+}
+
+int IStorageService::get_range(const std::string &row_key, const std::string &column_key, size_t offset, size_t length,
+                               const ValueSink &sink, size_t &value_size, const ValueRestart &restart)
+{
+    // Bytes already passed to sink, a retry resumes after them
+    size_t delivered = 0;
+    // Server that delivered them, a resumed transfer stays on it since replicas may not have applied the same writes
+    std::optional<KVServer> resume_server;
+    size_t resume_value_size = 0;
+
+    int max_tries = 2;
+    bool stale_retried = false;
+    for (int try_count = 0; try_count < max_tries; ++try_count)
+    {
+        bool reused = false;
+        try
+        {
+            PooledConnection connection(resume_server ? *resume_server : resolve_server_(row_key));
+            reused = connection.reused;
+            open_connection_(connection);
+            int sockfd = connection.sockfd;
+
+            // The whole value is requested with a plain GET
+            std::string request;
+            if (offset == 0 && length == std::string::npos && delivered == 0)
+                request = RequestAssembler::assemble_get(row_key, column_key);
+            else
+                request = RequestAssembler::assemble_get_range(row_key, column_key, offset + delivered,
+                                                               length == std::string::npos ? length : length - delivered);
+            if (write_message_(sockfd, request) == -1)
+                throw std::runtime_error("IStorageService: Failed sending data to KVStorage: " + std::string(strerror(errno)));
+
+            std::string bytes_response = read_response_(sockfd);
+            if (!is_success_response_(bytes_response))
+                throw std::runtime_error("IStorageService: Received error response from KVStorage: " + bytes_response);
+            size_t bytes = ResponseParser::parse_bytes(bytes_response);
+            value_size = ResponseParser::parse_value_size(bytes_response);
+            if (resume_server && value_size != resume_value_size)
+            {
+                fprintf(stderr, "IStorageService: Value changed while its transfer was interrupted\n");
+                return 1;
+            }
+
+            // The value is passed on in the pieces it is received in, its CRLF is dropped
+            char buffer[65536];
+            size_t received_total = 0;
+            while (received_total < bytes + 2)
+            {
+                ssize_t received = recv(sockfd, buffer, std::min(sizeof(buffer), bytes + 2 - received_total), 0);
+                if (received <= 0)
+                    throw std::runtime_error("IStorageService: Connection closed while receiving value\n");
+
+                size_t value_bytes = received_total < bytes ? std::min(static_cast<size_t>(received), bytes - received_total) : 0;
+                received_total += received;
+                if (value_bytes == 0)
+                    continue;
+
+                delivered += value_bytes;
+                reused = false;
+                if (!resume_server)
+                {
+                    resume_server = connection.server;
+                    resume_value_size = value_size;
+                }
+                if (!sink(reinterpret_cast<const std::byte *>(buffer), value_bytes))
+                    return 1; // The rest of the value is not read, so the connection is closed
+            }
+
+            connection.release();
+            return 0;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Runtime error occurred: " << e.what() << "\n";
+
+            // A connection closed by the server while it was idle is not an attempt
+            if (reused && !stale_retried)
+            {
+                stale_retried = true;
+                --try_count;
+                continue;
+            }
+
+            // With restart the transfer starts over and may move to another server
+            if (restart && resume_server)
+            {
+                restart();
+                delivered = 0;
+                resume_server.reset();
+            }
+
+            // Sleep for 100 ms (for cases where tablet splitting is in progress)
+            usleep(100000);
+        }
+    }
+
+    fprintf(stderr, "IStorageService: Failed to execute GET after %d attempts\n", max_tries);
+    return 1;
 }
 
 int IStorageService::get(const std::string &row_key, const std::string &column_key, tablet_value &value, const KVServer &server)
@@ -46,9 +147,25 @@ int IStorageService::get(const std::string &row_key, const std::string &column_k
     return 0;
 }
 
-int IStorageService::put(const std::string &row_key, const std::string &column_key, const tablet_value &value)
+int IStorageService::stat(const std::string &row_key, const std::string &column_key, ValueInfo &info)
+{
+    std::string request = RequestAssembler::assemble_stat(row_key, column_key);
+    TryExecuteRequestParams params{
+        .command = KVServerCommand::STAT,
+        .request = request,
+        .row_key = row_key};
+    std::string response = group_try_execute_request_(params);
+    if (response.empty())
+        return 1;
+
+    info = ResponseParser::parse_stat(response);
+    return 0;
+}
+
+int IStorageService::put(const std::string &row_key, const std::string &column_key, const tablet_value &value,
+                         WriteConsistency consistency)
 {
-    std::string request = RequestAssembler::assemble_put(row_key, column_key, value);
+    std::string request = RequestAssembler::assemble_put(row_key, column_key, value, consistency);
     TryExecuteRequestParams params{
         .command = KVServerCommand::PUT,
         .request = request,
@@ -59,10 +176,38 @@ int IStorageService::put(const std::string &row_key, const std::string &column_k
     return 0;
 }
 
+int IStorageService::multi_get(std::vector<KVCell> &cells)
+{
+    std::map<int, std::vector<KVCell *>> groups = group_cells_(cells);
+    for_each_group_(groups, [this](int group_id, std::vector<KVCell *> &group)
+                    { group_multi_get_(group_id, group); });
+
+    for (const KVCell &cell : cells)
+    {
+        if (!cell.success)
+            return 1;
+    }
+    return 0;
+}
+
+int IStorageService::multi_put(std::vector<KVCell> &cells, WriteConsistency consistency)
+{
+    std::map<int, std::vector<KVCell *>> groups = group_cells_(cells);
+    for_each_group_(groups, [this, consistency](int group_id, std::vector<KVCell *> &group)
+                    { group_multi_put_(group_id, group, consistency); });
+
+    for (const KVCell &cell : cells)
+    {
+        if (!cell.success)
+            return 1;
+    }
+    return 0;
+}
+
 int IStorageService::cput(const std::string &row_key, const std::string &column_key,
-                          const tablet_value &cvalue, const tablet_value &value, bool &result)
+                          const tablet_value &cvalue, const tablet_value &value, bool &result, WriteConsistency consistency)
 {
-    std::string request = RequestAssembler::assemble_cput(row_key, column_key, cvalue, value);
+    std::string request = RequestAssembler::assemble_cput(row_key, column_key, cvalue, value, consistency);
     TryExecuteRequestParams params{
         .command = KVServerCommand::CPUT,
         .request = request,
@@ -74,9 +219,10 @@ int IStorageService::cput(const std::string &row_key, const std::string &column_
     return 0;
 }
 
-int IStorageService::move(const std::string &row_key, const std::string &column_key, const std::string &new_column_key)
+int IStorageService::move(const std::string &row_key, const std::string &column_key, const std::string &new_column_key,
+                          WriteConsistency consistency)
 {
-    std::string request = RequestAssembler::assemble_move(row_key, column_key, new_column_key);
+    std::string request = RequestAssembler::assemble_move(row_key, column_key, new_column_key, consistency);
     TryExecuteRequestParams params{
         .command = KVServerCommand::MOVE,
         .request = request,
@@ -87,9 +233,9 @@ int IStorageService::move(const std::string &row_key, const std::string &column_
     return 0;
 }
 
-int IStorageService::remove(const std::string &row_key, const std::string &column_key)
+int IStorageService::remove(const std::string &row_key, const std::string &column_key, WriteConsistency consistency)
 {
-    std::string request = RequestAssembler::assemble_del(row_key, column_key);
+    std::string request = RequestAssembler::assemble_del(row_key, column_key, consistency);
     TryExecuteRequestParams params{
         .command = KVServerCommand::DEL,
         .request = request,
@@ -165,6 +311,24 @@ int IStorageService::list_columns(const std::string &row_key, std::set<std::stri
     return 0;
 }
 
+int IStorageService::list_columns(const std::string &row_key, std::map<std::string, ValueInfo> &columns)
+{
+    columns.clear();
+    std::string request = RequestAssembler::assemble_list_column_infos(row_key);
+    TryExecuteRequestParams params{
+        .command = KVServerCommand::LISTC,
+        .request = request,
+        .row_key = row_key,
+        .read_until_termination = "\r\n.\r\n"};
+    std::string response = group_try_execute_request_(params);
+    if (response.empty())
+        return 1;
+
+    columns = ResponseParser::parse_list_column_infos(response);
+
+    return 0;
+}
+
 int IStorageService::list_columns(const KVServer &server, const std::string &row_key, std::set<std::string> &columns)
 {
     columns.clear();
@@ -185,9 +349,9 @@ int IStorageService::list_columns(const KVServer &server, const std::string &row
     return 0;
 }
 
-int IStorageService::create_row(const std::string &row_key)
+int IStorageService::create_row(const std::string &row_key, WriteConsistency consistency)
 {
-    std::string request = RequestAssembler::assemble_create_row(row_key);
+    std::string request = RequestAssembler::assemble_create_row(row_key, consistency);
     TryExecuteRequestParams params{
         .command = KVServerCommand::CROW,
         .request = request,
@@ -237,151 +401,71 @@ int IStorageService::bring_up(const KVServer &server)
 
 BroadcastResult IStorageService::broadcast_put(const int rg_id, const std::string message_id, const std::string &row_key, const std::string &column_key, const tablet_value &value)
 {
-    std::vector<KVServer> live_servers = get_live_servers_(rg_id);
-
-    // Send out the request to all servers
-    std::map<std::string, int> status_codes;
-    std::map<std::string, std::string> results_strings;
-    for (const auto &server : live_servers)
-    {
-        std::string request = RequestAssembler::assemble_put(row_key, column_key, value);
-        TryExecuteRequestParams params{
-            .command = KVServerCommand::PUT,
-            .request = "#" + request, // Prepend with # to indicate it's a message comming from the primary node
-            .row_key = row_key,
-            .resolve_server_by_server = true,
-            .server = server};
-        std::string response = group_try_execute_request_(params);
-        if (response.empty())
-        {
-            status_codes[server.host + ":" + std::to_string(server.port)] = 1;
-            results_strings[server.host + ":" + std::to_string(server.port)] = "Error";
-        }
-        else
-        {
-            status_codes[server.host + ":" + std::to_string(server.port)] = 0;
-            results_strings[server.host + ":" + std::to_string(server.port)] = response;
-        }
-    }
+    return broadcast_(rg_id, message_id, KVServerCommand::PUT, RequestAssembler::assemble_put(row_key, column_key, value));
+}
 
-    return build_broadcast_result_(message_id, status_codes, results_strings);
+BroadcastResult IStorageService::broadcast_multi_put(const int rg_id, const std::string message_id, const std::vector<KVCell> &cells)
+{
+    std::vector<const KVCell *> request_cells;
+    for (const KVCell &cell : cells)
+        request_cells.push_back(&cell);
+    return broadcast_(rg_id, message_id, KVServerCommand::MPUT, RequestAssembler::assemble_multi_put(request_cells));
 }
 
 BroadcastResult IStorageService::broadcast_cput(const int rg_id, const std::string message_id, const std::string &row_key, const std::string &column_key, const tablet_value &cvalue,
                                                 const tablet_value &value)
 {
-    std::vector<KVServer> live_servers = get_live_servers_(rg_id);
-
-    // Send out the request to all servers
-    std::map<std::string, int> status_codes;
-    std::map<std::string, std::string> results_strings;
-    for (const auto &server : live_servers)
-    {
-        std::string request = RequestAssembler::assemble_cput(row_key, column_key, cvalue, value);
-        TryExecuteRequestParams params{
-            .command = KVServerCommand::CPUT,
-            .request = "#" + request, // Prepend with # to indicate it's a message comming from the primary node
-            .row_key = row_key,
-            .resolve_server_by_server = true,
-            .server = server};
-        std::string response = group_try_execute_request_(params);
-        if (response.empty())
-        {
-            status_codes[server.host + ":" + std::to_string(server.port)] = 1;
-            results_strings[server.host + ":" + std::to_string(server.port)] = "Error";
-        }
-        else
-        {
-            status_codes[server.host + ":" + std::to_string(server.port)] = 0;
-            results_strings[server.host + ":" + std::to_string(server.port)] = response;
-        }
-    }
-
-    return build_broadcast_result_(message_id, status_codes, results_strings);
+    return broadcast_(rg_id, message_id, KVServerCommand::CPUT, RequestAssembler::assemble_cput(row_key, column_key, cvalue, value));
 }
 
 BroadcastResult IStorageService::broadcast_move(const int rg_id, const std::string message_id, const std::string &row_key, const std::string &column_key, const std::string &new_column_key)
 {
-    std::vector<KVServer> live_servers = get_live_servers_(rg_id);
+    return broadcast_(rg_id, message_id, KVServerCommand::MOVE, RequestAssembler::assemble_move(row_key, column_key, new_column_key));
+}
 
-    // Send out the request to all servers
-    std::map<std::string, int> status_codes;
-    std::map<std::string, std::string> results_strings;
-    for (const auto &server : live_servers)
-    {
-        std::string request = RequestAssembler::assemble_move(row_key, column_key, new_column_key);
-        TryExecuteRequestParams params{
-            .command = KVServerCommand::MOVE,
-            .request = "#" + request, // Prepend with # to indicate it's a message comming from the primary node
-            .row_key = row_key,
-            .resolve_server_by_server = true,
-            .server = server};
-        std::string response = group_try_execute_request_(params);
-        if (response.empty())
-        {
-            status_codes[server.host + ":" + std::to_string(server.port)] = 1;
-            results_strings[server.host + ":" + std::to_string(server.port)] = "Error";
-        }
-        else
-        {
-            status_codes[server.host + ":" + std::to_string(server.port)] = 0;
-            results_strings[server.host + ":" + std::to_string(server.port)] = response;
-        }
-    }
+BroadcastResult IStorageService::broadcast_remove(const int rg_id, const std::string message_id, const std::string &row_key, const std::string &column_key)
+{
+    return broadcast_(rg_id, message_id, KVServerCommand::DEL, RequestAssembler::assemble_del(row_key, column_key));
+}
 
-    return build_broadcast_result_(message_id, status_codes, results_strings);
+BroadcastResult IStorageService::broadcast_create_row(const int rg_id, const std::string message_id, const std::string &row_key)
+{
+    return broadcast_(rg_id, message_id, KVServerCommand::CROW, RequestAssembler::assemble_create_row(row_key));
 }
 
-BroadcastResult IStorageService::broadcast_remove(const int rg_id, const std::string message_id, const std::string &row_key, const std::string &column_key)
+BroadcastResult IStorageService::broadcast_(const int rg_id, const std::string &message_id, const KVServerCommand command, const std::string &request)
 {
     std::vector<KVServer> live_servers = get_live_servers_(rg_id);
 
-    // Send out the request to all servers
-    std::map<std::string, int> status_codes;
-    std::map<std::string, std::string> results_strings;
-    for (const auto &server : live_servers)
+    // The request carries the value, so it is assembled once for all servers
+    const std::string primary_request = "#" + request; // Prepend with # to indicate it's a message comming from the primary node
+
+    // Send out the request to all servers at the same time, the broadcast takes as long as the slowest server
+    // instead of the sum of all of them. The first server is requested on the calling thread
+    std::vector<std::string> responses(live_servers.size());
+    auto send_to = [&](size_t index)
     {
-        std::string request = RequestAssembler::assemble_del(row_key, column_key);
         TryExecuteRequestParams params{
-            .command = KVServerCommand::DEL,
-            .request = "#" + request, // Prepend with # to indicate it's a message comming from the primary node
-            .row_key = row_key,
+            .command = command,
+            .request = primary_request,
             .resolve_server_by_server = true,
-            .server = server};
-        std::string response = group_try_execute_request_(params);
-        if (response.empty())
-        {
-            status_codes[server.host + ":" + std::to_string(server.port)] = 1;
-            results_strings[server.host + ":" + std::to_string(server.port)] = "Error";
-        }
-        else
-        {
-            status_codes[server.host + ":" + std::to_string(server.port)] = 0;
-            results_strings[server.host + ":" + std::to_string(server.port)] = response;
-        }
-    }
-
-    return build_broadcast_result_(message_id, status_codes, results_strings);
-}
-
-BroadcastResult IStorageService::broadcast_create_row(const int rg_id, const std::string message_id, const std::string &row_key)
-{
-    std::vector<KVServer> live_servers = get_live_servers_(rg_id);
+            .server = live_servers[index]};
+        responses[index] = group_try_execute_request_(params);
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < live_servers.size(); ++i)
+        threads.emplace_back(send_to, i);
+    if (!live_servers.empty())
+        send_to(0);
+    for (std::thread &thread : threads)
+        thread.join();
 
-    // Send out the request to all servers
     std::map<std::string, int> status_codes;
     std::map<std::string, std::string> results_strings;
-    for (const auto &server : live_servers)
+    for (size_t i = 0; i < live_servers.size(); ++i)
     {
-        std::string request = RequestAssembler::assemble_create_row(row_key);
-        TryExecuteRequestParams params{
-            .command = KVServerCommand::CROW,
-            .request = "#" + request, // Prepend with # to indicate it's a message comming from the primary node
-            .row_key = row_key,
-            .resolve_server_by_server = true,
-            .server = server};
-        std::string response = group_try_execute_request_(params);
-        if (response.empty())
+        const KVServer &server = live_servers[i];
+        if (responses[i].empty())
         {
             status_codes[server.host + ":" + std::to_string(server.port)] = 1;
             results_strings[server.host + ":" + std::to_string(server.port)] = "Error";
@@ -389,7 +473,7 @@ BroadcastResult IStorageService::broadcast_create_row(const int rg_id, const std
         else
         {
             status_codes[server.host + ":" + std::to_string(server.port)] = 0;
-            results_strings[server.host + ":" + std::to_string(server.port)] = response;
+            results_strings[server.host + ":" + std::to_string(server.port)] = responses[i];
         }
     }
 
@@ -412,57 +496,76 @@ std::string IStorageService::group_try_execute_request_(TryExecuteRequestParams
     const auto read_bytes_before_value = params.read_bytes_before_value;
     const auto read_until_termination = params.read_until_termination;
 
+    // Requests to the internal port and shutdowns do not leave a connection that can be used again
+    const bool keep_connection = params.with_welcome_message && params.command != KVServerCommand::SHUT_DOWN;
+
     int try_count = 0;
     int max_tries = 2; // NOTE: For all three attempts we will use a different server (picked randomly from the group)
-    int sockfd;
+    bool stale_retried = false;
+    int redirects = 0;
+    bool any_server = false;
     while (try_count < max_tries)
     {
+        bool reused = false;
         try
         {
-            // Get the server for the command
-            KVServer server = resolve_server_(params);
-
-            // Connect
-            sockfd = connect_to_server_(server);
-
-            // Welcome message (if it has one)
-            std::string welcome_response;
-            if (params.with_welcome_message)
-            {
-                welcome_response = read_response_(sockfd);
-            }
+            // Get the server for the command and a connection to it
+            PooledConnection connection(resolve_server_(params, any_server));
+            reused = connection.reused;
+            open_connection_(connection, params.with_welcome_message);
 
             // Send request
-            size_t bytes_sent = write_message_(sockfd, params.request);
+            size_t bytes_sent = write_message_(connection.sockfd, params.request);
             if (bytes_sent == -1)
                 throw std::runtime_error("IStorageService: Failed sending data to KVStorage: " + std::string(strerror(errno)));
 
             if (read_bytes_before_value)
             {
                 // Read Bytes Response
-                std::string bytes_response = read_response_(sockfd);
+                std::string bytes_response = read_response_(connection.sockfd);
                 if (!is_success_response_(bytes_response))
+                {
+                    // The error response was read completely
+                    reused = false;
+                    if (keep_connection)
+                        connection.release();
                     throw std::runtime_error("IStorageService: Received error response from KVStorage: " + bytes_response);
+                }
 
                 std::size_t bytes = ResponseParser::parse_bytes(bytes_response);
 
                 // Read Value Response
-                const std::string response = read_response_(sockfd, bytes);
+                const std::string response = read_response_(connection.sockfd, bytes);
 
-                close(sockfd);
+                if (keep_connection)
+                    connection.release();
 
                 return response;
             }
             else
             {
                 // Read Response
-                const std::string response = read_response_(sockfd, read_until_termination);
+                const std::string response = read_response_(connection.sockfd, read_until_termination);
 
                 // Validate response
                 if (!is_success_response_(response))
+                {
+                    reused = false;
+                    if (keep_connection)
+                        connection.release();
+
+                    // A replica answers a write with the primary it knows, the write is sent there right away
+                    if (redirects < MAX_WRITE_REDIRECTS && follow_redirect_(response))
+                    {
+                        ++redirects;
+                        any_server = false;
+                        continue;
+                    }
                     throw std::runtime_error("IStorageService: Received error response from KVStorage: " + response);
+                }
 
-                close(sockfd);
+                if (keep_connection)
+                    connection.release();
 
                 return response;
             }
@@ -471,16 +574,21 @@ std::string IStorageService::group_try_execute_request_(TryExecuteRequestParams
         {
             std::cerr << "Runtime error occurred: " << e.what() << "\n";
 
+            // A connection closed by the server while it was idle is not an attempt, the request is repeated on a
+            // new connection right away
+            if (reused && !stale_retried)
+            {
+                stale_retried = true;
+                continue;
+            }
+
             ++try_count;
 
+            // The primary may have failed, another server of the group redirects a write to its successor
+            any_server = true;
+
             // Sleep for 100 ms (for cases where tablet splitting is in progress)
             usleep(100000);
-
-            if (sockfd > 0)
-            {
-                // Attempt to close the socket if it was opened
-                close(sockfd);
-            }
         }
     }
 
@@ -501,22 +609,21 @@ std::vector<KVServer> IStorageService::get_live_servers_(const int rg_id)
     return live_servers;
 }
 
-KVServer IStorageService::resolve_server_(const TryExecuteRequestParams &params)
+KVServer IStorageService::resolve_server_(const TryExecuteRequestParams &params, bool any_server)
 {
     if (params.resolve_server_by_server)
     {
         return params.server;
     }
-    else if (params.resolve_server_by_group_id)
-    {
-        return resolve_server_(params.group_id);
-    }
 
     // Default is to resolve by row_key
-    return resolve_server_(params.row_key);
+    int group_id = params.resolve_server_by_group_id ? params.group_id : replication_group_(params.row_key);
+    if (is_write_(params.command) && !any_server)
+        return resolve_primary_(group_id);
+    return resolve_server_(group_id);
 }
 
-KVServer IStorageService::resolve_server_(const std::string &row_key)
+int IStorageService::replication_group_(const std::string &row_key)
 {
     if (kv_servers_map_.size() == 0)
     {
@@ -526,7 +633,12 @@ KVServer IStorageService::resolve_server_(const std::string &row_key)
     size_t rg_count = kv_servers_map_.size();
     size_t max = std::numeric_limits<size_t>::max();
     size_t hash = row_key.find('-') == std::string::npos ? std::stoull(row_key) : std::stoull(row_key.substr(0, row_key.find('-')));
-    int replication_group_id = hash / (max / rg_count);
+    return hash / (max / rg_count);
+}
+
+KVServer IStorageService::resolve_server_(const std::string &row_key)
+{
+    int replication_group_id = replication_group_(row_key);
 
     // Get the replication group
     std::vector<KVServer> servers = kv_servers_map_[replication_group_id];
@@ -578,6 +690,167 @@ KVServer IStorageService::resolve_server_(const int group_id)
     return alive_servers[random_index];
 }
 
+KVServer IStorageService::resolve_primary_(const int group_id)
+{
+    for (const KVServer &server : kv_servers_map_[group_id])
+    {
+        if (server.is_primary && server.is_alive)
+            return server;
+    }
+
+    // Any server of the group redirects to the primary it knows
+    return resolve_server_(group_id);
+}
+
+bool IStorageService::is_write_(KVServerCommand command)
+{
+    switch (command)
+    {
+    case KVServerCommand::CROW:
+    case KVServerCommand::PUT:
+    case KVServerCommand::CPUT:
+    case KVServerCommand::MPUT:
+    case KVServerCommand::MOVE:
+    case KVServerCommand::DEL:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool IStorageService::follow_redirect_(const std::string &response)
+{
+    std::string host;
+    int port;
+    if (!ResponseParser::parse_redirect(response, host, port))
+        return false;
+
+    for (auto &[group_id, servers] : kv_servers_map_)
+    {
+        auto primary = std::find_if(servers.begin(), servers.end(), [&host, port](const KVServer &server)
+                                    { return server.host == host && server.port == port; });
+        if (primary == servers.end())
+            continue;
+
+        for (KVServer &server : servers)
+            server.is_primary = &server == &*primary;
+        primary->is_alive = true;
+        return true;
+    }
+
+    fprintf(stderr, "IStorageService: Redirect to unknown server %s:%d\n", host.c_str(), port);
+    return false;
+}
+
+std::map<int, std::vector<KVCell *>> IStorageService::group_cells_(std::vector<KVCell> &cells)
+{
+    std::map<int, std::vector<KVCell *>> groups;
+    for (KVCell &cell : cells)
+    {
+        cell.success = false;
+        try
+        {
+            // The groups are requested on several threads, so they must all exist before (operator[] inserts)
+            int group_id = replication_group_(cell.row_key);
+            if (kv_servers_map_.find(group_id) == kv_servers_map_.end())
+                throw std::runtime_error("IStorageService: Replication group " + std::to_string(group_id) + " not found\n");
+            groups[group_id].push_back(&cell);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Runtime error occurred: " << e.what() << "\n";
+        }
+    }
+    return groups;
+}
+
+void IStorageService::for_each_group_(std::map<int, std::vector<KVCell *>> &groups, const std::function<void(int, std::vector<KVCell *> &)> &request)
+{
+    // The first group is requested on the calling thread
+    std::vector<std::thread> threads;
+    for (auto it = std::next(groups.begin(), groups.empty() ? 0 : 1); it != groups.end(); ++it)
+        threads.emplace_back(request, it->first, std::ref(it->second));
+    if (!groups.empty())
+        request(groups.begin()->first, groups.begin()->second);
+
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+void IStorageService::group_multi_get_(const int group_id, std::vector<KVCell *> &cells)
+{
+    std::string request = RequestAssembler::assemble_multi_get(std::vector<const KVCell *>(cells.begin(), cells.end()));
+
+    int max_tries = 2;
+    bool stale_retried = false;
+    for (int try_count = 0; try_count < max_tries; ++try_count)
+    {
+        bool reused = false;
+        try
+        {
+            PooledConnection connection(resolve_server_(group_id));
+            reused = connection.reused;
+            open_connection_(connection);
+            int sockfd = connection.sockfd;
+
+            if (write_message_(sockfd, request) == -1)
+                throw std::runtime_error("IStorageService: Failed sending data to KVStorage: " + std::string(strerror(errno)));
+
+            std::string count_response = read_response_(sockfd);
+            if (!is_success_response_(count_response))
+                throw std::runtime_error("IStorageService: Received error response from KVStorage: " + count_response);
+
+            // One GET response per cell in the order of the request
+            for (KVCell *cell : cells)
+            {
+                std::string bytes_response = read_response_(sockfd);
+                cell->success = is_success_response_(bytes_response);
+                if (cell->success)
+                    cell->value = from_string(read_response_(sockfd, ResponseParser::parse_bytes(bytes_response)));
+                else
+                    fprintf(stderr, "IStorageService: Failed to get %s %s: %s\n", cell->row_key.c_str(), cell->column_key.c_str(), bytes_response.c_str());
+            }
+
+            connection.release();
+            return;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Runtime error occurred: " << e.what() << "\n";
+            for (KVCell *cell : cells)
+                cell->success = false;
+
+            // A connection closed by the server while it was idle is not an attempt
+            if (reused && !stale_retried)
+            {
+                stale_retried = true;
+                --try_count;
+                continue;
+            }
+
+            // Sleep for 100 ms (for cases where tablet splitting is in progress)
+            usleep(100000);
+        }
+    }
+
+    fprintf(stderr, "IStorageService: Failed to execute MGET after %d attempts\n", max_tries);
+}
+
+void IStorageService::group_multi_put_(const int group_id, std::vector<KVCell *> &cells, WriteConsistency consistency)
+{
+    std::string request = RequestAssembler::assemble_multi_put(std::vector<const KVCell *>(cells.begin(), cells.end()), consistency);
+    TryExecuteRequestParams params{
+        .command = KVServerCommand::MPUT,
+        .request = request,
+        .resolve_server_by_group_id = true,
+        .group_id = group_id};
+
+    // The cells of a request share its response
+    bool success = !group_try_execute_request_(params).empty();
+    for (KVCell *cell : cells)
+        cell->success = success;
+}
+
 int IStorageService::connect_to_server_(const KVServer &server)
 {
     int sockfd = socket(AF_INET, SOCK_STREAM, 0);
@@ -591,11 +864,24 @@ int IStorageService::connect_to_server_(const KVServer &server)
     inet_pton(AF_INET, server.host.c_str(), &server_addr.sin_addr);
 
     if (connect(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+    {
+        close(sockfd);
         throw std::runtime_error("IStorageService: Failed to connect to server " + server.host + ":" + std::to_string(server.port) + "\n");
+    }
 
     return sockfd;
 }
 
+void IStorageService::open_connection_(PooledConnection &connection, bool with_welcome_message)
+{
+    if (connection.sockfd != -1)
+        return;
+
+    connection.sockfd = connect_to_server_(connection.server);
+    if (with_welcome_message)
+        read_response_(connection.sockfd);
+}
+
 std::string IStorageService::read_response_(const int sockfd, std::string termination)
 {
     // \r\n or for example \r\n.\r\n
@@ -613,10 +899,7 @@ std::string IStorageService::read_response_(const int sockfd, std::string termin
             throw std::runtime_error("IStorageService: Failed reading bytes from socket " + std::to_string(sockfd) + "\n");
 
         if (peek_bytes_received == 0)
-        {
-            fprintf(stderr, "IStorageService: Connection closed on socket %d\n", sockfd);
-            break; // Connection closed
-        }
+            throw std::runtime_error("IStorageService: Connection closed on socket " + std::to_string(sockfd) + "\n");
 
         std::string_view chunk(buffer, peek_bytes_received);
 
@@ -680,7 +963,7 @@ std::string IStorageService::read_response_(const int sockfd, const size_t bytes
     {
         // int bytes_received = recv(sockfd, buffer, sizeof(buffer) - 1, 0);
         int bytes_received = recv(sockfd, buffer, std::min(sizeof(buffer), 2 + bytes - total_bytes), 0);
-        if (bytes_received < 0)
+        if (bytes_received <= 0)
         {
             throw std::runtime_error("IStorageService: Failed reading bytes from socket " + std::to_string(sockfd) + "\n");
         }
@@ -757,3 +1040,199 @@ ssize_t IStorageService::write_message_(const int sockfd, const std::string &mes
 
     return total_bytes_written;
 }
+
+AsyncStorageSession::~AsyncStorageSession()
+{
+    // Connections with no responses left to read go back to the pool, the others are closed
+    for (auto &[server, connection] : connections_)
+    {
+        bool in_flight = !connection.requests.empty() || !connection.buffer.empty();
+        for (const auto &[tag, request] : requests_)
+            in_flight = in_flight || (request.server == server && !request.done);
+        if (!in_flight)
+            connection.pooled.release();
+    }
+}
+
+RequestTag AsyncStorageSession::get(const std::string &row_key, const std::string &column_key)
+{
+    return send_(row_key, RequestAssembler::assemble_get(row_key, column_key), true);
+}
+
+RequestTag AsyncStorageSession::put(const std::string &row_key, const std::string &column_key, const tablet_value &value)
+{
+    return send_(row_key, RequestAssembler::assemble_put(row_key, column_key, value), false);
+}
+
+RequestTag AsyncStorageSession::remove(const std::string &row_key, const std::string &column_key)
+{
+    return send_(row_key, RequestAssembler::assemble_del(row_key, column_key), false);
+}
+
+int AsyncStorageSession::wait(RequestTag tag)
+{
+    tablet_value value;
+    return wait(tag, value);
+}
+
+int AsyncStorageSession::wait(RequestTag tag, tablet_value &value)
+{
+    value.clear();
+    auto it = requests_.find(tag);
+    if (it == requests_.end())
+        return 1;
+
+    flush_();
+
+    // Responses of other requests read meanwhile are kept until they are waited for
+    while (!it->second.done)
+    {
+        auto connection = connections_.find(it->second.server);
+        if (connection == connections_.end() || !read_response_(connection->second))
+            fail_connection_(it->second.server);
+    }
+
+    bool success = it->second.success;
+    value = std::move(it->second.value);
+    requests_.erase(it);
+    return success ? 0 : 1;
+}
+
+RequestTag AsyncStorageSession::send_(const std::string &row_key, const std::string &request, bool reads_value)
+{
+    RequestTag tag = next_tag_++;
+    Request &pending = requests_[tag];
+    pending.reads_value = reads_value;
+
+    try
+    {
+        // Writes go to the primary, reads to any server of the row
+        KVServer server = reads_value ? storage_.resolve_server_(row_key) : storage_.resolve_primary_(storage_.replication_group_(row_key));
+        pending.server = server.host + ":" + std::to_string(server.port);
+
+        auto it = connections_.find(pending.server);
+        if (it == connections_.end())
+            it = connections_.emplace(pending.server, Connection{PooledConnection(server)}).first;
+        if (it->second.pooled.sockfd == -1)
+        {
+            it->second.pooled.sockfd = storage_.connect_to_server_(server);
+
+            // Welcome message
+            while (it->second.buffer.find("\r\n") == std::string::npos)
+            {
+                if (!receive_(it->second))
+                    throw std::runtime_error("IStorageService: Connection closed before welcome message\n");
+            }
+            it->second.buffer.erase(0, it->second.buffer.find("\r\n") + 2);
+        }
+
+        it->second.requests += "@" + std::to_string(tag) + " " + request;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Runtime error occurred: " << e.what() << "\n";
+        if (!pending.server.empty())
+            fail_connection_(pending.server);
+        pending.done = true;
+    }
+
+    return tag;
+}
+
+void AsyncStorageSession::flush_()
+{
+    std::vector<std::string> failed;
+    for (auto &[server, connection] : connections_)
+    {
+        if (connection.requests.empty())
+            continue;
+
+        if (storage_.write_message_(connection.pooled.sockfd, connection.requests) == -1)
+            failed.push_back(server);
+        connection.requests.clear();
+    }
+
+    for (const std::string &server : failed)
+        fail_connection_(server);
+}
+
+bool AsyncStorageSession::read_response_(Connection &connection)
+{
+    size_t line_end;
+    while ((line_end = connection.buffer.find("\r\n")) == std::string::npos)
+    {
+        if (!receive_(connection))
+            return false;
+    }
+
+    // @<tag> <response>
+    std::string line = connection.buffer.substr(0, line_end);
+    size_t space = line.find(' ');
+    if (line.empty() || line[0] != '@' || space == std::string::npos)
+    {
+        fprintf(stderr, "IStorageService: Untagged response %s\n", line.c_str());
+        return false;
+    }
+    RequestTag tag = std::stoul(line.substr(1, space - 1));
+    std::string response = line.substr(space + 1);
+    auto it = requests_.find(tag);
+    if (it == requests_.end())
+    {
+        fprintf(stderr, "IStorageService: Response to unknown request %zu\n", tag);
+        return false;
+    }
+
+    Request &request = it->second;
+    request.success = response.substr(0, 3) == "+OK";
+    size_t consumed = line_end + 2;
+    if (request.success && request.reads_value)
+    {
+        // The value and its CRLF follow the response line
+        size_t bytes = ResponseParser::parse_bytes(response);
+        while (connection.buffer.size() < consumed + bytes + 2)
+        {
+            if (!receive_(connection))
+                return false;
+        }
+        const std::byte *value = reinterpret_cast<const std::byte *>(connection.buffer.data() + consumed);
+        request.value.assign(value, value + bytes);
+        consumed += bytes + 2;
+    }
+    else if (!request.success)
+    {
+        // The request fails, later writes go to the primary named by a redirect
+        if (!storage_.follow_redirect_(response))
+            fprintf(stderr, "IStorageService: Received error response from KVStorage: %s\n", response.c_str());
+    }
+
+    connection.buffer.erase(0, consumed);
+    request.done = true;
+    return true;
+}
+
+bool AsyncStorageSession::receive_(Connection &connection)
+{
+    char buffer[16384];
+    ssize_t bytes_received = recv(connection.pooled.sockfd, buffer, sizeof(buffer), 0);
+    if (bytes_received <= 0)
+        return false;
+
+    connection.buffer.append(buffer, bytes_received);
+    return true;
+}
+
+void AsyncStorageSession::fail_connection_(const std::string &server)
+{
+    auto it = connections_.find(server);
+    if (it != connections_.end())
+        connections_.erase(it); // Closes the connection
+
+    for (auto &[tag, request] : requests_)
+    {
+        if (request.server == server && !request.done)
+        {
+            request.done = true;
+            request.success = false;
+        }
+    }
+}
@@ -5,11 +5,16 @@
 #include <set>
 #include <cstddef>
 #include <vector>
+#include <functional>
 #include "SharedStructures.h"
 #include "KVServerCommand.h"
+#include "ConnectionPool.h"
 
 typedef std::vector<std::byte> tablet_value;
 
+// Redirects to the primary a write follows before it counts as failed, both servers may still have stale primaries
+constexpr int MAX_WRITE_REDIRECTS{2};
+
 struct BroadcastResult
 {
     std::string initiator_address;                      // Address of the server that initiated the update request
@@ -20,6 +25,31 @@ struct BroadcastResult
     std::map<std::string, std::string> results_strings; // Map of server address to result strings
 };
 
+// Size of a value and the tablet version, the log version of the tablet storing it. Every write to the tablet
+// advances it, so the value did not change as long as the tablet version stays the same (it is not the version of
+// the value). Tablet versions are counted by each server on its own, so only those of the same server can be compared
+struct ValueInfo
+{
+    size_t size{0};
+    size_t tablet_version{0};
+};
+
+// Receives the bytes of a value in order as they arrive
+// Returns false to stop the transfer
+typedef std::function<bool(const std::byte *data, size_t size)> ValueSink;
+
+// Discards the bytes a sink received so far, the transfer starts over at the beginning of the range
+typedef std::function<void()> ValueRestart;
+
+// Cell read or written by a batched request
+struct KVCell
+{
+    std::string row_key;
+    std::string column_key;
+    tablet_value value;
+    bool success{false}; // Set once the cell was read or written
+};
+
 struct TryExecuteRequestParams
 {
     const KVServerCommand command; // Mandatory
@@ -42,6 +72,8 @@ struct TryExecuteRequestParams
  */
 class IStorageService
 {
+    friend class AsyncStorageSession;
+
 private:
     // Map to store the replication groups and their servers
     std::map<int, std::vector<KVServer>> kv_servers_map_;
@@ -49,8 +81,9 @@ private:
     // Executes the command on the server inside a try catch block (3 attempts)
     std::string group_try_execute_request_(TryExecuteRequestParams &params);
 
-    // Resolves the server based on the request parameters.
-    KVServer resolve_server_(const TryExecuteRequestParams &params);
+    // Resolves the server based on the request parameters. Writes go to the primary of the replication group
+    // unless any_server is set, e.g. after the primary failed to respond
+    KVServer resolve_server_(const TryExecuteRequestParams &params, bool any_server = false);
 
     // Picks a random server for a given row key
     KVServer resolve_server_(const std::string &row_key);
@@ -58,9 +91,37 @@ private:
     // Picks a random server for a given replication group
     KVServer resolve_server_(const int group_id);
 
+    // Picks the primary of a given replication group, or a random server if no live primary is known
+    KVServer resolve_primary_(const int group_id);
+
+    // Returns true if the command changes the stored values, these are applied by the primary
+    static bool is_write_(KVServerCommand command);
+
+    // Takes the server named by a redirect response as the primary of its replication group
+    // Returns false if the response is not a redirect to a known server
+    bool follow_redirect_(const std::string &response);
+
+    // Replication group storing a row key
+    int replication_group_(const std::string &row_key);
+
+    // Groups cells by the replication group of their row, a cell without a group fails right away
+    std::map<int, std::vector<KVCell *>> group_cells_(std::vector<KVCell> &cells);
+
+    // Executes request for every replication group on a thread of its own and waits for all of them
+    void for_each_group_(std::map<int, std::vector<KVCell *>> &groups, const std::function<void(int, std::vector<KVCell *> &)> &request);
+
+    // Reads the cells of a replication group with a single MGET request (2 attempts)
+    void group_multi_get_(const int group_id, std::vector<KVCell *> &cells);
+
+    // Writes the cells of a replication group with a single MPUT request (2 attempts)
+    void group_multi_put_(const int group_id, std::vector<KVCell *> &cells, WriteConsistency consistency);
+
     // Connects to the server and returns the socket file descriptor
     int connect_to_server_(const KVServer &server);
 
+    // Connects a connection taken from the pool without an idle connection and reads the welcome message
+    void open_connection_(PooledConnection &connection, bool with_welcome_message = true);
+
     // Reads the response from the server until termination
     std::string read_response_(const int sockfd, std::string termination = "\r\n");
 
@@ -79,6 +140,10 @@ private:
     // Write a message to the provided socket
     ssize_t write_message_(const int sockfd, const std::string &message);
 
+    // Sends request prefixed with # to all alive servers in the replication group in parallel and collects their
+    // responses
+    BroadcastResult broadcast_(const int rg_id, const std::string &message_id, const KVServerCommand command, const std::string &request);
+
 public:
     // Constructor
     IStorageService(std::map<int, std::vector<KVServer>> kv_servers_map)
@@ -99,26 +164,56 @@ public:
     // Returns 1 if error
     int get(const std::string &row_key, const std::string &column_key, tablet_value &value, const KVServer &server);
 
+    // Passes up to length bytes of the value in a given row and column key from offset on to sink as they arrive,
+    // the value is not buffered. value_size gets the size of the whole value before sink is called the first time.
+    // A transfer interrupted after sink received bytes starts over on any server after restart is called, so the
+    // bytes never mix replicas. Without restart it is resumed where it stopped on the same server, and fails if the
+    // size of the value changed meanwhile
+    // Returns 0 if successful
+    // Returns 1 if error or if sink stopped the transfer
+    int get_range(const std::string &row_key, const std::string &column_key, size_t offset, size_t length,
+                  const ValueSink &sink, size_t &value_size, const ValueRestart &restart = nullptr);
+
+    // Gets size and tablet version of the value in a given row and column key without transferring the value
+    // Returns 0 if successful
+    // Returns 1 if error
+    int stat(const std::string &row_key, const std::string &column_key, ValueInfo &info);
+
     // Puts value into a given row and column key
+    // consistency is the number of servers that must apply a write before it returns, see WriteConsistency
     // Returns 0 if successful
     // Returns 1 if error
-    int put(const std::string &row_key, const std::string &column_key, const tablet_value &value);
+    int put(const std::string &row_key, const std::string &column_key, const tablet_value &value,
+            WriteConsistency consistency = WriteConsistency::ALL);
+
+    // Gets the values of many cells, the cells of a replication group are read with a single request and the
+    // replication groups are requested in parallel. Sets value and success of every cell
+    // Returns 0 if all cells were read
+    // Returns 1 if error
+    int multi_get(std::vector<KVCell> &cells);
+
+    // Puts the values of many cells, the cells of a replication group are written with a single request and the
+    // replication groups are requested in parallel. Sets success of every cell
+    // Returns 0 if all cells were written
+    // Returns 1 if error
+    int multi_put(std::vector<KVCell> &cells, WriteConsistency consistency = WriteConsistency::ALL);
 
     // Conditional put updates value only if current value is equal to cvalue
     // Returns 0 if successful
     // Returns 1 if error
     int cput(const std::string &row_key, const std::string &column_key, const tablet_value &cvalue,
-             const tablet_value &value, bool &result);
+             const tablet_value &value, bool &result, WriteConsistency consistency = WriteConsistency::ALL);
 
     // Moves value from one column to another
     // Returns 0 if successful
     // Returns 1 if error
-    int move(const std::string &row_key, const std::string &column_key, const std::string &new_column_key);
+    int move(const std::string &row_key, const std::string &column_key, const std::string &new_column_key,
+             WriteConsistency consistency = WriteConsistency::ALL);
 
     // Removes value for a given row and column key
     // Returns 0 if successful
     // Returns 1 if error
-    int remove(const std::string &row_key, const std::string &column_key);
+    int remove(const std::string &row_key, const std::string &column_key, WriteConsistency consistency = WriteConsistency::ALL);
 
     // Retrieves all row keys as a set
     // Returns 0 if successful
@@ -135,6 +230,11 @@ public:
     // Returns 1 if error
     int list_columns(const std::string &row_key, std::set<std::string> &columns);
 
+    // Retrieves all column keys for a given row key with the sizes of their values and the tablet version
+    // Returns 0 if successful
+    // Returns 1 if error
+    int list_columns(const std::string &row_key, std::map<std::string, ValueInfo> &columns);
+
     // Retrieves all column keys for a given row key as a set for a specific server
     // Returns 0 if successful
     // Returns 1 if error
@@ -143,7 +243,7 @@ public:
     // Creates a new row with the given row key
     // Returns 0 if successful
     // Returns 1 if error
-    int create_row(const std::string &row_key);
+    int create_row(const std::string &row_key, WriteConsistency consistency = WriteConsistency::ALL);
 
     // Shuts down the server
     // Returns 0 if successful
@@ -159,6 +259,9 @@ public:
     // Broadcasts a put command to all alive servers in the replication group
     BroadcastResult broadcast_put(const int rg_id, const std::string message_id, const std::string &row_key, const std::string &column_key, const tablet_value &value);
 
+    // Broadcasts a multi put command to all alive servers in the replication group
+    BroadcastResult broadcast_multi_put(const int rg_id, const std::string message_id, const std::vector<KVCell> &cells);
+
     // Broadcasts a conditional put command to all alive servers in the replication group
     BroadcastResult broadcast_cput(const int rg_id, const std::string message_id, const std::string &row_key, const std::string &column_key, const tablet_value &cvalue,
                                    const tablet_value &value);
@@ -178,4 +281,88 @@ public:
 
     // Convenience function to convert string to tablet_value
     static tablet_value from_string(const std::string &value);
-};
\ No newline at end of file
+};
+
+// Identifies a request started on an AsyncStorageSession
+typedef size_t RequestTag;
+
+/*
+ * Keeps many requests in flight at once, e.g. all GETs needed to render an inbox
+ * Requests to the same server share one connection taken from the ConnectionPool. Each request carries a tag
+ * ("@<tag> <request>"), the server executes the requests of a connection concurrently and prefixes each response
+ * with the tag of its request, so responses are matched to their requests in any order. A session is used by one
+ * thread at a time.
+ */
+class AsyncStorageSession
+{
+private:
+    // Connection to a server, the requests not sent yet and the bytes received on it that were not parsed yet
+    struct Connection
+    {
+        PooledConnection pooled;
+        std::string requests;
+        std::string buffer;
+    };
+
+    // Request sent and its response once it arrived
+    struct Request
+    {
+        std::string server;
+        bool reads_value{false};
+        bool done{false};
+        bool success{false};
+        tablet_value value;
+    };
+
+    IStorageService &storage_;
+    // Connections by host:port of the server
+    std::map<std::string, Connection> connections_;
+    std::map<RequestTag, Request> requests_;
+    RequestTag next_tag_{0};
+
+    // Queues a tagged request for a server of the row, returns its tag
+    RequestTag send_(const std::string &row_key, const std::string &request, bool reads_value);
+
+    // Sends the queued requests of all connections, each with a single write
+    void flush_();
+
+    // Reads one tagged response and completes its request, returns false if the connection failed
+    bool read_response_(Connection &connection);
+
+    // Closes a failed connection, its requests still in flight fail
+    void fail_connection_(const std::string &server);
+
+    // Receives more bytes into the buffer of the connection
+    bool receive_(Connection &connection);
+
+public:
+    AsyncStorageSession(IStorageService &storage) : storage_(storage) {}
+
+    // Closes the connections of the session
+    ~AsyncStorageSession();
+
+    AsyncStorageSession(const AsyncStorageSession &) = delete;
+    AsyncStorageSession &operator=(const AsyncStorageSession &) = delete;
+
+    // Requests are queued and sent together once the session waits for one of them
+
+    // Sends a get request without waiting for its response
+    RequestTag get(const std::string &row_key, const std::string &column_key);
+
+    // Sends a put request without waiting for its response
+    // Writes are sent to the primary, a write redirected by a stale primary fails and the next one goes to the new primary
+    RequestTag put(const std::string &row_key, const std::string &column_key, const tablet_value &value);
+
+    // Sends a delete request without waiting for its response
+    RequestTag remove(const std::string &row_key, const std::string &column_key);
+
+    // Waits for the response of a request, value gets the value of a get request
+    // Returns 0 if successful
+    // Returns 1 if error
+    int wait(RequestTag tag, tablet_value &value);
+
+    // Waits for the response of a request
+    // Returns 0 if successful
+    // Returns 1 if error
+    int wait(RequestTag tag);
+};
@@ -10,6 +10,8 @@ std::string command_to_string(KVServerCommand cmd)
         return "SYNCF";
     case KVServerCommand::RW_RESULT:
         return "RW_RESULT";
+    case KVServerCommand::LOG:
+        return "LOG";
     case KVServerCommand::SHUT_DOWN:
         return "SHUT_DOWN";
     case KVServerCommand::BRING_UP:
@@ -20,6 +22,12 @@ std::string command_to_string(KVServerCommand cmd)
         return "PUT";
     case KVServerCommand::GET:
         return "GET";
+    case KVServerCommand::MPUT:
+        return "MPUT";
+    case KVServerCommand::MGET:
+        return "MGET";
+    case KVServerCommand::STAT:
+        return "STAT";
     case KVServerCommand::DEL:
         return "DEL";
     case KVServerCommand::LISTR:
@@ -28,6 +36,8 @@ std::string command_to_string(KVServerCommand cmd)
         return "LISTC";
     case KVServerCommand::LISTT:
         return "LISTT";
+    case KVServerCommand::CACHE:
+        return "CACHE";
     case KVServerCommand::ERR:
         return "ERR";
     case KVServerCommand::MOVE:
@@ -39,4 +49,31 @@ std::string command_to_string(KVServerCommand cmd)
     default:
         return "UNKNOWN";
     }
-}
\ No newline at end of file
+}
+
+std::string consistency_to_string(WriteConsistency consistency)
+{
+    switch (consistency)
+    {
+    case WriteConsistency::ONE:
+        return "ONE";
+    case WriteConsistency::QUORUM:
+        return "QUORUM";
+    case WriteConsistency::ALL:
+        return "ALL";
+    }
+    return "ALL";
+}
+
+bool string_to_consistency(const std::string &str, WriteConsistency &consistency)
+{
+    if (str == "ONE")
+        consistency = WriteConsistency::ONE;
+    else if (str == "QUORUM")
+        consistency = WriteConsistency::QUORUM;
+    else if (str == "ALL")
+        consistency = WriteConsistency::ALL;
+    else
+        return false;
+    return true;
+}
@@ -7,19 +7,37 @@ enum class KVServerCommand
     SYNCV,          // Retrieve version numbers for synchronization
     SYNCF,          // Retrieve files for synchronization
     RW_RESULT,      // Result of a remote write operation
+    LOG,            // Log records shipped by the primary
     SHUT_DOWN,      // Shut down the server
     BRING_UP,       // Bring server back up
     CROW,           // Create row
     CPUT,           // Conditional put
     PUT,            // Save value
     GET,            // Retrieve value
+    MPUT,           // Save values of several cells
+    MGET,           // Retrieve values of several cells
+    STAT,           // Retrieve size of value and tablet version
     DEL,            // Delete value
     LISTR,          // List rows
     LISTC,          // List columns
     LISTT,          // List tablets
+    CACHE,          // List tablet cache metrics
     ERR,            // Error
     MOVE,           // Move column
     QUIT            // Quit command
 };
 
-std::string command_to_string(KVServerCommand cmd);
\ No newline at end of file
+std::string command_to_string(KVServerCommand cmd);
+
+// Servers that must have applied a write before it succeeds, counting the primary of the replication group
+// A write always reaches all live servers, the ones not waited for apply it in the background
+enum class WriteConsistency
+{
+    ONE,    // The primary
+    QUORUM, // A majority of the servers of the replication group
+    ALL     // All live servers
+};
+
+std::string consistency_to_string(WriteConsistency consistency);
+// Returns false if str does not name a consistency level
+bool string_to_consistency(const std::string &str, WriteConsistency &consistency);
@@ -1,14 +1,28 @@
 #include "RequestAssembler.h"
 #include "IStorageService.h"
 
+namespace
+{
+    // Last argument of a write request, the server defaults to ALL
+    std::string consistency_argument(WriteConsistency consistency)
+    {
+        return consistency == WriteConsistency::ALL ? "" : " " + consistency_to_string(consistency);
+    }
+}
+
 std::string RequestAssembler::assemble_get(const std::string &row_key, const std::string &column_key)
 {
     return command_to_string(KVServerCommand::GET) + " " + row_key + " " + column_key + "\r\n";
 }
 
-std::string RequestAssembler::assemble_put(const std::string &row_key, const std::string &column_key, const tablet_value &value)
+std::string RequestAssembler::assemble_get_range(const std::string &row_key, const std::string &column_key, size_t offset, size_t length)
+{
+    return command_to_string(KVServerCommand::GET) + " " + row_key + " " + column_key + " " + std::to_string(offset) + " " + std::to_string(length) + "\r\n";
+}
+
+std::string RequestAssembler::assemble_put(const std::string &row_key, const std::string &column_key, const tablet_value &value, WriteConsistency consistency)
 {
-    std::string response{command_to_string(KVServerCommand::PUT) + " " + row_key + " " + column_key + " " + std::to_string(value.size()) + "\r\n"};
+    std::string response{command_to_string(KVServerCommand::PUT) + " " + row_key + " " + column_key + " " + std::to_string(value.size()) + consistency_argument(consistency) + "\r\n"};
     response.reserve(response.size() + value.size() + 2);
     response.append(reinterpret_cast<const char *>(value.data()), value.size());
     response.append("\r\n");
@@ -17,9 +31,9 @@ std::string RequestAssembler::assemble_put(const std::string &row_key, const std
 }
 
 std::string RequestAssembler::assemble_cput(const std::string &row_key, const std::string &column_key, const tablet_value &cvalue,
-                                            const tablet_value &value)
+                                            const tablet_value &value, WriteConsistency consistency)
 {
-    std::string response{command_to_string(KVServerCommand::CPUT) + " " + row_key + " " + column_key + " " + std::to_string(cvalue.size()) + " " + std::to_string(value.size())+ "\r\n"};
+    std::string response{command_to_string(KVServerCommand::CPUT) + " " + row_key + " " + column_key + " " + std::to_string(cvalue.size()) + " " + std::to_string(value.size()) + consistency_argument(consistency) + "\r\n"};
     response.reserve(response.size() + cvalue.size() + value.size() + 4);
     response.append(reinterpret_cast<const char *>(cvalue.data()), cvalue.size());
     response.append("\r\n");
@@ -29,14 +43,43 @@ std::string RequestAssembler::assemble_cput(const std::string &row_key, const st
     // return command_to_string(KVServerCommand::CPUT) + " " + row_key + " " + column_key + " " + std::to_string(cvalue.size()) + " " + std::to_string(value.size()) + "\r\n" + IStorageService::to_string(cvalue) + "\r\n" + IStorageService::to_string(value) + "\r\n";
 }
 
-std::string RequestAssembler::assemble_move(const std::string &row_key, const std::string &column_key, const std::string &new_column_key)
+std::string RequestAssembler::assemble_multi_get(const std::vector<const KVCell *> &cells)
 {
-    return command_to_string(KVServerCommand::MOVE) + " " + row_key + " " + column_key + " " + new_column_key + "\r\n";
+    std::string request{command_to_string(KVServerCommand::MGET)};
+    for (const KVCell *cell : cells)
+        request += " " + cell->row_key + " " + cell->column_key;
+    return request + "\r\n";
+}
+
+std::string RequestAssembler::assemble_multi_put(const std::vector<const KVCell *> &cells, WriteConsistency consistency)
+{
+    std::string request{command_to_string(KVServerCommand::MPUT)};
+    size_t values_size = 0;
+    for (const KVCell *cell : cells)
+    {
+        request += " " + cell->row_key + " " + cell->column_key + " " + std::to_string(cell->value.size());
+        values_size += cell->value.size() + 2;
+    }
+    request += consistency_argument(consistency) + "\r\n";
+
+    // The values follow the line in the order of their cells, each terminated by CRLF
+    request.reserve(request.size() + values_size);
+    for (const KVCell *cell : cells)
+    {
+        request.append(reinterpret_cast<const char *>(cell->value.data()), cell->value.size());
+        request.append("\r\n");
+    }
+    return request;
 }
 
-std::string RequestAssembler::assemble_del(const std::string &row_key, const std::string &column_key)
+std::string RequestAssembler::assemble_move(const std::string &row_key, const std::string &column_key, const std::string &new_column_key, WriteConsistency consistency)
 {
-    return command_to_string(KVServerCommand::DEL) + " " + row_key + " " + column_key + "\r\n";
+    return command_to_string(KVServerCommand::MOVE) + " " + row_key + " " + column_key + " " + new_column_key + consistency_argument(consistency) + "\r\n";
+}
+
+std::string RequestAssembler::assemble_del(const std::string &row_key, const std::string &column_key, WriteConsistency consistency)
+{
+    return command_to_string(KVServerCommand::DEL) + " " + row_key + " " + column_key + consistency_argument(consistency) + "\r\n";
 }
 
 std::string RequestAssembler::assemble_list_rows()
@@ -49,9 +92,19 @@ std::string RequestAssembler::assemble_list_columns(const std::string &row_key)
     return command_to_string(KVServerCommand::LISTC) + " " + row_key + "\r\n";
 }
 
-std::string RequestAssembler::assemble_create_row(const std::string &row_key)
+std::string RequestAssembler::assemble_list_column_infos(const std::string &row_key)
+{
+    return command_to_string(KVServerCommand::LISTC) + " " + row_key + " SIZES\r\n";
+}
+
+std::string RequestAssembler::assemble_stat(const std::string &row_key, const std::string &column_key)
+{
+    return command_to_string(KVServerCommand::STAT) + " " + row_key + " " + column_key + "\r\n";
+}
+
+std::string RequestAssembler::assemble_create_row(const std::string &row_key, WriteConsistency consistency)
 {
-    return command_to_string(KVServerCommand::CROW) + " " + row_key + "\r\n";
+    return command_to_string(KVServerCommand::CROW) + " " + row_key + consistency_argument(consistency) + "\r\n";
 }
 
 std::string RequestAssembler::assemble_shut_down()
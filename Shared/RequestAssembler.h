@@ -5,6 +5,7 @@
 #include <stdexcept>
 
 typedef std::vector<std::byte> tablet_value;
+struct KVCell;
 
 class RequestAssembler
 {
@@ -14,14 +15,22 @@ public:
     ~RequestAssembler() = default;
 
     static std::string assemble_get(const std::string &row_key, const std::string &column_key);
-    static std::string assemble_put(const std::string &row_key, const std::string &column_key, const tablet_value &value);
+    static std::string assemble_get_range(const std::string &row_key, const std::string &column_key, size_t offset, size_t length);
+    // Write requests carry their consistency level unless it is the default ALL
+    static std::string assemble_put(const std::string &row_key, const std::string &column_key, const tablet_value &value,
+                                    WriteConsistency consistency = WriteConsistency::ALL);
     static std::string assemble_cput(const std::string &row_key, const std::string &column_key, const tablet_value &cvalue,
-                                     const tablet_value &value);
-    static std::string assemble_move(const std::string &row_key, const std::string &column_key, const std::string &new_column_key);
-    static std::string assemble_del(const std::string &row_key, const std::string &column_key);
+                                     const tablet_value &value, WriteConsistency consistency = WriteConsistency::ALL);
+    static std::string assemble_multi_get(const std::vector<const KVCell *> &cells);
+    static std::string assemble_multi_put(const std::vector<const KVCell *> &cells, WriteConsistency consistency = WriteConsistency::ALL);
+    static std::string assemble_move(const std::string &row_key, const std::string &column_key, const std::string &new_column_key,
+                                     WriteConsistency consistency = WriteConsistency::ALL);
+    static std::string assemble_del(const std::string &row_key, const std::string &column_key, WriteConsistency consistency = WriteConsistency::ALL);
     static std::string assemble_list_rows();
     static std::string assemble_list_columns(const std::string &row_key);
-    static std::string assemble_create_row(const std::string &row_key);
+    static std::string assemble_list_column_infos(const std::string &row_key);
+    static std::string assemble_stat(const std::string &row_key, const std::string &column_key);
+    static std::string assemble_create_row(const std::string &row_key, WriteConsistency consistency = WriteConsistency::ALL);
     static std::string assemble_shut_down();
     static std::string assemble_bring_up();
 };
\ No newline at end of file
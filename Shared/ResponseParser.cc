@@ -1,5 +1,6 @@
 #include "ResponseParser.h"
 #include <regex>
+#include <sstream>
 
 std::string ResponseParser::parse_get(const std::string &response)
 {
@@ -54,11 +55,67 @@ std::set<std::string> ResponseParser::parse_list_columns(const std::string &resp
     return std::set<std::string>(rows.begin(), rows.end());
 }
 
+std::map<std::string, ValueInfo> ResponseParser::parse_list_column_infos(const std::string &response)
+{
+    std::map<std::string, ValueInfo> columns;
+    // Empty response case (row has no columns)
+    if (response == "+OK")
+    {
+        return columns;
+    }
+
+    // Example: "+OK\r\nc1 120 7\r\nc3 5 7\r\n"
+    for (const std::string &line : split_by_delimiter_(remove_prefix_(response, "+OK\r\n"), "\r\n"))
+    {
+        std::istringstream iss(line);
+        std::string column_key;
+        ValueInfo info;
+        if (iss >> column_key >> info.size >> info.tablet_version)
+            columns[column_key] = info;
+        else
+            fprintf(stderr, "ResponseParser Error: Invalid LISTC line format\n");
+    }
+    return columns;
+}
+
+ValueInfo ResponseParser::parse_stat(const std::string &response)
+{
+    // Example: "+OK 120 7"
+    ValueInfo info;
+    std::istringstream iss(remove_prefix_(response, "+OK "));
+    if (!(iss >> info.size >> info.tablet_version))
+        fprintf(stderr, "ResponseParser Error: Invalid STAT response format\n");
+    return info;
+}
+
 std::size_t ResponseParser::parse_bytes(const std::string &response)
 {
     return std::stoul(remove_prefix_(response, "+OK "));
 }
 
+std::size_t ResponseParser::parse_value_size(const std::string &response)
+{
+    // Example: "+OK 100 2000" for a range of a value, "+OK 2000" for the whole value
+    std::istringstream iss(remove_prefix_(response, "+OK "));
+    size_t bytes;
+    size_t value_size;
+    iss >> bytes;
+    return iss >> value_size ? value_size : bytes;
+}
+
+bool ResponseParser::parse_redirect(const std::string &response, std::string &host, int &port)
+{
+    // Example: "-ERR REDIRECT 127.0.0.1:8080"
+    std::regex re(R"(^-ERR REDIRECT (\S+):(\d+)$)");
+    std::smatch match;
+    if (!std::regex_match(response, match, re))
+        return false;
+
+    host = match[1].str();
+    port = std::stoi(match[2].str());
+    return true;
+}
+
 std::string ResponseParser::remove_prefix_(const std::string &input, const std::string prefix)
 {
     std::string::size_type pos = input.find(prefix);
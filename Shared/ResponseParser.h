@@ -1,6 +1,8 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <map>
+#include "IStorageService.h"
 
 class ResponseParser
 {
@@ -13,7 +15,12 @@ public:
     static bool parse_cput(const std::string &response);
     static std::set<std::string> parse_list_rows(const std::string &response);
     static std::set<std::string> parse_list_columns(const std::string &response);
+    static std::map<std::string, ValueInfo> parse_list_column_infos(const std::string &response);
+    static ValueInfo parse_stat(const std::string &response);
     static std::size_t parse_bytes(const std::string &response);
+    static std::size_t parse_value_size(const std::string &response);
+    // Returns false if the response is not a redirect to the primary of a replication group
+    static bool parse_redirect(const std::string &response, std::string &host, int &port);
 
 private:
     // Removes a prefix from the response